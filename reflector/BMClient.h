@@ -42,5 +42,5 @@ public:
 	bool IsAlive(void) const;
 
 	// reporting
-	void WriteXml(std::ofstream &) {}
+	void WriteXml(std::ostream &) {}
 };
@@ -28,13 +28,14 @@
 bool CBMProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
 	m_HasTranscoder = g_Configure.IsString(g_Keys.modules.tcmodules);
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = BM_KEEPALIVE_PERIOD;
+	m_PeerLinksPeriod = BM_RECONNECT_PERIOD;
+
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-	m_LastPeersLinkTime.start();
-
 	// done
 	return true;
 }
@@ -152,37 +153,15 @@ void CBMProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 			std::string title("Unknown XLX packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep alive
-	if ( m_LastKeepaliveTime.time() > BM_KEEPALIVE_PERIOD )
-	{
-		// handle keep alives
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
-
-	// peer connections
-	if ( m_LastPeersLinkTime.time() > BM_RECONNECT_PERIOD )
-	{
-		// handle remote peers connections
-		HandlePeerLinks();
-
-		// update time
-		m_LastPeersLinkTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -190,11 +169,10 @@ void CBMProtocol::Task(void)
 
 void CBMProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// encode it
 		CBuffer buffer;
 		if ( EncodeDvPacket(*packet, buffer) )
@@ -207,33 +185,33 @@ void CBMProtocol::HandleQueue(void)
 			}
 
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::bm, it)) != nullptr )
+			std::vector<CIp> ips, ipsLegacy;
+			for ( auto &client : GetSubscribers(EProtocol::bm, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
+					// no, add it to the destinations
 					// this is protocol revision dependent
 					switch ( client->GetProtocolRevision() )
 					{
 					case EProtoRev::original:
 					case EProtoRev::revised:
-						Send(bufferLegacy, client->GetIp());
+						ipsLegacy.push_back(client->GetIp());
 						break;
 					case EProtoRev::ambe:
 					default:
 						if (m_HasTranscoder)
-							Send(buffer, client->GetIp());
+							ips.push_back(client->GetIp());
 						else
-							Send(bufferLegacy, client->GetIp());
+							ipsLegacy.push_back(client->GetIp());
 						break;
 					}
 				}
 			}
-			g_Reflector.ReleaseClients();
+			Send(buffer, ips);
+			Send(bufferLegacy, ipsLegacy);
+			TraceSent(*packet);
 		}
 	}
 }
@@ -360,7 +338,7 @@ void CBMProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header, c
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 			// get origin
 			peer = client->GetCallsign();
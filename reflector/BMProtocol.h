@@ -70,9 +70,6 @@ protected:
 	bool EncodeDvFramePacket(const CDvFramePacket &, CBuffer &) const;
 
 protected:
-	// time
-	CTimer m_LastKeepaliveTime;
-	CTimer m_LastPeersLinkTime;
 	// config data;
 	bool m_HasTranscoder;
 };
@@ -20,12 +20,60 @@
 #include <cstdio>
 #include <cassert>
 #include <cstring>
+#include <array>
 
 #include "BPTC19696.h"
 
 #include "Hamming.h"
 #include "Utils.h"
 
+namespace
+{
+
+// where each deinterleaved bit is in the 33 byte burst, as shifts so the bits can be
+// moved without a branch on them
+struct SBPTCBit
+{
+	uint8_t byte, bit;
+	uint8_t row, column;
+};
+
+constexpr std::array<SBPTCBit, 195U> MakeInterleave()
+{
+	std::array<SBPTCBit, 195U> table {};
+	for (unsigned int a = 1U; a < 196U; a++)
+	{
+		// Calculate the interleave sequence
+		const unsigned int i = (a * 181U) % 196U;
+
+		// the raw bits are in bytes 0 to 12 and 20 to 32, with the sync between them
+		SBPTCBit b {};
+		if (i < 98U)
+		{
+			b.byte = uint8_t(i >> 3);
+			b.bit  = uint8_t(7U - (i & 7U));
+		}
+		else if (i < 100U)
+		{
+			b.byte = 20U;
+			b.bit  = uint8_t(99U - i);
+		}
+		else
+		{
+			b.byte = uint8_t(21U + ((i - 100U) >> 3));
+			b.bit  = uint8_t(7U - ((i - 100U) & 7U));
+		}
+		b.row    = uint8_t((a - 1U) / 15U);
+		b.column = uint8_t(14U - (a - 1U) % 15U);
+		table[a - 1U] = b;
+	}
+	return table;
+}
+
+constexpr std::array<SBPTCBit, 195U> INTERLEAVE = MakeInterleave();
+
+}
+
 CBPTC19696::CBPTC19696()
 {
 }
@@ -40,11 +88,8 @@ void CBPTC19696::decode(const unsigned char* in, unsigned char* out)
 	assert(in != nullptr);
 	assert(out != nullptr);
 
-	//  Get the raw binary
-	decodeExtractBinary(in);
-
-	// Deinterleave
-	decodeDeInterleave();
+	//  Get the raw binary and deinterleave it
+	decodeDeInterleave(in);
 
 	// Error check
 	decodeErrorCheck();
@@ -65,65 +110,17 @@ void CBPTC19696::encode(const unsigned char* in, unsigned char* out)
 	// Error check
 	encodeErrorCheck();
 
-	// Deinterleave
-	encodeInterleave();
-
-	//  Get the raw binary
-	encodeExtractBinary(out);
-}
-
-void CBPTC19696::decodeExtractBinary(const unsigned char* in)
-{
-	// First block
-	CUtils::byteToBitsBE(in[0U],  m_rawData + 0U);
-	CUtils::byteToBitsBE(in[1U],  m_rawData + 8U);
-	CUtils::byteToBitsBE(in[2U],  m_rawData + 16U);
-	CUtils::byteToBitsBE(in[3U],  m_rawData + 24U);
-	CUtils::byteToBitsBE(in[4U],  m_rawData + 32U);
-	CUtils::byteToBitsBE(in[5U],  m_rawData + 40U);
-	CUtils::byteToBitsBE(in[6U],  m_rawData + 48U);
-	CUtils::byteToBitsBE(in[7U],  m_rawData + 56U);
-	CUtils::byteToBitsBE(in[8U],  m_rawData + 64U);
-	CUtils::byteToBitsBE(in[9U],  m_rawData + 72U);
-	CUtils::byteToBitsBE(in[10U], m_rawData + 80U);
-	CUtils::byteToBitsBE(in[11U], m_rawData + 88U);
-	CUtils::byteToBitsBE(in[12U], m_rawData + 96U);
-
-	// Handle the two bits
-	bool bits[8U];
-	CUtils::byteToBitsBE(in[20U], bits);
-	m_rawData[98U] = bits[6U];
-	m_rawData[99U] = bits[7U];
-
-	// Second block
-	CUtils::byteToBitsBE(in[21U], m_rawData + 100U);
-	CUtils::byteToBitsBE(in[22U], m_rawData + 108U);
-	CUtils::byteToBitsBE(in[23U], m_rawData + 116U);
-	CUtils::byteToBitsBE(in[24U], m_rawData + 124U);
-	CUtils::byteToBitsBE(in[25U], m_rawData + 132U);
-	CUtils::byteToBitsBE(in[26U], m_rawData + 140U);
-	CUtils::byteToBitsBE(in[27U], m_rawData + 148U);
-	CUtils::byteToBitsBE(in[28U], m_rawData + 156U);
-	CUtils::byteToBitsBE(in[29U], m_rawData + 164U);
-	CUtils::byteToBitsBE(in[30U], m_rawData + 172U);
-	CUtils::byteToBitsBE(in[31U], m_rawData + 180U);
-	CUtils::byteToBitsBE(in[32U], m_rawData + 188U);
+	// Interleave it into the raw binary
+	encodeInterleave(out);
 }
 
 // Deinterleave the raw data
-void CBPTC19696::decodeDeInterleave()
+void CBPTC19696::decodeDeInterleave(const unsigned char* in)
 {
-	for (unsigned int i = 0U; i < 196U; i++)
-		m_deInterData[i] = false;
-
 	// The first bit is R(3) which is not used so can be ignored
-	for (unsigned int a = 0U; a < 196U; a++)
-	{
-		// Calculate the interleave sequence
-		unsigned int interleaveSequence = (a * 181U) % 196U;
-		// Shuffle the data
-		m_deInterData[a] = m_rawData[interleaveSequence];
-	}
+	memset(m_rows, 0, sizeof(m_rows));
+	for (const auto& b : INTERLEAVE)
+		m_rows[b.row] |= uint32_t((in[b.byte] >> b.bit) & 1U) << b.column;
 }
 
 // Check each row with a Hamming (15,11,3) code and each column with a Hamming (13,9,3) code
@@ -133,37 +130,13 @@ void CBPTC19696::decodeErrorCheck()
 	unsigned int count = 0U;
 	do
 	{
-		fixing = false;
-
-		// Run through each of the 15 columns
-		bool col[13U];
-		for (unsigned int c = 0U; c < 15U; c++)
-		{
-			unsigned int pos = c + 1U;
-			for (unsigned int a = 0U; a < 13U; a++)
-			{
-				col[a] = m_deInterData[pos];
-				pos = pos + 15U;
-			}
-
-			if (CHamming::decode1393(col))
-			{
-				unsigned int pos = c + 1U;
-				for (unsigned int a = 0U; a < 13U; a++)
-				{
-					m_deInterData[pos] = col[a];
-					pos = pos + 15U;
-				}
-
-				fixing = true;
-			}
-		}
+		// The rows are the 15 columns, a bit each
+		fixing = CHamming::decodeSliced1393(m_rows) != 0U;
 
 		// Run through each of the 9 rows containing data
 		for (unsigned int r = 0U; r < 9U; r++)
 		{
-			unsigned int pos = (r * 15U) + 1U;
-			if (CHamming::decode15113_2(m_deInterData + pos))
+			if (CHamming::decodeWord15113_2(m_rows[r]))
 				fixing = true;
 		}
 
@@ -172,183 +145,43 @@ void CBPTC19696::decodeErrorCheck()
 	while (fixing && count < 5U);
 }
 
-// Extract the 96 bits of payload
+// Extract the 96 bits of payload, 8 from the first row and 11 from the next 8
 void CBPTC19696::decodeExtractData(unsigned char* data) const
 {
-	bool bData[96U];
-	unsigned int pos = 0U;
-	for (unsigned int a = 4U; a <= 11U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 16U; a <= 26U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 31U; a <= 41U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 46U; a <= 56U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 61U; a <= 71U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 76U; a <= 86U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 91U; a <= 101U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 106U; a <= 116U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	for (unsigned int a = 121U; a <= 131U; a++, pos++)
-		bData[pos] = m_deInterData[a];
-
-	CUtils::bitsToByteBE(bData + 0U,  data[0U]);
-	CUtils::bitsToByteBE(bData + 8U,  data[1U]);
-	CUtils::bitsToByteBE(bData + 16U, data[2U]);
-	CUtils::bitsToByteBE(bData + 24U, data[3U]);
-	CUtils::bitsToByteBE(bData + 32U, data[4U]);
-	CUtils::bitsToByteBE(bData + 40U, data[5U]);
-	CUtils::bitsToByteBE(bData + 48U, data[6U]);
-	CUtils::bitsToByteBE(bData + 56U, data[7U]);
-	CUtils::bitsToByteBE(bData + 64U, data[8U]);
-	CUtils::bitsToByteBE(bData + 72U, data[9U]);
-	CUtils::bitsToByteBE(bData + 80U, data[10U]);
-	CUtils::bitsToByteBE(bData + 88U, data[11U]);
+	CUtils::writeBitsBE(data, 0U, 8U, (m_rows[0U] >> 4) & 0xFFU);
+	for (unsigned int r = 1U; r < 9U; r++)
+		CUtils::writeBitsBE(data, 8U + (r - 1U) * 11U, 11U, (m_rows[r] >> 4) & 0x7FFU);
 }
 
 // Extract the 96 bits of payload
 void CBPTC19696::encodeExtractData(const unsigned char* in)
 {
-	bool bData[96U];
-	CUtils::byteToBitsBE(in[0U],  bData + 0U);
-	CUtils::byteToBitsBE(in[1U],  bData + 8U);
-	CUtils::byteToBitsBE(in[2U],  bData + 16U);
-	CUtils::byteToBitsBE(in[3U],  bData + 24U);
-	CUtils::byteToBitsBE(in[4U],  bData + 32U);
-	CUtils::byteToBitsBE(in[5U],  bData + 40U);
-	CUtils::byteToBitsBE(in[6U],  bData + 48U);
-	CUtils::byteToBitsBE(in[7U],  bData + 56U);
-	CUtils::byteToBitsBE(in[8U],  bData + 64U);
-	CUtils::byteToBitsBE(in[9U],  bData + 72U);
-	CUtils::byteToBitsBE(in[10U], bData + 80U);
-	CUtils::byteToBitsBE(in[11U], bData + 88U);
-
-	for (unsigned int i = 0U; i < 196U; i++)
-		m_deInterData[i] = false;
-
-	unsigned int pos = 0U;
-	for (unsigned int a = 4U; a <= 11U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 16U; a <= 26U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 31U; a <= 41U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 46U; a <= 56U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 61U; a <= 71U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 76U; a <= 86U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 91U; a <= 101U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 106U; a <= 116U; a++, pos++)
-		m_deInterData[a] = bData[pos];
-
-	for (unsigned int a = 121U; a <= 131U; a++, pos++)
-		m_deInterData[a] = bData[pos];
+	memset(m_rows, 0, sizeof(m_rows));
+	m_rows[0U] = CUtils::readBitsBE(in, 0U, 8U) << 4;
+	for (unsigned int r = 1U; r < 9U; r++)
+		m_rows[r] = CUtils::readBitsBE(in, 8U + (r - 1U) * 11U, 11U) << 4;
 }
 
 // Check each row with a Hamming (15,11,3) code and each column with a Hamming (13,9,3) code
 void CBPTC19696::encodeErrorCheck()
 {
-
 	// Run through each of the 9 rows containing data
 	for (unsigned int r = 0U; r < 9U; r++)
-	{
-		unsigned int pos = (r * 15U) + 1U;
-		CHamming::encode15113_2(m_deInterData + pos);
-	}
-
-	// Run through each of the 15 columns
-	bool col[13U];
-	for (unsigned int c = 0U; c < 15U; c++)
-	{
-		unsigned int pos = c + 1U;
-		for (unsigned int a = 0U; a < 13U; a++)
-		{
-			col[a] = m_deInterData[pos];
-			pos = pos + 15U;
-		}
+		m_rows[r] = CHamming::encodeWord15113_2(m_rows[r]);
 
-		CHamming::encode1393(col);
-
-		pos = c + 1U;
-		for (unsigned int a = 0U; a < 13U; a++)
-		{
-			m_deInterData[pos] = col[a];
-			pos = pos + 15U;
-		}
-	}
+	// and all of the 15 columns
+	CHamming::encodeSliced1393(m_rows);
 }
 
 // Interleave the raw data
-void CBPTC19696::encodeInterleave()
+void CBPTC19696::encodeInterleave(unsigned char* data) const
 {
-	for (unsigned int i = 0U; i < 196U; i++)
-		m_rawData[i] = false;
-
-	// The first bit is R(3) which is not used so can be ignored
-	for (unsigned int a = 0U; a < 196U; a++)
-	{
-		// Calculate the interleave sequence
-		unsigned int interleaveSequence = (a * 181U) % 196U;
-		// Unshuffle the data
-		m_rawData[interleaveSequence] = m_deInterData[a];
-	}
-}
-
-void CBPTC19696::encodeExtractBinary(unsigned char* data)
-{
-	// First block
-	CUtils::bitsToByteBE(m_rawData + 0U,  data[0U]);
-	CUtils::bitsToByteBE(m_rawData + 8U,  data[1U]);
-	CUtils::bitsToByteBE(m_rawData + 16U, data[2U]);
-	CUtils::bitsToByteBE(m_rawData + 24U, data[3U]);
-	CUtils::bitsToByteBE(m_rawData + 32U, data[4U]);
-	CUtils::bitsToByteBE(m_rawData + 40U, data[5U]);
-	CUtils::bitsToByteBE(m_rawData + 48U, data[6U]);
-	CUtils::bitsToByteBE(m_rawData + 56U, data[7U]);
-	CUtils::bitsToByteBE(m_rawData + 64U, data[8U]);
-	CUtils::bitsToByteBE(m_rawData + 72U, data[9U]);
-	CUtils::bitsToByteBE(m_rawData + 80U, data[10U]);
-	CUtils::bitsToByteBE(m_rawData + 88U, data[11U]);
-
-	// Handle the two bits
-	unsigned char byte;
-	CUtils::bitsToByteBE(m_rawData + 96U, byte);
-	data[12U] = (data[12U] & 0x3FU) | ((byte >> 0) & 0xC0U);
-	data[20U] = (data[20U] & 0xFCU) | ((byte >> 4) & 0x03U);
-
-	// Second block
-	CUtils::bitsToByteBE(m_rawData + 100U,  data[21U]);
-	CUtils::bitsToByteBE(m_rawData + 108U,  data[22U]);
-	CUtils::bitsToByteBE(m_rawData + 116U,  data[23U]);
-	CUtils::bitsToByteBE(m_rawData + 124U,  data[24U]);
-	CUtils::bitsToByteBE(m_rawData + 132U,  data[25U]);
-	CUtils::bitsToByteBE(m_rawData + 140U,  data[26U]);
-	CUtils::bitsToByteBE(m_rawData + 148U,  data[27U]);
-	CUtils::bitsToByteBE(m_rawData + 156U,  data[28U]);
-	CUtils::bitsToByteBE(m_rawData + 164U,  data[29U]);
-	CUtils::bitsToByteBE(m_rawData + 172U,  data[30U]);
-	CUtils::bitsToByteBE(m_rawData + 180U,  data[31U]);
-	CUtils::bitsToByteBE(m_rawData + 188U,  data[32U]);
+	// bytes 12 and 20 are shared with the sync
+	memset(data, 0, 12U);
+	data[12U] &= 0x3FU;
+	data[20U] &= 0xFCU;
+	memset(data + 21U, 0, 12U);
+
+	for (const auto& b : INTERLEAVE)
+		data[b.byte] |= uint8_t(((m_rows[b.row] >> b.column) & 1U) << b.bit);
 }
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 class CBPTC19696
 {
 public:
@@ -29,16 +31,15 @@ public:
 	void encode(const unsigned char* in, unsigned char* out);
 
 private:
-	bool m_rawData[196];
-	bool m_deInterData[196];
+	// the deinterleaved bits, 13 rows of 15, the first column in bit 14 and
+	// R(3), the bit before the first row, left out
+	uint32_t m_rows[13];
 
-	void decodeExtractBinary(const unsigned char* in);
+	void decodeDeInterleave(const unsigned char* in);
 	void decodeErrorCheck();
-	void decodeDeInterleave();
 	void decodeExtractData(unsigned char* data) const;
 
 	void encodeExtractData(const unsigned char* in);
-	void encodeInterleave();
 	void encodeErrorCheck();
-	void encodeExtractBinary(unsigned char* data);
+	void encodeInterleave(unsigned char* data) const;
 };
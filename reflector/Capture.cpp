@@ -0,0 +1,241 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+
+#include "Capture.h"
+#include "Metrics.h"
+
+#define CAPTURE_FILE_BUFFER 65536
+
+////////////////////////////////////////////////////////////////////////////////////////
+// records
+
+static CSlabPool *RecordPool(void)
+{
+	static CSlabPool *pool = CSlabPool::Create("Capture records", sizeof(SCaptureRecord));
+	return pool;
+}
+
+void *SCaptureRecord::operator new(size_t size)
+{
+	return RecordPool()->Get(size);
+}
+
+void SCaptureRecord::operator delete(void *p, size_t size)
+{
+	RecordPool()->Put(p, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// writer
+
+CCapture::CCapture() : m_File(nullptr), m_Open(false), m_Queue(CAPTURE_QUEUE_DEPTH, EQueuePolicy::backpressure), m_Records(0), m_Bytes(0), m_Errors(0) {}
+
+CCapture::~CCapture()
+{
+	Close();
+}
+
+bool CCapture::Open(const std::string &path)
+{
+	m_File = fopen(path.c_str(), "wb");
+	if (nullptr == m_File)
+	{
+		std::cerr << "ERROR: could not open capture file " << path << ": " << strerror(errno) << std::endl;
+		return true;
+	}
+	setvbuf(m_File, nullptr, _IOFBF, CAPTURE_FILE_BUFFER);
+	if (1 != fwrite(CAPTURE_MAGIC, 8, 1, m_File))
+	{
+		std::cerr << "ERROR: could not write capture file " << path << ": " << strerror(errno) << std::endl;
+		fclose(m_File);
+		m_File = nullptr;
+		return true;
+	}
+	m_Path.assign(path);
+
+	CMetrics::CounterFn("urfd_capture_records_total", "Datagrams written to the capture file", "", this, [this]() { return double(m_Records.load()); });
+	CMetrics::CounterFn("urfd_capture_bytes_total", "Bytes written to the capture file", "", this, [this]() { return double(m_Bytes.load()); });
+	CMetrics::CounterFn("urfd_capture_dropped_total", "Datagrams the capture writer couldn't keep up with", "", this, [this]() { SQueueStats s; m_Queue.GetStats(s); return double(s.dropped); });
+
+	m_Open = true;
+	try
+	{
+		m_Future = std::async(std::launch::async, &CCapture::Thread, this);
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << "ERROR: could not start the capture thread: " << e.what() << std::endl;
+		Close();
+		return true;
+	}
+	std::cout << "Capturing the received datagrams to " << path << std::endl;
+	return false;
+}
+
+void CCapture::Close(void)
+{
+	if (! m_Open)
+		return;
+	m_Open = false;
+	m_Queue.Wake();
+	if (m_Future.valid())
+		m_Future.get();
+	CMetrics::Remove(this);
+
+	// what came in before it was closed
+	while (auto record = m_Queue.Pop())
+		Write(*record);
+	fclose(m_File);
+	m_File = nullptr;
+
+	SQueueStats stats;
+	m_Queue.GetStats(stats);
+	std::cout << "Capture " << m_Path << " closed with " << m_Records << " datagrams, " << stats.dropped << " dropped and " << m_Errors << " write errors" << std::endl;
+}
+
+void CCapture::Record(EProtocol protocol, const CIp &ip, uint64_t time, const CBuffer &buf)
+{
+	if (! m_Open.load(std::memory_order_relaxed) || buf.size() > UDP_BUFFER_LENMAX)
+		return;
+
+	std::unique_ptr<SCaptureRecord> record(new SCaptureRecord);
+	record->protocol = protocol;
+	record->ip = ip;
+	record->time = time;
+	record->size = uint16_t(buf.size());
+	memcpy(record->data, buf.data(), buf.size());
+	m_Queue.Push(std::move(record));
+}
+
+void CCapture::Thread(void)
+{
+	while (m_Open)
+	{
+		auto record = m_Queue.PopWait(100);
+		if (record)
+			Write(*record);
+		else
+			fflush(m_File);
+	}
+}
+
+// true on failure
+bool CCapture::Write(const SCaptureRecord &record)
+{
+	SCaptureHeader header;
+	memset(&header, 0, sizeof(header));
+	header.time = record.time;
+	header.protocol = uint8_t(record.protocol);
+	header.port = record.ip.GetPort();
+	header.size = record.size;
+	if (AF_INET == record.ip.GetFamily())
+	{
+		header.family = 4;
+		memcpy(header.addr, &((const struct sockaddr_in *)record.ip.GetCPointer())->sin_addr, 4);
+	}
+	else
+	{
+		header.family = 6;
+		memcpy(header.addr, &((const struct sockaddr_in6 *)record.ip.GetCPointer())->sin6_addr, 16);
+	}
+
+	if (1 != fwrite(&header, sizeof(header), 1, m_File) || (record.size && 1 != fwrite(record.data, record.size, 1, m_File)))
+	{
+		if (0 == m_Errors++)
+			std::cerr << "ERROR: writing capture file " << m_Path << ": " << strerror(errno) << std::endl;
+		return true;
+	}
+	m_Records++;
+	m_Bytes += sizeof(header) + record.size;
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// reader
+
+CCaptureReader::CCaptureReader() : m_File(nullptr) {}
+
+CCaptureReader::~CCaptureReader()
+{
+	Close();
+}
+
+bool CCaptureReader::Open(const std::string &path)
+{
+	m_File = fopen(path.c_str(), "rb");
+	if (nullptr == m_File)
+	{
+		std::cerr << "ERROR: could not open capture file " << path << ": " << strerror(errno) << std::endl;
+		return true;
+	}
+	setvbuf(m_File, nullptr, _IOFBF, CAPTURE_FILE_BUFFER);
+	char magic[8];
+	if (1 != fread(magic, 8, 1, m_File) || memcmp(magic, CAPTURE_MAGIC, 8))
+	{
+		std::cerr << "ERROR: " << path << " is not an urfd capture file" << std::endl;
+		Close();
+		return true;
+	}
+	m_Path.assign(path);
+	return false;
+}
+
+void CCaptureReader::Close(void)
+{
+	if (m_File)
+	{
+		fclose(m_File);
+		m_File = nullptr;
+	}
+}
+
+std::unique_ptr<SCaptureRecord> CCaptureReader::Next(void)
+{
+	SCaptureHeader header;
+	if (nullptr == m_File || 1 != fread(&header, sizeof(header), 1, m_File))
+		return nullptr;
+
+	if (header.size > UDP_BUFFER_LENMAX || header.protocol > uint8_t(EProtocol::m17) || (4 != header.family && 6 != header.family))
+	{
+		std::cerr << "ERROR: " << m_Path << " has a damaged record at offset " << ftell(m_File) - long(sizeof(header)) << std::endl;
+		return nullptr;
+	}
+
+	std::unique_ptr<SCaptureRecord> record(new SCaptureRecord);
+	record->protocol = EProtocol(header.protocol);
+	record->time = header.time;
+	record->size = header.size;
+	if (4 == header.family)
+	{
+		record->ip.Initialize(AF_INET, header.port, "any");
+		memcpy(&((struct sockaddr_in *)record->ip.GetPointer())->sin_addr, header.addr, 4);
+	}
+	else
+	{
+		record->ip.Initialize(AF_INET6, header.port, "any");
+		memcpy(&((struct sockaddr_in6 *)record->ip.GetPointer())->sin6_addr, header.addr, 16);
+	}
+	if (header.size && 1 != fread(record->data, header.size, 1, m_File))
+	{
+		std::cerr << "ERROR: " << m_Path << " ends in the middle of a record" << std::endl;
+		return nullptr;
+	}
+	return record;
+}
@@ -0,0 +1,122 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "Defines.h"
+#include "IP.h"
+#include "Buffer.h"
+#include "UDPSocket.h"
+#include "RingQueue.h"
+#include "SlabPool.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define CAPTURE_MAGIC       "URFDCAP1"  // the file starts with these 8 bytes
+#define CAPTURE_QUEUE_DEPTH 4096        // datagrams waiting for the writer, more than that are dropped
+
+////////////////////////////////////////////////////////////////////////////////////////
+// file format
+
+// After the magic, every datagram is a record header followed by its bytes, all in the
+// byte order of the machine that wrote it. The protocol is an EProtocol, so a capture
+// can only be replayed by a build with the same protocol list.
+struct SCaptureHeader
+{
+	uint64_t time;          // when it was received, CLOCK_MONOTONIC in ns
+	uint8_t  protocol;      // EProtocol
+	uint8_t  family;        // 4 or 6
+	uint16_t port;          // the source port
+	uint8_t  addr[16];      // the source address, only the first 4 bytes for IPv4
+	uint16_t size;          // the bytes that follow
+} __attribute__((packed));
+
+// one datagram, in memory
+struct SCaptureRecord
+{
+	EProtocol protocol;
+	CIp       ip;
+	uint64_t  time;
+	uint16_t  size;
+	uint8_t   data[UDP_BUFFER_LENMAX];
+
+	// they come from a pool, the writer would otherwise be a heap allocation per datagram
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// writer
+
+// Records every datagram the protocols receive. Record() only copies the datagram into
+// a queue, the writer thread does the file i/o. If the writer falls behind, the queue
+// refuses what doesn't fit and it's counted as dropped, a protocol thread never waits.
+
+class CCapture
+{
+public:
+	CCapture();
+	~CCapture();
+
+	// true on failure
+	bool Open(const std::string &path);
+	void Close(void);
+	bool IsOpen(void) const { return m_Open.load(std::memory_order_relaxed); }
+
+	// any protocol thread
+	void Record(EProtocol protocol, const CIp &ip, uint64_t time, const CBuffer &buf);
+
+protected:
+	void Thread(void);
+	bool Write(const SCaptureRecord &record);
+
+	// data
+	std::string m_Path;
+	FILE *m_File;
+	std::atomic<bool> m_Open;
+	CRingQueue<std::unique_ptr<SCaptureRecord>> m_Queue;
+	std::future<void> m_Future;
+	std::atomic<uint64_t> m_Records, m_Bytes, m_Errors;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// reader
+
+class CCaptureReader
+{
+public:
+	CCaptureReader();
+	~CCaptureReader();
+
+	// true on failure
+	bool Open(const std::string &path);
+	void Close(void);
+
+	// the next record, nullptr at the end of the file or on a damaged record
+	std::unique_ptr<SCaptureRecord> Next(void);
+
+protected:
+	FILE *m_File;
+	std::string m_Path;
+};
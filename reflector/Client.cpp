@@ -18,7 +18,7 @@
 
 
 #include <string.h>
-#include "Client.h"
+#include "Clients.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -27,6 +27,7 @@
 CClient::CClient()
 {
 	m_ReflectorModule = ' ';
+	m_Registry = nullptr;
 	m_ModuleMastered = ' ';
 	m_LastKeepaliveTime.start();
 	m_ConnectTime = std::time(nullptr);
@@ -36,6 +37,7 @@ CClient::CClient()
 CClient::CClient(const CCallsign &callsign, const CIp &ip, char reflectorModule)
 {
 	m_ReflectorModule = reflectorModule;
+	m_Registry = nullptr;
 	m_Callsign = callsign;
 	m_Ip = ip;
 	m_ModuleMastered = ' ';
@@ -49,12 +51,28 @@ CClient::CClient(const CClient &client)
 	m_Callsign = client.m_Callsign;
 	m_Ip = client.m_Ip;
 	m_ReflectorModule = client.m_ReflectorModule;
-	m_ModuleMastered = client.m_ModuleMastered;
+	m_Registry = nullptr;
+	m_ModuleMastered = client.m_ModuleMastered.load();
 	m_LastKeepaliveTime = client.m_LastKeepaliveTime;
 	m_ConnectTime = client.m_ConnectTime;
 	m_LastHeardTime = client.m_LastHeardTime;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+// set
+
+// the caller holds the clients lock if this client has been added
+void CClient::SetReflectorModule(char c)
+{
+	if (c != m_ReflectorModule)
+	{
+		if (m_Registry)
+			m_Registry->MoveClient(this, c);
+		else
+			m_ReflectorModule = c;
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // status
 
@@ -77,23 +95,23 @@ bool CClient::operator ==(const CClient &client) const
 ////////////////////////////////////////////////////////////////////////////////////////
 // reporting
 
-void CClient::WriteXml(std::ofstream &xmlFile)
+void CClient::WriteXml(std::ostream &xmlFile)
 {
-	xmlFile << "<NODE>" << std::endl;
-	xmlFile << "\t<Callsign>" << m_Callsign << "</Callsign>" << std::endl;
-	xmlFile << "\t<IP>" << m_Ip.GetAddress() << "</IP>" << std::endl;
-	xmlFile << "\t<LinkedModule>" << m_ReflectorModule << "</LinkedModule>" << std::endl;
-	xmlFile << "\t<Protocol>" << GetProtocolName() << "</Protocol>" << std::endl;
+	xmlFile << "<NODE>\n";
+	xmlFile << "\t<Callsign>" << m_Callsign << "</Callsign>\n";
+	xmlFile << "\t<IP>" << m_Ip.GetAddress() << "</IP>\n";
+	xmlFile << "\t<LinkedModule>" << m_ReflectorModule << "</LinkedModule>\n";
+	xmlFile << "\t<Protocol>" << GetProtocolName() << "</Protocol>\n";
 	char mbstr[100];
 	if (std::strftime(mbstr, sizeof(mbstr), "%A %c", std::localtime(&m_ConnectTime)))
 	{
-		xmlFile << "\t<ConnectTime>" << mbstr << "</ConnectTime>" << std::endl;
+		xmlFile << "\t<ConnectTime>" << mbstr << "</ConnectTime>\n";
 	}
 	if (std::strftime(mbstr, sizeof(mbstr), "%A %c", std::localtime(&m_LastHeardTime)))
 	{
-		xmlFile << "\t<LastHeardTime>" << mbstr << "</LastHeardTime>" << std::endl;
+		xmlFile << "\t<LastHeardTime>" << mbstr << "</LastHeardTime>\n";
 	}
-	xmlFile << "</NODE>" << std::endl;
+	xmlFile << "</NODE>\n";
 }
 
 void CClient::JsonReport(nlohmann::json &report)
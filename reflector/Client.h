@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <nlohmann/json.hpp>
 
 #include "Defines.h"
@@ -29,8 +30,13 @@
 
 enum class EProtoRev { original, revised, ambe };
 
+class CClients;
+
 class CClient
 {
+	// the registry keeps its indexes up to date
+	friend class CClients;
+
 public:
 	// constructors
 	CClient();
@@ -55,7 +61,7 @@ public:
 
 	// set
 	void SetCSModule(char c)                             { m_Callsign.SetCSModule(c); }
-	void SetReflectorModule(char c)                      { m_ReflectorModule = c; }
+	void SetReflectorModule(char c);
 
 	// identity
 	virtual EProtocol GetProtocol(void) const            { return EProtocol::none; }
@@ -75,7 +81,7 @@ public:
 	virtual void Heard(void)                            { m_LastHeardTime = std::time(nullptr); }
 
 	// reporting
-	virtual void WriteXml(std::ofstream &);
+	virtual void WriteXml(std::ostream &);
 	void JsonReport(nlohmann::json &report);
 
 protected:
@@ -85,9 +91,10 @@ protected:
 
 	// linked to
 	char        m_ReflectorModule;
+	CClients   *m_Registry;     // while in a CClients
 
 	// status
-	char        m_ModuleMastered;
+	std::atomic<char> m_ModuleMastered;     // read by the fan-out without the clients lock
 	CTimer      m_LastKeepaliveTime;
 	std::time_t m_ConnectTime;
 	std::time_t m_LastHeardTime;
@@ -23,8 +23,10 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 // constructor
 
-CClients::CClients()
+CClients::CClients() : m_SubscribersVersion(0)
 {
+	for ( auto &listening : m_Listening )
+		listening.store(0, std::memory_order_relaxed);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -32,9 +34,16 @@ CClients::CClients()
 
 CClients::~CClients()
 {
-	m_Mutex.lock();
+	m_Mutex.Lock();
+	for ( auto &client : m_Clients )
+		client->m_Registry = nullptr;
+	for ( auto &protocol : m_Subscribers )
+		for ( auto &slot : protocol )
+			std::atomic_store(&slot, std::shared_ptr<const ClientVector>());
+	m_CallsignIndex.clear();
+	m_IpIndex.clear();
 	m_Clients.clear();
-	m_Mutex.unlock();
+	m_Mutex.Unlock();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -42,10 +51,11 @@ CClients::~CClients()
 
 void CClients::AddClient(std::shared_ptr<CClient> client)
 {
-	// first check if client already exists
-	for ( auto it=begin(); it!=end(); it++ )
+	// first check if client already exists, it would have the same ip
+	auto range = m_IpIndex.equal_range(client->GetIp());
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if (*client == *(*it))
+		if (*client == *(it->second))
 			// if found, just do nothing
 			// so *client keep pointing on a valid object
 			// on function return
@@ -57,6 +67,10 @@ void CClients::AddClient(std::shared_ptr<CClient> client)
 
 	// and append
 	m_Clients.push_back(client);
+	m_IpIndex.emplace(client->GetIp(), client);
+	m_CallsignIndex.emplace(client->GetCallsign().GetKey(), client);
+	IndexModule(client);
+	client->m_Registry = this;
 	std::cout << "New client " << client->GetCallsign() << " at " << client->GetIp() << " added with protocol " << client->GetProtocolName();
 	if ( client->GetReflectorModule() != ' ' )
 	{
@@ -65,59 +79,164 @@ void CClients::AddClient(std::shared_ptr<CClient> client)
 	std::cout << std::endl;
 	// notify
 	g_Reflector.OnClientsChanged();
+	nlohmann::json event;
+	client->JsonReport(event);
+	g_Reflector.PostEvent("link", event["Clients"][0]);
 }
 
 void CClients::RemoveClient(std::shared_ptr<CClient> client)
 {
-	// look for the client
-	bool found = false;
+	// masters can't be removed
+	if ( client->IsAMaster() || ! IsClient(client) )
+		return;
+
+	std::cout << "Client " << client->GetCallsign() << " at " << client->GetIp() << " removed with protocol " << client->GetProtocolName();
+	if ( client->GetReflectorModule() != ' ' )
+	{
+		std::cout << " on module " << client->GetReflectorModule();
+	}
+	std::cout << std::endl;
+
+	// drop it from the indexes
+	UnindexModule(client.get());
+	auto range = m_IpIndex.equal_range(client->GetIp());
+	for ( auto it=range.first; it!=range.second; it++ )
+	{
+		if ( it->second == client )
+		{
+			m_IpIndex.erase(it);
+			break;
+		}
+	}
+	auto crange = m_CallsignIndex.equal_range(client->GetCallsign().GetKey());
+	for ( auto it=crange.first; it!=crange.second; it++ )
+	{
+		if ( it->second == client )
+		{
+			m_CallsignIndex.erase(it);
+			break;
+		}
+	}
+	client->m_Registry = nullptr;
+
+	// and from the list
 	for ( auto it=begin(); it!=end(); it++ )
 	{
-		// compare object pointers
 		if ( *it == client )
 		{
-			// found it !
-			if ( !(*it)->IsAMaster() )
-			{
-				// remove it
-				std::cout << "Client " << (*it)->GetCallsign() << " at " << (*it)->GetIp() << " removed with protocol " << (*it)->GetProtocolName();
-				if ( (*it)->GetReflectorModule() != ' ' )
-				{
-					std::cout << " on module " << (*it)->GetReflectorModule();
-				}
-				std::cout << std::endl;
-				m_Clients.erase(it);
-				// notify
-				g_Reflector.OnClientsChanged();
-				break;
-			}
+			m_Clients.erase(it);
+			break;
 		}
 	}
+	// notify
+	g_Reflector.OnClientsChanged();
+	nlohmann::json event;
+	client->JsonReport(event);
+	g_Reflector.PostEvent("unlink", event["Clients"][0]);
 }
 
 bool CClients::IsClient(std::shared_ptr<CClient> client) const
 {
-	for ( auto it=cbegin(); it!=cend(); it++ )
+	auto range = m_IpIndex.equal_range(client->GetIp());
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if (*it == client)
+		if (it->second == client)
 			return true;
 	}
 	return false;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////
-// find Clients
-
-std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip)
+void CClients::MoveClient(CClient *client, char module)
 {
-	// find client
-	for ( auto it=begin(); it!=end(); it++ )
+	// the ip index holds an owning pointer
+	auto range = m_IpIndex.equal_range(client->GetIp());
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( (*it)->GetIp() == Ip )
+		if ( it->second.get() == client )
 		{
-			return *it;
+			UnindexModule(client);
+			client->m_ReflectorModule = module;
+			IndexModule(it->second);
+			return;
 		}
 	}
+	client->m_ReflectorModule = module;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// subscribers
+
+int CClients::GetSubscriberSlot(EProtocol protocol, char module)
+{
+	if ( unsigned(protocol) >= NB_SUBSCRIBER_PROTOCOLS )
+		return -1;
+	if ( ' ' == module )
+		return 0;
+	if ( module >= 'A' && module <= 'Z' )
+		return module - 'A' + 1;
+	return -1;
+}
+
+// writers hold the lock, so the current snapshot can be read directly,
+// the copy is published before the version moves on
+void CClients::IndexModule(const std::shared_ptr<CClient> &client)
+{
+	auto m = GetSubscriberSlot(client->GetProtocol(), client->GetReflectorModule());
+	if ( m < 0 )
+		return;
+	auto &slot = m_Subscribers[unsigned(client->GetProtocol())][m];
+	auto snapshot = slot ? std::make_shared<ClientVector>(*slot) : std::make_shared<ClientVector>();
+	snapshot->push_back(client);
+	std::atomic_store(&slot, std::shared_ptr<const ClientVector>(snapshot));
+	m_Listening[m].fetch_or(1u << unsigned(client->GetProtocol()), std::memory_order_release);
+	m_SubscribersVersion.fetch_add(1, std::memory_order_release);
+}
+
+void CClients::UnindexModule(const CClient *client)
+{
+	auto m = GetSubscriberSlot(client->GetProtocol(), client->GetReflectorModule());
+	if ( m < 0 )
+		return;
+	auto &slot = m_Subscribers[unsigned(client->GetProtocol())][m];
+	if ( ! slot )
+		return;
+	auto snapshot = std::make_shared<ClientVector>();
+	snapshot->reserve(slot->size());
+	for ( auto &c : *slot )
+	{
+		if ( c.get() != client )
+			snapshot->push_back(c);
+	}
+	std::atomic_store(&slot, std::shared_ptr<const ClientVector>(snapshot));
+	if ( snapshot->empty() )
+		m_Listening[m].fetch_and(~(1u << unsigned(client->GetProtocol())), std::memory_order_release);
+	m_SubscribersVersion.fetch_add(1, std::memory_order_release);
+}
+
+uint32_t CClients::GetListening(const char ReflectorModule) const
+{
+	auto m = GetSubscriberSlot(EProtocol::none, ReflectorModule);
+	if ( m < 0 )
+		return 0;
+	return m_Listening[m].load(std::memory_order_acquire);
+}
+
+std::shared_ptr<const ClientVector> CClients::GetSubscribers(const EProtocol Protocol, const char ReflectorModule) const
+{
+	auto m = GetSubscriberSlot(Protocol, ReflectorModule);
+	if ( m < 0 )
+		return nullptr;
+	return std::atomic_load(&m_Subscribers[unsigned(Protocol)][m]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// find Clients
+
+std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip)
+{
+	auto found = m_IpIndex.find(Ip);
+	if ( found != m_IpIndex.end() )
+		return found->second;
 
 	// done
 	return nullptr;
@@ -125,12 +244,12 @@ std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip)
 
 std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip, const EProtocol Protocol)
 {
-	// find client
-	for ( auto it=begin(); it!=end(); it++ )
+	auto range = m_IpIndex.equal_range(Ip);
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( ((*it)->GetIp() == Ip)  && ((*it)->GetProtocol() == Protocol))
+		if ( it->second->GetProtocol() == Protocol )
 		{
-			return *it;
+			return it->second;
 		}
 	}
 
@@ -140,12 +259,12 @@ std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip, const EProtocol Pro
 
 std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip, const EProtocol Protocol, const char ReflectorModule)
 {
-	// find client
-	for ( auto it=begin(); it!=end(); it++ )
+	auto range = m_IpIndex.equal_range(Ip);
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( ((*it)->GetIp() == Ip)  && ((*it)->GetReflectorModule() == ReflectorModule) && ((*it)->GetProtocol() == Protocol) )
+		if ( (it->second->GetReflectorModule() == ReflectorModule) && (it->second->GetProtocol() == Protocol) )
 		{
-			return *it;
+			return it->second;
 		}
 	}
 
@@ -155,12 +274,12 @@ std::shared_ptr<CClient> CClients::FindClient(const CIp &Ip, const EProtocol Pro
 
 std::shared_ptr<CClient> CClients::FindClient(const CCallsign &Callsign, const CIp &Ip, const EProtocol Protocol)
 {
-	// find client
-	for ( auto it=begin(); it!=end(); it++ )
+	auto range = m_IpIndex.equal_range(Ip);
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( (*it)->GetCallsign().HasSameCallsign(Callsign) && ((*it)->GetIp() == Ip)  && ((*it)->GetProtocol() == Protocol) )
+		if ( it->second->GetCallsign().HasSameCallsign(Callsign) && (it->second->GetProtocol() == Protocol) )
 		{
-			return *it;
+			return it->second;
 		}
 	}
 
@@ -169,12 +288,12 @@ std::shared_ptr<CClient> CClients::FindClient(const CCallsign &Callsign, const C
 
 std::shared_ptr<CClient> CClients::FindClient(const CCallsign &Callsign, char module, const CIp &Ip, const EProtocol Protocol)
 {
-	// find client
-	for ( auto it=begin(); it!=end(); it++ )
+	auto range = m_IpIndex.equal_range(Ip);
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( (*it)->GetCallsign().HasSameCallsign(Callsign) && ((*it)->GetCSModule() == module) && ((*it)->GetIp() == Ip)  && ((*it)->GetProtocol() == Protocol) )
+		if ( it->second->GetCallsign().HasSameCallsign(Callsign) && (it->second->GetCSModule() == module) && (it->second->GetProtocol() == Protocol) )
 		{
-			return *it;
+			return it->second;
 		}
 	}
 
@@ -183,52 +302,50 @@ std::shared_ptr<CClient> CClients::FindClient(const CCallsign &Callsign, char mo
 
 std::shared_ptr<CClient> CClients::FindClient(const CCallsign &Callsign, const EProtocol Protocol)
 {
-	// find client
-	for ( auto it=begin(); it!=end(); it++ )
+	auto range = m_CallsignIndex.equal_range(Callsign.GetKey());
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( ((*it)->GetProtocol() == Protocol) && (*it)->GetCallsign().HasSameCallsign(Callsign) )
+		if ( (it->second->GetProtocol() == Protocol) && it->second->GetCallsign().HasSameCallsign(Callsign) )
 		{
-			return *it;
+			return it->second;
 		}
 	}
 
 	return nullptr;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////
-// iterate on clients
-
-std::shared_ptr<CClient> CClients::FindNextClient(const EProtocol Protocol, std::list<std::shared_ptr<CClient>>::iterator &it)
+ClientVector CClients::FindClients(const CIp &Ip, const EProtocol Protocol)
 {
-	while ( it != end() )
+	ClientVector found;
+	auto range = m_IpIndex.equal_range(Ip);
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( (*it)->GetProtocol() == Protocol )
-		{
-			return *it++;
-		}
-		it++;
+		if ( it->second->GetProtocol() == Protocol )
+			found.push_back(it->second);
 	}
-	return nullptr;
+	return found;
 }
 
-std::shared_ptr<CClient> CClients::FindNextClient(const CIp &Ip, const EProtocol Protocol, std::list<std::shared_ptr<CClient>>::iterator &it)
+ClientVector CClients::FindClients(const CCallsign &Callsign, const CIp &Ip, const EProtocol Protocol)
 {
-	while ( it != end() )
+	ClientVector found;
+	auto range = m_IpIndex.equal_range(Ip);
+	for ( auto it=range.first; it!=range.second; it++ )
 	{
-		if ( ((*it)->GetProtocol() == Protocol) && ((*it)->GetIp() == Ip) )
-		{
-			return *it++;
-		}
-		it++;
+		if ( (it->second->GetProtocol() == Protocol) && it->second->GetCallsign().HasSameCallsign(Callsign) )
+			found.push_back(it->second);
 	}
-	return nullptr;
+	return found;
 }
 
-std::shared_ptr<CClient> CClients::FindNextClient(const CCallsign &Callsign, const CIp &Ip, const EProtocol Protocol, std::list<std::shared_ptr<CClient>>::iterator &it)
+////////////////////////////////////////////////////////////////////////////////////////
+// iterate on clients
+
+std::shared_ptr<CClient> CClients::FindNextClient(const EProtocol Protocol, std::list<std::shared_ptr<CClient>>::iterator &it)
 {
 	while ( it != end() )
 	{
-		if ( ((*it)->GetProtocol() == Protocol) && ((*it)->GetIp() == Ip) && (*it)->GetCallsign().HasSameCallsign(Callsign) )
+		if ( (*it)->GetProtocol() == Protocol )
 		{
 			return *it++;
 		}
@@ -18,16 +18,33 @@
 
 #pragma once
 
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+
 #include "Client.h"
+#include "CountedMutex.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // define
 
+using ClientVector = std::vector<std::shared_ptr<CClient>>;
+
+// subscriber snapshots, by protocol and by module (' ' and 'A' to 'Z')
+#define NB_SUBSCRIBER_PROTOCOLS     (unsigned(EProtocol::m17) + 1)
+#define NB_SUBSCRIBER_MODULES       27
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // class
 
+// Besides the list, clients are indexed by ip and by callsign, so that
+// lookups don't have to walk every client. Everything is guarded by Lock(),
+// except the subscribers: each (protocol, reflector module) has an immutable
+// snapshot of its clients that is replaced, never modified, when a client
+// links, unlinks or changes module. The fan-out of a stream reads them with
+// GetSubscribers() without taking the lock.
+
 class CClients
 {
 public:
@@ -38,14 +55,16 @@ public:
 	virtual ~CClients();
 
 	// locks
-	void Lock(void)                     { m_Mutex.lock(); }
-	void Unlock(void)                   { m_Mutex.unlock(); }
+	void Lock(void)                     { m_Mutex.Lock(); }
+	void Unlock(void)                   { m_Mutex.Unlock(); }
+	void GetLockStats(SLockStats &stats) const { m_Mutex.GetStats(stats); }
 
 	// manage Clients
 	int     GetSize(void) const         { return (int)m_Clients.size(); }
 	void    AddClient(std::shared_ptr<CClient>);
 	void    RemoveClient(std::shared_ptr<CClient>);
 	bool    IsClient(std::shared_ptr<CClient>) const;
+	void    MoveClient(CClient *, char);    // called by CClient::SetReflectorModule()
 
 	// pass-through
 	std::list<std::shared_ptr<CClient>>::iterator begin()              { return m_Clients.begin(); }
@@ -61,13 +80,33 @@ public:
 	std::shared_ptr<CClient> FindClient(const CCallsign &, char, const CIp &, const EProtocol);
 	std::shared_ptr<CClient> FindClient(const CCallsign &, const EProtocol);
 
+	// find all matching clients
+	ClientVector FindClients(const CIp &, const EProtocol);
+	ClientVector FindClients(const CCallsign &, const CIp &, const EProtocol);
+
+	// the clients of a protocol linked to a reflector module, no lock needed
+	std::shared_ptr<const ClientVector> GetSubscribers(const EProtocol, const char) const;
+	// bumped after any snapshot is replaced
+	uint64_t GetSubscribersVersion(void) const { return m_SubscribersVersion.load(std::memory_order_acquire); }
+	// index of a module's snapshot, or -1 if there's none
+	static int GetSubscriberSlot(EProtocol, char);
+	// the protocols with at least one client linked to a module, bit (1 << protocol)
+	uint32_t GetListening(const char) const;
+
 	// iterate on clients
 	std::shared_ptr<CClient> FindNextClient(const EProtocol, std::list<std::shared_ptr<CClient>>::iterator &);
-	std::shared_ptr<CClient> FindNextClient(const CIp &, const EProtocol, std::list<std::shared_ptr<CClient>>::iterator &);
-	std::shared_ptr<CClient> FindNextClient(const CCallsign &, const CIp &, const EProtocol, std::list<std::shared_ptr<CClient>>::iterator &);
 
 protected:
+	// subscriber helpers
+	void IndexModule(const std::shared_ptr<CClient> &);
+	void UnindexModule(const CClient *);
+
 	// data
-	std::mutex           m_Mutex;
+	CCountedMutex        m_Mutex;
 	std::list<std::shared_ptr<CClient>> m_Clients;
+	std::unordered_multimap<CIp, std::shared_ptr<CClient>, CIpHash> m_IpIndex;
+	std::unordered_multimap<UCallsign, std::shared_ptr<CClient>, CCallsignHash, CCallsignEqual> m_CallsignIndex;
+	std::shared_ptr<const ClientVector> m_Subscribers[NB_SUBSCRIBER_PROTOCOLS][NB_SUBSCRIBER_MODULES];
+	std::atomic<uint64_t> m_SubscribersVersion;
+	std::atomic<uint32_t> m_Listening[NB_SUBSCRIBER_MODULES];
 };
@@ -0,0 +1,47 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// The steady clock that the timers, timeouts and the pacer go by. It is the
+// system's steady clock, unless a replay has moved it forward: at full speed,
+// the replay skips over the idle time between captured datagrams, so the
+// timeouts still see the time that went by when the capture was made.
+
+class CClock
+{
+public:
+	using time_point = std::chrono::steady_clock::time_point;
+
+	static time_point Now(void)
+	{
+		return std::chrono::steady_clock::now() + std::chrono::nanoseconds(s_Skipped.load(std::memory_order_relaxed));
+	}
+
+	// move the clock forward, it never goes back
+	static void Skip(uint64_t ns)   { s_Skipped.fetch_add(ns, std::memory_order_relaxed); }
+	static uint64_t Skipped(void)   { return s_Skipped.load(std::memory_order_relaxed); }
+
+private:
+	static inline std::atomic<uint64_t> s_Skipped{0};
+};
@@ -0,0 +1,160 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstddef>
+#include <string.h>
+
+#include "CodecStream.h"
+#include "CodecEngine.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+CCodecEngine::CCodecEngine(unsigned id, CTranscoderPool *pool) : m_Id(id), m_Pool(pool), m_Ready(0), keep_running(false)
+{
+	memset(m_Module, 0, sizeof(m_Module));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// destructor
+
+CCodecEngine::~CCodecEngine()
+{
+	Stop();
+	m_Reactor.Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// set up
+
+// returns true on failure
+bool CCodecEngine::Add(CCodecStream *stream)
+{
+	const char module = stream->GetModule();
+	if (module < 'A' || module > 'Z' || m_Module[module - 'A'])
+		return true;
+	if (! (m_Reactor.Open() && m_Reactor.Add(stream->GetReaderFD())))
+		return true;
+	m_Streams.push_back(stream);
+	m_Module[module - 'A'] = stream;
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// thread
+
+// returns true on failure
+bool CCodecEngine::Start(void)
+{
+	keep_running = true;
+	try
+	{
+		m_Future = std::async(std::launch::async, &CCodecEngine::Thread, this);
+	}
+	catch(const std::exception& e)
+	{
+		std::cerr << "Could not start transcoder thread #" << m_Id << ": " << e.what() << std::endl;
+		keep_running = false;
+		return true;
+	}
+	std::cout << "Transcoder thread #" << m_Id << " started for " << m_Streams.size() << " module" << ((1 == m_Streams.size()) ? "" : "s") << std::endl;
+	return false;
+}
+
+void CCodecEngine::Stop(void)
+{
+	keep_running = false;
+	m_Reactor.Notify();
+	if (m_Future.valid())
+		m_Future.get();
+}
+
+void CCodecEngine::Thread(void)
+{
+	while (keep_running)
+	{
+		Task();
+	}
+}
+
+// the module of a transcoder datagram, or 0 if it doesn't have one
+static char GetTCModule(const uint8_t *buf, ssize_t len)
+{
+	if (len == sizeof(STCPacket))
+		return buf[offsetof(STCPacket, module)];
+	if (len < ssize_t(TC_HEADER_SIZE + 1) || TC_MAGIC != (buf[0] << 8 | buf[1]))
+		return 0;
+	switch (ETCPacketType(buf[3]))
+	{
+	case ETCPacketType::hello_ack:
+		return buf[TC_HEADER_SIZE];
+	case ETCPacketType::frame:
+		return (len >= ssize_t(TC_FRAME_SIZE)) ? buf[TC_HEADER_SIZE + 6] : 0;
+	default:
+		return 0;
+	}
+}
+
+void CCodecEngine::Task(void)
+{
+	uint8_t buf[TC_MAX_PACKET];
+	int fds[REACTOR_MAX_EVENTS];
+
+	// sleep no longer than the earliest deadline of any module
+	int timeout = 100;
+	for (auto stream : m_Streams)
+	{
+		const auto t = stream->TimeToDeadline();
+		if (t < timeout)
+			timeout = t;
+	}
+
+	// wait for the transcoder, for a Push() to ring the doorbell, or for a deadline
+	const auto n = m_Reactor.Wait(timeout, fds, REACTOR_MAX_EVENTS);
+
+	// every packet from the transcoder, it goes to the module it's about
+	uint32_t ready = m_Ready.exchange(0);
+	for (int i=0; i<n; i++)
+	{
+		if (REACTOR_NOTIFIED == fds[i])
+			continue;
+		for (auto stream : m_Streams)
+		{
+			if (fds[i] != stream->GetReaderFD())
+				continue;
+			// until the socket is empty, a burst of replies is handled in one go
+			ssize_t len;
+			while ((len = stream->ReadTC(buf, sizeof(buf))) > 0)
+			{
+				const char module = GetTCModule(buf, len);
+				auto target = (module >= 'A' && module <= 'Z') ? m_Module[module - 'A'] : nullptr;
+				if (! target)
+					target = stream;	// it will complain
+				target->Receive(buf, len);
+				ready |= ModuleBit(target->GetModule());
+			}
+			break;
+		}
+	}
+
+	// then the modules that got something, or have a frame due, send what's in their queue and hand back what's ready
+	for (auto stream : m_Streams)
+	{
+		if ((ready & ModuleBit(stream->GetModule())) || stream->TimeToDeadline() <= 0)
+			stream->Service();
+	}
+}
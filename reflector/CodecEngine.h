@@ -0,0 +1,77 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <vector>
+
+#include "Reactor.h"
+#include "TranscoderPool.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// One thread doing the transcoder I/O for any number of transcoded modules.
+// It waits on every module's receive socket and on the doorbell rung by
+// CCodecStream::Push(), hands each datagram from the transcoder to the
+// module named in it, and keeps every module's in-flight window moving.
+// The reflector can spread the modules over a small pool of these.
+
+class CCodecStream;
+
+class CCodecEngine
+{
+public:
+	// constructor
+	CCodecEngine(unsigned id, CTranscoderPool *pool);
+
+	// destructor
+	~CCodecEngine();
+
+	// set up, before Start()
+	bool Add(CCodecStream *stream);
+
+	// thread
+	bool Start(void);
+	void Stop(void);
+
+	// wake the thread, there's something in a module's queue
+	void Notify(char module) { m_Ready.fetch_or(ModuleBit(module)); m_Reactor.Notify(); }
+
+	// get
+	unsigned GetId(void) const { return m_Id; }
+	CTranscoderPool *GetPool(void) const { return m_Pool; }
+
+protected:
+	// task
+	void Thread(void);
+	void Task(void);
+	static uint32_t ModuleBit(char module) { return (module >= 'A' && module <= 'Z') ? (1u << (module - 'A')) : 0u; }
+
+	// data
+	const unsigned m_Id;
+	CTranscoderPool *const m_Pool;
+	CReactor m_Reactor;
+	std::vector<CCodecStream *> m_Streams;
+	CCodecStream *m_Module[26];	// by the module in the transcoder's datagram
+	std::atomic<uint32_t> m_Ready;	// the modules pushed to since the last Task()
+
+	// thread
+	std::atomic<bool> keep_running;
+	std::future<void> m_Future;
+};
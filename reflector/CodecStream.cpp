@@ -18,6 +18,8 @@
 
 
 #include <string.h>
+#include <cstddef>
+#include "Global.h"
 #include "DVFramePacket.h"
 #include "PacketStream.h"
 #include "CodecStream.h"
@@ -25,30 +27,24 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 // constructor
 
-CCodecStream::CCodecStream(CPacketStream *PacketStream, char module) : m_CSModule(module), m_IsOpen(false)
+CCodecStream::CCodecStream(CPacketStream *PacketStream, char module) : m_CSModule(module), m_IsOpen(false), m_Engine(nullptr), m_Transcoder(-1), m_TranscoderBusy(false), m_TCVersion(1), m_HelloPending(true), m_TCReconnects(0), m_Wanted(TC_CODEC_DIGITAL), m_WantedVersion(UINT64_MAX), m_WantedStream(0), m_PacketStream(PacketStream), m_InFlight(new SInFlight[CODEC_QUEUE_DEPTH]), m_NextSeq(0), m_NextOut(0), m_Deadline(250), m_Pending(0), m_Queue(CODEC_QUEUE_DEPTH, EQueuePolicy::backpressure), m_RTTotalCount(0), m_RTTotalUs(0), m_RTWorstUs(0), m_TCBytesOut(0), m_TCBytesIn(0), m_Lost(0), m_Late(0), m_Bypassed(0), m_Untranscoded(0), m_RTHistogram(nullptr)
 {
-	m_PacketStream = PacketStream;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // destructor
 
+// the engine has to be stopped first
 CCodecStream::~CCodecStream()
 {
-	// kill the thread
-	keep_running = false;
-	if ( m_Future.valid() )
-	{
-		m_Future.get();
-	}
-	// and close the socket
+	CMetrics::Remove(this);
+	// close the socket
 	m_TCReader.Close();
 }
 
 void CCodecStream::ResetStats(uint16_t streamid, ECodecType type)
 {
 	m_IsOpen = true;
-	keep_running = true;
 	m_uiStreamId = streamid;
 	m_uiPid = 0;
 	m_eCodecIn = type;
@@ -70,128 +66,578 @@ void CCodecStream::ReportStats()
 		double ave = 1000.0 * m_RTSum / double(m_RTCount);
 		auto prec = std::cout.precision();
 		std::cout.precision(1);
-		std::cout << std::fixed << "TC round-trip time(ms): " << min << '/' << ave << '/' << max << ", " << m_RTCount << " total packets" << std::endl;
+		std::cout << std::fixed << "TC round-trip time(ms): " << min << '/' << ave << '/' << max << ", " << m_RTCount << " total packets";
+		if (m_uiTotalPackets > m_RTCount)
+			std::cout << ", " << (m_uiTotalPackets - m_RTCount) << " unanswered";
+		std::cout << std::endl;
 		std::cout.precision(prec);
 	}
 }
 
+void CCodecStream::JsonReport(nlohmann::json &report) const
+{
+	SDgramStats stats { 0, 0, 0 };
+	for (const auto &writer : m_TCWriters)
+	{
+		SDgramStats s;
+		writer->GetStats(s);
+		stats.sent += s.sent;
+		stats.failed += s.failed;
+		stats.reconnects += s.reconnects;
+	}
+	const int transcoder = m_Transcoder;
+	const auto count = m_RTTotalCount.load(std::memory_order_relaxed);
+	nlohmann::json jtc;
+	jtc["Module"] = std::string(1, m_CSModule);
+	jtc["Thread"] = m_Engine ? m_Engine->GetId() : 0u;
+	jtc["Transcoder"] = (transcoder < 0) ? std::string() : m_Engine->GetPool()->GetName(transcoder);
+	jtc["Version"] = m_TCVersion.load();
+	jtc["BytesOut"] = m_TCBytesOut.load(std::memory_order_relaxed);
+	jtc["BytesIn"] = m_TCBytesIn.load(std::memory_order_relaxed);
+	jtc["Sent"] = stats.sent;
+	jtc["SendFailed"] = stats.failed;
+	jtc["Reconnects"] = stats.reconnects;
+	jtc["Returned"] = count;
+	jtc["AverageRTus"] = count ? m_RTTotalUs.load(std::memory_order_relaxed) / count : 0;
+	jtc["WorstRTus"] = m_RTWorstUs.load(std::memory_order_relaxed);
+	jtc["Lost"] = m_Lost.load(std::memory_order_relaxed);
+	jtc["Late"] = m_Late.load(std::memory_order_relaxed);
+	jtc["Bypassed"] = m_Bypassed.load(std::memory_order_relaxed);
+	jtc["Untranscoded"] = m_Untranscoded.load(std::memory_order_relaxed);
+	report["Transcoder"].push_back(jtc);
+	m_Pacer.JsonReport(report, std::string("Module ") + m_CSModule);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // initialization
 
-bool CCodecStream::InitCodecStream()
+bool CCodecStream::InitCodecStream(CCodecEngine *engine)
 {
-	m_TCWriter.SetUp(REF2TC);
+	m_Deadline = g_Configure.GetUnsigned(g_Keys.modules.tcdeadline);
+	const auto labels = CMetrics::Labels({{"module", std::string(1, m_CSModule)}});
+	m_RTHistogram = CMetrics::Histogram("urfd_transcoder_rtt_seconds", "Round trip of a frame through the transcoder", labels, { 0.005, 0.01, 0.02, 0.04, 0.06, 0.08, 0.1, 0.15, 0.25, 0.5 });
+	CMetrics::GaugeFn("urfd_queue_depth", "Packets waiting in a queue", CMetrics::Labels({{"queue", std::string("Codec ") + m_CSModule}}), this, [this]() { return double(m_Queue.GetSize()); });
+	for (size_t i=0; i<engine->GetPool()->GetSize(); i++)
+	{
+		m_TCWriters.emplace_back(new CUnixDgramWriter);
+		m_TCWriters.back()->SetUp(engine->GetPool()->GetName(i).c_str());
+	}
 	std::string name(TC2REF);
 	name.append(1, m_CSModule);
 	if (m_TCReader.Open(name.c_str()))
 		return true;
-	std::cout << "Initialized CodecStream receive socket " << name << std::endl;
-	keep_running = true;
-	try
-	{
-		m_Future = std::async(std::launch::async, &CCodecStream::Thread, this);
-	}
-	catch(const std::exception& e)
+	if (engine->Add(this))
 	{
-		std::cerr << "Could not start Codec processing on module '" << m_CSModule << "': " << e.what() << std::endl;
+		std::cerr << "Could not add module '" << m_CSModule << "' to transcoder thread #" << engine->GetId() << std::endl;
 		m_TCReader.Close();
 		return true;
 	}
+	m_Engine = engine;
+	std::cout << "Initialized CodecStream receive socket " << name << std::endl;
+	// the hello goes to the first transcoder the module is given
 	return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
-// thread
+// engine tasks
 
-void CCodecStream::Thread()
+// a datagram from the transcoder
+void CCodecStream::Receive(const uint8_t *buf, ssize_t len)
 {
-	while (keep_running)
+	STCPacket pack;
+	uint8_t codecs = 0;
+
+	if (DecodeTCPacket(buf, len, pack, codecs))
 	{
-		Task();
+		if (pack.module != m_CSModule)
+			std::cerr << "CodecStream '" << m_CSModule << "' received a transcoded packet from module '" << pack.module << "'" << std::endl;
+		else if (pack.sequence - m_NextOut < m_NextSeq - m_NextOut)
+		{
+			auto &slot = m_InFlight[pack.sequence % CODEC_QUEUE_DEPTH];
+			if (slot.packet && ! slot.done)
+				Returned(slot.packet, slot.transcoder, pack, codecs);
+			slot.done = true;
+		}
+		else if (m_NextOut - pack.sequence <= CODEC_QUEUE_DEPTH)
+		{
+			// we already gave up on this one
+			m_Late.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			std::cout << "Unexpected transcoded packet received from transcoder: Module='" << pack.module << "' Sequence=" << pack.sequence << " StreamID=" << std::hex << std::showbase << ntohs(pack.streamid) << std::dec << std::noshowbase << std::endl;
+		}
 	}
 }
 
-void CCodecStream::Task(void)
+// send what's in our queue, and hand back what's ready
+void CCodecStream::Service(void)
 {
-	STCPacket pack;
+	// a closed stream no longer counts against its transcoder
+	if (m_TranscoderBusy && ! m_IsOpen)
+	{
+		m_Engine->GetPool()->Release(m_Transcoder);
+		m_TranscoderBusy = false;
+	}
 
-	// any packet from transcoder
-	if (m_TCReader.Receive(&pack, 5))
+	// anything in our queue
+	auto Packet = m_Queue.Pop();
+	while (Packet)
 	{
-		// update statistics
-		double rt = pack.rt_timer.time();	// the round-trip time
-		if (0 == m_RTCount)
+		// we need a CDvFramePacket pointer to access Frame stuff
+		auto Frame = (CDvFramePacket *)Packet.get();
+
+		if (m_IsOpen)
 		{
-			m_RTMin = rt;
-			m_RTMax = rt;
+			// if the transcoder has stopped answering, make room by giving up on the oldest
+			if (m_NextSeq - m_NextOut >= CODEC_QUEUE_DEPTH)
+			{
+				if (! m_InFlight[m_NextOut % CODEC_QUEUE_DEPTH].done)
+					Expire();
+				Release();
+			}
+
+			// update important stuff in Frame->m_TCPack for the transcoder
+			// sets the packet counter, stream id, last_packet, module and start the trip timer
+			Frame->SetTCParams(m_NextSeq);
+
+			// if everybody listening can use the input codec, the transcoder is skipped,
+			// but the frame still takes its turn in the window, behind any that aren't back yet
+			auto &slot = m_InFlight[m_NextSeq % CODEC_QUEUE_DEPTH];
+			slot.transcoder = -1;
+			slot.done = true;
+			if (! NeedsTranscoding(Frame->GetCodecIn()))
+			{
+				// silence for a client that links before it goes out
+				Frame->SetCodecSilence();
+				m_Bypassed.fetch_add(1, std::memory_order_relaxed);
+			}
+			else if (SelectTranscoder() && ! SendTCPacket(*Frame->GetCodecPacket()))
+			{
+				m_uiTotalPackets++;
+				Frame->Trace().tcsent = CLatency::Now();
+				slot.transcoder = m_Transcoder;
+				slot.done = false;
+			}
+			else
+			{
+				// no transcoder to send it to, it goes out as is
+				Frame->SetCodecSilence();
+				m_Untranscoded.fetch_add(1, std::memory_order_relaxed);
+			}
+			slot.packet = std::move(Packet);
+			m_NextSeq++;
 		}
 		else
+			m_Pending--;	// dropped
+
+		// get the next packet, if there is one
+		Packet = m_Queue.Pop();
+	}
+
+	// anything that is back, or has run out of time, goes back to the clients in order
+	Release();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// in-flight window
+
+static_assert(0 == (CODEC_QUEUE_DEPTH & (CODEC_QUEUE_DEPTH - 1)), "the in-flight window has to divide the sequence space");
+
+void CCodecStream::Returned(std::unique_ptr<CPacket> &Packet, int transcoder, const STCPacket &pack, uint8_t codecs)
+{
+	auto Frame = (CDvFramePacket *)Packet.get();
+
+	// update statistics, the trip timer was started when the frame was sent
+	double rt = Frame->GetCodecPacket()->rt_timer.time();	// the round-trip time
+	if (0 == m_RTCount)
+	{
+		m_RTMin = rt;
+		m_RTMax = rt;
+	}
+	else
+	{
+		if (rt < m_RTMin)
+			m_RTMin = rt;
+		else if (rt > m_RTMax)
+			m_RTMax = rt;
+	}
+	m_RTSum += rt;
+	m_RTCount++;
+	const uint64_t us = rt * 1.0e6;
+	m_RTTotalCount.fetch_add(1, std::memory_order_relaxed);
+	m_RTTotalUs.fetch_add(us, std::memory_order_relaxed);
+	if (us > m_RTWorstUs.load(std::memory_order_relaxed))
+		m_RTWorstUs.store(us, std::memory_order_relaxed);
+	m_Engine->GetPool()->Answered(transcoder, us);
+	m_RTHistogram->Observe(rt);
+	Frame->Trace().tcback = CLatency::Now();
+
+	// does it look okay?
+	if (pack.streamid != Frame->GetCodecPacket()->streamid)
+		std::cerr << std::hex  << std::showbase << "StreamID mismatch: this voice frame=" << ntohs(Frame->GetCodecPacket()->streamid) << " returned transcoder packet=" << ntohs(pack.streamid) << std::dec << std::noshowbase << std::endl;
+
+	// update content with transcoded data
+	Frame->SetCodecData(&pack, codecs);
+}
+
+// hand back every frame at the front of the window that is done or past its deadline
+void CCodecStream::Release(void)
+{
+	while (m_NextOut != m_NextSeq)
+	{
+		auto &slot = m_InFlight[m_NextOut % CODEC_QUEUE_DEPTH];
+		auto Frame = (CDvFramePacket *)slot.packet.get();
+		if (! slot.done)
 		{
-			if (rt < m_RTMin)
-				m_RTMin = rt;
-			else if (rt > m_RTMax)
-				m_RTMax = rt;
+			if (1000.0 * Frame->GetCodecPacket()->rt_timer.time() < m_Deadline)
+				break;
+			Expire();
 		}
-		m_RTSum += rt;
-		m_RTCount++;
 
-		if ( m_LocalQueue.IsEmpty() )
+		// mark the DStar sync frames if the source isn't dstar
+		if (ECodecType::dstar!=Frame->GetCodecIn() && 0==Frame->GetPacketId()%21)
 		{
-			std::cout << "Unexpected transcoded packet received from transcoder: Module='" << pack.module << "' StreamID=" << std::hex << std::showbase << ntohs(pack.streamid) << std::endl;
+			const uint8_t DStarSync[] = { 0x55, 0x2D, 0x16 };
+			Frame->SetDvData(DStarSync);
 		}
-		else if (m_IsOpen)
-		{
-			// pop the original packet
-			auto Packet = m_LocalQueue.Pop();
-			auto Frame = (CDvFramePacket *)Packet.get();
-
-			// do things look okay?
-			if (pack.module != m_CSModule)
-				std::cerr << "CodecStream '" << m_CSModule << "' received a transcoded packet from module '" << pack.module << "'" << std::dec << std::noshowbase << std::endl;
-			if (pack.sequence != Frame->GetCodecPacket()->sequence)
-				std::cerr << "Sequence mismatch: this voice frame=" << Frame->GetCodecPacket()->sequence << " returned transcoder packet=" << pack.sequence << std::endl;
-			if (pack.streamid != Frame->GetCodecPacket()->streamid)
-				std::cerr << std::hex  << std::showbase << "StreamID mismatch: this voice frame=" << ntohs(Frame->GetCodecPacket()->streamid) << " returned transcoder packet=" << ntohs(pack.streamid) << std::dec << std::noshowbase << std::endl;
-
-			// update content with transcoded data
-			Frame->SetCodecData(&pack);
-			// mark the DStar sync frames if the source isn't dstar
-			if (ECodecType::dstar!=Frame->GetCodecIn() && 0==Frame->GetPacketId()%21)
-			{
-				const uint8_t DStarSync[] = { 0x55, 0x2D, 0x16 };
-				Frame->SetDvData(DStarSync);
-			}
 
-			// and push it back to client
-			m_PacketStream->ReturnPacket(std::move(Packet));
-		}
+		// and on to the pacer, unless its stream has closed
+		if (m_IsOpen && Frame->GetStreamId() == m_uiStreamId)
+			m_Pacer.Push(std::move(slot.packet));
 		else
 		{
-			std::cout << "Transcoder packet received but CodecStream[" << m_CSModule << "] is closed: Module='" << pack.module << "' StreamID=" << std::hex << std::showbase << ntohs(pack.streamid) << std::endl;
+			slot.packet.reset();
+			m_Pending--;
 		}
+		m_NextOut++;
 	}
 
-	// anything in our queue
-	auto Packet = m_Queue.Pop();
+	// replies come back in bursts, but the clients get a frame every 20 ms
+	auto Packet = m_Pacer.Pop();
 	while (Packet)
 	{
-		// we need a CDvFramePacket pointer to access Frame stuff
-		auto Frame = (CDvFramePacket *)Packet.get();
+		if (m_IsOpen && Packet->GetStreamId() == m_uiStreamId)
+			m_PacketStream->ReturnPacket(std::move(Packet));
+		// only after it's in the packet stream's queue, so a closing stream never looks drained too soon
+		m_Pending--;
+		Packet = m_Pacer.Pop();
+	}
+}
 
-		if (m_IsOpen)
+// gives up on the oldest frame in flight, the clients get the input codec as is, and silence for the rest
+void CCodecStream::Expire(void)
+{
+	auto &slot = m_InFlight[m_NextOut % CODEC_QUEUE_DEPTH];
+	m_Lost.fetch_add(1, std::memory_order_relaxed);
+	m_Engine->GetPool()->Missed(slot.transcoder);
+	((CDvFramePacket *)slot.packet.get())->SetCodecSilence();
+	slot.done = true;
+}
+
+// how long the reactor can sleep before the oldest frame runs out of time, or a paced one is due, in ms
+int CCodecStream::TimeToDeadline(void) const
+{
+	if (m_TranscoderBusy && ! m_IsOpen)
+		return 0;	// Service() has a transcoder to give back
+	if (m_NextOut == m_NextSeq)
+		return m_Pacer.TimeToNext(100);
+	const auto Frame = (const CDvFramePacket *)m_InFlight[m_NextOut % CODEC_QUEUE_DEPTH].packet.get();
+	const int left = int(m_Deadline) - int(1000.0 * Frame->GetCodecPacket()->rt_timer.time());
+	return m_Pacer.TimeToNext((left < 0) ? 0 : ((left < 100) ? left + 1 : 100));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// transcoder link
+
+static_assert(TC_FRAME_SIZE + 9 + 9 + 16 + 11 + 320 < sizeof(STCPacket), "a version 2 frame can't be mistaken for a version 1 packet");
+
+static uint8_t CodecBit(ECodecType type)
+{
+	switch (type)
+	{
+	case ECodecType::dstar:
+		return TC_CODEC_DSTAR;
+	case ECodecType::dmr:
+		return TC_CODEC_DMR;
+	case ECodecType::c2_1600:
+	case ECodecType::c2_3200:
+		return TC_CODEC_M17;
+	case ECodecType::p25:
+		return TC_CODEC_P25;
+	case ECodecType::usrp:
+		return TC_CODEC_USRP;
+	default:
+		return 0;
+	}
+}
+
+static void SetHeader(uint8_t *buf, ETCPacketType type, size_t length)
+{
+	buf[0] = TC_MAGIC >> 8;
+	buf[1] = TC_MAGIC & 0xffu;
+	buf[2] = TC_VERSION;
+	buf[3] = uint8_t(type);
+	buf[4] = length >> 8;
+	buf[5] = length & 0xffu;
+}
+
+// a stream keeps its transcoder until it closes, or the transcoder is taken out of the pool,
+// returns false if there's no healthy transcoder
+bool CCodecStream::SelectTranscoder(void)
+{
+	auto pool = m_Engine->GetPool();
+	const int current = m_Transcoder;
+	if (m_TranscoderBusy && pool->IsHealthy(current))
+		return true;
+
+	const auto next = pool->Pick(current, m_TranscoderBusy);
+	m_TranscoderBusy = (next >= 0);
+	if (next != current)
+	{
+		if (next < 0)
+			std::cout << "No transcoder for module " << m_CSModule << ", its frames go out untranscoded" << std::endl;
+		else if (current >= 0 || pool->GetSize() > 1)
+			std::cout << "Module " << m_CSModule << " is using transcoder " << pool->GetName(next) << std::endl;
+		m_Transcoder = next;
+		if (next >= 0)
 		{
-			// update important stuff in Frame->m_TCPack for the transcoder
-			// sets the packet counter, stream id, last_packet, module and start the trip timer
-			Frame->SetTCParams(m_uiTotalPackets++);
+			// a different transcoder has to be asked what it speaks
+			SDgramStats stats;
+			m_TCWriters[next]->GetStats(stats);
+			m_TCReconnects = stats.reconnects;
+			m_TCVersion = 1;
+			m_HelloPending = true;
+		}
+	}
+	return m_TranscoderBusy;
+}
 
-			// now send to transcoder
-			m_TCWriter.Send(Frame->GetCodecPacket());
+void CCodecStream::SendHello(void)
+{
+	uint8_t buf[TC_HEADER_SIZE + 1];
+	SetHeader(buf, ETCPacketType::hello, sizeof(buf));
+	buf[TC_HEADER_SIZE] = m_CSModule;
+	if (! m_TCWriters[m_Transcoder]->Send(buf, sizeof(buf)))
+		m_HelloPending = false;
+}
 
-			// push to our local queue where it can wait for the transcoder
-			m_LocalQueue.Push(std::move(Packet));
+// returns true on failure, and the transcoder is taken out of the pool
+// a transcoder that has been restarted may not speak version 2 any more
+bool CCodecStream::SendTCPacket(const STCPacket &pack)
+{
+	auto &writer = *m_TCWriters[m_Transcoder];
+	SDgramStats stats;
+	writer.GetStats(stats);
+	if (stats.reconnects != m_TCReconnects)
+	{
+		m_TCReconnects = stats.reconnects;
+		m_TCVersion = 1;
+		m_HelloPending = true;
+	}
+	if (m_HelloPending)
+		SendHello();
+
+	if (1 == m_TCVersion)
+	{
+		if (writer.Send(&pack))
+		{
+			m_Engine->GetPool()->Failed(m_Transcoder);
+			return true;
 		}
+		m_TCBytesOut.fetch_add(sizeof(STCPacket), std::memory_order_relaxed);
+		return false;
+	}
 
-		// get the next packet, if there is one
-		Packet = m_Queue.Pop();
+	// version 2, only the input codec goes to the transcoder
+	uint8_t buf[TC_MAX_PACKET];
+	const auto codec = CodecBit(pack.codec_in);
+	size_t off = TC_HEADER_SIZE;
+	buf[off++] = (pack.sequence >> 24) & 0xffu;
+	buf[off++] = (pack.sequence >> 16) & 0xffu;
+	buf[off++] = (pack.sequence >>  8) & 0xffu;
+	buf[off++] = pack.sequence & 0xffu;
+	memcpy(buf+off, &pack.streamid, 2); off += 2;	// already in network order
+	buf[off++] = pack.module;
+	buf[off++] = pack.is_last ? TC_FLAG_LAST : 0;
+	buf[off++] = uint8_t(pack.codec_in);
+	buf[off++] = codec;
+	buf[off++] = GetWantedCodecs();
+	switch (codec)
+	{
+	case TC_CODEC_DSTAR:
+		memcpy(buf+off, pack.dstar, 9);  off += 9;
+		break;
+	case TC_CODEC_DMR:
+		memcpy(buf+off, pack.dmr, 9);    off += 9;
+		break;
+	case TC_CODEC_M17:
+		memcpy(buf+off, pack.m17, 16);   off += 16;
+		break;
+	case TC_CODEC_P25:
+		memcpy(buf+off, pack.p25, 11);   off += 11;
+		break;
+	case TC_CODEC_USRP:
+		for (unsigned i=0; i<160; i++)
+		{
+			buf[off++] = uint16_t(pack.usrp[i]) >> 8;
+			buf[off++] = uint16_t(pack.usrp[i]) & 0xffu;
+		}
+		break;
 	}
+	SetHeader(buf, ETCPacketType::frame, off);
+	if (writer.Send(buf, off))
+	{
+		m_Engine->GetPool()->Failed(m_Transcoder);
+		return true;
+	}
+	m_TCBytesOut.fetch_add(off, std::memory_order_relaxed);
+	return false;
+}
+
+// returns true if this is a transcoded frame, codecs has the TC_CODEC_* it carries
+bool CCodecStream::DecodeTCPacket(const uint8_t *buf, ssize_t len, STCPacket &pack, uint8_t &codecs)
+{
+	if (len <= 0)
+		return false;
+	m_TCBytesIn.fetch_add(len, std::memory_order_relaxed);
+
+	if (len == sizeof(STCPacket))
+	{
+		// a version 1 packet is the raw struct, the trip timer stays the one in the frame
+		memcpy(&pack.sequence, buf + offsetof(STCPacket, sequence), sizeof(pack.sequence));
+		pack.module = char(buf[offsetof(STCPacket, module)]);
+		pack.is_last = buf[offsetof(STCPacket, is_last)] ? true : false;
+		memcpy(&pack.streamid, buf + offsetof(STCPacket, streamid), sizeof(pack.streamid));
+		pack.codec_in = ECodecType(buf[offsetof(STCPacket, codec_in)]);
+		memcpy(pack.dstar, buf + offsetof(STCPacket, dstar), sizeof(pack.dstar));
+		memcpy(pack.dmr, buf + offsetof(STCPacket, dmr), sizeof(pack.dmr));
+		memcpy(pack.m17, buf + offsetof(STCPacket, m17), sizeof(pack.m17));
+		memcpy(pack.p25, buf + offsetof(STCPacket, p25), sizeof(pack.p25));
+		memcpy(pack.usrp, buf + offsetof(STCPacket, usrp), sizeof(pack.usrp));
+		codecs = TC_CODEC_DIGITAL | TC_CODEC_USRP;
+		return true;
+	}
+
+	const bool is_v2 = len >= ssize_t(TC_HEADER_SIZE + 1) && TC_MAGIC == (buf[0] << 8 | buf[1]) && TC_VERSION == buf[2] && len == (buf[4] << 8 | buf[5]);
+	if (! is_v2)
+	{
+		std::cerr << "Received transcoder packet is wrong size: " << len << " but should be " << sizeof(STCPacket) << std::endl;
+		return false;
+	}
+
+	switch (ETCPacketType(buf[3]))
+	{
+	case ETCPacketType::hello_ack:
+		if (1 == m_TCVersion)
+			std::cout << "Transcoder link for module " << m_CSModule << " is now version " << TC_VERSION << std::endl;
+		m_TCVersion = TC_VERSION;
+		return false;
+	case ETCPacketType::frame:
+		break;
+	default:
+		std::cerr << "Unexpected transcoder packet type " << unsigned(buf[3]) << " on module " << m_CSModule << std::endl;
+		return false;
+	}
+
+	if (len < ssize_t(TC_FRAME_SIZE))
+		return false;
+	size_t off = TC_HEADER_SIZE;
+	pack.sequence = uint32_t(buf[off]) << 24 | uint32_t(buf[off+1]) << 16 | uint32_t(buf[off+2]) << 8 | buf[off+3]; off += 4;
+	memcpy(&pack.streamid, buf+off, 2); off += 2;
+	pack.module = buf[off++];
+	pack.is_last = (buf[off++] & TC_FLAG_LAST) ? true : false;
+	pack.codec_in = ECodecType(buf[off++]);
+	codecs = buf[off++];
+	off++;	// wanted, only meaningful to the transcoder
+
+	// check the payload before using it
+	size_t need = off;
+	need += (codecs & TC_CODEC_DSTAR) ? 9 : 0;
+	need += (codecs & TC_CODEC_DMR) ? 9 : 0;
+	need += (codecs & TC_CODEC_M17) ? 16 : 0;
+	need += (codecs & TC_CODEC_P25) ? 11 : 0;
+	need += (codecs & TC_CODEC_USRP) ? 320 : 0;
+	if (0 == codecs || need != size_t(len))
+	{
+		std::cerr << "Received transcoder frame on module " << m_CSModule << " has " << len << " bytes, but should have " << need << std::endl;
+		return false;
+	}
+
+	if (codecs & TC_CODEC_DSTAR)
+	{
+		memcpy(pack.dstar, buf+off, 9); off += 9;
+	}
+	if (codecs & TC_CODEC_DMR)
+	{
+		memcpy(pack.dmr, buf+off, 9); off += 9;
+	}
+	if (codecs & TC_CODEC_M17)
+	{
+		memcpy(pack.m17, buf+off, 16); off += 16;
+	}
+	if (codecs & TC_CODEC_P25)
+	{
+		memcpy(pack.p25, buf+off, 11); off += 11;
+	}
+	if (codecs & TC_CODEC_USRP)
+	{
+		for (unsigned i=0; i<160; i++, off+=2)
+			pack.usrp[i] = int16_t(uint16_t(buf[off]) << 8 | buf[off+1]);
+	}
+	return true;
+}
+
+// the codecs the clients of a protocol are sent
+static uint8_t ProtocolCodecs(EProtocol protocol)
+{
+	switch (protocol)
+	{
+	case EProtocol::dextra:
+	case EProtocol::dplus:
+	case EProtocol::dcs:
+	case EProtocol::g3:
+		return TC_CODEC_DSTAR;
+	case EProtocol::dmrplus:
+	case EProtocol::dmrmmdvm:
+	case EProtocol::nxdn:
+	case EProtocol::ysf:
+		return TC_CODEC_DMR;
+	case EProtocol::bm:
+		return TC_CODEC_DSTAR | TC_CODEC_DMR;
+	case EProtocol::p25:
+		return TC_CODEC_P25;
+	case EProtocol::m17:
+		return TC_CODEC_M17;
+	case EProtocol::usrp:
+		return TC_CODEC_USRP;
+	default:	// urf peers get everything
+		return TC_CODEC_DIGITAL | TC_CODEC_USRP;
+	}
+}
+
+// only the codecs of the protocols the router sends the module to are wanted,
+// the talker changes with each stream, so a new stream looks again
+uint8_t CCodecStream::GetWantedCodecs(void)
+{
+	const auto version = g_Reflector.GetSubscribersVersion();
+	if (version != m_WantedVersion || m_uiStreamId != m_WantedStream)
+	{
+		const auto listening = g_Reflector.GetListeners(m_CSModule);
+		m_WantedStream = m_uiStreamId;
+		m_Wanted = 0;
+		for (unsigned p=0; p<NB_SUBSCRIBER_PROTOCOLS; p++)
+		{
+			if (listening & (1u << p))
+				m_Wanted |= ProtocolCodecs(EProtocol(p));
+		}
+		m_WantedVersion = version;
+	}
+	return m_Wanted;
+}
+
+// false if the input codec is all that anybody wants
+bool CCodecStream::NeedsTranscoding(ECodecType codec_in)
+{
+	return 0 != (GetWantedCodecs() & ~CodecBit(codec_in));
 }
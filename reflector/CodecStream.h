@@ -19,11 +19,15 @@
 #pragma once
 
 #include <atomic>
-#include <future>
+#include <nlohmann/json.hpp>
 
 #include "DVFramePacket.h"
 #include "UnixDgramSocket.h"
-#include "SafePacketQueue.h"
+#include "CodecEngine.h"
+#include "RingQueue.h"
+#include "Pacer.h"
+#include "Metrics.h"
+#include "Latency.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // class
@@ -35,25 +39,46 @@ class CCodecStream
 public:
 	// constructor
 	CCodecStream(CPacketStream *packetstream, char module);
-	bool InitCodecStream();
+	bool InitCodecStream(CCodecEngine *engine);
 
 	void ResetStats(uint16_t streamid, ECodecType codectype);
 	void ReportStats();
+	void JsonReport(nlohmann::json &report) const;
 
 	// destructor
 	virtual ~CCodecStream();
 
 	// get
 	uint16_t GetStreamId(void) const          { return m_uiStreamId; }
+	char     GetModule(void) const            { return m_CSModule; }
 
-	// task
-	void Thread(void);
-	void Task(void);
+	// called by the engine's thread
+	int     GetReaderFD(void) const           { return m_TCReader.GetFD(); }
+	ssize_t ReadTC(uint8_t *buf, size_t size) { return m_TCReader.Read(buf, size); }
+	void    Receive(const uint8_t *buf, ssize_t len);
+	void    Service(void);
+	int     TimeToDeadline(void) const;
+
+	// no frame of ours is queued, in flight or waiting in the pacer
+	bool    IsIdle(void) const                { return 0 == m_Pending.load(); }
 
 	// pass-through
-	void Push(std::unique_ptr<CPacket> p) { m_Queue.Push(std::move(p)); }
+	void Push(std::unique_ptr<CPacket> p) { m_Pending++; if (! m_Queue.Push(std::move(p))) m_Pending--; m_Engine->Notify(m_CSModule); }
 
 protected:
+	// transcoder link
+	bool    SelectTranscoder(void);
+	void    SendHello(void);
+	bool    SendTCPacket(const STCPacket &);
+	bool    DecodeTCPacket(const uint8_t *, ssize_t, STCPacket &, uint8_t &);
+	uint8_t GetWantedCodecs(void);
+	bool    NeedsTranscoding(ECodecType);
+
+	// in-flight window
+	void    Returned(std::unique_ptr<CPacket> &, int, const STCPacket &, uint8_t);
+	void    Release(void);
+	void    Expire(void);
+
 	// identity
 	const char      m_CSModule;
 	// state
@@ -66,17 +91,46 @@ protected:
 
 	// sockets
 	CUnixDgramReader m_TCReader;
-	CUnixDgramWriter m_TCWriter;
+	std::vector<std::unique_ptr<CUnixDgramWriter>> m_TCWriters;	// one for each transcoder in the pool
+	CCodecEngine    *m_Engine;
+
+	// the transcoder this module is using, -1 if none, and if the current stream counts against it
+	std::atomic<int> m_Transcoder;
+	bool             m_TranscoderBusy;
+
+	// transcoder link version, 1 until the transcoder acknowledges our hello
+	std::atomic<unsigned> m_TCVersion;
+	bool             m_HelloPending;
+	uint64_t         m_TCReconnects;
+	uint8_t          m_Wanted;
+	uint64_t         m_WantedVersion;
+	uint16_t         m_WantedStream;
 
 	// associated packet stream
 	CPacketStream  *m_PacketStream;
 
-	// queues
-	CSafePacketQueue<std::unique_ptr<CPacket>> m_LocalQueue, m_Queue;
-
-	// thread
-	std::atomic<bool> keep_running;
-	std::future<void> m_Future;
+	// frames waiting for the transcoder, indexed by sequence and only touched by our thread.
+	// Replies can come back in any order, but frames leave in the order they came in,
+	// and a frame that isn't back by the deadline leaves with silence instead.
+	struct SInFlight
+	{
+		std::unique_ptr<CPacket> packet;
+		int  transcoder;	// where it was sent, -1 if it wasn't
+		bool done;
+	};
+	std::unique_ptr<SInFlight[]> m_InFlight;
+	uint32_t        m_NextSeq;      // of the next frame sent
+	uint32_t        m_NextOut;      // of the oldest frame still waiting
+	unsigned        m_Deadline;     // in ms
+
+	// frames on their way back to the clients
+	CPacer          m_Pacer;
+
+	// frames pushed to us that haven't gone back to the packet stream, or been dropped
+	std::atomic<unsigned> m_Pending;
+
+	// queue
+	CRingQueue<std::unique_ptr<CPacket>> m_Queue;
 
 	// statistics
 	double       m_RTMin;
@@ -84,4 +138,9 @@ protected:
 	double       m_RTSum;
 	unsigned int m_RTCount;
 	uint32_t     m_uiTotalPackets;
+	// since the start, for the report
+	std::atomic<uint64_t> m_RTTotalCount, m_RTTotalUs, m_RTWorstUs;
+	std::atomic<uint64_t> m_TCBytesOut, m_TCBytesIn;
+	std::atomic<uint64_t> m_Lost, m_Late, m_Bypassed, m_Untranscoded;
+	CMetricHistogram *m_RTHistogram;
 };
@@ -60,6 +60,7 @@
 #define JIPV6BINDING             "IPv6Binding"
 #define JIPV6EXTERNAL            "IPv6External"
 #define JJSONPATH                "JsonPath"
+#define JKERNELTIMESTAMPS        "KernelTimestamps"
 #define JM17                     "M17"
 #define JMMDVM                   "MMDVM"
 #define JMODE                    "Mode"
@@ -76,11 +77,17 @@
 #define JREGISTRATIONDESCRIPTION "RegistrationDescription"
 #define JREGISTRATIONID          "RegistrationID"
 #define JREGISTRATIONNAME        "RegistrationName"
+#define JREPORTINTERVAL          "ReportInterval"
 #define JRXPORT                  "RxPort"
 #define JSPONSOR                 "Sponsor"
+#define JSTATUSPORT              "StatusPort"
+#define JCAPTUREPATH             "CapturePath"
 #define JSYSOPEMAIL              "SysopEmail"
 #define JTRANSCODED              "Transcoded"
+#define JTRANSCODEDEADLINE       "TranscodeDeadline"
 #define JTRANSCODER              "Transcoder"
+#define JTRANSCODERSOCKETS       "TranscoderSockets"
+#define JTRANSCODERTHREADS       "TranscoderThreads"
 #define JTXPORT                  "TxPort"
 #define JURF                     "URF"
 #define JURL                     "URL"
@@ -282,6 +289,10 @@ bool CConfigure::ReadData(const std::string &path)
 				{
 					data[g_Keys.ip.ipv6address] = value;
 				}
+				else if (0 == key.compare(JKERNELTIMESTAMPS))
+				{
+					data[g_Keys.ip.kerneltimestamps] = IS_TRUE(value[0]);
+				}
 				else if (0 == key.compare(JTRANSCODER))
 				{
 					if (value.compare("local"))
@@ -314,6 +325,12 @@ bool CConfigure::ReadData(const std::string &path)
 					} else
 						data[g_Keys.modules.tcmodules] = m;
 				}
+				else if (0 == key.compare(JTRANSCODEDEADLINE))
+					data[g_Keys.modules.tcdeadline] = getUnsigned(value, JTRANSCODEDEADLINE, 20, 2000, 250);
+				else if (0 == key.compare(JTRANSCODERSOCKETS))
+					data[g_Keys.modules.tcsockets] = value;
+				else if (0 == key.compare(JTRANSCODERTHREADS))
+					data[g_Keys.modules.tcthreads] = getUnsigned(value, JTRANSCODERTHREADS, 1, 8, 1);
 				else if (0 == key.compare(0, 11, "Description"))
 				{
 					if (12 == key.size() && isupper(key[11]))
@@ -481,6 +498,12 @@ bool CConfigure::ReadData(const std::string &path)
 					data[g_Keys.files.xml] = value;
 				else if (0 == key.compare(JJSONPATH))
 					data[g_Keys.files.json] = value;
+				else if (0 == key.compare(JREPORTINTERVAL))
+					data[g_Keys.files.reportinterval] = getUnsigned(value, JREPORTINTERVAL, 100, 10000, 1000);
+				else if (0 == key.compare(JSTATUSPORT))
+					data[g_Keys.files.statusport] = getUnsigned(value, JSTATUSPORT, 0, 65535, 0);
+				else if (0 == key.compare(JCAPTUREPATH))
+					data[g_Keys.files.capture] = value;
 				else if (0 == key.compare(JWHITELISTPATH))
 					data[g_Keys.files.white] = value;
 				else if (0 == key.compare(JBLACKLISTPATH))
@@ -602,6 +625,9 @@ bool CConfigure::ReadData(const std::string &path)
 		data[g_Keys.ip.ipv6address] = nullptr;
 	}
 
+	if (! data.contains(g_Keys.ip.kerneltimestamps))
+		data[g_Keys.ip.kerneltimestamps] = false;
+
 	// Modules section
 	if (isDefined(ErrorLevel::fatal, JMODULES, JMODULES, g_Keys.modules.modules, rval))
 	{
@@ -624,6 +650,18 @@ bool CConfigure::ReadData(const std::string &path)
 					rval = true;
 				}
 			}
+
+			// how long to wait for a transcoded frame, in milliseconds
+			if (! data.contains(g_Keys.modules.tcdeadline))
+				data[g_Keys.modules.tcdeadline] = 250u;
+
+			// how many threads share the transcoder work
+			if (! data.contains(g_Keys.modules.tcthreads))
+				data[g_Keys.modules.tcthreads] = 1u;
+
+			// where the transcoders are listening
+			if (! data.contains(g_Keys.modules.tcsockets))
+				data[g_Keys.modules.tcsockets] = REF2TC;
 		}
 		else
 			data[g_Keys.modules.tcmodules] = nullptr;
@@ -760,6 +798,12 @@ bool CConfigure::ReadData(const std::string &path)
 	// Other files
 	isDefined(ErrorLevel::fatal, JFILES, JPIDPATH, g_Keys.files.pid, rval);
 	isDefined(ErrorLevel::fatal, JFILES, JXMLPATH, g_Keys.files.xml, rval);
+	// how often the dashboard files are checked for changes, in milliseconds
+	if (! data.contains(g_Keys.files.reportinterval))
+		data[g_Keys.files.reportinterval] = 1000u;
+	// the local status server is off unless it has a port
+	if (! data.contains(g_Keys.files.statusport))
+		data[g_Keys.files.statusport] = 0u;
 	if (isDefined(ErrorLevel::fatal, JFILES, JWHITELISTPATH, g_Keys.files.white, rval))
 		checkFile(JFILES, JWHITELISTPATH, data[g_Keys.files.white]);
 	if (isDefined(ErrorLevel::fatal, JFILES, JBLACKLISTPATH, g_Keys.files.black, rval))
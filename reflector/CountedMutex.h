@@ -0,0 +1,69 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+struct SLockStats
+{
+	uint64_t acquired, contended;
+	uint64_t waitns, maxwaitns;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// A mutex that counts how often it's taken, how often somebody had to wait
+// for it, and for how long. An uncontended Lock() costs a try_lock().
+
+class CCountedMutex
+{
+public:
+	CCountedMutex() : m_Acquired(0), m_Contended(0), m_WaitNs(0), m_MaxWaitNs(0) {}
+
+	void Lock(void)     { if (! m_Mutex.try_lock()) Contended(); m_Acquired.fetch_add(1, std::memory_order_relaxed); }
+	void Unlock(void)   { m_Mutex.unlock(); }
+
+	void GetStats(SLockStats &stats) const
+	{
+		stats.acquired  = m_Acquired.load(std::memory_order_relaxed);
+		stats.contended = m_Contended.load(std::memory_order_relaxed);
+		stats.waitns    = m_WaitNs.load(std::memory_order_relaxed);
+		stats.maxwaitns = m_MaxWaitNs.load(std::memory_order_relaxed);
+	}
+
+protected:
+	void Contended(void)
+	{
+		auto start = std::chrono::steady_clock::now();
+		m_Mutex.lock();
+		uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		m_Contended.fetch_add(1, std::memory_order_relaxed);
+		m_WaitNs.fetch_add(ns, std::memory_order_relaxed);
+		// we own the lock, nobody else updates the max
+		if (ns > m_MaxWaitNs.load(std::memory_order_relaxed))
+			m_MaxWaitNs.store(ns, std::memory_order_relaxed);
+	}
+
+	// data
+	std::mutex m_Mutex;
+	std::atomic<uint64_t> m_Acquired, m_Contended, m_WaitNs, m_MaxWaitNs;
+};
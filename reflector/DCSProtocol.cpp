@@ -27,13 +27,15 @@
 
 bool CDcsProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = DCS_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// done
 	return true;
 }
@@ -132,9 +134,7 @@ void CDcsProtocol::Task(void)
 
 			// find all clients with that callsign & ip and keep them alive
 			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(Callsign, Ip, EProtocol::dcs, it)) != nullptr )
+			for ( auto &client : clients->FindClients(Callsign, Ip, EProtocol::dcs) )
 			{
 				client->Alive();
 			}
@@ -148,27 +148,15 @@ void CDcsProtocol::Task(void)
 		else
 		{
 			// invalid packet
+			m_ParseFailures->Add();
 			std::string title("Unknown DCS packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > DCS_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -201,7 +189,7 @@ void CDcsProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -218,11 +206,10 @@ void CDcsProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 
 void CDcsProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto module = packet->GetPacketModule();
 
@@ -251,20 +238,18 @@ void CDcsProtocol::HandleQueue(void)
 			if ( buffer.size() > 0 )
 			{
 				// and push it to all our clients linked to the module and who are not streaming in
-				CClients *clients = g_Reflector.GetClients();
-				auto it = clients->begin();
-				std::shared_ptr<CClient>client = nullptr;
-				while ( (client = clients->FindNextClient(EProtocol::dcs, it)) != nullptr )
+				std::vector<CIp> ips;
+				for ( auto &client : GetSubscribers(EProtocol::dcs, module) )
 				{
 					// is this client busy ?
-					if ( !client->IsAMaster() && (client->GetReflectorModule() == module) )
+					if ( !client->IsAMaster() )
 					{
-						// no, send the packet
-						Send(buffer, client->GetIp());
-
+						// no, add it to the destinations
+						ips.push_back(client->GetIp());
 					}
 				}
-				g_Reflector.ReleaseClients();
+				Send(buffer, ips);
+				TraceSent(*packet);
 			}
 		}
 	}
@@ -273,7 +258,7 @@ void CDcsProtocol::HandleQueue(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CDcsProtocol::HandleKeepalives(void)
+void CDcsProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// DCS protocol sends and monitors keepalives packets
 	// event if the client is currently streaming
@@ -281,41 +266,32 @@ void CDcsProtocol::HandleKeepalives(void)
 	CBuffer keepalive1;
 	EncodeKeepAlivePacket(&keepalive1);
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::dcs, it)) != nullptr )
-	{
-		// encode client's specific keepalive packet
-		CBuffer keepalive2;
-		EncodeKeepAlivePacket(&keepalive2, client);
+	// encode client's specific keepalive packet
+	CBuffer keepalive2;
+	EncodeKeepAlivePacket(&keepalive2, client);
 
-		// send keepalive
-		Send(keepalive1, client->GetIp());
-		Send(keepalive2, client->GetIp());
-
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, disconnect
-			CBuffer disconnect;
-			EncodeDisconnectPacket(&disconnect, client);
-			Send(disconnect, client->GetIp());
-
-			// remove it
-			std::cout << "DCS client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
+	// send keepalive
+	Send(keepalive1, client->GetIp());
+	Send(keepalive2, client->GetIp());
 
+	// is this client busy ?
+	if ( client->IsAMaster() )
+	{
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, disconnect
+		CBuffer disconnect;
+		EncodeDisconnectPacket(&disconnect, client);
+		Send(disconnect, client->GetIp());
+
+		// remove it
+		std::cout << "DCS client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
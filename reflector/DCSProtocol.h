@@ -53,7 +53,7 @@ protected:
 	void HandleQueue(void);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -75,9 +75,6 @@ protected:
 	void EncodeLastDCSPacket(const CDvHeaderPacket &, const CDvFramePacket &, uint32_t, CBuffer *) const;
 
 protected:
-	// for keep alive
-	CTimer          m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CDcsStreamCacheItem> m_StreamsCache;
 };
@@ -29,13 +29,15 @@
 
 bool CDextraProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = DEXTRA_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// done
 	return true;
 }
@@ -155,9 +157,7 @@ void CDextraProtocol::Task(void)
 
 			// find all clients with that callsign & ip and keep them alive
 			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(Callsign, Ip, EProtocol::dextra, it)) != nullptr )
+			for ( auto &client : clients->FindClients(Callsign, Ip, EProtocol::dextra) )
 			{
 				client->Alive();
 			}
@@ -165,27 +165,15 @@ void CDextraProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 			std::string title("Unknown DExtra packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep alive
-	if ( m_LastKeepaliveTime.time() > DEXTRA_KEEPALIVE_PERIOD )
-	{
-		// handle keep alives
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -193,33 +181,33 @@ void CDextraProtocol::Task(void)
 
 void CDextraProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty() )
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// encode it
 		CBuffer buffer;
 		if ( EncodeDvPacket(*packet, buffer) )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::dextra, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::dextra, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
-					int n = packet->IsDvHeader() ? 5 : 1;
-					for ( int i = 0; i < n; i++ )
-					{
-						Send(buffer, client->GetIp());
-					}
+					// no, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+
+			// headers are sent several times
+			int n = packet->IsDvHeader() ? 5 : 1;
+			for ( int i = 0; i < n; i++ )
+			{
+				Send(buffer, ips);
+			}
+			TraceSent(*packet);
 		}
 	}
 }
@@ -227,7 +215,7 @@ void CDextraProtocol::HandleQueue(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CDextraProtocol::HandleKeepalives(void)
+void CDextraProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// DExtra protocol sends and monitors keepalives packets
 	// event if the client is currently streaming
@@ -235,47 +223,41 @@ void CDextraProtocol::HandleKeepalives(void)
 	CBuffer keepalive;
 	EncodeKeepAlivePacket(&keepalive);
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::dextra, it)) != nullptr )
-	{
-		// send keepalive
-		Send(keepalive, client->GetIp());
+	// send keepalive
+	Send(keepalive, client->GetIp());
 
-		// client busy ?
-		if ( client->IsAMaster() )
+	// client busy ?
+	if ( client->IsAMaster() )
+	{
+		// yes, just tickle it
+		client->Alive();
+	}
+	// otherwise check if still with us
+	else if ( !client->IsAlive() )
+	{
+		CPeers *peers = g_Reflector.GetPeers();
+		std::shared_ptr<CPeer>peer = peers->FindPeer(client->GetCallsign(), client->GetIp(), EProtocol::dextra);
+		if ( peer != nullptr && peer->GetReflectorModules()[0] == client->GetReflectorModule() )
 		{
-			// yes, just tickle it
-			client->Alive();
+			// no, but this is a peer client, so it will be handled with the peers
 		}
-		// otherwise check if still with us
-		else if ( !client->IsAlive() )
+		else
 		{
-			CPeers *peers = g_Reflector.GetPeers();
-			std::shared_ptr<CPeer>peer = peers->FindPeer(client->GetCallsign(), client->GetIp(), EProtocol::dextra);
-			if ( peer != nullptr && peer->GetReflectorModules()[0] == client->GetReflectorModule() )
-			{
-				// no, but this is a peer client, so it will be handled below
-			}
-			else
-			{
-				// no, disconnect
-				CBuffer disconnect;
-				EncodeDisconnectPacket(&disconnect, client->GetReflectorModule());
-				Send(disconnect, client->GetIp());
+			// no, disconnect
+			CBuffer disconnect;
+			EncodeDisconnectPacket(&disconnect, client->GetReflectorModule());
+			Send(disconnect, client->GetIp());
 
-				// remove it
-				std::cout << "DExtra client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-				clients->RemoveClient(client);
-			}
-			g_Reflector.ReleasePeers();
+			// remove it
+			std::cout << "DExtra client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+			clients->RemoveClient(client);
 		}
-
+		g_Reflector.ReleasePeers();
 	}
-	g_Reflector.ReleaseClients();
+}
 
+void CDextraProtocol::HandleKeepalives(void)
+{
 	// iterate on peers
 	CPeers *peers = g_Reflector.GetPeers();
 	auto pit = peers->begin();
@@ -344,7 +326,7 @@ void CDextraProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Heade
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
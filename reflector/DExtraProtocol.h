@@ -62,6 +62,7 @@ protected:
 	void HandleQueue(void);
 
 	// keepalive helpers
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 	void HandleKeepalives(void);
 
 	// stream helpers
@@ -83,7 +84,4 @@ protected:
 	void EncodeDisconnectedPacket(CBuffer *);
 	bool EncodeDvHeaderPacket(const CDvHeaderPacket &, CBuffer &) const;
 	bool EncodeDvFramePacket(const CDvFramePacket &, CBuffer &) const;
-
-	// time
-	CTimer m_LastKeepaliveTime;
 };
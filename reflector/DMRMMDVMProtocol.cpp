@@ -49,13 +49,15 @@ static uint8_t g_DmrSyncMSData[]     = { 0x0D,0x5D,0x7F,0x77,0xFD,0x75,0x70 };
 bool CDmrmmdvmProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
 	m_DefaultId = g_Configure.GetUnsigned(g_Keys.mmdvm.defaultid);
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = DMRMMDVM_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// random number generator
 	time_t t;
 	::srand((unsigned) time(&t));
@@ -198,9 +200,7 @@ void CDmrmmdvmProtocol::Task(void)
 
 			// find all clients with that callsign & ip and keep them alive
 			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(Callsign, Ip, EProtocol::dmrmmdvm, it)) != nullptr )
+			for ( auto &client : clients->FindClients(Callsign, Ip, EProtocol::dmrmmdvm) )
 			{
 				// acknowledge
 				EncodeKeepAlivePacket(&Buffer, client);
@@ -227,28 +227,14 @@ void CDmrmmdvmProtocol::Task(void)
 		}
 		else if ( Buffer.size() != 55 )
 		{
+			m_ParseFailures->Add();
 			std::string title("Unknown DMRMMDVM packet from ");
 			title += Ip.GetAddress();
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > DMRMMDVM_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
-
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -319,7 +305,7 @@ void CDmrmmdvmProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Hea
 				if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 				{
 					// keep the handle
-					m_Streams[stream->GetStreamId()] = stream;
+					AddStream(stream);
 					lastheard = true;
 				}
 			}
@@ -346,11 +332,10 @@ void CDmrmmdvmProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Hea
 
 void CDmrmmdvmProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto mod = packet->GetPacketModule();
 
@@ -401,20 +386,18 @@ void CDmrmmdvmProtocol::HandleQueue(void)
 		if ( buffer.size() > 0 )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::dmrmmdvm, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::dmrmmdvm, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
-					Send(buffer, client->GetIp());
-
+					// no, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+			Send(buffer, ips);
+			TraceSent(*packet);
 		}
 	}
 }
@@ -422,38 +405,29 @@ void CDmrmmdvmProtocol::HandleQueue(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CDmrmmdvmProtocol::HandleKeepalives(void)
+void CDmrmmdvmProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// DMRhomebrew protocol keepalive request is client tasks
 	// here, just check that all clients are still alive
 	// and disconnect them if not
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::dmrmmdvm, it)) != nullptr )
+	// is this client busy ?
+	if ( client->IsAMaster() )
 	{
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, disconnect
-			CBuffer disconnect;
-			Send(disconnect, client->GetIp());
-
-			// remove it
-			std::cout << "DMRmmdvm client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, disconnect
+		CBuffer disconnect;
+		Send(disconnect, client->GetIp());
 
+		// remove it
+		std::cout << "DMRmmdvm client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -67,7 +67,7 @@ protected:
 	void HandleQueue(void);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &, uint8_t, uint8_t);
@@ -107,9 +107,6 @@ protected:
 
 
 protected:
-	// for keep alive
-	 CTimer         m_LastKeepaliveTime;
-
 	// for stream id
 	uint16_t              m_uiStreamId;
 
@@ -41,13 +41,15 @@ static uint8_t g_DmrSyncMSData[]     = { 0x0D,0x5D,0x7F,0x77,0xFD,0x75,0x70 };
 
 bool CDmrplusProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = DMRPLUS_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// random number generator
 	time_t t;
 	::srand((unsigned) time(&t));
@@ -150,28 +152,15 @@ void CDmrplusProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 			std::string title("Unknown DMR+ packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > DMRPLUS_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -202,7 +191,7 @@ void CDmrplusProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Head
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -218,11 +207,10 @@ void CDmrplusProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Head
 
 void CDmrplusProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto mod = packet->GetPacketModule();
 
@@ -265,19 +253,18 @@ void CDmrplusProtocol::HandleQueue(void)
 		if ( buffer.size() > 0 )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::dmrplus, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::dmrplus, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
-					Send(buffer, client->GetIp());
+					// no, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+			Send(buffer, ips);
+			TraceSent(*packet);
 
 			// debug
 			//buffer.DebugDump(g_Reflector.m_DebugFile);
@@ -290,19 +277,15 @@ void CDmrplusProtocol::SendBufferToClients(const CBuffer &buffer, uint8_t module
 	if ( buffer.size() > 0 )
 	{
 		// and push it to all our clients linked to the module and who are not streaming in
-		CClients *clients = g_Reflector.GetClients();
-		auto it = clients->begin();
-		std::shared_ptr<CClient>client = nullptr;
-		while ( (client = clients->FindNextClient(EProtocol::dmrplus, it)) != nullptr )
+		for ( auto &client : GetSubscribers(EProtocol::dmrplus, module) )
 		{
 			// is this client busy ?
-			if ( !client->IsAMaster() && (client->GetReflectorModule() == module) )
+			if ( !client->IsAMaster() )
 			{
 				// no, send the packet
 				Send(buffer, client->GetIp());
 			}
 		}
-		g_Reflector.ReleaseClients();
 
 		// debug
 		//buffer.DebugDump(g_Reflector.m_DebugFile);
@@ -313,39 +296,30 @@ void CDmrplusProtocol::SendBufferToClients(const CBuffer &buffer, uint8_t module
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CDmrplusProtocol::HandleKeepalives(void)
+void CDmrplusProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// DMRplus protocol keepalive request is client tasks
 	// here, just check that all clients are still alive
 	// and disconnect them if not
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::dmrplus, it)) != nullptr )
+	// is this client busy ?
+	if ( client->IsAMaster() )
 	{
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, disconnect
-			//CBuffer disconnect;
-			//EncodeDisconnectPacket(&disconnect, client);
-			//Send(disconnect, client->GetIp());
-
-			// remove it
-			std::cout << "DMRplus client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
-
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, disconnect
+		//CBuffer disconnect;
+		//EncodeDisconnectPacket(&disconnect, client);
+		//Send(disconnect, client->GetIp());
+
+		// remove it
+		std::cout << "DMRplus client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
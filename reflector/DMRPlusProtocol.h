@@ -61,7 +61,7 @@ protected:
 	void SendBufferToClients(const CBuffer &, uint8_t);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -96,9 +96,6 @@ protected:
 
 
 protected:
-	// for keep alive
-	CTimer m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CDmrplusStreamCacheItem> m_StreamsCache;
 };
@@ -28,13 +28,15 @@
 
 bool CDplusProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = DPLUS_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// done
 	return true;
 }
@@ -130,9 +132,7 @@ void CDplusProtocol::Task(void)
 
 			// find all clients with that callsign & ip and keep them alive
 			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(Ip, EProtocol::dplus, it)) != nullptr )
+			for ( auto &client : clients->FindClients(Ip, EProtocol::dplus) )
 			{
 				client->Alive();
 			}
@@ -140,27 +140,15 @@ void CDplusProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 			std::string title("Unknown DPlus packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > DPLUS_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -206,7 +194,7 @@ void CDplusProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header
 				if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 				{
 					// keep the handle
-					m_Streams[stream->GetStreamId()] = stream;
+					AddStream(stream);
 				}
 			}
 			// release
@@ -228,11 +216,10 @@ void CDplusProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header
 
 void CDplusProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto mod = packet->GetPacketModule();
 
@@ -251,6 +238,8 @@ void CDplusProtocol::HandleQueue(void)
 			// and push it to all our clients who are not streaming in
 			// note that for dplus protocol, all stream of all modules are push to all clients
 			// it's client who decide which stream he's interrrested in
+			std::vector<CIp> ips;
+			std::vector<std::shared_ptr<CClient>> headerCopies;
 			CClients *clients = g_Reflector.GetClients();
 			auto it = clients->begin();
 			std::shared_ptr<CClient>client = nullptr;
@@ -270,24 +259,31 @@ void CDplusProtocol::HandleQueue(void)
 					else if ( packet->IsDvFrame() )
 					{
 						// and send the DV frame
-						Send(buffer, client->GetIp());
+						ips.push_back(client->GetIp());
 
 						// is it time to insert a DVheader copy ?
 						if ( (m_StreamsCache[mod].m_iSeqCounter++ % 21) == 20 )
 						{
-							// yes, clone it
-							CDvHeaderPacket packet2(m_StreamsCache[mod].m_dvHeader);
-							// and send it
-							SendDvHeader(&packet2, (CDplusClient *)client.get());
+							// yes, after the frame
+							headerCopies.push_back(client);
 						}
 					}
 					else
 					{
 						// otherwise, send the original packet
-						Send(buffer, client->GetIp());
+						ips.push_back(client->GetIp());
 					}
 				}
 			}
+			Send(buffer, ips);
+			TraceSent(*packet);
+			for ( auto &c : headerCopies )
+			{
+				// clone it
+				CDvHeaderPacket packet2(m_StreamsCache[mod].m_dvHeader);
+				// and send it
+				SendDvHeader(&packet2, (CDplusClient *)c.get());
+			}
 			g_Reflector.ReleaseClients();
 		}
 	}
@@ -333,42 +329,34 @@ void CDplusProtocol::SendDvHeader(CDvHeaderPacket *packet, CDplusClient *client)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CDplusProtocol::HandleKeepalives(void)
+void CDplusProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// send keepalives
 	CBuffer keepalive;
 	EncodeKeepAlivePacket(&keepalive);
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::dplus, it)) != nullptr )
-	{
-		// send keepalive
-		//std::cout << "Sending DPlus packet @ " << client->GetIp() << std::endl;
-		Send(keepalive, client->GetIp());
+	// send keepalive
+	//std::cout << "Sending DPlus packet @ " << client->GetIp() << std::endl;
+	Send(keepalive, client->GetIp());
 
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, disconnect
-			CBuffer disconnect;
-			EncodeDisconnectPacket(&disconnect);
-			Send(disconnect, client->GetIp());
-
-			// and remove it
-			std::cout << "DPlus client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
+	// is this client busy ?
+	if ( client->IsAMaster() )
+	{
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, disconnect
+		CBuffer disconnect;
+		EncodeDisconnectPacket(&disconnect);
+		Send(disconnect, client->GetIp());
+
+		// and remove it
+		std::cout << "DPlus client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
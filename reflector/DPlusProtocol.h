@@ -50,7 +50,7 @@ protected:
 	void SendDvHeader(CDvHeaderPacket *, CDplusClient *);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -72,9 +72,6 @@ protected:
 	bool EncodeDvFramePacket(const CDvFramePacket &, CBuffer &) const;
 
 protected:
-	// for keep alive
-	CTimer m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CDPlusStreamCacheItem> m_StreamsCache;
 };
@@ -20,66 +20,109 @@
 #include <string.h>
 #include "DVFramePacket.h"
 
-// default constructor
+////////////////////////////////////////////////////////////////////////////////////////
+// pools & stats
+
+std::atomic<uint64_t> CDvFramePacket::s_SharedCopies(0);
+std::atomic<uint64_t> CDvFramePacket::s_PayloadClones(0);
+
+CSlabPool *CDvFramePacket::FramePool(void)
+{
+	static CSlabPool *pool = CSlabPool::Create("DV frames", sizeof(CDvFramePacket));
+	return pool;
+}
+
+// room for the shared_ptr control block that allocate_shared() puts in front of the payload
+CSlabPool *CDvFramePacket::PayloadPool(void)
+{
+	static CSlabPool *pool = CSlabPool::Create("DV frame payloads", sizeof(SDvFramePayload) + 4 * sizeof(void *));
+	return pool;
+}
+
+void *CDvFramePacket::operator new(size_t size)
+{
+	return FramePool()->Get(size);
+}
+
+void CDvFramePacket::operator delete(void *p, size_t size)
+{
+	FramePool()->Put(p, size);
+}
+
+// a fresh, zeroed payload
+std::shared_ptr<SDvFramePayload> CDvFramePacket::MakePayload(void)
+{
+	auto p = std::allocate_shared<SDvFramePayload>(CSlabAllocator<SDvFramePayload>(PayloadPool()));
+	memset(p->dvdata, 0, 3);
+	memset(p->dvsync, 0, 7);
+	memset(p->nonce, 0, 14);
+	memset(p->tcpack.dstar, 0, 9);
+	memset(p->tcpack.dmr, 0, 9);
+	memset(p->tcpack.m17, 0, 16);
+	memset(p->tcpack.p25, 0, 11);
+	memset(p->tcpack.usrp, 0, 320);
+	p->tcpack.codec_in = ECodecType::none;
+	return p;
+}
+
+SDvFramePayload &CDvFramePacket::NewPayload(void)
+{
+	m_Payload = MakePayload();
+	return *m_Payload;
+}
+
+// copy on write
+SDvFramePayload &CDvFramePacket::MutablePayload(void)
+{
+	if (m_Payload.use_count() > 1)
+	{
+		m_Payload = std::allocate_shared<SDvFramePayload>(CSlabAllocator<SDvFramePayload>(PayloadPool()), *m_Payload);
+		s_PayloadClones++;
+	}
+	return *m_Payload;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructors
+
+// default constructor, all default frames share one empty payload
 CDvFramePacket::CDvFramePacket()
 {
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.dmr, 0, 9);
-	memset(m_uiDvSync, 0, 7);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.usrp, 0, 320);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::none;
+	// never destroyed, frames in static objects may outlive it
+	static const auto empty = new std::shared_ptr<SDvFramePayload>(MakePayload());
+	m_Payload = *empty;
 };
 
 // dstar constructor
 CDvFramePacket::CDvFramePacket(const SDStarFrame *dvframe, uint16_t sid, uint8_t pid)
 	: CPacket(sid, pid)
 {
-	memcpy(m_TCPack.dstar, dvframe->AMBE, 9);
-	memcpy(m_uiDvData, dvframe->DVDATA, 3);
-	memset(m_TCPack.dmr, 0, 9);
-	memset(m_uiDvSync, 0, 7);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.usrp, 0, 320);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::dstar;
+	auto &p = NewPayload();
+	memcpy(p.tcpack.dstar, dvframe->AMBE, 9);
+	memcpy(p.dvdata, dvframe->DVDATA, 3);
+	p.tcpack.codec_in = ECodecType::dstar;
 }
 
 // dmr constructor
 CDvFramePacket::CDvFramePacket(const uint8_t *ambe, const uint8_t *sync, uint16_t sid, uint8_t pid, uint8_t spid, bool islast)
 	: CPacket(sid, pid, spid, islast)
 {
-	memcpy(m_TCPack.dmr, ambe, 9);
-	memcpy(m_uiDvSync, sync, 7);
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.usrp, 0, 320);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::dmr;
+	auto &p = NewPayload();
+	memcpy(p.tcpack.dmr, ambe, 9);
+	memcpy(p.dvsync, sync, 7);
+	p.tcpack.codec_in = ECodecType::dmr;
 }
 
 // ysf constructor
 CDvFramePacket::CDvFramePacket(const uint8_t *ambe, uint16_t sid, uint8_t pid, uint8_t spid, uint8_t fid, CCallsign cs, bool islast)
 	: CPacket(sid, pid, spid, fid, islast)
 {
-	memcpy(m_TCPack.dmr, ambe, 9);
-	memset(m_uiDvSync, 0, 7);
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.usrp, 0, 320);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::dmr;
+	auto &p = NewPayload();
+	memcpy(p.tcpack.dmr, ambe, 9);
+	p.tcpack.codec_in = ECodecType::dmr;
 	uint8_t c[12];
     cs.GetCallsign(c);
-    m_Callsign.SetCallsign((char *)c);
+    p.callsign.SetCallsign((char *)c);
 }
 
 // bm constructor
@@ -87,35 +130,31 @@ CDvFramePacket::CDvFramePacket
 (uint16_t sid, uint8_t dstarpid, const uint8_t *dstarambe, const uint8_t *dstardvdata, uint8_t dmrpid, uint8_t dprspid, const uint8_t *dmrambe, const uint8_t *dmrsync, ECodecType codecInType, bool islast)
 	: CPacket(sid, dstarpid, dmrpid, dprspid, 0xFF, 0xFF, 0xFF, codecInType, islast)
 {
-	::memcpy(m_TCPack.dstar, dstarambe, 9);
-	::memcpy(m_uiDvData, dstardvdata, 3);
-	::memcpy(m_TCPack.dmr, dmrambe, 9);
-	::memcpy(m_uiDvSync, dmrsync, 7);
-	m_TCPack.codec_in = codecInType;
+	auto &p = NewPayload();
+	::memcpy(p.tcpack.dstar, dstarambe, 9);
+	::memcpy(p.dvdata, dstardvdata, 3);
+	::memcpy(p.tcpack.dmr, dmrambe, 9);
+	::memcpy(p.dvsync, dmrsync, 7);
+	p.tcpack.codec_in = codecInType;
 }
 
 // m17 constructor
 
 CDvFramePacket::CDvFramePacket(const CM17Packet &m17) : CPacket(m17)
 {
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.dmr, 0, 9);
-	memset(m_uiDvSync, 0, 7);
-	memcpy(m_TCPack.m17, m17.GetPayload(), 16);
-	memcpy(m_Nonce, m17.GetNonce(), 14);
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.usrp, 0, 320);
+	auto &p = NewPayload();
+	memcpy(p.tcpack.m17, m17.GetPayload(), 16);
+	memcpy(p.nonce, m17.GetNonce(), 14);
 	switch (0x6U & m17.GetFrameType())
 	{
 		case 0x4U:
-			m_TCPack.codec_in = ECodecType::c2_3200;
+			p.tcpack.codec_in = ECodecType::c2_3200;
 			break;
 		case 0x6U:
-			m_TCPack.codec_in = ECodecType::c2_1600;
+			p.tcpack.codec_in = ECodecType::c2_1600;
 			break;
 		default:
-			m_TCPack.codec_in = ECodecType::none;
+			p.tcpack.codec_in = ECodecType::none;
 			break;
 	}
 }
@@ -124,51 +163,35 @@ CDvFramePacket::CDvFramePacket(const CM17Packet &m17) : CPacket(m17)
 CDvFramePacket::CDvFramePacket(const uint8_t *imbe, uint16_t streamid, bool islast)
 	: CPacket(streamid, false, islast)
 {
-	memcpy(m_TCPack.p25, imbe, 11);
-	memset(m_TCPack.dmr, 0, 9);
-	memset(m_uiDvSync, 0, 7);
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_TCPack.usrp, 0, 320);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::p25;
+	auto &p = NewPayload();
+	memcpy(p.tcpack.p25, imbe, 11);
+	p.tcpack.codec_in = ECodecType::p25;
 }
 
 // nxdn constructor
 CDvFramePacket::CDvFramePacket(const uint8_t *ambe, uint16_t sid, uint8_t pid, bool islast)
 	: CPacket(sid, pid, islast)
 {
-	memcpy(m_TCPack.dmr, ambe, 9);
-	memset(m_uiDvSync, 0, 7);
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.usrp, 0, 320);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::dmr;
+	auto &p = NewPayload();
+	memcpy(p.tcpack.dmr, ambe, 9);
+	p.tcpack.codec_in = ECodecType::dmr;
 }
 
 // usrp constructor
 CDvFramePacket::CDvFramePacket(const int16_t *usrp, uint16_t streamid, bool islast)
 	: CPacket(streamid, true, islast)
 {
+	auto &p = NewPayload();
 	for(int i = 0; i < 160; ++i){
-		m_TCPack.usrp[i] = usrp[i];
+		p.tcpack.usrp[i] = usrp[i];
 	}
-	memset(m_TCPack.p25, 0, 11);
-	memset(m_TCPack.dmr, 0, 9);
-	memset(m_uiDvSync, 0, 7);
-	memset(m_TCPack.dstar, 0, 9);
-	memset(m_uiDvData, 0, 3);
-	memset(m_TCPack.m17, 0, 16);
-	memset(m_Nonce, 0, 14);
-	m_TCPack.codec_in = ECodecType::usrp;
+	p.tcpack.codec_in = ECodecType::usrp;
 }
 
+// only the header is copied, the payload is shared
 std::unique_ptr<CPacket> CDvFramePacket::Copy(void)
 {
+	s_SharedCopies++;
 	return std::unique_ptr<CPacket>(new CDvFramePacket(*this));
 }
 
@@ -180,6 +203,7 @@ unsigned int CDvFramePacket::GetNetworkSize()
 
 CDvFramePacket::CDvFramePacket(const CBuffer &buf) : CPacket(buf)
 {
+	auto &p = NewPayload();
 	if (buf.size() >= GetNetworkSize())
 	{
 		auto data = buf.data();
@@ -188,14 +212,14 @@ CDvFramePacket::CDvFramePacket(const CBuffer &buf) : CPacket(buf)
 		for (unsigned int i=0; i<4; i++)
 			seq = 0x100u * seq + data[off+i];
 		off += 4;
-		memcpy(m_uiDvData,		data+off, 3);	off += 3;
-		memcpy(m_uiDvSync,		data+off, 7);	off += 7;
-		memcpy(m_Nonce,			data+off, 14);	off += 14;
-		memcpy(m_TCPack.dstar,	data+off, 9);	off += 9;
-		memcpy(m_TCPack.dmr,	data+off, 9);	off += 9;
-		memcpy(m_TCPack.m17,	data+off, 16);	off += 16;
-		memcpy(m_TCPack.p25,    data+off, 11);	off += 11;
-		memcpy(m_TCPack.usrp,   data+off, 320);
+		memcpy(p.dvdata,		data+off, 3);	off += 3;
+		memcpy(p.dvsync,		data+off, 7);	off += 7;
+		memcpy(p.nonce,			data+off, 14);	off += 14;
+		memcpy(p.tcpack.dstar,	data+off, 9);	off += 9;
+		memcpy(p.tcpack.dmr,	data+off, 9);	off += 9;
+		memcpy(p.tcpack.m17,	data+off, 16);	off += 16;
+		memcpy(p.tcpack.p25,    data+off, 11);	off += 11;
+		memcpy(p.tcpack.usrp,   data+off, 320);
 		SetTCParams(seq);
 	}
 	else
@@ -208,18 +232,19 @@ void CDvFramePacket::EncodeInterlinkPacket(CBuffer &buf) const
 	buf.resize(GetNetworkSize());
 	auto data = buf.data();
 	auto off = CPacket::GetNetworkSize();
-	data[off++] = (m_TCPack.sequence >> 24) & 0xffu;
-	data[off++] = (m_TCPack.sequence >> 16) & 0xffu;
-	data[off++] = (m_TCPack.sequence >>  8) & 0xffu;
-	data[off++] = m_TCPack.sequence & 0xffu;
-	memcpy(data+off, m_uiDvData,      3); off += 3;
-	memcpy(data+off, m_uiDvSync,      7); off += 7;
-	memcpy(data+off, m_Nonce,        14); off += 14;
-	memcpy(data+off, m_TCPack.dstar,  9); off += 9;
-	memcpy(data+off, m_TCPack.dmr,    9); off += 9;
-	memcpy(data+off, m_TCPack.m17,   16); off += 16;
-	memcpy(data+off, m_TCPack.p25,   11); off += 11;
-	memcpy(data+off, m_TCPack.usrp, 320);
+	const auto &p = *m_Payload;
+	data[off++] = (p.tcpack.sequence >> 24) & 0xffu;
+	data[off++] = (p.tcpack.sequence >> 16) & 0xffu;
+	data[off++] = (p.tcpack.sequence >>  8) & 0xffu;
+	data[off++] = p.tcpack.sequence & 0xffu;
+	memcpy(data+off, p.dvdata,        3); off += 3;
+	memcpy(data+off, p.dvsync,        7); off += 7;
+	memcpy(data+off, p.nonce,        14); off += 14;
+	memcpy(data+off, p.tcpack.dstar,  9); off += 9;
+	memcpy(data+off, p.tcpack.dmr,    9); off += 9;
+	memcpy(data+off, p.tcpack.m17,   16); off += 16;
+	memcpy(data+off, p.tcpack.p25,   11); off += 11;
+	memcpy(data+off, p.tcpack.usrp, 320);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -230,16 +255,16 @@ const uint8_t *CDvFramePacket::GetCodecData(ECodecType type) const
 	switch (type)
 	{
 	case ECodecType::dstar:
-		return m_TCPack.dstar;
+		return m_Payload->tcpack.dstar;
 	case ECodecType::dmr:
-		return m_TCPack.dmr;
+		return m_Payload->tcpack.dmr;
 	case ECodecType::c2_1600:
 	case ECodecType::c2_3200:
-		return m_TCPack.m17;
+		return m_Payload->tcpack.m17;
 	case ECodecType::p25:
-		return m_TCPack.p25;
+		return m_Payload->tcpack.p25;
 	case ECodecType::usrp:
-		return (uint8_t*)m_TCPack.usrp;
+		return (uint8_t*)m_Payload->tcpack.usrp;
 	default:
 		return nullptr;
 	}
@@ -250,19 +275,59 @@ const uint8_t *CDvFramePacket::GetCodecData(ECodecType type) const
 
 void CDvFramePacket::SetDvData(const uint8_t *DvData)
 {
-	memcpy(m_uiDvData, DvData, 3);
+	memcpy(MutablePayload().dvdata, DvData, 3);
 }
 
 void CDvFramePacket::SetCodecData(const STCPacket *pack)
 {
-	memcpy(&m_TCPack, pack, sizeof(STCPacket));
+	MutablePayload().tcpack = *pack;
+}
+
+void CDvFramePacket::SetCodecData(const STCPacket *pack, uint8_t codecs)
+{
+	auto &tcpack = MutablePayload().tcpack;
+	if (codecs & TC_CODEC_DSTAR)
+		memcpy(tcpack.dstar, pack->dstar, 9);
+	if (codecs & TC_CODEC_DMR)
+		memcpy(tcpack.dmr, pack->dmr, 9);
+	if (codecs & TC_CODEC_M17)
+		memcpy(tcpack.m17, pack->m17, 16);
+	if (codecs & TC_CODEC_P25)
+		memcpy(tcpack.p25, pack->p25, 11);
+	if (codecs & TC_CODEC_USRP)
+		memcpy(tcpack.usrp, pack->usrp, 320);
+}
+
+void CDvFramePacket::SetCodecSilence(void)
+{
+	static const uint8_t dstar[9]  = { 0x9E, 0x8D, 0x32, 0x88, 0x26, 0x1A, 0x3F, 0x61, 0xE8 };
+	static const uint8_t dmr[9]    = { 0xB9, 0xE8, 0x81, 0x52, 0x61, 0x73, 0x00, 0x2A, 0x6B };
+	static const uint8_t c2[8]     = { 0x01, 0x00, 0x09, 0x43, 0x9C, 0xE4, 0x21, 0x08 };
+	static const uint8_t p25[11]   = { 0x04, 0x0C, 0xFD, 0x7B, 0xFB, 0x7D, 0xF2, 0x7B, 0x3D, 0x9E, 0x45 };
+
+	auto &tcpack = MutablePayload().tcpack;
+	const auto in = tcpack.codec_in;
+	if (ECodecType::dstar != in)
+		memcpy(tcpack.dstar, dstar, 9);
+	if (ECodecType::dmr != in)
+		memcpy(tcpack.dmr, dmr, 9);
+	if (ECodecType::c2_1600 != in && ECodecType::c2_3200 != in)
+	{
+		memcpy(tcpack.m17, c2, 8);
+		memcpy(tcpack.m17+8, c2, 8);
+	}
+	if (ECodecType::p25 != in)
+		memcpy(tcpack.p25, p25, 11);
+	if (ECodecType::usrp != in)
+		memset(tcpack.usrp, 0, 320);
 }
 
 void CDvFramePacket::SetTCParams(uint32_t seq)
 {
-	m_TCPack.sequence = seq;
-	m_TCPack.streamid = m_uiStreamId;
-	m_TCPack.is_last = m_bLastPacket;
-	m_TCPack.module = m_cModule;
-	m_TCPack.rt_timer.start();
+	auto &tcpack = MutablePayload().tcpack;
+	tcpack.sequence = seq;
+	tcpack.streamid = m_uiStreamId;
+	tcpack.is_last = m_bLastPacket;
+	tcpack.module = m_cModule;
+	tcpack.rt_timer.start();
 }
@@ -18,8 +18,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <atomic>
+#include <memory>
+
 #include "Packet.h"
 #include "Callsign.h"
+#include "SlabPool.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // defines
@@ -32,9 +36,27 @@ using SDStarFrame = struct __attribute__ ((__packed__))dstar_dvframe_tag
 	uint8_t	DVDATA[3];
 };
 
+// the bulk of a frame, shared by all of its copies
+struct SDvFramePayload
+{
+	// data (dstar)
+	uint8_t dvdata[3];
+	// data (dmr)
+	uint8_t dvsync[7];
+	// m17
+	uint8_t nonce[14];
+	// the transcoder packet
+	STCPacket tcpack;
+	CCallsign callsign;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // class
 
+// A frame is a small CPacket header and a pooled, reference counted payload.
+// Copy() only duplicates the header, which is all a protocol may change,
+// and the payload is copied on write if anyone changes a shared one.
+
 class CDvFramePacket : public CPacket
 {
 	//friend class CCodecStream;
@@ -68,26 +90,39 @@ public:
 	bool IsDvFrame(void) const           { return true; }
 
 	// get
-	const STCPacket *GetCodecPacket() const { return &m_TCPack; }
+	const STCPacket *GetCodecPacket() const { return &m_Payload->tcpack; }
 	const uint8_t *GetCodecData(ECodecType) const;
-	const uint8_t *GetDvSync(void) const { return m_uiDvSync; }
-	const uint8_t *GetDvData(void) const { return m_uiDvData; }
-	const uint8_t *GetNonce(void)  const { return m_Nonce; }
-	const CCallsign &GetMyCallsign(void) const { return m_Callsign; }
+	const uint8_t *GetDvSync(void) const { return m_Payload->dvsync; }
+	const uint8_t *GetDvData(void) const { return m_Payload->dvdata; }
+	const uint8_t *GetNonce(void)  const { return m_Payload->nonce; }
+	const CCallsign &GetMyCallsign(void) const { return m_Payload->callsign; }
 
 	// set
 	void SetDvData(const uint8_t *);
 	void SetCodecData(const STCPacket *pack);
+	void SetCodecData(const STCPacket *pack, uint8_t codecs);	// only the TC_CODEC_* in codecs
+	void SetCodecSilence(void);	// every codec but the input one, for a frame that wasn't transcoded
 	void SetTCParams(uint32_t seq);
 
+	// frames come from a pool
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
+
+	// allocation stats
+	static uint64_t GetSharedCopies(void)  { return s_SharedCopies; }
+	static uint64_t GetPayloadClones(void) { return s_PayloadClones; }
+
 protected:
-	// data (dstar)
-	uint8_t m_uiDvData[3];
-	// data (dmr)
-	uint8_t m_uiDvSync[7];
-	// m17
-	uint8_t m_Nonce[14];
-	// the transcoder packet
-	STCPacket m_TCPack;
-	CCallsign m_Callsign;
+	// payload helpers
+	static std::shared_ptr<SDvFramePayload> MakePayload(void);
+	SDvFramePayload &NewPayload(void);
+	SDvFramePayload &MutablePayload(void);
+	static CSlabPool *FramePool(void);
+	static CSlabPool *PayloadPool(void);
+
+	// data
+	std::shared_ptr<SDvFramePayload> m_Payload;
+
+	// stats
+	static std::atomic<uint64_t> s_SharedCopies, s_PayloadClones;
 };
@@ -130,6 +130,13 @@ enum class EProtocol { any, none, dextra, dplus, dcs, g3, bm, urf, dmrplus, dmrm
 #define G3_KEEPALIVE_PERIOD             10                                  // in seconds
 #define G3_KEEPALIVE_TIMEOUT            3600                                // in seconds, 1 hour
 
+// queues ------------------------------------------------------
+// in packets, a module's voice stream is 50 frames per second
+
+#define PROTOCOL_QUEUE_DEPTH            1024                                // router to protocol, drops the oldest
+#define STREAM_QUEUE_DEPTH              1024                                // protocol & transcoder to router, backpressure
+#define CODEC_QUEUE_DEPTH               256                                 // to and waiting for the transcoder
+
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // macros
@@ -0,0 +1,217 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// faketcd -- a transcoder that doesn't transcode, for testing without the hardware.
+//
+// It listens where tcd does, speaks both versions of the link, and answers
+// every frame right away. The input codec comes back as it was sent, and every
+// other codec is filled with one byte, so whoever gets the frame can tell which
+// instance answered it. It can also be told to stop answering, like a
+// transcoder that has hung.
+
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "UnixDgramSocket.h"
+
+static volatile sig_atomic_t g_Stop = 0;
+
+static void OnSignal(int)
+{
+	g_Stop = 1;
+}
+
+static void Usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " [-n socket] [-b byte] [-a count]" << std::endl;
+	std::cerr << "  -n  the socket to listen on, the default is " << REF2TC << std::endl;
+	std::cerr << "  -b  what the transcoded codecs are filled with, the default is 0x55" << std::endl;
+	std::cerr << "  -a  stop answering after this many frames, the default is never" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the link
+
+static const struct { uint8_t bit; size_t size; } g_Codecs[] = {
+	{ TC_CODEC_DSTAR, 9 }, { TC_CODEC_DMR, 9 }, { TC_CODEC_M17, 16 }, { TC_CODEC_P25, 11 }, { TC_CODEC_USRP, 320 }
+};
+
+static void SetHeader(uint8_t *buf, ETCPacketType type, size_t length)
+{
+	buf[0] = TC_MAGIC >> 8;
+	buf[1] = TC_MAGIC & 0xffu;
+	buf[2] = TC_VERSION;
+	buf[3] = uint8_t(type);
+	buf[4] = length >> 8;
+	buf[5] = length & 0xffu;
+}
+
+// a version 1 packet goes back whole, with everything but the input codec filled in,
+// returns the length of the reply, or 0 if there is none
+static size_t AnswerV1(const uint8_t *in, uint8_t *out, uint8_t fill, char &module)
+{
+	memcpy(out, in, sizeof(STCPacket));
+	module = char(in[offsetof(STCPacket, module)]);
+	const auto codec_in = ECodecType(in[offsetof(STCPacket, codec_in)]);
+	if (ECodecType::dstar != codec_in)
+		memset(out + offsetof(STCPacket, dstar), fill, 9);
+	if (ECodecType::dmr != codec_in)
+		memset(out + offsetof(STCPacket, dmr), fill, 9);
+	if (ECodecType::c2_1600 != codec_in && ECodecType::c2_3200 != codec_in)
+		memset(out + offsetof(STCPacket, m17), fill, 16);
+	if (ECodecType::p25 != codec_in)
+		memset(out + offsetof(STCPacket, p25), fill, 11);
+	if (ECodecType::usrp != codec_in)
+		memset(out + offsetof(STCPacket, usrp), fill, 320);
+	return sizeof(STCPacket);
+}
+
+// a hello gets its acknowledgement, and a frame the codecs it wants,
+// returns the length of the reply, or 0 if there is none
+static size_t AnswerV2(const uint8_t *in, size_t len, uint8_t *out, uint8_t fill, char &module)
+{
+	if (len < TC_HEADER_SIZE + 1 || TC_MAGIC != (in[0] << 8 | in[1]) || TC_VERSION != in[2] || len != size_t(in[4] << 8 | in[5]))
+		return 0;
+
+	switch (ETCPacketType(in[3]))
+	{
+	case ETCPacketType::hello:
+		module = char(in[TC_HEADER_SIZE]);
+		SetHeader(out, ETCPacketType::hello_ack, TC_HEADER_SIZE + 1);
+		out[TC_HEADER_SIZE] = in[TC_HEADER_SIZE];
+		return TC_HEADER_SIZE + 1;
+	case ETCPacketType::frame:
+		break;
+	default:
+		return 0;
+	}
+	if (len < TC_FRAME_SIZE)
+		return 0;
+
+	// sequence, stream id, module, flags and the input codec go back as they came
+	memcpy(out + TC_HEADER_SIZE, in + TC_HEADER_SIZE, 9);
+	module = char(in[TC_HEADER_SIZE + 6]);
+	const uint8_t codec = in[TC_HEADER_SIZE + 9];
+	const uint8_t wanted = in[TC_HEADER_SIZE + 10];
+	const uint8_t codecs = wanted | codec;
+	out[TC_HEADER_SIZE + 9] = codecs;
+	out[TC_HEADER_SIZE + 10] = wanted;
+
+	size_t off = TC_FRAME_SIZE;
+	for (const auto &c : g_Codecs)
+	{
+		if (0 == (codecs & c.bit))
+			continue;
+		if (c.bit == codec)
+		{
+			if (len < TC_FRAME_SIZE + c.size)
+				return 0;
+			memcpy(out + off, in + TC_FRAME_SIZE, c.size);
+		}
+		else
+			memset(out + off, fill, c.size);
+		off += c.size;
+	}
+	SetHeader(out, ETCPacketType::frame, off);
+	return off;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// main
+
+int main(int argc, char *argv[])
+{
+	std::string name(REF2TC);
+	uint8_t fill = 0x55u;
+	long answers = -1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:b:a:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			name.assign(optarg);
+			break;
+		case 'b':
+			fill = uint8_t(strtoul(optarg, nullptr, 0));
+			break;
+		case 'a':
+			answers = strtol(optarg, nullptr, 0);
+			break;
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	CUnixDgramReader reader;
+	if (reader.Open(name.c_str()))
+		return 1;
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	// the replies go to each module's own socket
+	std::unique_ptr<CUnixDgramWriter> writers[26];
+
+	unsigned long answered = 0, ignored = 0;
+	uint8_t in[TC_MAX_PACKET], out[TC_MAX_PACKET];
+	static_assert(sizeof(STCPacket) <= TC_MAX_PACKET, "a version 1 packet has to fit");
+	while (! g_Stop)
+	{
+		struct pollfd pfd = { reader.GetFD(), POLLIN, 0 };
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		const auto len = reader.Read(in, sizeof(in));
+		if (len <= 0)
+			continue;
+
+		char module = 0;
+		const bool is_frame = (len == sizeof(STCPacket) || (len >= ssize_t(TC_FRAME_SIZE) && ETCPacketType::frame == ETCPacketType(in[3])));
+		const size_t size = (len == sizeof(STCPacket)) ? AnswerV1(in, out, fill, module) : AnswerV2(in, len, out, fill, module);
+		if (0 == size || module < 'A' || module > 'Z')
+		{
+			std::cerr << "faketcd " << name << " can't answer a " << len << " byte packet" << std::endl;
+			continue;
+		}
+		if (is_frame && answers >= 0 && answered >= (unsigned long)answers)
+		{
+			ignored++;
+			continue;
+		}
+
+		auto &writer = writers[module - 'A'];
+		if (! writer)
+		{
+			std::string tc2ref(TC2REF);
+			tc2ref.append(1, module);
+			writer.reset(new CUnixDgramWriter);
+			writer->SetUp(tc2ref.c_str());
+		}
+		if (! writer->Send(out, size) && is_frame)
+			answered++;
+	}
+
+	std::cout << "faketcd " << name << " answered " << answered << " frames and ignored " << ignored << std::endl;
+	return 0;
+}
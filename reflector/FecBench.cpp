@@ -0,0 +1,733 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// urffec -- micro-benchmarks for the FEC and CRC kernels.
+//
+// Every kernel is run over a set of frames made from a seeded random number
+// generator, so the same seed always gives the same input. The decoders get
+// their codewords with as many bit errors as the code is sure to correct, and
+// each result is checked against the data that went in. The outputs of every
+// kernel are hashed, so the json results of one build can be given to the next
+// with -c, to show that an optimized kernel still gives the same bits, and how
+// much faster it is.
+
+#include <string.h>
+#include <getopt.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "Golay24128.h"
+#include "Golay2087.h"
+#include "BPTC19696.h"
+#include "Hamming.h"
+#include "QR1676.h"
+#include "RS129.h"
+#include "YSFConvolution.h"
+#include "CRC.h"
+#include "M17CRC.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define FEC_FRAMES          65536       // frames in each input set
+#define FEC_SEED            20230101ull
+#define FEC_MIN_MS          200         // each kernel is timed for at least this long
+#define FEC_MIN_PASSES      3           // and this many times over its input
+#define FEC_M17_FRAME       52          // sizeof(SM17Frame), less its crc
+
+static const unsigned char BIT_MASK_TABLE[] = { 0x80U, 0x40U, 0x20U, 0x10U, 0x08U, 0x04U, 0x02U, 0x01U };
+
+#define WRITE_BIT1(p,i,b) p[(i)>>3] = (b) ? (p[(i)>>3] | BIT_MASK_TABLE[(i)&7]) : (p[(i)>>3] & ~BIT_MASK_TABLE[(i)&7])
+#define READ_BIT1(p,i)    (p[(i)>>3] & BIT_MASK_TABLE[(i)&7])
+
+////////////////////////////////////////////////////////////////////////////////////////
+// random input
+
+// xorshift64*, it's the same sequence on every machine and compiler
+class CRandom
+{
+public:
+	CRandom(uint64_t seed) : m_State(seed ? seed : FEC_SEED) {}
+
+	uint64_t Next(void)
+	{
+		m_State ^= m_State >> 12;
+		m_State ^= m_State << 25;
+		m_State ^= m_State >> 27;
+		return m_State * 0x2545F4914F6CDD1Dull;
+	}
+	unsigned Below(unsigned n) { return unsigned((Next() >> 32) % n); }
+	void Fill(uint8_t *p, size_t n)
+	{
+		for (size_t i=0; i<n; i++)
+			p[i] = uint8_t(Next() >> 56);
+	}
+
+	// between 0 and max errors, in different places
+	unsigned Errors(unsigned max, unsigned nbits, unsigned *where)
+	{
+		const unsigned n = Below(max + 1);
+		for (unsigned i=0; i<n; i++)
+		{
+			bool again;
+			do
+			{
+				where[i] = Below(nbits);
+				again = false;
+				for (unsigned j=0; j<i; j++)
+					again = again || where[j] == where[i];
+			} while (again);
+		}
+		return n;
+	}
+
+private:
+	uint64_t m_State;
+};
+
+// flip some bits of a word, the first bit is the most significant of nbits
+static uint32_t FlipWord(CRandom &rnd, uint32_t word, unsigned nbits, unsigned max, unsigned &errors)
+{
+	unsigned where[8];
+	const auto n = rnd.Errors(max, nbits, where);
+	for (unsigned i=0; i<n; i++)
+		word ^= 1u << (nbits - 1 - where[i]);
+	errors += n;
+	return word;
+}
+
+// and of a bit string, the bits are numbered from the front
+static void FlipBits(CRandom &rnd, uint8_t *p, unsigned nbits, unsigned max, unsigned &errors)
+{
+	unsigned where[8];
+	const auto n = rnd.Errors(max, nbits, where);
+	for (unsigned i=0; i<n; i++)
+		p[where[i] >> 3] ^= BIT_MASK_TABLE[where[i] & 7];
+	errors += n;
+}
+
+static void FlipBools(CRandom &rnd, bool *p, unsigned nbits, unsigned max, unsigned &errors)
+{
+	unsigned where[8];
+	const auto n = rnd.Errors(max, nbits, where);
+	for (unsigned i=0; i<n; i++)
+		p[where[i]] = ! p[where[i]];
+	errors += n;
+}
+
+// one bit of a bit string, for what's only meant to see the error
+static void FlipOne(CRandom &rnd, uint8_t *p, unsigned nbits, unsigned &errors)
+{
+	const auto where = rnd.Below(nbits);
+	p[where >> 3] ^= BIT_MASK_TABLE[where & 7];
+	errors++;
+}
+
+static void Put32(uint8_t *p, uint32_t v) { memcpy(p, &v, 4); }
+static uint32_t Get32(const uint8_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+////////////////////////////////////////////////////////////////////////////////////////
+// kernels
+
+// A kernel makes its own input frames and then runs over them. Make writes one
+// frame and, if the right answer is known, what the kernel should output for it,
+// returning false when there's nothing to check. Run is what's timed, one call is
+// one frame.
+struct SKernel
+{
+	const char *name;
+	const char *frame;          // what one frame is
+	size_t insize, outsize;
+	bool (*make)(CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors);
+	void (*run)(const uint8_t *in, uint8_t *out);
+};
+
+// the hamming codes all look the same from here
+template <unsigned N, unsigned K>
+static bool MakeHammingData(CRandom &rnd, uint8_t *in, uint8_t *, unsigned &)
+{
+	bool *d = (bool *)in;
+	for (unsigned i=0; i<N; i++)
+		d[i] = (i < K) ? (rnd.Next() >> 63) : false;
+	return false;
+}
+
+template <void (*ENCODE)(bool *), unsigned N, unsigned K>
+static bool MakeHammingCode(CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+{
+	MakeHammingData<N, K>(rnd, expect, nullptr, errors);
+	ENCODE((bool *)expect);
+	memcpy(in, expect, N);
+	FlipBools(rnd, (bool *)in, N, 1, errors);
+	return true;
+}
+
+template <void (*ENCODE)(bool *), unsigned N>
+static void RunHammingEncode(const uint8_t *in, uint8_t *out)
+{
+	memcpy(out, in, N);
+	ENCODE((bool *)out);
+}
+
+template <bool (*DECODE)(bool *), unsigned N>
+static void RunHammingDecode(const uint8_t *in, uint8_t *out)
+{
+	memcpy(out, in, N);
+	DECODE((bool *)out);
+}
+
+// and packed, the data bits on top
+template <unsigned N, unsigned K>
+static bool MakeHammingWordData(CRandom &rnd, uint8_t *in, uint8_t *, unsigned &)
+{
+	Put32(in, rnd.Below(1u << K) << (N - K));
+	return false;
+}
+
+template <uint32_t (*ENCODE)(uint32_t), unsigned N, unsigned K>
+static bool MakeHammingWord(CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+{
+	const auto code = ENCODE(rnd.Below(1u << K) << (N - K));
+	Put32(expect, code);
+	Put32(in, FlipWord(rnd, code, N, 1, errors));
+	return true;
+}
+
+template <bool (*DECODE)(uint32_t &)>
+static void RunHammingWordDecode(const uint8_t *in, uint8_t *out)
+{
+	auto code = Get32(in);
+	DECODE(code);
+	Put32(out, code);
+}
+
+#define HAMMING(NAME, N, K) \
+	{ "hamming" #NAME ".encode", #N " bools", N, N, MakeHammingData<N, K>, RunHammingEncode<CHamming::encode##NAME, N> }, \
+	{ "hamming" #NAME ".decode", #N " bools, up to 1 error", N, N, MakeHammingCode<CHamming::encode##NAME, N, K>, RunHammingDecode<CHamming::decode##NAME, N> }, \
+	{ "hamming" #NAME ".encodeword", #K " bits", 4, 4, MakeHammingWordData<N, K>, [](const uint8_t *in, uint8_t *out) { Put32(out, CHamming::encodeWord##NAME(Get32(in))); } }, \
+	{ "hamming" #NAME ".decodeword", #N " bits, up to 1 error", 4, 4, MakeHammingWord<CHamming::encodeWord##NAME, N, K>, RunHammingWordDecode<CHamming::decodeWord##NAME> }
+
+static const SKernel g_Kernels[] =
+{
+	{
+		"golay24128.encode", "12 bits", 4, 4,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { Put32(in, rnd.Below(4096)); return false; },
+		[](const uint8_t *in, uint8_t *out) { Put32(out, CGolay24128::encode24128(Get32(in))); }
+	},
+	{
+		"golay24128.decode", "24 bits, up to 3 errors", 4, 4,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			const auto data = rnd.Below(4096);
+			Put32(expect, data);
+			Put32(in, FlipWord(rnd, CGolay24128::encode24128(data), 24, 3, errors));
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { Put32(out, CGolay24128::decode24128(Get32(in))); }
+	},
+	{
+		"golay24128.decodebytes", "3 bytes, up to 3 errors", 3, 4,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			const auto data = rnd.Below(4096);
+			Put32(expect, data);
+			const auto code = FlipWord(rnd, CGolay24128::encode24128(data), 24, 3, errors);
+			in[0] = code >> 16;
+			in[1] = code >> 8;
+			in[2] = code;
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out)
+		{
+			uint8_t bytes[3];
+			memcpy(bytes, in, 3);
+			Put32(out, CGolay24128::decode24128(bytes));
+		}
+	},
+	{
+		"golay23127.encode", "12 bits", 4, 4,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { Put32(in, rnd.Below(4096)); return false; },
+		[](const uint8_t *in, uint8_t *out) { Put32(out, CGolay24128::encode23127(Get32(in))); }
+	},
+	{
+		"golay23127.decode", "23 bits, up to 3 errors", 4, 4,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			const auto data = rnd.Below(4096);
+			Put32(expect, data);
+			// the encoder's codeword is shifted up by one, as in the 24 bit code
+			Put32(in, FlipWord(rnd, CGolay24128::encode23127(data) >> 1, 23, 3, errors));
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { Put32(out, CGolay24128::decode23127(Get32(in))); }
+	},
+	{
+		"golay2087.encode", "8 bits", 1, 3,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { in[0] = rnd.Below(256); return false; },
+		[](const uint8_t *in, uint8_t *out) { out[0] = in[0]; CGolay2087::encode(out); }
+	},
+	{
+		"golay2087.decode", "19 bits, up to 2 errors", 3, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			expect[0] = in[0] = rnd.Below(256);
+			CGolay2087::encode(in);
+			FlipBits(rnd, in, 19, 2, errors);
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { out[0] = CGolay2087::decode(in); }
+	},
+	{
+		"qr1676.encode", "7 bits", 1, 2,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { in[0] = rnd.Below(128) << 1; return false; },
+		[](const uint8_t *in, uint8_t *out) { out[0] = in[0]; CQR1676::encode(out); }
+	},
+	{
+		"qr1676.decode", "15 bits, up to 2 errors", 2, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			in[0] = rnd.Below(128) << 1;
+			CQR1676::encode(in);
+			// it gives back the first byte of the codeword
+			expect[0] = in[0];
+			FlipBits(rnd, in, 15, 2, errors);
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { out[0] = CQR1676::decode(in); }
+	},
+	{
+		"bptc19696.encode", "12 bytes", 12, 33,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 12); return false; },
+		[](const uint8_t *in, uint8_t *out) { CBPTC19696 bptc; bptc.encode(in, out); }
+	},
+	{
+		"bptc19696.decode", "196 bits, up to 1 error", 33, 12,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			rnd.Fill(expect, 12);
+			memset(in, 0, 33);
+			CBPTC19696 bptc;
+			bptc.encode(expect, in);
+			// the 196 coded bits are either side of the sync and the slot type
+			unsigned where[1];
+			const auto n = rnd.Errors(1, 196, where);
+			errors += n;
+			for (unsigned i=0; i<n; i++)
+			{
+				const unsigned bit = (where[0] < 98) ? where[0] : where[0] + 68;
+				in[bit >> 3] ^= BIT_MASK_TABLE[bit & 7];
+			}
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { CBPTC19696 bptc; bptc.decode(in, out); }
+	},
+	HAMMING(15113_1, 15, 11),
+	HAMMING(15113_2, 15, 11),
+	HAMMING(1393, 13, 9),
+	HAMMING(1063, 10, 6),
+	HAMMING(16114, 16, 11),
+	HAMMING(17123, 17, 12),
+	{
+		"rs129.encode", "9 bytes", 9, 4,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 9); return false; },
+		[](const uint8_t *in, uint8_t *out) { CRS129::encode(in, 9, out); }
+	},
+	{
+		"rs129.check", "12 bytes, half damaged", 12, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			rnd.Fill(in, 9);
+			uint8_t parity[4];
+			CRS129::encode(in, 9, parity);
+			in[9] = parity[2];
+			in[10] = parity[1];
+			in[11] = parity[0];
+			// a single byte error is always seen
+			expect[0] = 1;
+			if (rnd.Next() >> 63)
+			{
+				in[rnd.Below(12)] ^= 1 + rnd.Below(255);
+				expect[0] = 0;
+				errors++;
+			}
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { out[0] = CRS129::check(in) ? 1 : 0; }
+	},
+	{
+		// the YSF FICH, 96 bits and a 4 bit tail
+		"ysfconvolution.encode", "100 bits", 13, 25,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 12); in[12] = 0; return false; },
+		[](const uint8_t *in, uint8_t *out) { CYSFConvolution conv; conv.encode(in, out, 100); }
+	},
+	{
+		"ysfconvolution.decode", "200 bits, up to 1 error", 25, 12,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			uint8_t data[13];
+			rnd.Fill(data, 12);
+			data[12] = 0;
+			memcpy(expect, data, 12);
+			CYSFConvolution conv;
+			conv.encode(data, in, 100);
+			// more than that isn't always corrected this close to the end of the tail
+			FlipBits(rnd, in, 200, 1, errors);
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out)
+		{
+			CYSFConvolution conv;
+			conv.start();
+			for (unsigned i=0; i<200; i+=2)
+				conv.decode(READ_BIT1(in, i) ? 1 : 0, READ_BIT1(in, i + 1) ? 1 : 0);
+			uint8_t bits[13];
+			conv.chainback(bits, 96);
+			memcpy(out, bits, 12);
+		}
+	},
+	{
+		"crc.ccitt161.add", "12 bytes", 12, 12,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 12); return false; },
+		[](const uint8_t *in, uint8_t *out) { memcpy(out, in, 12); CCRC::addCCITT161(out, 12); }
+	},
+	{
+		"crc.ccitt161.check", "12 bytes, half damaged", 12, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			rnd.Fill(in, 12);
+			CCRC::addCCITT161(in, 12);
+			expect[0] = 1;
+			if (rnd.Next() >> 63)
+			{
+				FlipOne(rnd, in, 96, errors);
+				expect[0] = 0;
+			}
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { out[0] = CCRC::checkCCITT161(in, 12) ? 1 : 0; }
+	},
+	{
+		// the YSF payload
+		"crc.ccitt162.add", "22 bytes", 22, 22,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 22); return false; },
+		[](const uint8_t *in, uint8_t *out) { memcpy(out, in, 22); CCRC::addCCITT162(out, 22); }
+	},
+	{
+		"crc.ccitt162.check", "22 bytes, half damaged", 22, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			rnd.Fill(in, 22);
+			CCRC::addCCITT162(in, 22);
+			expect[0] = 1;
+			if (rnd.Next() >> 63)
+			{
+				FlipOne(rnd, in, 176, errors);
+				expect[0] = 0;
+			}
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out) { out[0] = CCRC::checkCCITT162(in, 22) ? 1 : 0; }
+	},
+	{
+		"crc.crc8", "12 bytes", 12, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 12); return false; },
+		[](const uint8_t *in, uint8_t *out) { out[0] = CCRC::crc8(in, 12); }
+	},
+	{
+		// the Wires-X replies
+		"crc.addcrc", "128 bytes", 128, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, 128); return false; },
+		[](const uint8_t *in, uint8_t *out) { out[0] = CCRC::addCRC(in, 128); }
+	},
+	{
+		"crc.fivebit.encode", "72 bools", 72, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &)
+		{
+			for (unsigned i=0; i<72; i++)
+				in[i] = rnd.Next() >> 63;
+			return false;
+		},
+		[](const uint8_t *in, uint8_t *out) { unsigned crc; CCRC::encodeFiveBit((const bool *)in, crc); out[0] = crc; }
+	},
+	{
+		"crc.fivebit.check", "72 bools, half damaged", 73, 1,
+		[](CRandom &rnd, uint8_t *in, uint8_t *expect, unsigned &errors)
+		{
+			for (unsigned i=0; i<72; i++)
+				in[i] = rnd.Next() >> 63;
+			unsigned crc;
+			CCRC::encodeFiveBit((const bool *)in, crc);
+			in[72] = crc;
+			expect[0] = 1;
+			if (rnd.Next() >> 63)
+			{
+				const auto where = rnd.Below(72);
+				in[where] = ! in[where];
+				errors++;
+				expect[0] = 0;
+			}
+			return true;
+		},
+		[](const uint8_t *in, uint8_t *out)
+		{
+			bool bits[72];
+			memcpy(bits, in, 72);
+			out[0] = CCRC::checkFiveBit(bits, in[72]) ? 1 : 0;
+		}
+	},
+	{
+		"m17crc", "52 bytes", FEC_M17_FRAME, 2,
+		[](CRandom &rnd, uint8_t *in, uint8_t *, unsigned &) { rnd.Fill(in, FEC_M17_FRAME); return false; },
+		[](const uint8_t *in, uint8_t *out)
+		{
+			static const CM17CRC crc;
+			const auto v = crc.CalcCRC(in, FEC_M17_FRAME);
+			memcpy(out, &v, 2);
+		}
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// benchmark
+
+struct SFecOptions
+{
+	SFecOptions() : frames(FEC_FRAMES), seed(FEC_SEED), ms(FEC_MIN_MS) {}
+
+	unsigned frames;
+	uint64_t seed;
+	unsigned ms;
+	std::vector<std::string> only;
+	std::string reference, outfile;
+};
+
+// FNV-1a
+static uint64_t Hash(const uint8_t *p, size_t n, uint64_t h = 0xCBF29CE484222325ull)
+{
+	for (size_t i=0; i<n; i++)
+		h = (h ^ p[i]) * 0x100000001B3ull;
+	return h;
+}
+
+static std::string Hex(uint64_t v)
+{
+	std::ostringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << v;
+	return ss.str();
+}
+
+static uint64_t Now(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// true if a frame didn't come out as it should have
+static bool Bench(const SKernel &kernel, const SFecOptions &opt, nlohmann::json &result)
+{
+	const size_t n = opt.frames;
+	std::vector<uint8_t> in(kernel.insize * n), expect(kernel.outsize * n), out(kernel.outsize * n);
+	std::vector<bool> known(n);
+
+	// each kernel has its own sequence, so running only some of them gives the same inputs
+	CRandom rnd(opt.seed ^ Hash((const uint8_t *)kernel.name, strlen(kernel.name)));
+	unsigned errors = 0;
+	for (size_t i=0; i<n; i++)
+		known[i] = kernel.make(rnd, in.data() + i * kernel.insize, expect.data() + i * kernel.outsize, errors);
+
+	// the best pass is the one that's least disturbed by everything else on the machine
+	uint64_t best = UINT64_MAX, total = 0;
+	unsigned passes = 0;
+	do
+	{
+		const auto start = Now();
+		for (size_t i=0; i<n; i++)
+			kernel.run(in.data() + i * kernel.insize, out.data() + i * kernel.outsize);
+		const auto ns = Now() - start;
+		best = std::min(best, ns);
+		total += ns;
+		passes++;
+	} while (passes < FEC_MIN_PASSES || total < uint64_t(opt.ms) * 1000000ull);
+
+	unsigned checked = 0, failed = 0;
+	for (size_t i=0; i<n; i++)
+	{
+		if (! known[i])
+			continue;
+		checked++;
+		if (memcmp(out.data() + i * kernel.outsize, expect.data() + i * kernel.outsize, kernel.outsize))
+			failed++;
+	}
+
+	const double ns = double(best) / n;
+	result["Frame"] = kernel.frame;
+	result["Passes"] = passes;
+	result["NsPerFrame"] = ns;
+	result["FramesPerSecond"] = (best > 0) ? 1.0e9 / ns : 0.0;
+	result["InjectedErrors"] = errors;
+	result["Checked"] = checked;
+	result["Failed"] = failed;
+	result["Digest"] = Hex(Hash(out.data(), out.size()));
+
+	std::cerr << std::left << std::setw(26) << kernel.name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << ns << " ns/frame " << std::setw(14) << std::setprecision(0) << 1.0e9 / ns << " frames/s";
+	if (checked)
+		std::cerr << std::setw(10) << checked - failed << '/' << checked << " right";
+	std::cerr << std::endl;
+	if (failed)
+		std::cerr << "ERROR: " << kernel.name << " got " << failed << " of " << checked << " frames wrong" << std::endl;
+	return 0 != failed;
+}
+
+static bool Selected(const SKernel &kernel, const SFecOptions &opt)
+{
+	if (opt.only.empty())
+		return true;
+	for (const auto &name : opt.only)
+	{
+		if (0 == strncmp(kernel.name, name.c_str(), name.size()))
+			return true;
+	}
+	return false;
+}
+
+// the outputs have to be the same bits as the reference build's, true if not
+static bool Compare(const nlohmann::json &reference, nlohmann::json &results)
+{
+	bool bad = false;
+	for (auto &item : results["Kernels"].items())
+	{
+		auto &result = item.value();
+		if (! reference["Kernels"].contains(item.key()))
+			continue;
+		const auto &ref = reference["Kernels"][item.key()];
+		const bool match = (ref["Digest"] == result["Digest"]);
+		result["Match"] = match;
+		result["ReferenceNsPerFrame"] = ref["NsPerFrame"];
+		result["Speedup"] = ref["NsPerFrame"].get<double>() / result["NsPerFrame"].get<double>();
+		if (! match)
+		{
+			std::cerr << "ERROR: " << item.key() << " doesn't give the same output as the reference" << std::endl;
+			bad = true;
+		}
+	}
+	return bad;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// main
+
+static void usage(std::ostream &os, const char *name)
+{
+	os << "\nUsage: " << name << " [options]\n"
+		"Time the FEC and CRC kernels and check what they put out.\n"
+		"Options\n"
+		"    -n FRAMES  : frames in each kernel's input, default " << FEC_FRAMES << "\n"
+		"    -s SEED    : for the random input, default " << FEC_SEED << "\n"
+		"    -t MS      : time each kernel for at least this long, default " << FEC_MIN_MS << ",\n"
+		"                 and at least " << FEC_MIN_PASSES << " passes, the best pass is reported\n"
+		"    -k NAMES   : only the kernels starting with one of these comma separated names\n"
+		"    -c FILE    : the json results of another build, the outputs must be the same\n"
+		"                 and the speedup is reported, the seed and frames are taken from it\n"
+		"    -o FILE    : write the json results to FILE instead of stdout\n"
+		"    -l         : list the kernels\n"
+		"The decoders get as many bit errors as their code always corrects, and every frame\n"
+		"with a known answer is checked. The exit status is a failure if a frame is wrong or\n"
+		"an output doesn't match the reference.\n\n";
+}
+
+int main(int argc, char *argv[])
+{
+	SFecOptions opt;
+	int c;
+	while (-1 != (c = getopt(argc, argv, "n:s:t:k:c:o:lh")))
+	{
+		switch (c)
+		{
+		case 'n': opt.frames = std::max(1ul, std::stoul(optarg)); break;
+		case 's': opt.seed = std::stoull(optarg);        break;
+		case 't': opt.ms = std::stoul(optarg);           break;
+		case 'c': opt.reference.assign(optarg);          break;
+		case 'o': opt.outfile.assign(optarg);            break;
+		case 'k':
+		{
+			std::istringstream ss(optarg);
+			std::string name;
+			while (std::getline(ss, name, ','))
+				opt.only.push_back(name);
+			break;
+		}
+		case 'l':
+			for (const auto &kernel : g_Kernels)
+				std::cout << std::left << std::setw(26) << kernel.name << kernel.frame << std::endl;
+			return EXIT_SUCCESS;
+		default:
+			usage(std::cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc)
+	{
+		usage(std::cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// the same input as the reference
+	nlohmann::json reference;
+	if (! opt.reference.empty())
+	{
+		std::ifstream f(opt.reference);
+		try
+		{
+			reference = nlohmann::json::parse(f);
+			opt.seed = reference["Seed"].get<uint64_t>();
+			opt.frames = reference["Frames"].get<unsigned>();
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << "ERROR: " << opt.reference << " is not the json results of " << argv[0] << ": " << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	nlohmann::json results;
+	results["Seed"] = opt.seed;
+	results["Frames"] = opt.frames;
+	results["Kernels"] = nlohmann::json::object();
+	bool bad = false;
+	for (const auto &kernel : g_Kernels)
+	{
+		if (Selected(kernel, opt))
+			bad = Bench(kernel, opt, results["Kernels"][kernel.name]) || bad;
+	}
+	if (! opt.reference.empty())
+	{
+		results["Reference"] = opt.reference;
+		bad = Compare(reference, results) || bad;
+	}
+
+	if (opt.outfile.empty())
+		std::cout << results.dump(4) << std::endl;
+	else
+	{
+		std::ofstream f(opt.outfile, std::ios::out | std::ios::trunc);
+		f << results.dump(4) << std::endl;
+	}
+	return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -32,6 +32,8 @@
 bool CG3Protocol::Initialize(const char */*type*/, const EProtocol /*type*/, const uint16_t /*port*/, const bool /*has_ipv4*/, const bool /*has_ipv6*/)
 // everything is hard coded until ICOM gets their act together and start supporting IPv6
 {
+	m_Protocol = EProtocol::g3;
+
 	//config data
 	m_TerminalPath.assign(g_Configure.GetString(g_Keys.files.terminal));
 	const std::string ipv4address(g_Configure.GetString(g_Keys.ip.ipv4bind));
@@ -47,12 +49,18 @@ bool CG3Protocol::Initialize(const char */*type*/, const EProtocol /*type*/, con
 	// update the reflector callsign
 	//m_ReflectorCallsign.PatchCallsign(0, "XLX", 3);
 
+	// create our readiness set
+	if (! m_Reactor.Open())
+		return false;
+
 	// create our sockets
 	CIp ip(AF_INET, G3_DV_PORT, ipv4address.c_str());
 	if ( ip.IsSet() )
 	{
 		if (! m_Socket4.Open(ip))
 			return false;
+		if (g_Configure.GetBoolean(g_Keys.ip.kerneltimestamps))
+			m_Socket4.EnableKernelTimestamps();
 	}
 	else
 		return false;
@@ -80,65 +88,20 @@ bool CG3Protocol::Initialize(const char */*type*/, const EProtocol /*type*/, con
 		return false;
 	}
 
-	// start helper threads
-	m_Future         = std::async(std::launch::async, &CG3Protocol::Thread, this);
-	m_PresenceFuture = std::async(std::launch::async, &CG3Protocol::PresenceThread, this);
-	m_ConfigFuture   = std::async(std::launch::async, &CG3Protocol::ConfigThread, this);
-	m_IcmpFuture     = std::async(std::launch::async, &CG3Protocol::IcmpThread, this);
+	// all four sockets are serviced by the one protocol thread
+	if (! (m_Reactor.Add(m_Socket4.GetSocket()) && m_Reactor.Add(m_PresenceSocket.GetSocket()) && m_Reactor.Add(m_ConfigSocket.GetSocket()) && m_Reactor.Add(m_IcmpRawSocket.GetSocket())))
+		return false;
+
+	// start the thread
+	m_Future = std::async(std::launch::async, &CG3Protocol::Thread, this);
 
 	// update time
 	m_LastKeepaliveTime.start();
 
-	std::cout << "Initialized G3 Protocol, all threads started" << std::endl;
+	std::cout << "Initialized G3 Protocol, thread started" << std::endl;
 	return true;
 }
 
-void CG3Protocol::Close(void)
-{
-	if (m_PresenceFuture.valid())
-	{
-		m_PresenceFuture.get();
-	}
-
-	if (m_ConfigFuture.valid())
-	{
-		m_ConfigFuture.get();
-	}
-
-	if (m_IcmpFuture.valid())
-	{
-		m_IcmpFuture.get();
-	}
-}
-
-
-////////////////////////////////////////////////////////////////////////////////////////
-// private threads
-
-void CG3Protocol::PresenceThread()
-{
-	while (keep_running)
-	{
-		PresenceTask();
-	}
-}
-
-void CG3Protocol::ConfigThread()
-{
-	while (keep_running)
-	{
-		ConfigTask();
-	}
-}
-
-void CG3Protocol::IcmpThread()
-{
-	while (keep_running)
-	{
-		IcmpTask();
-	}
-}
-
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // presence task
@@ -152,7 +115,7 @@ void CG3Protocol::PresenceTask(void)
 	CCallsign           Terminal;
 
 
-	if ( m_PresenceSocket.Receive(Buffer, ReqIp, 20) )
+	if ( m_PresenceSocket.ReceiveFrom(Buffer, ReqIp) )
 	{
 
 		CIp Ip(ReqIp);
@@ -239,7 +202,7 @@ void CG3Protocol::ConfigTask(void)
 	CCallsign           Call;
 	bool                isRepeaterCall;
 
-	if ( m_ConfigSocket.Receive(&Buffer, &Ip, 20) != -1 )
+	if ( m_ConfigSocket.Receive(&Buffer, &Ip, 0) != -1 )
 	{
 		if (Buffer.size() == 16)
 		{
@@ -341,7 +304,7 @@ void CG3Protocol::IcmpTask(void)
 	CIp Ip;
 	int iIcmpType;
 
-	if ((iIcmpType = m_IcmpRawSocket.IcmpReceive(Buffer, &Ip, 20)) != -1)
+	if ((iIcmpType = m_IcmpRawSocket.IcmpReceive(Buffer, &Ip, 0)) != -1)
 	{
 		if (iIcmpType == ICMP_DEST_UNREACH)
 		{
@@ -375,8 +338,18 @@ void CG3Protocol::Task(void)
 	std::unique_ptr<CDvHeaderPacket>    Header;
 	std::unique_ptr<CDvFramePacket>     Frame;
 
+	// a pending batch on the DV socket is served first, the reactor can't see it
+	// and a replayed one before that
+	const bool injected = ReceiveInjected(Buffer, Ip);
+	const auto fd = (injected || m_Socket4.HasBatched()) ? m_Socket4.GetSocket() : m_Reactor.Wait(GetWaitTime(20));
+	if ( fd == m_PresenceSocket.GetSocket() )
+		PresenceTask();
+	else if ( fd == m_ConfigSocket.GetSocket() )
+		ConfigTask();
+	else if ( fd == m_IcmpRawSocket.GetSocket() )
+		IcmpTask();
 	// any incoming packet ?
-	if ( m_Socket4.Receive(Buffer, Ip, 20) )
+	else if ( fd == m_Socket4.GetSocket() && (injected || ReceiveBatch(m_Socket4, Buffer, Ip)) )
 	{
 		CIp ClIp;
 		CIp *BaseIp = nullptr;
@@ -417,9 +390,6 @@ void CG3Protocol::Task(void)
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
 
@@ -442,36 +412,36 @@ void CG3Protocol::Task(void)
 
 void CG3Protocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
 		// suppress host checks
 		m_LastKeepaliveTime.start();
 
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// encode it
 		CBuffer buffer;
 		if ( EncodeDvPacket(*packet, buffer) )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::g3, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::g3, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// not busy, send the packet
-					int n = packet->IsDvHeader() ? 5 : 1;
-					for ( int i = 0; i < n; i++ )
-					{
-						Send(buffer, client->GetIp());
-					}
+					// not busy, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+
+			// headers are sent several times
+			int n = packet->IsDvHeader() ? 5 : 1;
+			for ( int i = 0; i < n; i++ )
+			{
+				Send(buffer, ips);
+			}
+			TraceSent(*packet);
 		}
 	}
 }
@@ -566,7 +536,7 @@ void CG3Protocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header, c
 				if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 				{
 					// keep the handle
-					m_Streams[stream->GetStreamId()] = stream;
+					AddStream(stream);
 				}
 
 				// update last heard
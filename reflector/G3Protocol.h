@@ -63,18 +63,10 @@ public:
 	// initialization
 	bool Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6);
 
-	// close
-	void Close(void);
-
 	// task
 	void Task(void);
 
 protected:
-	// threads
-	void PresenceThread(void);
-	void ConfigThread(void);
-	void IcmpThread(void);
-
 	// helper tasks
 	void PresenceTask(void);
 	void ConfigTask(void);
@@ -105,8 +97,6 @@ protected:
 	bool EncodeDvFramePacket(const CDvFramePacket &, CBuffer &) const;
 
 protected:
-	std::future<void> m_PresenceFuture, m_ConfigFuture, m_IcmpFuture;
-
 	// time
 	CTimer              m_LastKeepaliveTime;
 
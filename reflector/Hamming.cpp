@@ -17,9 +17,11 @@
  */
 
 #include "Hamming.h"
+#include "Utils.h"
 
 #include <cstdio>
 #include <cassert>
+#include <initializer_list>
 
 // Hamming (15,11,3) check a boolean data array
 bool CHamming::decode15113_1(bool* d)
@@ -532,3 +534,183 @@ void CHamming::encode17123(bool* d)
 	d[15] = d[0] ^ d[1] ^ d[4] ^ d[5] ^ d[7] ^ d[10];
 	d[16] = d[0] ^ d[1] ^ d[2] ^ d[5] ^ d[6] ^ d[8] ^ d[11];
 }
+
+////////////////////////////////////////////////////////////////////////////////////////
+// packed
+
+namespace
+{
+
+// A code is its parity checks, each over some of the data bits and its own parity bit.
+// The syndrome has the result of check j where the word has parity bit j, so the
+// syndrome of the data bits alone is the parity bits. It's linear, the xor of the
+// syndromes of the bits that are set, so it's looked up a byte at a time. A single bit
+// error's syndrome is the checks that bit is in, which is different for every bit, so
+// fix[] can map it back to the bit.
+struct SHammingCode
+{
+	unsigned n, k;
+	uint32_t check[5U];         // packed, with the parity bit
+	uint8_t  lo[256U];          // the syndrome of bits 0 to 7
+	uint8_t  hi[512U];          // and of bits 8 to 16
+	uint32_t fix[32U];          // by syndrome, the bit to flip, 0 if it's not a single bit error
+};
+
+constexpr uint32_t Bit(unsigned n, unsigned i)
+{
+	return 1U << (n - 1U - i);
+}
+
+// the checks are the d[] indexes of the data bits, as in the bool versions
+constexpr SHammingCode MakeCode(unsigned n, unsigned k, std::initializer_list<std::initializer_list<unsigned>> checks)
+{
+	SHammingCode code { n, k, {}, {}, {}, {} };
+	unsigned j = 0U;
+	for (const auto& c : checks)
+	{
+		code.check[j] = Bit(n, k + j);
+		for (auto i : c)
+			code.check[j] |= Bit(n, i);
+		j++;
+	}
+
+	// the syndrome of each bit of the word
+	uint8_t syndrome[17U] {};
+	for (unsigned b = 0U; b < n; b++)
+	{
+		for (j = 0U; j < n - k; j++)
+			syndrome[b] |= (code.check[j] & (1U << b)) ? Bit(n, k + j) : 0U;
+		code.fix[syndrome[b]] = 1U << b;
+	}
+
+	for (unsigned v = 0U; v < 512U; v++)
+	{
+		for (unsigned b = 0U; b < 9U; b++)
+		{
+			if ((v & (1U << b)) && v < 256U)
+				code.lo[v] ^= syndrome[b];
+			if ((v & (1U << b)) && b + 8U < n)
+				code.hi[v] ^= syndrome[b + 8U];
+		}
+	}
+	return code;
+}
+
+constexpr SHammingCode HAMMING15113_1 = MakeCode(15U, 11U, { {0,1,2,3,4,5,6}, {0,1,2,3,7,8,9}, {0,1,4,5,7,8,10}, {0,2,4,6,7,9,10} });
+constexpr SHammingCode HAMMING15113_2 = MakeCode(15U, 11U, { {0,1,2,3,5,7,8}, {1,2,3,4,6,8,9}, {2,3,4,5,7,9,10}, {0,1,2,4,6,7,10} });
+constexpr SHammingCode HAMMING1393    = MakeCode(13U,  9U, { {0,1,3,5,6}, {0,1,2,4,6,7}, {0,1,2,3,5,7,8}, {0,2,4,5,8} });
+constexpr SHammingCode HAMMING1063    = MakeCode(10U,  6U, { {0,1,2,5}, {0,1,3,5}, {0,2,3,4}, {1,2,3,4} });
+constexpr SHammingCode HAMMING16114   = MakeCode(16U, 11U, { {0,1,2,3,5,7,8}, {1,2,3,4,6,8,9}, {2,3,4,5,7,9,10}, {0,1,2,4,6,7,10}, {0,2,5,6,8,9,10} });
+constexpr SHammingCode HAMMING17123   = MakeCode(17U, 12U, { {0,1,2,3,6,7,9}, {0,1,2,3,4,7,8,10}, {1,2,3,4,5,8,9,11}, {0,1,4,5,7,10}, {0,1,2,5,6,8,11} });
+
+inline unsigned Syndrome(const SHammingCode& code, uint32_t d)
+{
+	return code.lo[d & 0xFFU] ^ code.hi[(d >> 8) & 0x1FFU];
+}
+
+inline uint32_t Encode(const SHammingCode& code, uint32_t d)
+{
+	// the parity bits are the low ones
+	d &= ~((1U << (code.n - code.k)) - 1U);
+	return d | Syndrome(code, d);
+}
+
+// true if it fixed a bit
+inline bool Correct(const SHammingCode& code, uint32_t& d)
+{
+	const uint32_t fix = code.fix[Syndrome(code, d)];
+	d ^= fix;
+	return fix != 0U;
+}
+
+// true if there was no error or it fixed one
+inline bool Check(const SHammingCode& code, uint32_t& d)
+{
+	const unsigned s = Syndrome(code, d);
+	d ^= code.fix[s];
+	return (s == 0U) || (code.fix[s] != 0U);
+}
+
+// each word is a bit of every codeword, so a check is an xor of words
+void EncodeSliced(const SHammingCode& code, uint32_t* d)
+{
+	for (unsigned j = 0U; j < code.n - code.k; j++)
+	{
+		uint32_t p = 0U;
+		for (unsigned i = 0U; i < code.k; i++)
+			p ^= (code.check[j] & Bit(code.n, i)) ? d[i] : 0U;
+		d[code.k + j] = p;
+	}
+}
+
+// the mask of the codewords it fixed a bit in
+uint32_t CorrectSliced(const SHammingCode& code, uint32_t* d)
+{
+	uint32_t s[5U];
+	uint32_t errors = 0U;
+	for (unsigned j = 0U; j < code.n - code.k; j++)
+	{
+		s[j] = 0U;
+		for (unsigned i = 0U; i < code.n; i++)
+			s[j] ^= (code.check[j] & Bit(code.n, i)) ? d[i] : 0U;
+		errors |= s[j];
+	}
+
+	// only the codewords with a syndrome, usually none
+	uint32_t fixed = 0U;
+	while (errors != 0U)
+	{
+		const unsigned c = CUtils::lowestBit(errors);
+		errors &= errors - 1U;
+
+		unsigned syndrome = 0U;
+		for (unsigned j = 0U; j < code.n - code.k; j++)
+			syndrome |= ((s[j] >> c) & 1U) ? Bit(code.n, code.k + j) : 0U;
+		const uint32_t fix = code.fix[syndrome];
+		if (fix != 0U)
+		{
+			d[code.n - 1U - CUtils::lowestBit(fix)] ^= 1U << c;
+			fixed |= 1U << c;
+		}
+	}
+	return fixed;
+}
+
+}
+
+uint32_t CHamming::encodeWord15113_1(uint32_t d) { return Encode(HAMMING15113_1, d); }
+bool CHamming::decodeWord15113_1(uint32_t& d)    { return Correct(HAMMING15113_1, d); }
+uint32_t CHamming::encodeWord15113_2(uint32_t d) { return Encode(HAMMING15113_2, d); }
+bool CHamming::decodeWord15113_2(uint32_t& d)    { return Correct(HAMMING15113_2, d); }
+uint32_t CHamming::encodeWord1393(uint32_t d)    { return Encode(HAMMING1393, d); }
+bool CHamming::decodeWord1393(uint32_t& d)       { return Correct(HAMMING1393, d); }
+uint32_t CHamming::encodeWord1063(uint32_t d)    { return Encode(HAMMING1063, d); }
+bool CHamming::decodeWord1063(uint32_t& d)       { return Correct(HAMMING1063, d); }
+uint32_t CHamming::encodeWord16114(uint32_t d)   { return Encode(HAMMING16114, d); }
+bool CHamming::decodeWord16114(uint32_t& d)      { return Check(HAMMING16114, d); }
+uint32_t CHamming::encodeWord17123(uint32_t d)   { return Encode(HAMMING17123, d); }
+bool CHamming::decodeWord17123(uint32_t& d)      { return Check(HAMMING17123, d); }
+
+void CHamming::encodeSliced15113_2(uint32_t* d)
+{
+	assert(d != nullptr);
+	EncodeSliced(HAMMING15113_2, d);
+}
+
+uint32_t CHamming::decodeSliced15113_2(uint32_t* d)
+{
+	assert(d != nullptr);
+	return CorrectSliced(HAMMING15113_2, d);
+}
+
+void CHamming::encodeSliced1393(uint32_t* d)
+{
+	assert(d != nullptr);
+	EncodeSliced(HAMMING1393, d);
+}
+
+uint32_t CHamming::decodeSliced1393(uint32_t* d)
+{
+	assert(d != nullptr);
+	return CorrectSliced(HAMMING1393, d);
+}
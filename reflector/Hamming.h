@@ -19,6 +19,14 @@
 #ifndef	Hamming_H
 #define	Hamming_H
 
+#include <cstdint>
+
+// The bool arrays hold a codeword a bit at a time, d[0] first. The word versions
+// take the same codeword packed, d[0] in the most significant bit, so the data bits
+// are on top of the parity bits, and the sliced versions do up to 32 codewords at
+// once, word i has bit d[i] of each of them. They return what the bool version
+// would, the sliced ones as a mask of the codewords it would be true for. The
+// encoders fill in the parity bits, whatever was in them.
 class CHamming
 {
 public:
@@ -39,6 +47,24 @@ public:
 
 	static void encode17123(bool* d);
 	static bool decode17123(bool* d);
+
+	static uint32_t encodeWord15113_1(uint32_t d);
+	static bool     decodeWord15113_1(uint32_t& d);
+	static uint32_t encodeWord15113_2(uint32_t d);
+	static bool     decodeWord15113_2(uint32_t& d);
+	static uint32_t encodeWord1393(uint32_t d);
+	static bool     decodeWord1393(uint32_t& d);
+	static uint32_t encodeWord1063(uint32_t d);
+	static bool     decodeWord1063(uint32_t& d);
+	static uint32_t encodeWord16114(uint32_t d);
+	static bool     decodeWord16114(uint32_t& d);
+	static uint32_t encodeWord17123(uint32_t d);
+	static bool     decodeWord17123(uint32_t& d);
+
+	static void     encodeSliced15113_2(uint32_t* d);
+	static uint32_t decodeSliced15113_2(uint32_t* d);
+	static void     encodeSliced1393(uint32_t* d);
+	static uint32_t decodeSliced1393(uint32_t* d);
 };
 
 #endif
@@ -16,6 +16,7 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <cstdint>
+#include <functional>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -134,6 +135,26 @@ bool CIp::operator==(const CIp &rhs) const	// compares ports, addresses and fami
 	return false;
 }
 
+size_t CIp::Hash() const	// hashes ports, addresses and families
+{
+	uint64_t h = addr.ss_family;
+	if (AF_INET == addr.ss_family)
+	{
+		auto a = (struct sockaddr_in *)&addr;
+		h = (h << 16) | a->sin_port;
+		h = (h << 32) | a->sin_addr.s_addr;
+	}
+	else if (AF_INET6 == addr.ss_family)
+	{
+		auto a = (struct sockaddr_in6 *)&addr;
+		const uint32_t *w = (const uint32_t *)&(a->sin6_addr);
+		h = (h << 16) | a->sin6_port;
+		for (int i=0; i<4; i++)
+			h = h * 0x100000001b3ull ^ w[i];
+	}
+	return std::hash<uint64_t>()(h);
+}
+
 bool CIp::operator!=(const CIp &rhs) const	// compares ports, addresses and families
 {
 	// if anything is not equal, then we are done
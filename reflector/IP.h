@@ -43,6 +43,7 @@ public:
 	// comparison operators
 	bool operator==(const CIp &rhs) const;
 	bool operator!=(const CIp &rhs) const;
+	size_t Hash() const;	// consistent with operator==
 
 	// state methods
 	bool IsSet() const { return is_set; }
@@ -72,3 +73,12 @@ private:
 };
 
 std::ostream &operator<<(std::ostream &stream, const CIp &Ip);
+
+// functions for unordered containers
+struct CIpHash
+{
+	std::size_t operator() (const CIp &ip) const
+	{
+		return ip.Hash();
+	}
+};
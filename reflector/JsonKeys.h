@@ -42,11 +42,11 @@ struct SJsonKeys {
 	struct NAMES { const std::string callsign, bootstrap, url, email, country, sponsor; }
 	names { "Callsign", "bootstrap", "DashboardUrl", "SysopEmail", "Country", "Sponsor" };
 
-	struct IP { const std::string ipv4bind, ipv4address, ipv6bind, ipv6address, transcoder; }
-	ip { "ipv4bind", "IPv4Address", "ipv6bind", "IPv6Address", "tcaddress" };
+	struct IP { const std::string ipv4bind, ipv4address, ipv6bind, ipv6address, transcoder, kerneltimestamps; }
+	ip { "ipv4bind", "IPv4Address", "ipv6bind", "IPv6Address", "tcaddress", "kernelTimestamps" };
 
-	struct MODULES { const std::string modules, tcmodules, descriptor[26]; }
-	modules { "Modules", "TranscodedModules",
+	struct MODULES { const std::string modules, tcmodules, tcdeadline, tcthreads, tcsockets, descriptor[26]; }
+	modules { "Modules", "TranscodedModules", "TranscodeDeadline", "TranscoderThreads", "TranscoderSockets",
 		"DescriptionA", "DescriptionB", "DescriptionC", "DescriptionD", "DescriptionE", "DescriptionF", "DescriptionG", "DescriptionH", "DescriptionI", "DescriptionJ", "DescriptionK", "DescriptionL", "DescriptionM", "DescriptionN", "DescriptionO", "DescriptionP", "DescriptionQ", "DescriptionR", "DescriptionS", "DescriptionT", "DescriptionU", "DescriptionV", "DescriptionW", "DescriptionX", "DescriptionY", "DescriptionZ" };
 
 	struct USRP { const std::string enable, ip, txport, rxport, module, callsign, filepath; }
@@ -66,6 +66,6 @@ struct SJsonKeys {
 	nxdniddb  { "nxdnIdDbUrl", "nxdnIdDbMode", "nxdnIdDbRefresh", "nxdnIdDbFilePath" },
 	ysftxrxdb {  "ysfIdDbUrl",  "ysfIdDbMode",  "ysfIdDbRefresh",  "ysfIdDbFilePath" };
 
-	struct FILES { const std::string pid, xml, json, white, black, interlink, terminal; }
-	files { "pidFilePath", "xmlFilePath", "jsonFilePath", "whitelistFilePath", "blacklistFilePath", "interlinkFilePath", "g3TerminalFilePath" };
+	struct FILES { const std::string pid, xml, json, white, black, interlink, terminal, reportinterval, statusport, capture; }
+	files { "pidFilePath", "xmlFilePath", "jsonFilePath", "whitelistFilePath", "blacklistFilePath", "interlinkFilePath", "g3TerminalFilePath", "reportInterval", "statusPort", "capturePath" };
 };
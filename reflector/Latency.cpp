@@ -0,0 +1,161 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <tuple>
+#include <time.h>
+
+#include "Latency.h"
+#include "Metrics.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// histogram
+
+CLatencyHistogram::CLatencyHistogram() : m_MaxUs(0)
+{
+	for (auto &count : m_Counts)
+		count.store(0, std::memory_order_relaxed);
+}
+
+unsigned CLatencyHistogram::Bucket(uint64_t us)
+{
+	if (us < 2 * LATENCY_SUB)
+		return unsigned(us);
+	if (us >= (1ull << LATENCY_MAX_BITS))
+		us = (1ull << LATENCY_MAX_BITS) - 1;
+	const unsigned msb = 63 - __builtin_clzll(us);
+	const unsigned shift = msb - LATENCY_SUB_BITS;
+	return (shift + 1) * LATENCY_SUB + unsigned(us >> shift) - LATENCY_SUB;
+}
+
+uint64_t CLatencyHistogram::Highest(unsigned bucket)
+{
+	if (bucket < 2 * LATENCY_SUB)
+		return bucket;
+	const unsigned shift = bucket / LATENCY_SUB - 1;
+	return ((uint64_t(bucket % LATENCY_SUB + LATENCY_SUB) + 1) << shift) - 1;
+}
+
+void CLatencyHistogram::Record(uint64_t ns)
+{
+	const uint64_t us = ns / 1000;
+	m_Counts[Bucket(us)].fetch_add(1, std::memory_order_relaxed);
+	auto max = m_MaxUs.load(std::memory_order_relaxed);
+	while (us > max && ! m_MaxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+		;
+}
+
+uint64_t CLatencyHistogram::Count(void) const
+{
+	uint64_t total = 0;
+	for (const auto &count : m_Counts)
+		total += count.load(std::memory_order_relaxed);
+	return total;
+}
+
+double CLatencyHistogram::Quantile(double q) const
+{
+	uint64_t counts[LATENCY_BUCKETS];
+	uint64_t total = 0;
+	for (unsigned i=0; i<LATENCY_BUCKETS; i++)
+	{
+		counts[i] = m_Counts[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+	if (0 == total)
+		return 0.0;
+
+	uint64_t rank = uint64_t(q * total + 0.999999);
+	if (0 == rank)
+		rank = 1;
+	uint64_t seen = 0;
+	for (unsigned i=0; i<LATENCY_BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+			return std::min(1.0e-6 * Highest(i), Max());
+	}
+	return Max();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// registry
+
+static const char *s_StageNames[] = { "push", "route", "transcoder", "send" };
+static const std::pair<double, const char *> s_Quantiles[] = { { 0.5, "0.5" }, { 0.99, "0.99" }, { 0.999, "0.999" } };
+
+static std::mutex s_Mutex;
+static std::map<std::tuple<int, char, int>, CLatencyHistogram *> s_Histograms;
+
+uint64_t CLatency::Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+CLatencyHistogram *CLatency::Get(ETraceStage stage, char module, EProtocol protocol)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto &histogram = s_Histograms[std::make_tuple(int(stage), module, int(protocol))];
+	if (nullptr == histogram)
+	{
+		histogram = new CLatencyHistogram;
+		const CLatencyHistogram *h = histogram;
+		for (const auto &quantile : s_Quantiles)
+		{
+			const auto q = quantile.first;
+			std::string labels;
+			if (EProtocol::none == protocol)
+				labels = CMetrics::Labels({{"stage", s_StageNames[int(stage)]}, {"module", std::string(1, module)}, {"quantile", quantile.second}});
+			else
+				labels = CMetrics::Labels({{"stage", s_StageNames[int(stage)]}, {"module", std::string(1, module)}, {"protocol", CMetrics::ProtocolLabel(protocol)}, {"quantile", quantile.second}});
+			CMetrics::GaugeFn("urfd_latency_seconds", "Latency a frame picked up inside the reflector, by stage", labels, h, [h, q]() { return h->Quantile(q); });
+		}
+	}
+	return histogram;
+}
+
+void CLatency::JsonReport(nlohmann::json &report)
+{
+	std::map<std::tuple<int, char, int>, CLatencyHistogram *> histograms;
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		histograms = s_Histograms;
+	}
+
+	report["Latency"] = nlohmann::json::array();
+	for (const auto &item : histograms)
+	{
+		const auto h = item.second;
+		if (0 == h->Count())
+			continue;
+		nlohmann::json jlatency;
+		jlatency["Stage"] = s_StageNames[std::get<0>(item.first)];
+		jlatency["Module"] = std::string(1, std::get<1>(item.first));
+		if (EProtocol::none != EProtocol(std::get<2>(item.first)))
+			jlatency["Protocol"] = CMetrics::ProtocolLabel(EProtocol(std::get<2>(item.first)));
+		jlatency["Count"] = h->Count();
+		jlatency["P50Us"] = uint64_t(1.0e6 * h->Quantile(0.5));
+		jlatency["P99Us"] = uint64_t(1.0e6 * h->Quantile(0.99));
+		jlatency["P999Us"] = uint64_t(1.0e6 * h->Quantile(0.999));
+		jlatency["MaxUs"] = uint64_t(1.0e6 * h->Max());
+		report["Latency"].push_back(jlatency);
+	}
+}
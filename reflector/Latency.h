@@ -0,0 +1,82 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+#include "Defines.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define LATENCY_SUB_BITS    4       // 16 linear buckets for each power of two, so within about 6%
+#define LATENCY_MAX_BITS    24      // in us, anything over about 16 seconds is counted as that
+#define LATENCY_SUB         (1u << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS     ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB)
+
+// where a frame's latency is measured, push, route and send are from the socket
+// receive, transcoder is from the frame going to the transcoder to it coming back
+enum class ETraceStage { push, route, transcoder, send };
+
+////////////////////////////////////////////////////////////////////////////////////////
+// histogram
+
+// An HDR style histogram in microseconds: exact below 32 us, then each power of two
+// is split into LATENCY_SUB buckets. Recording is one relaxed add, from any thread.
+
+class CLatencyHistogram
+{
+public:
+	CLatencyHistogram();
+
+	void Record(uint64_t ns);
+
+	// in seconds, the highest value of the bucket the quantile falls in
+	double   Quantile(double q) const;
+	double   Max(void) const    { return 1.0e-6 * m_MaxUs.load(std::memory_order_relaxed); }
+	uint64_t Count(void) const;
+
+protected:
+	static unsigned Bucket(uint64_t us);
+	static uint64_t Highest(unsigned bucket);
+
+	std::atomic<uint64_t> m_Counts[LATENCY_BUCKETS];
+	std::atomic<uint64_t> m_MaxUs;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// registry
+
+// The histograms are created on first use and never freed, so a thread looks its own
+// up once and keeps the pointer. Each one is published as urfd_latency_seconds quantiles
+// and is in the json report.
+
+class CLatency
+{
+public:
+	// the clock of the trace stamps, CLOCK_MONOTONIC in ns, like CUdpSocket::GetRxTime()
+	static uint64_t Now(void);
+
+	// a module's histogram for a stage, send also has the protocol it went out on
+	static CLatencyHistogram *Get(ETraceStage stage, char module, EProtocol protocol = EProtocol::none);
+
+	// report
+	static void JsonReport(nlohmann::json &report);
+};
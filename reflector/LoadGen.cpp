@@ -0,0 +1,1789 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// urfload -- a synthetic load for capacity testing a local urfd.
+//
+// It reads the urfd ini file for the ports, modules and pid file, logs in
+// simulated clients on each protocol, has them take turns talking on their
+// modules and measures what comes back out of the reflector. Every voice
+// frame carries a marker with the talker and a sequence number in the first
+// bytes of its codec data, so a listener on the same codec knows when the
+// frame was sent. The results are written as json.
+//
+// MMDVM, YSF and NXDN carry the same AMBE+2 frames, but YSF and NXDN only keep
+// the 49 bits of voice in them, so for those three the marker goes in the
+// voice bits and the frames are put together by the reflector's own encoders.
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <cmath>
+#include <thread>
+#include <sstream>
+
+#include "Global.h"
+#include "UDPSocket.h"
+#include "Latency.h"
+#include "YSFUtils.h"
+#include "NXDNProtocol.h"
+#include "YSFProtocol.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// global objects, the YSF and NXDN encoders bring in the rest of urfd
+
+SJsonKeys   g_Keys;
+CReflector  g_Reflector;
+CGateKeeper g_GateKeeper;
+CConfigure  g_Configure;
+CVersion    g_Version(3,1,0);   // as in Main.cpp
+CLookupDmr  g_LDid;
+CLookupNxdn g_LNid;
+CLookupYsf  g_LYtr;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define LOAD_TICK_NS        20000000ull     // one DStar, P25 or half an M17 frame
+#define LOAD_LOGIN_TICKS    100             // unlinked clients try again every 2 seconds
+#define LOAD_KEEPALIVE_TICKS 50             // and linked ones send a keepalive every second
+#define LOAD_SETTLE_TICKS   100             // after the logins, for the link streams to close
+#define LOAD_DRAIN_TICKS    50              // after the last frame, for the stragglers
+#define LOAD_STREAM_TICKS   80              // urfd's STREAM_TIMEOUT, a talker is busy until its stream closes
+#define LOAD_SENT_RING      4096            // send times kept for each talker, about 80 seconds
+#define LOAD_MARKER_0       0xA5u
+#define LOAD_MARKER_1       0x5Au
+#define LOAD_MARKER_SIZE    7
+#define LOAD_MAX_MARKERS    5               // the voice frames in a YSF packet
+#define LOAD_DMR_FRAMES     60              // DMR, NXDN and YSF bursts fill 3, 4 and 5 frame packets
+
+enum class ELoadProto { dextra, dplus, dcs, m17, mmdvm, p25, ysf, nxdn, size };
+enum class ECodecFamily { dstar, dmr, m17, p25 };
+enum class EPattern { rotate, single, storm };
+
+static const char *g_ProtoNames[] = { "dextra", "dplus", "dcs", "m17", "mmdvm", "p25", "ysf", "nxdn" };
+static const size_t NPROTO = size_t(ELoadProto::size);
+
+static uint8_t g_DmrSyncMSVoice[] = { 0x07,0xF7,0xD5,0xDD,0x57,0xDF,0xD0 };
+static uint8_t g_DmrSyncMSData[]  = { 0x0D,0x5D,0x7F,0x77,0xFD,0x75,0x70 };
+
+// the offset of the IMBE data in each P25 record type, 0x62 to 0x73
+static const uint8_t g_P25Offset[] = { 10,1,5,5,5,5,5,5,4,10,1,5,5,5,5,5,5,4 };
+static const uint8_t g_P25Size[]   = { 22,14,17,17,17,17,17,17,16,22,14,17,17,17,17,17,17,16 };
+
+static uint64_t Now(void)
+{
+	return CLatency::Now();
+}
+
+static ECodecFamily CodecOf(ELoadProto p)
+{
+	switch (p)
+	{
+	case ELoadProto::m17:   return ECodecFamily::m17;
+	case ELoadProto::mmdvm:
+	case ELoadProto::ysf:
+	case ELoadProto::nxdn:  return ECodecFamily::dmr;
+	case ELoadProto::p25:   return ECodecFamily::p25;
+	default:                return ECodecFamily::dstar;
+	}
+}
+
+// M17 base-40 callsign encoding
+static void M17Encode(const std::string &cs, uint8_t *out)
+{
+	uint64_t v = 0;
+	for (auto it=cs.rbegin(); it!=cs.rend(); it++)
+	{
+		const char c = *it;
+		v *= 40;
+		if ('A' <= c && c <= 'Z')
+			v += c - 'A' + 1;
+		else if ('0' <= c && c <= '9')
+			v += c - '0' + 27;
+	}
+	for (int i=5; i>=0; i--)
+	{
+		out[i] = v & 0xFFu;
+		v >>= 8;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// statistics, each receiver thread has its own
+
+struct SRxStats
+{
+	uint64_t received, unmarked, jittern;
+	double   jittersum, jittermax;
+};
+
+struct SRxThreadStats
+{
+	SRxStats proto[NPROTO];
+};
+
+// shared by all the receivers, recording is one relaxed add
+static CLatencyHistogram *g_Latency[NPROTO+1];
+
+////////////////////////////////////////////////////////////////////////////////////////
+// a simulated client
+
+class CLoadClient
+{
+public:
+	CLoadClient(ELoadProto proto, unsigned index, char module, uint32_t dmrid);
+	virtual ~CLoadClient() {}
+
+	bool Open(void);
+	int  GetSocket(void) const      { return m_Socket.GetSocket(); }
+	ELoadProto GetProto(void) const { return m_Proto; }
+	char GetModule(void) const      { return m_Module; }
+	bool IsLinked(void) const       { return m_Linked.load(std::memory_order_acquire); }
+	uint32_t GetDmrid(void) const   { return m_Dmrid; }
+	const std::string &GetCallsign(void) const { return m_Callsign; }
+	// where it is in the list of clients, it goes in the marker
+	void SetIndex(uint16_t index)   { m_Index = index; }
+
+	// the login and keepalive, from the sender
+	virtual void Login(void) = 0;
+	virtual void KeepAlive(void) = 0;
+	virtual void Logout(void) {}
+
+	// talking, from the sender
+	virtual unsigned FrameTicks(void) const { return 1; }
+	// the voice frames in a packet that have a marker of their own
+	virtual unsigned Markers(void) const    { return 1; }
+	void StartBurst(void);
+	void SendFrame(bool last);
+	uint64_t GetFramesSent(void) const { return m_FramesSent; }
+
+	// everything the reflector sends, from a receiver
+	void Receive(std::vector<std::unique_ptr<CLoadClient>> &all, SRxThreadStats &stats, bool measuring);
+
+	// where the reflector is
+	static CIp s_Reflector[NPROTO];
+	static std::string s_RefCallsign;
+
+protected:
+	// the protocol part
+	virtual void Header(void) = 0;
+	// there are Markers() of them, one after the other
+	virtual void Frame(const uint8_t *marker, bool last) = 0;
+	// returns the codec data if it's a voice frame, otherwise handles it,
+	// with more than one marker they are decoded one after the other
+	virtual const uint8_t *Parse(const CBuffer &buf) = 0;
+
+	void Send(const uint8_t *data, size_t size) const { m_Socket.Send(data, size, s_Reflector[unsigned(m_Proto)]); }
+	void Linked(void)                                 { m_Linked.store(true, std::memory_order_release); }
+
+	// data
+	const ELoadProto m_Proto;
+	const char m_Module;
+	const uint32_t m_Dmrid;
+	std::string m_Callsign;
+	CUdpSocket m_Socket;
+	std::atomic<bool> m_Linked;
+
+	// talker, the marker of the next frame and when the last ones were sent
+	uint16_t m_Index;
+	uint32_t m_Seq, m_BurstFrame, m_StreamId;
+	uint64_t m_FramesSent;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_SentSeq;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_SentNs;
+
+	// listener, for the jitter
+	uint16_t m_LastTalker;
+	uint32_t m_LastSeq;
+	uint64_t m_LastSent, m_LastRx;
+	double   m_Jitter;
+};
+
+CIp         CLoadClient::s_Reflector[NPROTO];
+std::string CLoadClient::s_RefCallsign;
+
+CLoadClient::CLoadClient(ELoadProto proto, unsigned index, char module, uint32_t dmrid)
+	: m_Proto(proto), m_Module(module), m_Dmrid(dmrid), m_Linked(false), m_Index(0), m_Seq(0), m_BurstFrame(0), m_StreamId(0), m_FramesSent(0),
+	m_SentSeq(new std::atomic<uint32_t>[LOAD_SENT_RING]), m_SentNs(new std::atomic<uint64_t>[LOAD_SENT_RING]), m_LastTalker(0xFFFFu), m_LastSeq(0), m_LastSent(0), m_LastRx(0), m_Jitter(0.0)
+{
+	// N0AAA, N0AAB, ... the digit is the protocol
+	m_Callsign.assign("N0AAA");
+	m_Callsign[1] = '0' + char(proto);
+	for (int i=4; i>=2; i--)
+	{
+		m_Callsign[i] = 'A' + index % 26;
+		index /= 26;
+	}
+	m_Callsign.resize(8, ' ');
+	for (unsigned i=0; i<LOAD_SENT_RING; i++)
+		m_SentSeq[i].store(0xFFFFFFFFu, std::memory_order_relaxed);
+}
+
+bool CLoadClient::Open(void)
+{
+	return ! m_Socket.Open(CIp(AF_INET, 0, "0.0.0.0")) || m_Socket.EnableKernelTimestamps();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// talking
+
+void CLoadClient::StartBurst(void)
+{
+	m_BurstFrame = 0;
+	m_StreamId = (uint32_t(::rand()) & 0xFFFFFFFEu) + 1u;
+	Header();
+}
+
+void CLoadClient::SendFrame(bool last)
+{
+	// the markers, two magic bytes, the talker and a 24 bit sequence
+	uint8_t markers[LOAD_MAX_MARKERS][LOAD_MARKER_SIZE];
+	const auto now = Now();
+	for (unsigned i=0; i<Markers(); i++)
+	{
+		auto marker = markers[i];
+		marker[0] = LOAD_MARKER_0;
+		marker[1] = LOAD_MARKER_1;
+		marker[2] = m_Index >> 8;
+		marker[3] = m_Index & 0xFFu;
+		marker[4] = (m_Seq >> 16) & 0xFFu;
+		marker[5] = (m_Seq >> 8) & 0xFFu;
+		marker[6] = m_Seq & 0xFFu;
+
+		const auto slot = m_Seq % LOAD_SENT_RING;
+		m_SentSeq[slot].store(0xFFFFFFFFu, std::memory_order_relaxed);
+		m_SentNs[slot].store(now, std::memory_order_relaxed);
+		m_SentSeq[slot].store(m_Seq, std::memory_order_release);
+		m_Seq = (m_Seq + 1) & 0xFFFFFFu;
+	}
+
+	Frame(markers[0], last);
+	m_BurstFrame++;
+	m_FramesSent += Markers();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// listening
+
+void CLoadClient::Receive(std::vector<std::unique_ptr<CLoadClient>> &all, SRxThreadStats &stats, bool measuring)
+{
+	CBuffer buf;
+	CIp ip;
+	while (m_Socket.ReceiveBatch(buf, ip))
+	{
+		auto data = Parse(buf);
+		if (nullptr == data || ! measuring)
+			continue;
+
+		auto &st = stats.proto[unsigned(m_Proto)];
+		const auto rx = m_Socket.GetRxTime();
+		for (unsigned i=0; i<Markers(); i++, data+=LOAD_MARKER_SIZE)
+		{
+			const uint16_t talker = (data[2] << 8) | data[3];
+			const uint32_t seq = (data[4] << 16) | (data[5] << 8) | data[6];
+			if (LOAD_MARKER_0 != data[0] || LOAD_MARKER_1 != data[1] || talker >= all.size())
+			{
+				// probably transcoded, it's counted but can't be timed
+				st.unmarked++;
+				continue;
+			}
+
+			auto &t = *all[talker];
+			const auto slot = seq % LOAD_SENT_RING;
+			if (t.m_SentSeq[slot].load(std::memory_order_acquire) != seq)
+			{
+				st.unmarked++;
+				continue;
+			}
+			const auto sent = t.m_SentNs[slot].load(std::memory_order_relaxed);
+			const auto latency = (rx > sent) ? rx - sent : 0;
+			g_Latency[unsigned(m_Proto)]->Record(latency);
+			g_Latency[NPROTO]->Record(latency);
+			st.received++;
+
+			// RFC 3550 interarrival jitter over consecutive frames of the same talker
+			if (talker == m_LastTalker && seq == ((m_LastSeq + 1) & 0xFFFFFFu))
+			{
+				const double d = (double(rx) - double(m_LastRx)) - (double(sent) - double(m_LastSent));
+				m_Jitter += (fabs(d) - m_Jitter) / 16.0;
+				st.jittersum += m_Jitter;
+				st.jittern++;
+				if (m_Jitter > st.jittermax)
+					st.jittermax = m_Jitter;
+			}
+			m_LastTalker = talker;
+			m_LastSeq = seq;
+			m_LastSent = sent;
+			m_LastRx = rx;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the D-Star protocols share the header
+
+static void DStarHeader(uint8_t *h, const std::string &callsign, char module)
+{
+	// flags, rpt2, rpt1, ur, my, suffix and a crc nobody checks
+	memset(h, 0, 41);
+	std::string rpt2(CLoadClient::s_RefCallsign);
+	rpt2.resize(7, ' ');
+	memcpy(h+3, rpt2.c_str(), 7);
+	h[10] = module;
+	memcpy(h+11, rpt2.c_str(), 7);
+	h[18] = 'G';
+	memcpy(h+19, "CQCQCQ  ", 8);
+	memcpy(h+27, callsign.c_str(), 8);
+	memcpy(h+35, "LOAD", 4);
+	h[39] = h[40] = 0xFFu;
+}
+
+static void DStarFrame(uint8_t *f, const uint8_t *marker, uint32_t frame)
+{
+	static const uint8_t sync[] = { 0x55, 0x2D, 0x16 };
+	static const uint8_t filler[] = { 0x16, 0x29, 0xF5 };
+	memset(f, 0, 9);
+	memcpy(f, marker, 7);
+	memcpy(f+9, (0 == frame % 21) ? sync : filler, 3);
+}
+
+// the pointer to the "ACK" in a reply, or nullptr
+static const uint8_t *FindAck(const CBuffer &buf)
+{
+	return (const uint8_t *)memmem(buf.data(), buf.size(), "ACK", 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DExtra
+
+class CDextraLoad : public CLoadClient
+{
+public:
+	using CLoadClient::CLoadClient;
+
+	void Login(void)
+	{
+		uint8_t b[11];
+		memcpy(b, m_Callsign.c_str(), 8);
+		b[8] = 'B';
+		b[9] = m_Module;
+		b[10] = 11;
+		Send(b, sizeof(b));
+	}
+
+	void KeepAlive(void)
+	{
+		uint8_t b[9];
+		memcpy(b, m_Callsign.c_str(), 8);
+		b[8] = 0;
+		Send(b, sizeof(b));
+	}
+
+	void Logout(void)
+	{
+		uint8_t b[11];
+		memcpy(b, m_Callsign.c_str(), 8);
+		b[8] = 'B';
+		b[9] = ' ';
+		b[10] = 0;
+		Send(b, sizeof(b));
+	}
+
+protected:
+	void Header(void)
+	{
+		uint8_t b[56] = { 'D','S','V','T', 0x10,0,0,0, 0x20,0,1,2 };
+		memcpy(b+12, &m_StreamId, 2);
+		b[14] = 0x80;
+		DStarHeader(b+15, m_Callsign, m_Module);
+		Send(b, sizeof(b));
+	}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		uint8_t b[27] = { 'D','S','V','T', 0x20,0,0,0, 0x20,0,1,2 };
+		memcpy(b+12, &m_StreamId, 2);
+		b[14] = (m_BurstFrame % 21) | (last ? 0x40 : 0);
+		DStarFrame(b+15, marker, m_BurstFrame);
+		Send(b, sizeof(b));
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		if (27 == buf.size() && 0 == memcmp(buf.data(), "DSVT", 4) && 0x20 == buf.data()[4])
+			return buf.data() + 15;
+		if (14 == buf.size() && FindAck(buf))
+			Linked();
+		return nullptr;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DPlus, the reflector sends every module to all its clients
+
+class CDplusLoad : public CLoadClient
+{
+public:
+	using CLoadClient::CLoadClient;
+
+	void Login(void)
+	{
+		const uint8_t b[] = { 0x05,0x00,0x18,0x00,0x01 };
+		Send(b, sizeof(b));
+	}
+
+	void KeepAlive(void)
+	{
+		const uint8_t b[] = { 0x03,0x60,0x00 };
+		Send(b, sizeof(b));
+	}
+
+	void Logout(void)
+	{
+		const uint8_t b[] = { 0x05,0x00,0x18,0x00,0x00 };
+		Send(b, sizeof(b));
+	}
+
+protected:
+	void Header(void)
+	{
+		uint8_t b[58] = { 0x3A,0x80, 'D','S','V','T', 0x10,0,0,0, 0x20,0,1,2 };
+		memcpy(b+14, &m_StreamId, 2);
+		b[16] = 0x80;
+		DStarHeader(b+17, m_Callsign, m_Module);
+		Send(b, sizeof(b));
+	}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		uint8_t b[32] = { uint8_t(last ? 0x20 : 0x1D),0x80, 'D','S','V','T', 0x20,0,0,0, 0x20,0,1,2 };
+		memcpy(b+14, &m_StreamId, 2);
+		b[16] = (m_BurstFrame % 21) | (last ? 0x40 : 0);
+		DStarFrame(b+17, marker, m_BurstFrame);
+		Send(b, last ? 32 : 29);
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		if ((29 == buf.size() || 32 == buf.size()) && 0 == memcmp(buf.data()+2, "DSVT", 4) && 0x20 == buf.data()[6])
+			return buf.data() + 17;
+		if (5 == buf.size() && 0x05 == buf.data()[0] && 0x01 == buf.data()[4])
+		{
+			// connected, now the login
+			uint8_t b[28] = { 0x1C,0xC0,0x04,0x00 };
+			memcpy(b+4, m_Callsign.c_str(), 8);
+			memcpy(b+20, "DV019999", 8);
+			Send(b, sizeof(b));
+		}
+		else if (8 == buf.size() && 0 == memcmp(buf.data()+4, "OKRW", 4))
+			Linked();
+		return nullptr;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// DCS, the header goes with every frame
+
+class CDcsLoad : public CLoadClient
+{
+public:
+	using CLoadClient::CLoadClient;
+
+	void Login(void)
+	{
+		uint8_t b[519];
+		memset(b, 0, sizeof(b));
+		memcpy(b, m_Callsign.c_str(), 8);
+		b[8] = 'B';
+		b[9] = m_Module;
+		Send(b, sizeof(b));
+	}
+
+	void KeepAlive(void)
+	{
+		uint8_t b[17];
+		memset(b, ' ', sizeof(b));
+		memcpy(b, m_Callsign.c_str(), 8);
+		b[8] = 0;
+		memcpy(b+9, s_RefCallsign.c_str(), std::min(s_RefCallsign.size(), size_t(8)));
+		Send(b, sizeof(b));
+	}
+
+	void Logout(void)
+	{
+		uint8_t b[11];
+		memcpy(b, m_Callsign.c_str(), 8);
+		b[8] = 'B';
+		b[9] = ' ';
+		b[10] = 0;
+		Send(b, sizeof(b));
+	}
+
+protected:
+	void Header(void) {}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		uint8_t b[100];
+		memset(b, 0, sizeof(b));
+		memcpy(b, "0001", 4);
+		uint8_t h[41];
+		DStarHeader(h, m_Callsign, m_Module);
+		memcpy(b+4, h, 39);
+		memcpy(b+43, &m_StreamId, 2);
+		b[45] = (m_BurstFrame % 21) | (last ? 0x40 : 0);
+		DStarFrame(b+46, marker, m_BurstFrame);
+		Send(b, sizeof(b));
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		if (100 <= buf.size() && 0 == memcmp(buf.data(), "0001", 4))
+			return buf.data() + 46;
+		if (14 == buf.size() && FindAck(buf))
+			Linked();
+		return nullptr;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// M17, 40 ms of codec2 in each frame
+
+class CM17Load : public CLoadClient
+{
+public:
+	using CLoadClient::CLoadClient;
+
+	void Login(void)
+	{
+		uint8_t b[11];
+		memcpy(b, "CONN", 4);
+		M17Encode(m_Callsign.substr(0, 8) + 'B', b+4);
+		b[10] = m_Module;
+		Send(b, sizeof(b));
+	}
+
+	// the reflector pings us
+	void KeepAlive(void) {}
+
+	void Logout(void)
+	{
+		uint8_t b[10];
+		memcpy(b, "DISC", 4);
+		M17Encode(m_Callsign.substr(0, 8) + 'B', b+4);
+		Send(b, sizeof(b));
+	}
+
+	unsigned FrameTicks(void) const { return 2; }
+
+protected:
+	void Header(void) {}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		uint8_t b[54];
+		memset(b, 0, sizeof(b));
+		memcpy(b, "M17 ", 4);
+		b[4] = (m_StreamId >> 8) & 0xFFu;
+		b[5] = m_StreamId & 0xFFu;
+		std::string dst(s_RefCallsign);
+		dst.resize(7, ' ');
+		M17Encode(dst + m_Module, b+6);
+		M17Encode(m_Callsign.substr(0, 8) + 'B', b+12);
+		b[19] = 0x05;
+		const uint16_t fn = (m_BurstFrame & 0x7FFFu) | (last ? 0x8000u : 0);
+		b[34] = fn >> 8;
+		b[35] = fn & 0xFFu;
+		memcpy(b+36, marker, 7);
+		Send(b, sizeof(b));
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		if (54 == buf.size() && 0 == memcmp(buf.data(), "M17 ", 4))
+			return buf.data() + 36;
+		if (10 == buf.size() && 0 == memcmp(buf.data(), "PING", 4))
+		{
+			uint8_t b[10];
+			memcpy(b, "PONG", 4);
+			M17Encode(m_Callsign.substr(0, 8) + 'B', b+4);
+			Send(b, sizeof(b));
+		}
+		else if (4 <= buf.size() && 0 == memcmp(buf.data(), "ACKN", 4))
+			Linked();
+		return nullptr;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the DMR family, the marker goes in the 49 voice bits of an AMBE+2 frame,
+// with room for only one magic byte, and the FEC around them is CNXDNProtocol's
+
+class CNxdnCodec : public CNXDNProtocol
+{
+public:
+	CNxdnCodec(uint16_t id) { m_ReflectorId = id; }
+	using CNXDNProtocol::EncodeNXDNHeaderPacket;
+	using CNXDNProtocol::EncodeNXDNPacket;
+
+	// the marker as the 49 voice bits that NXDN carries
+	static void ToVoice(const uint8_t *marker, uint8_t *voice)
+	{
+		voice[0] = marker[0];
+		memcpy(voice+1, marker+2, 5);
+		voice[6] = 0;
+	}
+
+	// one that isn't a marker is counted as unmarked
+	static void FromVoice(const uint8_t *voice, uint8_t *marker)
+	{
+		marker[0] = (LOAD_MARKER_0 == voice[0] && 0 == (voice[6] & 0x80u)) ? LOAD_MARKER_0 : 0;
+		marker[1] = LOAD_MARKER_1;
+		memcpy(marker+2, voice+1, 5);
+	}
+
+	// and as a 72 bit AMBE+2 frame, the way DMR and YSF carry it
+	void ToAmbe(const uint8_t *marker, uint8_t *ambe) const
+	{
+		uint8_t voice[7];
+		ToVoice(marker, voice);
+		memset(ambe, 0, 9);
+		encode(voice, ambe);
+	}
+
+	void FromAmbe(const uint8_t *ambe, uint8_t *marker) const
+	{
+		uint8_t voice[7] = { 0 };
+		decode(ambe, voice);
+		FromVoice(voice, marker);
+	}
+};
+
+class CYsfCodec : public CYsfProtocol
+{
+public:
+	using CYsfProtocol::EncodeYSFHeaderPacket;
+	using CYsfProtocol::EncodeYSFPacket;
+	using CYsfProtocol::EncodeLastYSFPacket;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// MMDVM, three AMBE frames in each 60 ms DMRD packet
+// the reflector only knows the DMR id if it's in the DMR id database
+
+class CMmdvmLoad : public CLoadClient
+{
+public:
+	CMmdvmLoad(ELoadProto proto, unsigned index, char module, uint32_t dmrid, const CNxdnCodec &codec)
+		: CLoadClient(proto, index, module, dmrid), m_Codec(codec) {}
+
+	void Login(void)
+	{
+		m_Step.store(0, std::memory_order_relaxed);
+		uint8_t b[8] = { 'R','P','T','L' };
+		PutId(b+4);
+		Send(b, sizeof(b));
+	}
+
+	void KeepAlive(void)
+	{
+		uint8_t b[11] = { 'R','P','T','P','I','N','G' };
+		PutId(b+7);
+		Send(b, sizeof(b));
+	}
+
+	unsigned FrameTicks(void) const { return 3; }
+	unsigned Markers(void) const    { return 3; }
+
+protected:
+	void PutId(uint8_t *p) const
+	{
+		p[0] = (m_Dmrid >> 24) & 0xFFu;
+		p[1] = (m_Dmrid >> 16) & 0xFFu;
+		p[2] = (m_Dmrid >> 8) & 0xFFu;
+		p[3] = m_Dmrid & 0xFFu;
+	}
+
+	// the group call to the module's talkgroup, on the reflector's slot
+	void Dmrd(uint8_t *b, uint8_t flags)
+	{
+		memset(b, 0, 55);
+		memcpy(b, "DMRD", 4);
+		b[4] = m_DmrSeq++;
+		b[5] = (m_Dmrid >> 16) & 0xFFu;
+		b[6] = (m_Dmrid >> 8) & 0xFFu;
+		b[7] = m_Dmrid & 0xFFu;
+		const uint32_t tg = 4001u + (m_Module - 'A');
+		b[8] = (tg >> 16) & 0xFFu;
+		b[9] = (tg >> 8) & 0xFFu;
+		b[10] = tg & 0xFFu;
+		PutId(b+11);
+		b[15] = 0x80u | flags;
+		memcpy(b+16, &m_StreamId, 4);
+	}
+
+	// a sync in the middle of the 33 byte payload
+	static void Sync(uint8_t *payload, const uint8_t *sync)
+	{
+		payload[13] = (payload[13] & 0xF0u) | (sync[0] & 0x0Fu);
+		memcpy(payload+14, sync+1, 5);
+		payload[19] = (sync[6] & 0xF0u) | (payload[19] & 0x0Fu);
+	}
+
+	// the three AMBE frames go around the sync in the middle of the payload
+	static void PutAmbe(uint8_t *payload, const uint8_t *ambe)
+	{
+		memcpy(payload, ambe, 13);
+		payload[13] = (ambe[13] & 0xF0u) | (payload[13] & 0x0Fu);
+		payload[19] = (payload[19] & 0xF0u) | (ambe[13] & 0x0Fu);
+		memcpy(payload+20, ambe+14, 13);
+	}
+
+	static void GetAmbe(const uint8_t *payload, uint8_t *ambe)
+	{
+		memcpy(ambe, payload, 13);
+		ambe[13] = (payload[13] & 0xF0u) | (payload[19] & 0x0Fu);
+		memcpy(ambe+14, payload+20, 13);
+	}
+
+	void DataSync(uint8_t slottype)
+	{
+		uint8_t b[55];
+		Dmrd(b, 0x20u | slottype);
+		Sync(b+20, g_DmrSyncMSData);
+		Send(b, sizeof(b));
+	}
+
+	void Header(void)
+	{
+		m_DmrSeq = 0;
+		DataSync(1);
+	}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		const uint8_t voiceseq = (m_BurstFrame % 6);
+		uint8_t b[55], ambe[27];
+		Dmrd(b, (0 == voiceseq) ? 0x10u : voiceseq);
+		for (unsigned i=0; i<3; i++)
+			m_Codec.ToAmbe(marker + i * LOAD_MARKER_SIZE, ambe + 9 * i);
+		PutAmbe(b+20, ambe);
+		if (0 == voiceseq)
+			Sync(b+20, g_DmrSyncMSVoice);
+		Send(b, sizeof(b));
+		if (last)
+			DataSync(2);
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		if (55 == buf.size() && 0 == memcmp(buf.data(), "DMRD", 4))
+		{
+			const auto ftype = (buf.data()[15] & 0x30u) >> 4;
+			if (ftype > 1)
+				return nullptr;
+			uint8_t ambe[27];
+			GetAmbe(buf.data() + 20, ambe);
+			for (unsigned i=0; i<3; i++)
+				m_Codec.FromAmbe(ambe + 9 * i, m_Rx + i * LOAD_MARKER_SIZE);
+			return m_Rx;
+		}
+		if (6 <= buf.size() && 0 == memcmp(buf.data(), "RPTACK", 6))
+		{
+			// the RPTL, RPTK, RPTC handshake, then link with a header to the module's talkgroup
+			switch (m_Step.fetch_add(1, std::memory_order_relaxed))
+			{
+			case 0:
+			{
+				uint8_t b[40] = { 'R','P','T','K' };
+				PutId(b+4);
+				Send(b, sizeof(b));
+				break;
+			}
+			case 1:
+			{
+				uint8_t b[302];
+				memset(b, ' ', sizeof(b));
+				memcpy(b, "RPTC", 4);
+				PutId(b+4);
+				memcpy(b+8, m_Callsign.c_str(), 8);
+				Send(b, sizeof(b));
+				break;
+			}
+			case 2:
+				m_StreamId = (uint32_t(::rand()) & 0xFFFFFFFEu) + 1u;
+				m_DmrSeq = 0;
+				DataSync(1);
+				DataSync(2);
+				Linked();
+				break;
+			default:
+				break;
+			}
+		}
+		else if (6 <= buf.size() && 0 == memcmp(buf.data(), "MSTNAK", 6))
+			m_Step.store(0, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	// data
+	const CNxdnCodec &m_Codec;
+	std::atomic<int> m_Step { 0 };
+	uint8_t m_DmrSeq = 0;
+	uint8_t m_Rx[3 * LOAD_MARKER_SIZE];
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// P25, the clients all go to the autolink module
+// and there is only one P25 stream at a time, whatever the module
+
+class CP25Load : public CLoadClient
+{
+public:
+	using CLoadClient::CLoadClient;
+
+	void Login(void)
+	{
+		uint8_t b[11];
+		b[0] = 0xF0u;
+		memcpy(b+1, m_Callsign.c_str(), 8);
+		b[9] = b[10] = ' ';
+		Send(b, sizeof(b));
+	}
+
+	// a P25 gateway polls with its connect
+	void KeepAlive(void) { Login(); }
+
+	void Logout(void)
+	{
+		uint8_t b[11];
+		b[0] = 0xF1u;
+		memcpy(b+1, m_Callsign.c_str(), 8);
+		b[9] = b[10] = ' ';
+		Send(b, sizeof(b));
+	}
+
+protected:
+	void Header(void) {}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		uint8_t b[22];
+		memset(b, 0, sizeof(b));
+		// start with 0x66, it has the source id and opens the stream
+		const auto rec = (m_BurstFrame + 4) % 18;
+		b[0] = 0x62u + rec;
+		if (0x66u == b[0])
+		{
+			b[1] = (m_Dmrid >> 16) & 0xFFu;
+			b[2] = (m_Dmrid >> 8) & 0xFFu;
+			b[3] = m_Dmrid & 0xFFu;
+		}
+		memcpy(b + g_P25Offset[rec], marker, 7);
+		Send(b, g_P25Size[rec]);
+		if (last)
+		{
+			memset(b, 0, sizeof(b));
+			b[0] = 0x80u;
+			Send(b, 17);
+		}
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		if (11 == buf.size() && 0xF0u == buf.data()[0])
+		{
+			Linked();
+			return nullptr;
+		}
+		if (0x62u <= buf.data()[0] && buf.data()[0] <= 0x73u)
+		{
+			const auto offset = g_P25Offset[buf.data()[0] - 0x62u];
+			if (buf.size() >= offset + 11u)
+				return buf.data() + offset;
+		}
+		return nullptr;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// YSF, five AMBE frames in each 100 ms packet, the clients all go to the autolink module
+
+class CYsfLoad : public CLoadClient
+{
+public:
+	CYsfLoad(ELoadProto proto, unsigned index, char module, const CYsfCodec &ysf, const CNxdnCodec &codec)
+		: CLoadClient(proto, index, module, 0), m_Ysf(ysf), m_Codec(codec) {}
+
+	void Login(void)   { Poll('P'); }
+
+	// a YSF gateway polls with its connect
+	void KeepAlive(void) { Login(); }
+
+	void Logout(void)  { Poll('U'); }
+
+	unsigned FrameTicks(void) const { return 5; }
+	unsigned Markers(void) const    { return 5; }
+
+protected:
+	void Poll(char type)
+	{
+		uint8_t b[14];
+		memcpy(b, "YSF", 3);
+		b[3] = type;
+		memset(b+4, ' ', 10);
+		memcpy(b+4, m_Callsign.c_str(), 8);
+		Send(b, sizeof(b));
+	}
+
+	void Header(void)
+	{
+		const CCallsign cs(m_Callsign.substr(0, 5));
+		m_Header = CDvHeaderPacket(cs, CCallsign("CQCQCQ"), cs, CCallsign(s_RefCallsign), uint16_t(m_StreamId), uint8_t(0));
+		CBuffer b;
+		m_Ysf.EncodeYSFHeaderPacket(m_Header, &b);
+		Send(b.data(), b.size());
+	}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		// numbered the way urfd numbers a stream's frames for YSF
+		const uint8_t fn = m_BurstFrame % 8;
+		const uint8_t fid = (m_BurstFrame & 0x7Fu) << 1;
+		CDvFramePacket frames[5];
+		for (unsigned i=0; i<5; i++)
+		{
+			uint8_t ambe[9];
+			m_Codec.ToAmbe(marker + i * LOAD_MARKER_SIZE, ambe);
+			frames[i] = CDvFramePacket(ambe, uint16_t(m_StreamId), fn, uint8_t(i), fid, m_Header.GetMyCallsign(), false);
+		}
+		CBuffer b;
+		m_Ysf.EncodeYSFPacket(m_Header, frames, &b);
+		Send(b.data(), b.size());
+		if (last)
+		{
+			m_Ysf.EncodeLastYSFPacket(m_Header, &b);
+			Send(b.data(), b.size());
+		}
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		CYSFFICH fich;
+		if (155 == buf.size() && 0 == memcmp(buf.data(), "YSFD", 4) && fich.decode(buf.data() + 40)
+			&& YSF_FI_COMMUNICATIONS == fich.getFI() && YSF_DT_VD_MODE2 == fich.getDT())
+		{
+			uint8_t ambe[5][9];
+			uint8_t *ambes[5] = { ambe[0], ambe[1], ambe[2], ambe[3], ambe[4] };
+			CYsfUtils::DecodeVD2Vchs((uint8_t *)buf.data() + 35, ambes);
+			for (unsigned i=0; i<5; i++)
+				m_Codec.FromAmbe(ambe[i], m_Rx + i * LOAD_MARKER_SIZE);
+			return m_Rx;
+		}
+		if (14 == buf.size() && 0 == memcmp(buf.data(), "YSFP", 4))
+			Linked();
+		return nullptr;
+	}
+
+	// data
+	const CYsfCodec &m_Ysf;
+	const CNxdnCodec &m_Codec;
+	CDvHeaderPacket m_Header;
+	uint8_t m_Rx[5 * LOAD_MARKER_SIZE];
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// NXDN, the voice bits of four frames in each 80 ms packet, the clients all go to the
+// autolink module and there is only one NXDN stream at a time, whatever the module
+// the reflector only knows the NXDN id if it's in the NXDN id database
+
+class CNxdnLoad : public CLoadClient
+{
+public:
+	CNxdnLoad(ELoadProto proto, unsigned index, char module, uint16_t nxdnid, CNxdnCodec &codec)
+		: CLoadClient(proto, index, module, 0), m_Nxdnid(nxdnid), m_Codec(codec) {}
+
+	uint16_t GetNxdnid(void) const { return m_Nxdnid; }
+
+	void Login(void)   { Poll('P'); }
+
+	// an NXDN gateway polls with its connect
+	void KeepAlive(void) { Login(); }
+
+	void Logout(void)  { Poll('U'); }
+
+	unsigned FrameTicks(void) const { return 4; }
+	unsigned Markers(void) const    { return 4; }
+
+protected:
+	void Poll(char type)
+	{
+		uint8_t b[17];
+		memcpy(b, "NXDN", 4);
+		b[4] = type;
+		memset(b+5, ' ', 10);
+		memcpy(b+5, m_Callsign.c_str(), 8);
+		b[15] = b[16] = 0;
+		Send(b, sizeof(b));
+	}
+
+	// urfd takes this header and the terminator for voice too, their frames come out unmarked
+	void Header(void)
+	{
+		const CCallsign cs(m_Callsign.substr(0, 5), 0, m_Nxdnid);
+		m_Header = CDvHeaderPacket(cs, CCallsign("CQCQCQ"), cs, CCallsign(s_RefCallsign), uint16_t(m_StreamId), uint8_t(0));
+		CBuffer b;
+		m_Codec.EncodeNXDNHeaderPacket(m_Header, b);
+		Send(b.data(), b.size());
+	}
+
+	void Frame(const uint8_t *marker, bool last)
+	{
+		CDvFramePacket frames[4];
+		for (unsigned i=0; i<4; i++)
+		{
+			uint8_t ambe[9];
+			m_Codec.ToAmbe(marker + i * LOAD_MARKER_SIZE, ambe);
+			frames[i] = CDvFramePacket(ambe, uint16_t(m_StreamId), uint8_t(i), false);
+		}
+		CBuffer b;
+		m_Codec.EncodeNXDNPacket(m_Header, m_BurstFrame, frames, b);
+		Send(b.data(), b.size());
+		if (last)
+		{
+			m_Codec.EncodeNXDNHeaderPacket(m_Header, b, true);
+			Send(b.data(), b.size());
+		}
+	}
+
+	// the second and the fourth frame start a bit later
+	static void Unshift(const uint8_t *d, uint8_t *voice)
+	{
+		for (unsigned i=0; i<6; i++)
+			voice[i] = (d[i] << 1) | (d[i+1] >> 7);
+		voice[6] = d[6] << 1;
+	}
+
+	const uint8_t *Parse(const CBuffer &buf)
+	{
+		// the header and the terminator have a LICH without voice
+		if (43 == buf.size() && 0 == memcmp(buf.data(), "NXDND", 5) && (buf.data()[10] & 0x30u))
+		{
+			const auto d = buf.data();
+			uint8_t voice[7];
+			CNxdnCodec::FromVoice(d+15, m_Rx);
+			Unshift(d+21, voice);
+			CNxdnCodec::FromVoice(voice, m_Rx + LOAD_MARKER_SIZE);
+			CNxdnCodec::FromVoice(d+29, m_Rx + 2 * LOAD_MARKER_SIZE);
+			Unshift(d+35, voice);
+			CNxdnCodec::FromVoice(voice, m_Rx + 3 * LOAD_MARKER_SIZE);
+			return m_Rx;
+		}
+		if (17 == buf.size() && 0 == memcmp(buf.data(), "NXDNP", 5))
+			Linked();
+		return nullptr;
+	}
+
+	// data
+	const uint16_t m_Nxdnid;
+	CNxdnCodec &m_Codec;
+	CDvHeaderPacket m_Header;
+	uint8_t m_Rx[4 * LOAD_MARKER_SIZE];
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// cpu usage of a process, from /proc
+
+static bool CpuTicks(const std::string &pid, uint64_t &ticks)
+{
+	std::ifstream f("/proc/" + pid + "/stat");
+	std::string line;
+	if (! std::getline(f, line))
+		return true;
+	// the command can have spaces, the fields we want are after it
+	auto p = line.rfind(')');
+	if (std::string::npos == p)
+		return true;
+	std::istringstream ss(line.substr(p + 2));
+	std::string field;
+	uint64_t utime = 0, stime = 0;
+	for (int i=3; i<=15 && ss >> field; i++)
+	{
+		if (14 == i)
+			utime = std::stoull(field);
+		else if (15 == i)
+			stime = std::stoull(field);
+	}
+	ticks = utime + stime;
+	return false;
+}
+
+static uint64_t RssKb(const std::string &pid)
+{
+	std::ifstream f("/proc/" + pid + "/status");
+	std::string line;
+	while (std::getline(f, line))
+	{
+		if (0 == line.compare(0, 6, "VmRSS:"))
+			return std::stoull(line.substr(6));
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the load
+
+struct SLoadOptions
+{
+	unsigned clients[NPROTO] = { 2, 2, 2, 2, 2, 2, 2, 2 };
+	std::string modules, outfile, dmridfile, nxdnidfile, pid;
+	unsigned duration = 60, talk = 5, gap = 2, receivers = 1, warmup = 10;
+	uint32_t dmrid = 9990001;
+	uint16_t nxdnid = 60001;
+	EPattern pattern = EPattern::rotate;
+};
+
+class CLoadGen
+{
+public:
+	bool Configure(const SLoadOptions &opt);
+	bool Run(nlohmann::json &results);
+
+protected:
+	void Receiver(unsigned n);
+	void Tick(uint64_t tick, bool talking);
+	void Fanout(const CLoadClient &talker, uint64_t tick);
+	bool Linking(void);
+
+	// data
+	SLoadOptions m_Opt;
+	std::unique_ptr<CNxdnCodec> m_Nxdn;
+	std::unique_ptr<CYsfCodec> m_Ysf;
+	std::vector<std::unique_ptr<CLoadClient>> m_Clients;
+	std::vector<std::vector<unsigned>> m_Talkers;   // for each module, who can talk on it
+	std::vector<SRxThreadStats> m_RxStats;
+	std::atomic<bool> m_Run, m_Measuring;
+
+	// talkers, each module has a turn going, with when it started
+	std::vector<size_t>   m_Turn;
+	std::vector<uint64_t> m_TurnStart;
+	uint64_t m_TalkTicks, m_DmrTalkTicks, m_CycleTicks;
+
+	// linked listeners on each module, for what every frame should reach
+	unsigned m_Listeners[26][NPROTO];
+	unsigned m_DplusListeners;
+	std::vector<uint64_t> m_BusyUntil;              // DPlus clients don't hear any module while they are talking
+	uint64_t m_Expected[NPROTO], m_TxFrames[NPROTO];
+};
+
+bool CLoadGen::Configure(const SLoadOptions &opt)
+{
+	m_Opt = opt;
+	const auto &mods = m_Opt.modules;
+
+	// the reflector ports
+	std::string addr("127.0.0.1");
+	if (g_Configure.IsString(g_Keys.ip.ipv4bind) && 0 != g_Configure.GetString(g_Keys.ip.ipv4bind).compare("0.0.0.0"))
+		addr.assign(g_Configure.GetString(g_Keys.ip.ipv4bind));
+	const std::string *ports[NPROTO] = { &g_Keys.dextra.port, &g_Keys.dplus.port, &g_Keys.dcs.port, &g_Keys.m17.port, &g_Keys.mmdvm.port, &g_Keys.p25.port, &g_Keys.ysf.port, &g_Keys.nxdn.port };
+	for (unsigned p=0; p<NPROTO; p++)
+	{
+		if (m_Opt.clients[p] && ! g_Configure.Contains(*ports[p]))
+		{
+			std::cerr << "The ini file has no port for " << g_ProtoNames[p] << std::endl;
+			return true;
+		}
+		if (m_Opt.clients[p])
+			CLoadClient::s_Reflector[p] = CIp(AF_INET, uint16_t(g_Configure.GetUnsigned(*ports[p])), addr.c_str());
+	}
+	CLoadClient::s_RefCallsign.assign(g_Configure.GetString(g_Keys.names.callsign));
+
+	// P25, YSF and NXDN only go to their autolink modules
+	char automod[NPROTO];
+	memset(automod, ' ', sizeof(automod));
+	const struct { ELoadProto proto; const std::string &key; const char *name; } autolinks[] = {
+		{ ELoadProto::p25,  g_Keys.p25.autolinkmod,  "P25" },
+		{ ELoadProto::ysf,  g_Keys.ysf.autolinkmod,  "YSF" },
+		{ ELoadProto::nxdn, g_Keys.nxdn.autolinkmod, "NXDN" }
+	};
+	for (const auto &a : autolinks)
+	{
+		const auto p = unsigned(a.proto);
+		if (0 == m_Opt.clients[p])
+			continue;
+		if (g_Configure.Contains(a.key))
+			automod[p] = g_Configure.GetAutolinkModule(a.key);
+		if (std::string::npos == mods.find(automod[p]))
+		{
+			std::cerr << a.name << " clients need a " << a.name << " autolink module that is one of the modules, so there won't be any" << std::endl;
+			m_Opt.clients[p] = 0;
+		}
+	}
+
+	// the reflector's own encoders
+	uint16_t nxdnrefid = 0;
+	if (g_Configure.Contains(g_Keys.nxdn.reflectorid))
+		nxdnrefid = uint16_t(g_Configure.GetUnsigned(g_Keys.nxdn.reflectorid));
+	m_Nxdn.reset(new CNxdnCodec(nxdnrefid));
+	m_Ysf.reset(new CYsfCodec);
+
+	// the clients, spread over the modules
+	m_Talkers.resize(mods.size());
+	uint32_t dmrid = m_Opt.dmrid;
+	uint16_t nxdnid = m_Opt.nxdnid;
+	std::ofstream idfile, nxdnfile;
+	if (! m_Opt.dmridfile.empty())
+	{
+		idfile.open(m_Opt.dmridfile, std::ios::out | std::ios::trunc);
+		if (! idfile.is_open())
+		{
+			std::cerr << "Can't write " << m_Opt.dmridfile << std::endl;
+			return true;
+		}
+	}
+	if (! m_Opt.nxdnidfile.empty())
+	{
+		nxdnfile.open(m_Opt.nxdnidfile, std::ios::out | std::ios::trunc);
+		if (! nxdnfile.is_open())
+		{
+			std::cerr << "Can't write " << m_Opt.nxdnidfile << std::endl;
+			return true;
+		}
+	}
+	if (0 == nxdnid || size_t(nxdnid) + m_Opt.clients[unsigned(ELoadProto::nxdn)] > 0x10000u)
+	{
+		std::cerr << "The NXDN ids of the NXDN clients have to be between 1 and 65535" << std::endl;
+		return true;
+	}
+	for (unsigned p=0; p<NPROTO; p++)
+	{
+		for (unsigned i=0; i<m_Opt.clients[p]; i++)
+		{
+			const auto proto = ELoadProto(p);
+			const char mod = (' ' != automod[p]) ? automod[p] : mods[i % mods.size()];
+			std::unique_ptr<CLoadClient> client;
+			switch (proto)
+			{
+			case ELoadProto::dextra: client.reset(new CDextraLoad(proto, i, mod, 0));     break;
+			case ELoadProto::dplus:  client.reset(new CDplusLoad(proto, i, mod, 0));      break;
+			case ELoadProto::dcs:    client.reset(new CDcsLoad(proto, i, mod, 0));        break;
+			case ELoadProto::m17:    client.reset(new CM17Load(proto, i, mod, 0));        break;
+			case ELoadProto::mmdvm:  client.reset(new CMmdvmLoad(proto, i, mod, dmrid++, *m_Nxdn)); break;
+			case ELoadProto::p25:    client.reset(new CP25Load(proto, i, mod, dmrid++));  break;
+			case ELoadProto::ysf:    client.reset(new CYsfLoad(proto, i, mod, *m_Ysf, *m_Nxdn)); break;
+			case ELoadProto::nxdn:   client.reset(new CNxdnLoad(proto, i, mod, nxdnid++, *m_Nxdn)); break;
+			default: break;
+			}
+			if (client->Open())
+				return true;
+			if (client->GetDmrid() && idfile.is_open())
+				idfile << client->GetDmrid() << ';' << client->GetCallsign().substr(0, 5) << ";\n";
+			if (ELoadProto::nxdn == proto && nxdnfile.is_open())
+				nxdnfile << static_cast<const CNxdnLoad &>(*client).GetNxdnid() << ',' << client->GetCallsign().substr(0, 5) << ",\n";
+			client->SetIndex(uint16_t(m_Clients.size()));
+			m_Talkers[mods.find(mod)].push_back(m_Clients.size());
+			m_Clients.push_back(std::move(client));
+		}
+	}
+	if (m_Clients.empty() || m_Clients.size() > 0xFFFFu)
+	{
+		std::cerr << "Between 1 and 65535 clients, please" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// receivers, each one has every nth client
+
+void CLoadGen::Receiver(unsigned n)
+{
+	auto efd = epoll_create1(0);
+	if (0 > efd)
+	{
+		std::cerr << "epoll_create1: " << strerror(errno) << std::endl;
+		return;
+	}
+	for (unsigned i=n; i<m_Clients.size(); i+=m_Opt.receivers)
+	{
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		epoll_ctl(efd, EPOLL_CTL_ADD, m_Clients[i]->GetSocket(), &ev);
+	}
+
+	struct epoll_event events[64];
+	auto &stats = m_RxStats[n];
+	while (m_Run.load(std::memory_order_relaxed))
+	{
+		const auto count = epoll_wait(efd, events, 64, 100);
+		const bool measuring = m_Measuring.load(std::memory_order_acquire);
+		for (int i=0; i<count; i++)
+			m_Clients[events[i].data.u32]->Receive(m_Clients, stats, measuring);
+	}
+	close(efd);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// sender
+
+// what one frame of this talker should reach, and is counted for the listener's protocol
+void CLoadGen::Fanout(const CLoadClient &talker, uint64_t tick)
+{
+	unsigned dplus = m_DplusListeners;
+	for (size_t i=0; i<m_Clients.size(); i++)
+	{
+		if (ELoadProto::dplus == m_Clients[i]->GetProto() && m_BusyUntil[i] > tick && dplus)
+			dplus--;
+	}
+
+	const auto codec = CodecOf(talker.GetProto());
+	const auto m = talker.GetModule() - 'A';
+	const auto frames = talker.Markers();
+	for (unsigned p=0; p<NPROTO; p++)
+	{
+		if (CodecOf(ELoadProto(p)) != codec)
+			continue;
+		if (ELoadProto::dplus == ELoadProto(p))
+		{
+			// the talker is already one of the busy ones
+			m_Expected[p] += dplus * frames;
+			continue;
+		}
+		uint64_t n = m_Listeners[m][p];
+		if (unsigned(talker.GetProto()) == p && n)
+			n--;
+		m_Expected[p] += n * frames;
+	}
+}
+
+void CLoadGen::Tick(uint64_t tick, bool talking)
+{
+	// keepalives, spread over the second
+	for (size_t i=tick % LOAD_KEEPALIVE_TICKS; i<m_Clients.size(); i+=LOAD_KEEPALIVE_TICKS)
+	{
+		if (m_Clients[i]->IsLinked())
+			m_Clients[i]->KeepAlive();
+	}
+
+	if (! talking)
+		return;
+
+	for (size_t m=0; m<m_Talkers.size(); m++)
+	{
+		auto &list = m_Talkers[m];
+		if (list.empty() || tick < m_TurnStart[m])
+			continue;
+
+		// whose turn is it?
+		auto t = tick - m_TurnStart[m];
+		if (t >= m_CycleTicks)
+		{
+			m_TurnStart[m] = tick;
+			if (EPattern::rotate == m_Opt.pattern)
+				m_Turn[m] = (m_Turn[m] + 1) % list.size();
+			t = 0;
+		}
+		if (t > std::max(m_TalkTicks, m_DmrTalkTicks))
+			continue;
+
+		size_t first = m_Turn[m], last = m_Turn[m] + 1;
+		if (EPattern::storm == m_Opt.pattern)
+		{
+			first = 0;
+			last = list.size();
+		}
+		for (auto i=first; i<last; i++)
+		{
+			auto &c = *m_Clients[list[i]];
+			const auto talk = (ECodecFamily::dmr == CodecOf(c.GetProto())) ? m_DmrTalkTicks : m_TalkTicks;
+			if (! c.IsLinked() || t > talk)
+				continue;
+			if (0 == t)
+				c.StartBurst();
+			if (0 == t % c.FrameTicks())
+			{
+				c.SendFrame(t + c.FrameTicks() > talk);
+				m_TxFrames[unsigned(c.GetProto())] += c.Markers();
+				m_BusyUntil[list[i]] = tick + LOAD_STREAM_TICKS;
+				Fanout(c, tick);
+			}
+		}
+	}
+}
+
+// everybody still not linked tries again, returns true while any are
+bool CLoadGen::Linking(void)
+{
+	bool any = false;
+	for (auto &c : m_Clients)
+	{
+		if (! c->IsLinked())
+		{
+			c->Login();
+			any = true;
+		}
+	}
+	return any;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the run
+
+static void SleepUntil(uint64_t ns)
+{
+	struct timespec ts;
+	ts.tv_sec = ns / 1000000000ull;
+	ts.tv_nsec = ns % 1000000000ull;
+	while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr))
+		;
+}
+
+static nlohmann::json Quantiles(const CLatencyHistogram &h)
+{
+	nlohmann::json j;
+	j["p50"]  = 1000.0 * h.Quantile(0.5);
+	j["p90"]  = 1000.0 * h.Quantile(0.9);
+	j["p99"]  = 1000.0 * h.Quantile(0.99);
+	j["p999"] = 1000.0 * h.Quantile(0.999);
+	j["max"]  = 1000.0 * h.Max();
+	return j;
+}
+
+bool CLoadGen::Run(nlohmann::json &results)
+{
+	for (auto &h : g_Latency)
+		h = new CLatencyHistogram;
+	m_RxStats.assign(m_Opt.receivers, SRxThreadStats());
+	memset(m_Expected, 0, sizeof(m_Expected));
+	memset(m_TxFrames, 0, sizeof(m_TxFrames));
+	m_Run = true;
+	m_Measuring = false;
+	std::vector<std::thread> threads;
+	for (unsigned n=0; n<m_Opt.receivers; n++)
+		threads.emplace_back(&CLoadGen::Receiver, this, n);
+
+	// log everybody in
+	uint64_t tick = 0;
+	auto next = Now();
+	const uint64_t warmupticks = m_Opt.warmup * 50ull;
+	while (tick < warmupticks)
+	{
+		if (0 == tick % LOAD_LOGIN_TICKS && ! Linking())
+			break;
+		Tick(tick++, false);
+		SleepUntil(next += LOAD_TICK_NS);
+	}
+	for (unsigned i=0; i<LOAD_SETTLE_TICKS; i++)
+	{
+		Tick(tick++, false);
+		SleepUntil(next += LOAD_TICK_NS);
+	}
+
+	// who made it
+	memset(m_Listeners, 0, sizeof(m_Listeners));
+	m_DplusListeners = 0;
+	m_BusyUntil.assign(m_Clients.size(), 0);
+	unsigned linked[NPROTO] = { 0 };
+	for (auto &c : m_Clients)
+	{
+		if (! c->IsLinked())
+			continue;
+		const auto p = unsigned(c->GetProto());
+		linked[p]++;
+		m_Listeners[c->GetModule() - 'A'][p]++;
+		if (ELoadProto::dplus == c->GetProto())
+			m_DplusListeners++;
+	}
+	for (unsigned p=0; p<NPROTO; p++)
+	{
+		if (m_Opt.clients[p])
+			std::cerr << g_ProtoNames[p] << ": " << linked[p] << " of " << m_Opt.clients[p] << " clients linked" << std::endl;
+	}
+
+	// the talkers start staggered over the modules
+	m_TalkTicks = m_Opt.talk * 50ull;
+	// a DMR family burst fills the last packet of each of them, so all of it comes out
+	m_DmrTalkTicks = std::max(uint64_t(1), m_TalkTicks / LOAD_DMR_FRAMES) * LOAD_DMR_FRAMES - 1;
+	m_CycleTicks = std::max(m_TalkTicks, m_DmrTalkTicks) + m_Opt.gap * 50ull;
+	m_Turn.assign(m_Talkers.size(), 0);
+	m_TurnStart.resize(m_Talkers.size());
+	for (size_t m=0; m<m_Talkers.size(); m++)
+		m_TurnStart[m] = tick + m * m_CycleTicks / m_Talkers.size();
+
+	// measure
+	std::string pid(m_Opt.pid);
+	if (pid.empty() && g_Configure.IsString(g_Keys.files.pid))
+	{
+		std::ifstream f(g_Configure.GetString(g_Keys.files.pid));
+		std::getline(f, pid);
+	}
+	const double hz = double(sysconf(_SC_CLK_TCK));
+	uint64_t cpustart = 0, cpulast = 0, cpunow = 0, selfstart = 0, selfend = 0;
+	double cpumax = 0.0;
+	bool cpu = ! pid.empty() && ! CpuTicks(pid, cpustart);
+	if (! pid.empty() && ! cpu)
+		std::cerr << "Can't read the cpu time of pid " << pid << std::endl;
+	CpuTicks("self", selfstart);
+	cpulast = cpustart;
+
+	m_Measuring.store(true, std::memory_order_release);
+	const auto start = Now();
+	const uint64_t end = tick + m_Opt.duration * 50ull;
+	uint64_t late = 0;
+	while (tick < end)
+	{
+		Tick(tick, true);
+		if (cpu && 0 == (end - tick) % 50)
+		{
+			if (! CpuTicks(pid, cpunow))
+			{
+				cpumax = std::max(cpumax, 100.0 * (cpunow - cpulast) / hz);
+				cpulast = cpunow;
+			}
+		}
+		tick++;
+		const auto now = Now();
+		next += LOAD_TICK_NS;
+		if (now > next)
+			late = std::max(late, now - next);
+		SleepUntil(next);
+	}
+	const auto elapsed = 1.0e-9 * (Now() - start);
+	if (cpu)
+		CpuTicks(pid, cpunow);
+	CpuTicks("self", selfend);
+	for (unsigned i=0; i<LOAD_DRAIN_TICKS; i++)
+	{
+		Tick(tick++, false);
+		SleepUntil(next += LOAD_TICK_NS);
+	}
+	m_Measuring.store(false, std::memory_order_release);
+	for (auto &c : m_Clients)
+		c->Logout();
+	m_Run = false;
+	for (auto &t : threads)
+		t.join();
+
+	// the results
+	const char *patterns[] = { "rotate", "single", "storm" };
+	results["reflector"] = CLoadClient::s_RefCallsign;
+	results["modules"] = m_Opt.modules;
+	results["pattern"] = patterns[unsigned(m_Opt.pattern)];
+	results["duration"] = elapsed;
+	results["talk"] = m_Opt.talk;
+	results["gap"] = m_Opt.gap;
+	SRxStats total;
+	memset(&total, 0, sizeof(total));
+	uint64_t texpected = 0, ttx = 0;
+	for (unsigned p=0; p<NPROTO; p++)
+	{
+		if (0 == m_Opt.clients[p])
+			continue;
+		SRxStats s;
+		memset(&s, 0, sizeof(s));
+		for (auto &r : m_RxStats)
+		{
+			s.received  += r.proto[p].received;
+			s.unmarked  += r.proto[p].unmarked;
+			s.jittersum += r.proto[p].jittersum;
+			s.jittern   += r.proto[p].jittern;
+			s.jittermax  = std::max(s.jittermax, r.proto[p].jittermax);
+		}
+		auto &j = results["protocols"][g_ProtoNames[p]];
+		j["clients"] = m_Opt.clients[p];
+		j["linked"] = linked[p];
+		j["frames_sent"] = m_TxFrames[p];
+		j["frames_expected"] = m_Expected[p];
+		j["frames_received"] = s.received;
+		j["frames_unmarked"] = s.unmarked;
+		j["loss"] = m_Expected[p] ? 1.0 - double(std::min(s.received, m_Expected[p])) / m_Expected[p] : 0.0;
+		j["latency_ms"] = Quantiles(*g_Latency[p]);
+		j["jitter_ms"]["mean"] = s.jittern ? 1.0e-6 * s.jittersum / s.jittern : 0.0;
+		j["jitter_ms"]["max"] = 1.0e-6 * s.jittermax;
+		total.received  += s.received;
+		total.unmarked  += s.unmarked;
+		total.jittersum += s.jittersum;
+		total.jittern   += s.jittern;
+		total.jittermax  = std::max(total.jittermax, s.jittermax);
+		texpected += m_Expected[p];
+		ttx += m_TxFrames[p];
+	}
+	auto &t = results["total"];
+	t["frames_sent"] = ttx;
+	t["frames_expected"] = texpected;
+	t["frames_received"] = total.received;
+	t["frames_unmarked"] = total.unmarked;
+	t["loss"] = texpected ? 1.0 - double(std::min(total.received, texpected)) / texpected : 0.0;
+	t["latency_ms"] = Quantiles(*g_Latency[NPROTO]);
+	t["jitter_ms"]["mean"] = total.jittern ? 1.0e-6 * total.jittersum / total.jittern : 0.0;
+	t["jitter_ms"]["max"] = 1.0e-6 * total.jittermax;
+	if (cpu)
+	{
+		results["urfd"]["pid"] = pid;
+		results["urfd"]["cpu_percent"] = 100.0 * (cpunow - cpustart) / hz / elapsed;
+		results["urfd"]["cpu_percent_max"] = cpumax;
+		results["urfd"]["rss_kb"] = RssKb(pid);
+	}
+	// if the load generator was busy or late, the numbers above are suspect
+	results["urfload"]["cpu_percent"] = 100.0 * (selfend - selfstart) / hz / elapsed;
+	results["urfload"]["tick_late_max_ms"] = 1.0e-6 * late;
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static void usage(std::ostream &os, const char *name)
+{
+	os << "\nUsage: " << name << " [options] INIFILE\n"
+		"Log simulated clients into the urfd on this machine, have them talk and measure what comes back.\n"
+		"INIFILE   : the urfd ini file, for the ports, modules and pid file.\n"
+		"Options\n"
+		"    -c LIST    : clients for each protocol, default dextra=2,dplus=2,dcs=2,m17=2,mmdvm=2,p25=2,ysf=2,nxdn=2\n"
+		"    -m MODULES : the modules to load, default is all of them\n"
+		"    -t SECONDS : how long to measure, default 60\n"
+		"    -k SECONDS : how long each talker talks, default 5, the MMDVM, YSF and NXDN ones\n"
+		"                 talk in multiples of 1.2 seconds, at least once\n"
+		"    -g SECONDS : the gap between talkers, default 2, urfd only frees a module\n"
+		"                 when its stream has been idle for 1.6 seconds\n"
+		"    -p PATTERN : rotate (the module's clients take turns), single (the first one always talks)\n"
+		"                 or storm (they all talk at once), default rotate\n"
+		"    -r NUMBER  : receiver threads, default 1\n"
+		"    -w SECONDS : how long to wait for the logins, default 10\n"
+		"    -i DMRID   : the first DMR id of the MMDVM and P25 clients, default 9990001\n"
+		"    -d FILE    : write the DMR ids of the clients, for the [DMR ID DB] FilePath of urfd\n"
+		"    -x NXDNID  : the first NXDN id of the NXDN clients, default 60001\n"
+		"    -n FILE    : write the NXDN ids of the clients, for the [NXDN ID DB] FilePath of urfd\n"
+		"    -u PID     : the urfd process, default is from the pid file\n"
+		"    -o FILE    : write the json results to FILE instead of stdout\n"
+		"Frames are timed when they come out on the codec they went in on, for the others\n"
+		"(transcoded or not) only the count is reported, as frames_unmarked.\n\n";
+}
+
+int main(int argc, char *argv[])
+{
+	SLoadOptions opt;
+	std::string clients;
+	int c;
+	while (-1 != (c = getopt(argc, argv, "c:m:t:k:g:p:r:w:i:d:x:n:u:o:h")))
+	{
+		switch (c)
+		{
+		case 'c': clients.assign(optarg);                 break;
+		case 'm': opt.modules.assign(optarg);             break;
+		case 't': opt.duration = std::stoul(optarg);      break;
+		case 'k': opt.talk = std::stoul(optarg);          break;
+		case 'g': opt.gap = std::stoul(optarg);           break;
+		case 'r': opt.receivers = std::max(1ul, std::stoul(optarg)); break;
+		case 'w': opt.warmup = std::stoul(optarg);        break;
+		case 'i': opt.dmrid = std::stoul(optarg);         break;
+		case 'd': opt.dmridfile.assign(optarg);           break;
+		case 'x': opt.nxdnid = uint16_t(std::stoul(optarg)); break;
+		case 'n': opt.nxdnidfile.assign(optarg);          break;
+		case 'u': opt.pid.assign(optarg);                 break;
+		case 'o': opt.outfile.assign(optarg);             break;
+		case 'p':
+			if (0 == strcmp(optarg, "rotate"))
+				opt.pattern = EPattern::rotate;
+			else if (0 == strcmp(optarg, "single"))
+				opt.pattern = EPattern::single;
+			else if (0 == strcmp(optarg, "storm"))
+				opt.pattern = EPattern::storm;
+			else
+			{
+				usage(std::cerr, argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			usage(std::cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind + 1 != argc || 0 == opt.talk)
+	{
+		usage(std::cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (opt.gap < 2)
+		std::cerr << "WARNING: with a gap of " << opt.gap << " seconds, the next talker will find the module still busy" << std::endl;
+
+	// name=count,...
+	if (! clients.empty())
+	{
+		memset(opt.clients, 0, sizeof(opt.clients));
+		std::istringstream ss(clients);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			const auto eq = item.find('=');
+			const auto name = item.substr(0, eq);
+			unsigned p = 0;
+			while (p < NPROTO && name.compare(g_ProtoNames[p]))
+				p++;
+			if (NPROTO == p || std::string::npos == eq)
+			{
+				std::cerr << "Unknown protocol '" << name << "', it's one of dextra, dplus, dcs, m17, mmdvm, p25, ysf or nxdn" << std::endl;
+				return EXIT_FAILURE;
+			}
+			opt.clients[p] = std::stoul(item.substr(eq + 1));
+		}
+	}
+
+	// stdout is for the results, the chatter goes to stderr
+	auto coutbuf = std::cout.rdbuf(std::cerr.rdbuf());
+
+	if (g_Configure.ReadData(argv[optind]))
+		return EXIT_FAILURE;
+
+	// only the reflector's modules
+	const auto refmods(g_Configure.GetString(g_Keys.modules.modules));
+	if (opt.modules.empty())
+		opt.modules.assign(refmods);
+	for (auto m : opt.modules)
+	{
+		if (std::string::npos == refmods.find(m))
+		{
+			std::cerr << "Module '" << m << "' is not one of " << refmods << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// a socket for each client
+	struct rlimit rl;
+	if (0 == getrlimit(RLIMIT_NOFILE, &rl))
+	{
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	CLoadGen load;
+	nlohmann::json results;
+	if (load.Configure(opt) || load.Run(results))
+		return EXIT_FAILURE;
+
+	std::cout.rdbuf(coutbuf);
+	if (opt.outfile.empty())
+		std::cout << results.dump(4) << std::endl;
+	else
+	{
+		std::ofstream f(opt.outfile, std::ios::out | std::ios::trunc);
+		f << results.dump(4) << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
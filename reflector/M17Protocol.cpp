@@ -28,13 +28,15 @@
 
 bool CM17Protocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = M17_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// done
 	return true;
 }
@@ -79,12 +81,9 @@ void CM17Protocol::Task(void)
 				if (Frame->IsLastPacket())
 					Frame->SetLastPacket(false);
 
-				// push the "first" packet
-				OnDvFramePacketIn(Frame, &Ip);
-				// leave a space between this pair of frames
-				std::this_thread::sleep_for(std::chrono::milliseconds(16));
-				// push the "second" packet
-				OnDvFramePacketIn(secondFrame, &Ip); // push two packet because we need a packet every 20 ms
+				// the pacer lets the "first" packet go now and the "second" one 20 ms later
+				PaceDvFramePacketIn(Frame, Ip);
+				PaceDvFramePacketIn(secondFrame, Ip); // push two packet because we need a packet every 20 ms
 			}
 		}
 		else if ( IsValidConnectPacket(Buffer, Callsign, ToLinkModule) )
@@ -139,9 +138,7 @@ void CM17Protocol::Task(void)
 		{
 			// find all clients with that callsign & ip and keep them alive
 			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(Callsign, Ip, EProtocol::m17, it)) != nullptr )
+			for ( auto &client : clients->FindClients(Callsign, Ip, EProtocol::m17) )
 			{
 				client->Alive();
 			}
@@ -150,27 +147,18 @@ void CM17Protocol::Task(void)
 		else
 		{
 			// invalid packet
+			m_ParseFailures->Add();
 			std::string title("Unknown M17 packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
+	// frames whose time has come
+	HandlePacer();
 
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > M17_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -204,7 +192,7 @@ void CM17Protocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -221,11 +209,10 @@ void CM17Protocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 
 void CM17Protocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto module = packet->GetPacketModule();
 
@@ -247,24 +234,24 @@ void CM17Protocol::HandleQueue(void)
 				EncodeM17Packet(frame, m_StreamsCache[module].m_dvHeader, (CDvFramePacket *)packet.get(), m_StreamsCache[module].m_iSeqCounter);
 
 				// push it to all our clients linked to the module and who are not streaming in
-				CClients *clients = g_Reflector.GetClients();
-				auto it = clients->begin();
-				std::shared_ptr<CClient>client = nullptr;
-				while ( (client = clients->FindNextClient(EProtocol::m17, it)) != nullptr )
+				std::vector<SM17Frame> frames;
+				std::vector<CIp> ips;
+				for ( auto &client : GetSubscribers(EProtocol::m17, module) )
 				{
 					// is this client busy ?
-					if ( !client->IsAMaster() && (client->GetReflectorModule() == module) )
+					if ( !client->IsAMaster() )
 					{
 						// set the destination
 						client->GetCallsign().CodeOut(frame.lich.addr_dst);
 						// set the crc
 						frame.crc = htons(m17crc.CalcCRC(frame.magic, sizeof(SM17Frame)-2));
-						// now send the packet
-						Send(frame, client->GetIp());
-
+						// now add it to the batch
+						frames.push_back(frame);
+						ips.push_back(client->GetIp());
 					}
 				}
-				g_Reflector.ReleaseClients();
+				Send(frames, ips);
+				TraceSent(*packet);
 			}
 			m_StreamsCache[module].m_iSeqCounter++;
 		}
@@ -274,7 +261,7 @@ void CM17Protocol::HandleQueue(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CM17Protocol::HandleKeepalives(void)
+void CM17Protocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// M17 protocol sends and monitors keepalives packets
 	// event if the client is currently streaming
@@ -282,34 +269,25 @@ void CM17Protocol::HandleKeepalives(void)
 	CBuffer keepalive;
 	EncodeKeepAlivePacket(keepalive);
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::m17, it)) != nullptr )
-	{
-		// send keepalive
-		Send(keepalive, client->GetIp());
-
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, disconnect
-			Send("DISC", client->GetIp());
+	// send keepalive
+	Send(keepalive, client->GetIp());
 
-			// remove it
-			std::cout << "M17 client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
+	// is this client busy ?
+	if ( client->IsAMaster() )
+	{
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, disconnect
+		Send("DISC", client->GetIp());
 
+		// remove it
+		std::cout << "M17 client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -54,7 +54,7 @@ protected:
 	void HandleQueue(void);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -70,9 +70,6 @@ protected:
 	void EncodeM17Packet(SM17Frame &, const CDvHeaderPacket &, const CDvFramePacket *, uint32_t) const;
 
 protected:
-	// for keep alive
-	CTimer m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CM17StreamCacheItem> m_StreamsCache;
 
@@ -19,6 +19,10 @@
 #include <sys/stat.h>
 
 #include "Global.h"
+#ifdef REPLAY
+#include <getopt.h>
+#include "Replay.h"
+#endif
 
 #ifndef UTILITY
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +39,7 @@ CLookupYsf  g_LYtr;
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
+#ifndef REPLAY
 int main(int argc, char *argv[])
 {
 	if (argc != 2)
@@ -78,6 +83,83 @@ int main(int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+#else  // REPLAY is defined
+
+static void usage(std::ostream &os, const char *name)
+{
+	os << "\nUsage: " << name << " [-s SPEED] [-o FILE] CAPTURE INIFILE\n"
+		"Run the reflector on the datagrams in CAPTURE, recorded by urfd with [Files] CapturePath.\n"
+		"INIFILE   : a urfd ini file, without a CapturePath. It should be like the one the capture\n"
+		"            was made with, the replies go to 127.0.0.1:9 or [::1]:9 instead of the clients.\n"
+		"Options\n"
+		"    -s SPEED : a multiple of real time, 1 is real time, 0 (the default) is as fast as it goes\n"
+		"    -o FILE  : write the json results to FILE instead of stdout\n\n";
+}
+
+int main(int argc, char *argv[])
+{
+	double speed = 0.0;
+	std::string outfile;
+	int opt;
+	while (-1 != (opt = getopt(argc, argv, "s:o:h")))
+	{
+		switch (opt)
+		{
+		case 's': speed = std::stod(optarg); break;
+		case 'o': outfile.assign(optarg);    break;
+		default:
+			usage(std::cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind + 2 != argc || speed < 0.0)
+	{
+		usage(std::cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// the reflector talks on stdout, the results get it to themselves
+	auto rdbuf = std::cout.rdbuf(std::cerr.rdbuf());
+
+	if (g_Configure.ReadData(argv[optind + 1]))
+		return EXIT_FAILURE;
+	if (g_Configure.IsString(g_Keys.files.capture))
+	{
+		std::cerr << "ERROR: take the CapturePath out of " << argv[optind + 1] << " for a replay" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// nothing goes back to the captured clients
+	CUdpSocket::SetSink(CIp(AF_INET, 9, "127.0.0.1"));
+	CUdpSocket::SetSink(CIp(AF_INET6, 9, "::1"));
+
+	if (g_Reflector.Start())
+	{
+		std::cerr << "Error starting reflector" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	CReplay replay;
+	const bool failed = replay.Run(argv[optind], speed);
+	g_Reflector.Stop();
+	if (failed)
+		return EXIT_FAILURE;
+
+	nlohmann::json report;
+	replay.JsonReport(report);
+	std::cout.rdbuf(rdbuf);
+	if (outfile.empty())
+		std::cout << report.dump(4) << std::endl;
+	else
+	{
+		std::ofstream ofs(outfile);
+		ofs << report.dump(4) << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
+#endif // REPLAY
+
 #else  // UTILITY is defined
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,349 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <map>
+#include <mutex>
+#include <cmath>
+#include <sstream>
+
+#include "Metrics.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// counter
+
+CMetricCounter::CMetricCounter()
+{
+	for (auto &shard : m_Shards)
+		shard.value.store(0, std::memory_order_relaxed);
+}
+
+// each thread gets a shard the first time it counts something
+unsigned CMetricCounter::Shard(void)
+{
+	static std::atomic<unsigned> next(0);
+	static thread_local unsigned shard = next.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+	return shard;
+}
+
+uint64_t CMetricCounter::Value(void) const
+{
+	uint64_t sum = 0;
+	for (const auto &shard : m_Shards)
+		sum += shard.value.load(std::memory_order_relaxed);
+	return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// histogram
+
+CMetricHistogram::CMetricHistogram(const std::vector<double> &bounds) : m_Bounds(bounds), m_Counts(new std::atomic<uint64_t>[bounds.size() + 1]), m_SumNs(0)
+{
+	for (size_t i=0; i<=m_Bounds.size(); i++)
+		m_Counts[i].store(0, std::memory_order_relaxed);
+}
+
+void CMetricHistogram::Observe(double v)
+{
+	size_t i = 0;
+	while (i < m_Bounds.size() && v > m_Bounds[i])
+		i++;
+	m_Counts[i].fetch_add(1, std::memory_order_relaxed);
+	if (v > 0.0)
+		m_SumNs.fetch_add(uint64_t(v * 1.0e9), std::memory_order_relaxed);
+}
+
+void CMetricHistogram::GetCounts(std::vector<uint64_t> &counts, double &sum) const
+{
+	counts.resize(m_Bounds.size() + 1);
+	for (size_t i=0; i<counts.size(); i++)
+		counts[i] = m_Counts[i].load(std::memory_order_relaxed);
+	sum = 1.0e-9 * m_SumNs.load(std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// registry
+
+namespace
+{
+	enum class EMetricType { counter, gauge, histogram };
+
+	struct SSeries
+	{
+		std::string       labels;
+		CMetricCounter   *counter = nullptr;
+		CMetricGauge     *gauge = nullptr;
+		CMetricHistogram *histogram = nullptr;
+		const void       *owner = nullptr;
+		std::function<double(void)> fn;
+	};
+
+	struct SFamily
+	{
+		std::string help;
+		EMetricType type;
+		std::vector<SSeries> series;
+	};
+}
+
+// the registry, and a second lock that Write() holds while it calls the functions,
+// so those can take other locks, even ones held by somebody registering a metric
+static std::mutex s_Mutex;
+static std::mutex s_ScrapeMutex;
+// it's never destroyed, a global owner still calls Remove() from its destructor at exit
+static std::map<std::string, SFamily> &s_Families = *new std::map<std::string, SFamily>;
+
+static SSeries &FindSeries(const std::string &name, const std::string &help, EMetricType type, const std::string &labels)
+{
+	auto &family = s_Families[name];
+	if (family.series.empty())
+	{
+		family.help = help;
+		family.type = type;
+	}
+	for (auto &series : family.series)
+	{
+		if (series.labels == labels && nullptr == series.owner)
+			return series;
+	}
+	family.series.emplace_back();
+	family.series.back().labels = labels;
+	return family.series.back();
+}
+
+CMetricCounter *CMetrics::Counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto &series = FindSeries(name, help, EMetricType::counter, labels);
+	if (nullptr == series.counter)
+		series.counter = new CMetricCounter;
+	return series.counter;
+}
+
+CMetricGauge *CMetrics::Gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto &series = FindSeries(name, help, EMetricType::gauge, labels);
+	if (nullptr == series.gauge)
+		series.gauge = new CMetricGauge;
+	return series.gauge;
+}
+
+CMetricHistogram *CMetrics::Histogram(const std::string &name, const std::string &help, const std::string &labels, const std::vector<double> &bounds)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto &series = FindSeries(name, help, EMetricType::histogram, labels);
+	if (nullptr == series.histogram)
+		series.histogram = new CMetricHistogram(bounds);
+	return series.histogram;
+}
+
+void CMetrics::CounterFn(const std::string &name, const std::string &help, const std::string &labels, const void *owner, std::function<double(void)> fn)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto &family = s_Families[name];
+	if (family.series.empty())
+	{
+		family.help = help;
+		family.type = EMetricType::counter;
+	}
+	family.series.emplace_back();
+	family.series.back().labels = labels;
+	family.series.back().owner = owner;
+	family.series.back().fn = std::move(fn);
+}
+
+void CMetrics::GaugeFn(const std::string &name, const std::string &help, const std::string &labels, const void *owner, std::function<double(void)> fn)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto &family = s_Families[name];
+	if (family.series.empty())
+	{
+		family.help = help;
+		family.type = EMetricType::gauge;
+	}
+	family.series.emplace_back();
+	family.series.back().labels = labels;
+	family.series.back().owner = owner;
+	family.series.back().fn = std::move(fn);
+}
+
+void CMetrics::Remove(const void *owner)
+{
+	std::lock_guard<std::mutex> scrape(s_ScrapeMutex);
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	for (auto &item : s_Families)
+	{
+		auto &series = item.second.series;
+		for (auto it=series.begin(); it!=series.end(); )
+		{
+			if (owner == it->owner)
+				it = series.erase(it);
+			else
+				it++;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// exposition
+
+static void WriteValue(std::ostream &os, double v)
+{
+	if (std::isnan(v))
+		os << "NaN";
+	else if (v == std::floor(v) && std::fabs(v) < 9.0e15)
+		os << int64_t(v);
+	else
+		os << v;
+}
+
+static void WriteSample(std::ostream &os, const std::string &name, const std::string &labels, const std::string &extra)
+{
+	os << name;
+	if (! labels.empty() || ! extra.empty())
+	{
+		os << '{' << labels;
+		if (! labels.empty() && ! extra.empty())
+			os << ',';
+		os << extra << '}';
+	}
+	os << ' ';
+}
+
+void CMetrics::Write(std::ostream &os)
+{
+	static const char *types[] = { "counter", "gauge", "histogram" };
+
+	std::lock_guard<std::mutex> scrape(s_ScrapeMutex);
+	std::map<std::string, SFamily> families;
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		families = s_Families;
+	}
+
+	os.precision(9);
+	for (const auto &item : families)
+	{
+		const auto &name = item.first;
+		const auto &family = item.second;
+		if (family.series.empty())
+			continue;
+
+		os << "# HELP " << name << ' ' << family.help << '\n';
+		os << "# TYPE " << name << ' ' << types[int(family.type)] << '\n';
+		for (const auto &series : family.series)
+		{
+			if (series.histogram)
+			{
+				std::vector<uint64_t> counts;
+				double sum;
+				series.histogram->GetCounts(counts, sum);
+				const auto &bounds = series.histogram->GetBounds();
+				uint64_t total = 0;
+				for (size_t i=0; i<counts.size(); i++)
+				{
+					total += counts[i];
+					std::ostringstream le;
+					le.precision(9);
+					le << "le=\"";
+					if (i < bounds.size())
+						le << bounds[i];
+					else
+						le << "+Inf";
+					le << '"';
+					WriteSample(os, name + "_bucket", series.labels, le.str());
+					os << total << '\n';
+				}
+				WriteSample(os, name + "_sum", series.labels, "");
+				WriteValue(os, sum);
+				os << '\n';
+				WriteSample(os, name + "_count", series.labels, "");
+				os << total << '\n';
+				continue;
+			}
+
+			WriteSample(os, name, series.labels, "");
+			if (series.counter)
+				os << series.counter->Value();
+			else if (series.gauge)
+				os << series.gauge->Value();
+			else if (series.fn)
+				WriteValue(os, series.fn());
+			os << '\n';
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+
+std::string CMetrics::Labels(std::initializer_list<std::pair<const char *, std::string>> labels)
+{
+	std::string s;
+	for (const auto &label : labels)
+	{
+		if (! s.empty())
+			s.push_back(',');
+		s.append(label.first);
+		s.append("=\"");
+		for (auto c : label.second)
+		{
+			if ('\\' == c || '"' == c)
+				s.push_back('\\');
+			if ('\n' == c)
+				s.append("\\n");
+			else
+				s.push_back(c);
+		}
+		s.push_back('"');
+	}
+	return s;
+}
+
+const char *CMetrics::ProtocolLabel(EProtocol p)
+{
+	switch (p)
+	{
+		case EProtocol::dextra:
+			return "dextra";
+		case EProtocol::dplus:
+			return "dplus";
+		case EProtocol::dcs:
+			return "dcs";
+		case EProtocol::g3:
+			return "g3";
+		case EProtocol::bm:
+			return "bm";
+		case EProtocol::urf:
+			return "urf";
+		case EProtocol::dmrplus:
+			return "dmrplus";
+		case EProtocol::dmrmmdvm:
+			return "mmdvm";
+		case EProtocol::nxdn:
+			return "nxdn";
+		case EProtocol::p25:
+			return "p25";
+		case EProtocol::usrp:
+			return "usrp";
+		case EProtocol::ysf:
+			return "ysf";
+		case EProtocol::m17:
+			return "m17";
+		default:
+			return "none";
+	}
+}
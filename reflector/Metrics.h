@@ -0,0 +1,120 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <ostream>
+
+#include "Defines.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define METRIC_SHARDS       16      // cache lines a counter is spread over
+
+////////////////////////////////////////////////////////////////////////////////////////
+// metrics
+
+// A counter that the threads bump on their own cache line, summed when it's read.
+class CMetricCounter
+{
+public:
+	CMetricCounter();
+
+	void     Add(uint64_t n = 1)            { m_Shards[Shard()].value.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t Value(void) const;
+
+protected:
+	static unsigned Shard(void);
+
+	struct alignas(64) SShard
+	{
+		std::atomic<uint64_t> value;
+	};
+	SShard m_Shards[METRIC_SHARDS];
+};
+
+class CMetricGauge
+{
+public:
+	CMetricGauge() : m_Value(0) {}
+
+	void    Set(int64_t v)                  { m_Value.store(v, std::memory_order_relaxed); }
+	void    Add(int64_t n)                  { m_Value.fetch_add(n, std::memory_order_relaxed); }
+	int64_t Value(void) const               { return m_Value.load(std::memory_order_relaxed); }
+
+protected:
+	std::atomic<int64_t> m_Value;
+};
+
+// Fixed buckets, each one counted on its own. Observations are in seconds,
+// and the sum is kept in nanoseconds, so none of it needs a lock.
+class CMetricHistogram
+{
+public:
+	CMetricHistogram(const std::vector<double> &bounds);
+
+	void Observe(double v);
+
+	// for the exposition, the counts are per bucket, not cumulative, and the last one is +Inf
+	const std::vector<double> &GetBounds(void) const { return m_Bounds; }
+	void GetCounts(std::vector<uint64_t> &counts, double &sum) const;
+
+protected:
+	const std::vector<double> m_Bounds;
+	std::unique_ptr<std::atomic<uint64_t>[]> m_Counts;
+	std::atomic<uint64_t> m_SumNs;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// registry
+
+// Every metric is a series of a named family, with its labels already formatted
+// by Labels(). The counters, gauges and histograms are created here and live until
+// the program exits, so the hot paths keep a plain pointer to them. Values that
+// are already kept elsewhere are read when they are scraped, by a function that
+// belongs to an owner, and the owner has to Remove() them before it goes away.
+// Write() is the Prometheus text format.
+
+class CMetrics
+{
+public:
+	// it's the same series if name and labels match
+	static CMetricCounter   *Counter(const std::string &name, const std::string &help, const std::string &labels = "");
+	static CMetricGauge     *Gauge(const std::string &name, const std::string &help, const std::string &labels = "");
+	static CMetricHistogram *Histogram(const std::string &name, const std::string &help, const std::string &labels, const std::vector<double> &bounds);
+
+	// read at scrape time
+	static void CounterFn(const std::string &name, const std::string &help, const std::string &labels, const void *owner, std::function<double(void)> fn);
+	static void GaugeFn(const std::string &name, const std::string &help, const std::string &labels, const void *owner, std::function<double(void)> fn);
+	// drop every function of an owner, once this returns none of them is running
+	static void Remove(const void *owner);
+
+	// exposition
+	static void Write(std::ostream &os);
+
+	// helpers
+	static std::string Labels(std::initializer_list<std::pair<const char *, std::string>> labels);
+	static const char *ProtocolLabel(EProtocol p);
+};
@@ -56,13 +56,14 @@ bool CNXDNProtocol::Initialize(const char *type, const EProtocol ptype, const ui
 	m_ReflectorId = g_Configure.GetUnsigned(g_Keys.nxdn.reflectorid);
 	m_AutolinkModule = g_Configure.GetAutolinkModule(g_Keys.nxdn.autolinkmod);
 
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = NXDN_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	return true;
 }
 
@@ -166,6 +167,7 @@ void CNXDNProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 #ifdef DEBUG
 			std::string title("Unknown NXDN packet from ");
 			title += Ip.GetAddress();
@@ -174,21 +176,8 @@ void CNXDNProtocol::Task(void)
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > NXDN_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -226,7 +215,7 @@ void CNXDNProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -246,11 +235,10 @@ void CNXDNProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 
 void CNXDNProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto mod = packet->GetPacketModule();
 
@@ -293,20 +281,18 @@ void CNXDNProtocol::HandleQueue(void)
 		if ( buffer.size() > 0 )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::nxdn, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::nxdn, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
-					Send(buffer, client->GetIp());
-
+					// no, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+			Send(buffer, ips);
+			TraceSent(*packet);
 		}
 	}
 }
@@ -314,34 +300,25 @@ void CNXDNProtocol::HandleQueue(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CNXDNProtocol::HandleKeepalives(void)
+void CNXDNProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// YSF protocol keepalive request is client tasks
 	// here, just check that all clients are still alive
 	// and disconnect them if not
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::nxdn, it)) != nullptr )
+	// is this client busy ?
+	if ( client->IsAMaster() )
 	{
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, remove it
-			std::cout << "NXDN client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
-
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, remove it
+		std::cout << "NXDN client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -62,7 +62,7 @@ protected:
 	void HandleQueue(void);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -111,9 +111,6 @@ protected:
 	bool DebugDumpLastDvPacket(const CBuffer &);
 
 protected:
-	// for keep alive
-	CTimer m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CNXDNStreamCacheItem> m_StreamsCache;
 
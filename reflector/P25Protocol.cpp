@@ -55,13 +55,15 @@ bool CP25Protocol::Initialize(const char *type, const EProtocol ptype, const uin
 	m_AutolinkModule = g_Configure.GetAutolinkModule(g_Keys.p25.autolinkmod);
 
 	m_uiStreamId = 0;
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = P25_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// done
 	return true;
 }
@@ -156,27 +158,15 @@ void CP25Protocol::Task(void)
 		else
 		{
 			// invalid packet
+			m_ParseFailures->Add();
 			std::string title("Unknown P25 packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > P25_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -212,7 +202,7 @@ void CP25Protocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -229,11 +219,10 @@ void CP25Protocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 
 void CP25Protocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto module = packet->GetPacketModule();
 
@@ -258,20 +247,18 @@ void CP25Protocol::HandleQueue(void)
 			if ( buffer.size() > 0 )
 			{
 				// and push it to all our clients linked to the module and who are not streaming in
-				CClients *clients = g_Reflector.GetClients();
-				auto it = clients->begin();
-				std::shared_ptr<CClient>client = nullptr;
-				while ( (client = clients->FindNextClient(EProtocol::p25, it)) != nullptr )
+				std::vector<CIp> ips;
+				for ( auto &client : GetSubscribers(EProtocol::p25, module) )
 				{
 					// is this client busy ?
-					if ( !client->IsAMaster() && (client->GetReflectorModule() == module) )
+					if ( !client->IsAMaster() )
 					{
-						// no, send the packet
-						Send(buffer, client->GetIp());
-
+						// no, add it to the destinations
+						ips.push_back(client->GetIp());
 					}
 				}
-				g_Reflector.ReleaseClients();
+				Send(buffer, ips);
+				TraceSent(*packet);
 			}
 		}
 	}
@@ -503,28 +490,19 @@ void CP25Protocol::EncodeP25Packet(const CDvHeaderPacket &Header, const CDvFrame
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CP25Protocol::HandleKeepalives(void)
+void CP25Protocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::p25, it)) != nullptr )
+	// is this client busy ?
+	if ( client->IsAMaster() )
 	{
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, remove it
-			std::cout << "P25 client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
-
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, remove it
+		std::cout << "P25 client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
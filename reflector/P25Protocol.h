@@ -53,7 +53,7 @@ public:
 protected:
 	// queue helper
 	void HandleQueue(void);
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -67,9 +67,6 @@ protected:
 	// packet encoding helpers
 	void EncodeP25Packet(const CDvHeaderPacket &, const CDvFramePacket &, uint32_t, CBuffer &Buffer, bool) const;
 
-	// for keep alive
-	CTimer m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CP25StreamCacheItem> m_StreamsCache;
 	uint32_t m_uiStreamId;
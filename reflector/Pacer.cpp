@@ -0,0 +1,146 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "Pacer.h"
+#include "Clock.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+CPacer::CPacer() : m_Pushed(0), m_Held(0), m_Restarts(0), m_WorstHoldUs(0) {}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// schedule
+
+void CPacer::Push(std::unique_ptr<CPacket> packet, const CIp *ip)
+{
+	const auto now = CClock::Now();
+	const auto period = std::chrono::milliseconds(PACER_PERIOD_MS);
+	const auto jitter = std::chrono::milliseconds(PACER_JITTER_MS);
+	const auto sid = packet->GetStreamId();
+
+	// forget streams that went quiet without a last frame
+	for (auto it=m_NextSlot.begin(); it!=m_NextSlot.end(); )
+	{
+		if (it->second + std::chrono::seconds(1) < now)
+			it = m_NextSlot.erase(it);
+		else
+			it++;
+	}
+
+	// a new stream, or one that's behind, goes now and the cadence starts from here
+	auto due = now;
+	auto slot = m_NextSlot.find(sid);
+	if (slot != m_NextSlot.end() && slot->second + jitter >= now)
+	{
+		if (slot->second > now + std::chrono::milliseconds(PACER_MAX_HOLD_MS))
+		{
+			// the source is running fast, what it has waiting goes first
+			m_Restarts.fetch_add(1, std::memory_order_relaxed);
+			Flush(sid, now);
+		}
+		else
+			due = slot->second;
+	}
+
+	if (packet->IsLastPacket())
+		m_NextSlot.erase(sid);
+	else
+		m_NextSlot[sid] = due + period;
+
+	// statistics
+	m_Pushed.fetch_add(1, std::memory_order_relaxed);
+	if (due > now + jitter)
+	{
+		m_Held.fetch_add(1, std::memory_order_relaxed);
+		const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(due - now).count();
+		if (us > m_WorstHoldUs.load(std::memory_order_relaxed))
+			m_WorstHoldUs.store(us, std::memory_order_relaxed);
+	}
+
+	Schedule(SPaced { due, std::move(packet), ip ? *ip : CIp() });
+}
+
+// frames of other streams can be due later than this one, it goes after any due at the same time
+void CPacer::Schedule(SPaced &&paced)
+{
+	auto pos = m_Paced.end();
+	while (pos != m_Paced.begin() && std::prev(pos)->due > paced.due)
+		pos--;
+	m_Paced.insert(pos, std::move(paced));
+}
+
+// makes the frames of a stream due at when, in the order they were pushed
+void CPacer::Flush(uint16_t sid, std::chrono::steady_clock::time_point when)
+{
+	std::deque<SPaced> held;
+	for (auto it=m_Paced.begin(); it!=m_Paced.end(); )
+	{
+		if (it->packet->GetStreamId() == sid)
+		{
+			held.push_back(std::move(*it));
+			it = m_Paced.erase(it);
+		}
+		else
+			it++;
+	}
+	for (auto &paced : held)
+	{
+		paced.due = when;
+		Schedule(std::move(paced));
+	}
+}
+
+std::unique_ptr<CPacket> CPacer::Pop(CIp *ip)
+{
+	if (m_Paced.empty() || m_Paced.front().due > CClock::Now() + std::chrono::milliseconds(PACER_JITTER_MS))
+		return nullptr;
+
+	auto packet = std::move(m_Paced.front().packet);
+	if (ip)
+		*ip = m_Paced.front().ip;
+	m_Paced.pop_front();
+	return packet;
+}
+
+int CPacer::TimeToNext(int max_ms) const
+{
+	if (m_Paced.empty())
+		return max_ms;
+	const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_Paced.front().due - CClock::Now()).count() + 1 - PACER_JITTER_MS;
+	return (left < 0) ? 0 : ((left < max_ms) ? int(left) : max_ms);
+}
+
+void CPacer::Clear(void)
+{
+	m_Paced.clear();
+	m_NextSlot.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// report
+
+void CPacer::JsonReport(nlohmann::json &report, const std::string &name) const
+{
+	nlohmann::json jpacer;
+	jpacer["Name"] = name;
+	jpacer["Pushed"] = m_Pushed.load(std::memory_order_relaxed);
+	jpacer["Held"] = m_Held.load(std::memory_order_relaxed);
+	jpacer["Restarts"] = m_Restarts.load(std::memory_order_relaxed);
+	jpacer["WorstHoldUs"] = m_WorstHoldUs.load(std::memory_order_relaxed);
+	report["Pacers"].push_back(jpacer);
+}
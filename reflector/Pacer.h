@@ -0,0 +1,86 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+#include "Packet.h"
+#include "IP.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define PACER_PERIOD_MS     20      // a voice frame every 20 ms
+#define PACER_JITTER_MS     2       // this close to its slot, a frame is on time
+#define PACER_MAX_HOLD_MS   100     // a stream running further ahead than this starts over
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// Holds voice frames until their turn, so each stream leaves at a steady 20 ms,
+// no matter how they were bunched up when they arrived. A frame is never held
+// because it's late, a late frame goes right away and the cadence starts over.
+// A stream that gets too far ahead starts over too, after what it has waiting.
+// Nothing in here blocks: the owner's thread Push()es frames, asks TimeToNext()
+// how long it can wait for its sockets, and Pop()s whatever is due.
+// Only the owner's thread touches the frames, the statistics can be read by anyone.
+
+class CPacer
+{
+public:
+	// constructor
+	CPacer();
+
+	// schedule a frame in the next slot of its stream
+	void Push(std::unique_ptr<CPacket> packet, const CIp *ip = nullptr);
+
+	// the next frame that is due, nullptr if none is, and where it came from
+	std::unique_ptr<CPacket> Pop(CIp *ip = nullptr);
+
+	// how long, in ms, until the next frame is due, no longer than max_ms
+	int TimeToNext(int max_ms) const;
+
+	// throw everything away
+	void Clear(void);
+
+	// report
+	uint64_t GetPushed(void) const { return m_Pushed.load(std::memory_order_relaxed); }
+	void JsonReport(nlohmann::json &report, const std::string &name) const;
+
+protected:
+	struct SPaced
+	{
+		std::chrono::steady_clock::time_point due;
+		std::unique_ptr<CPacket> packet;
+		CIp ip;
+	};
+	void Schedule(SPaced &&paced);
+	void Flush(uint16_t sid, std::chrono::steady_clock::time_point when);
+
+	// data
+	std::deque<SPaced> m_Paced;     // in due order
+	std::unordered_map<uint16_t, std::chrono::steady_clock::time_point> m_NextSlot;  // by stream id
+
+	// statistics
+	std::atomic<uint64_t> m_Pushed, m_Held, m_Restarts, m_WorstHoldUs;
+};
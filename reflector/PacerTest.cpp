@@ -0,0 +1,147 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// urfpacer -- checks that the pacer lets frames out in the order of their stream.
+//
+// The frames are pushed the way the sources send them, steadily or in bursts,
+// and the clock is moved forward with CClock::Skip() instead of waiting, so the
+// whole test takes no time. Each case prints what came out, and the exit code
+// is the number of cases that failed.
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "Pacer.h"
+#include "Clock.h"
+#include "Configure.h"
+#include "JsonKeys.h"
+#include "LookupDmr.h"
+#include "LookupNxdn.h"
+#include "LookupYsf.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// global objects, CPacket's M17 constructor brings in CCallsign and the lookups
+
+SJsonKeys   g_Keys;
+CConfigure  g_Configure;
+CLookupDmr  g_LDid;
+CLookupNxdn g_LNid;
+CLookupYsf  g_LYtr;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// a frame that only knows its stream and its place in it
+
+class CTestFrame : public CPacket
+{
+public:
+	CTestFrame(uint16_t sid, uint8_t pid, bool last) : CPacket(sid, pid, last) {}
+
+	std::unique_ptr<CPacket> Copy(void) { return std::unique_ptr<CPacket>(new CTestFrame(*this)); }
+	bool IsDvHeader(void) const         { return false; }
+	bool IsDvFrame(void) const          { return true; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the cases
+
+// a stream, how many frames it sends, and how many of them at once
+struct SSource
+{
+	uint16_t sid;
+	unsigned frames, burst;
+};
+
+// runs the sources side by side, a burst every burst*20 ms, returns the frame ids in the order they came out, by stream
+static std::map<uint16_t, std::vector<unsigned>> Run(const std::vector<SSource> &sources)
+{
+	CPacer pacer;
+	std::map<uint16_t, std::vector<unsigned>> out;
+	auto drain = [&]()
+	{
+		auto packet = pacer.Pop();
+		while (packet)
+		{
+			out[packet->GetStreamId()].push_back(packet->GetNXDNPacketId());
+			packet = pacer.Pop();
+		}
+	};
+
+	std::map<uint16_t, unsigned> sent;
+	for (unsigned tick=0; ; tick++)
+	{
+		bool more = false;
+		for (const auto &source : sources)
+		{
+			auto &n = sent[source.sid];
+			if (0 == tick % source.burst)
+			{
+				for (unsigned i=0; i<source.burst && n<source.frames; i++, n++)
+					pacer.Push(std::unique_ptr<CPacket>(new CTestFrame(source.sid, uint8_t(n), n+1 == source.frames)));
+			}
+			more = more || n < source.frames;
+		}
+		drain();
+		if (! more)
+			break;
+		CClock::Skip(PACER_PERIOD_MS * 1000000ull);
+	}
+
+	// and what's still held
+	for (unsigned i=0; i<100 && pacer.TimeToNext(100) < 100; i++)
+	{
+		CClock::Skip(PACER_PERIOD_MS * 1000000ull);
+		drain();
+	}
+	return out;
+}
+
+// returns true on failure
+static bool Check(const char *name, const std::vector<SSource> &sources)
+{
+	const auto out = Run(sources);
+
+	bool failed = false;
+	for (const auto &source : sources)
+	{
+		const auto it = out.find(source.sid);
+		const auto &ids = (it == out.end()) ? std::vector<unsigned>() : it->second;
+		std::cout << name << " stream " << source.sid << ":";
+		for (const auto id : ids)
+			std::cout << ' ' << id;
+		bool ok = (ids.size() == source.frames);
+		for (unsigned i=0; ok && i<ids.size(); i++)
+			ok = (ids[i] == i);
+		std::cout << (ok ? "  ok" : "  FAILED") << std::endl;
+		failed = failed || ! ok;
+	}
+	return failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// main
+
+int main()
+{
+	int failed = 0;
+	failed += Check("steady", { { 1, 30, 1 } });
+	failed += Check("burst", { { 1, 10, 10 } });
+	failed += Check("bursts", { { 1, 40, 8 } });
+	failed += Check("two bursts", { { 1, 10, 10 }, { 2, 10, 10 } });
+	failed += Check("mixed", { { 1, 30, 1 }, { 2, 30, 7 }, { 3, 25, 25 } });
+	std::cout << (failed ? "FAILED" : "passed") << std::endl;
+	return failed;
+}
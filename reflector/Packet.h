@@ -26,6 +26,12 @@
 
 enum class EOrigin : std::uint8_t { local=0, peer=1 };
 
+// when a frame got to each stage, in CLatency::Now() ns, 0 if it didn't
+struct SPacketTrace
+{
+	uint64_t rx, push, route, tcsent, tcback;
+};
+
 class CPacket
 {
 public:
@@ -40,6 +46,9 @@ public:
 	CPacket(uint16_t sid, uint8_t dstarpid, uint8_t dmrpid, uint8_t dmrsubpid, uint8_t ysfpid, uint8_t ysfsubpid, uint8_t ysfsubpidmax, ECodecType, bool lastpacket);
 	CPacket(const CM17Packet &);
 
+	// destructor, packets are deleted through a CPacket pointer
+	virtual ~CPacket() {}
+
 	// identity
 	virtual std::unique_ptr<CPacket> Copy(void) = 0;
 	virtual bool IsDvHeader(void) const = 0;
@@ -61,6 +70,8 @@ public:
 	char         GetPacketModule(void) const     { return m_cModule; }
 	bool         IsLocalOrigin(void) const       { return (m_eOrigin == EOrigin::local); }
 	ECodecType   GetCodecIn(void) const          { return m_eCodecIn; }
+	const SPacketTrace &GetTrace(void) const     { return m_Trace; }
+	SPacketTrace &Trace(void)                    { return m_Trace; }
 
 	// set
 	void UpdatePids(const uint32_t);
@@ -89,4 +100,6 @@ protected:
 	uint8_t    m_uiYsfPacketSubId;
 	uint8_t    m_uiYsfPacketFrameId;
 	uint8_t    m_uiNXDNPacketId;
+	// not on the network
+	SPacketTrace m_Trace {};
 };
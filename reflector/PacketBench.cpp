@@ -0,0 +1,814 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// urfbench -- micro-benchmarks for the protocols' packet parsers and encoders.
+//
+// Each protocol's DV encoders are run on a synthetic stream, a header and voice
+// frames with every codec filled in, and its parsers on the packets that came out
+// of them, or on the datagrams of that protocol in a capture file made with
+// [Files] CapturePath. Each function is called on its own, without the protocol's
+// thread, sockets or the rest of the reflector, and what it costs is reported for
+// one call: the time, the heap allocations and, where the kernel lets us count
+// them, the instructions. The results are written as json.
+
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "Global.h"
+#include "Capture.h"
+#include "M17CRC.h"
+#include "YSFFich.h"
+#include "BMProtocol.h"
+#include "DCSProtocol.h"
+#include "DExtraProtocol.h"
+#include "DMRMMDVMProtocol.h"
+#include "DMRPlusProtocol.h"
+#include "DPlusProtocol.h"
+#include "G3Protocol.h"
+#include "M17Protocol.h"
+#include "NXDNProtocol.h"
+#include "P25Protocol.h"
+#include "URFProtocol.h"
+#include "USRPProtocol.h"
+#include "YSFProtocol.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// global objects
+
+SJsonKeys   g_Keys;
+CReflector  g_Reflector;
+CGateKeeper g_GateKeeper;
+CConfigure  g_Configure;
+CVersion    g_Version(3,1,0);   // as in Main.cpp
+CLookupDmr  g_LDid;
+CLookupNxdn g_LNid;
+CLookupYsf  g_LYtr;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define BENCH_FRAMES        60          // voice frames in the synthetic stream, a multiple of 3, 4 and 5
+#define BENCH_MIN_MS        100         // each function is timed for at least this long
+#define BENCH_MIN_PASSES    3           // and this many times over its input
+#define BENCH_STREAMID      0x5A5A
+#define BENCH_ADDRESS       "192.0.2.1" // where every packet comes from, a documentation address
+
+////////////////////////////////////////////////////////////////////////////////////////
+// allocations
+
+// every heap allocation of the process, the protocols are only ever called from main()
+static std::atomic<uint64_t> s_Allocations(0), s_AllocatedBytes(0);
+
+void *operator new(size_t size)
+{
+	s_Allocations.fetch_add(1, std::memory_order_relaxed);
+	s_AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void *p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// instructions
+
+// the retired user space instructions of this thread, if there's a hardware counter
+// and perf_event_paranoid lets us have it
+class CInstructions
+{
+public:
+	CInstructions() : m_Fd(-1)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		m_Fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+		if (m_Fd < 0)
+			std::cerr << "The instruction counter isn't available (" << strerror(errno) << "), there will be no instructions per frame" << std::endl;
+	}
+	~CInstructions()
+	{
+		if (m_Fd >= 0)
+			close(m_Fd);
+	}
+	bool IsOpen(void) const { return m_Fd >= 0; }
+	void Start(void)
+	{
+		if (m_Fd < 0)
+			return;
+		ioctl(m_Fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(m_Fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	uint64_t Stop(void)
+	{
+		uint64_t count = 0;
+		if (m_Fd < 0)
+			return 0;
+		ioctl(m_Fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (sizeof(count) != read(m_Fd, &count, sizeof(count)))
+			return 0;
+		return count;
+	}
+
+private:
+	int m_Fd;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the protocols, with what's to be measured made public
+
+// a protocol as it is after Initialize(), without its sockets and thread
+template <class T> class CBench : public T
+{
+public:
+	CBench()
+	{
+		this->m_ReflectorCallsign = CCallsign("URF000");
+	}
+
+	// the frame parsers of some protocols only take a stream that's open
+	void OpenStream(uint16_t sid, const CIp &ip, const CDvHeaderPacket &header)
+	{
+		auto stream = std::make_shared<CPacketStream>('A');
+		stream->OpenPacketStream(header, std::make_shared<CClient>(header.GetMyCallsign(), ip, 'A'));
+		this->m_Streams[sid] = stream;
+	}
+	void CloseStreams(void) { this->m_Streams.clear(); }
+};
+
+class CBenchDextra : public CBench<CDextraProtocol>
+{
+public:
+	using CDextraProtocol::IsValidDvHeaderPacket;
+	using CDextraProtocol::IsValidDvFramePacket;
+	using CDextraProtocol::EncodeDvHeaderPacket;
+	using CDextraProtocol::EncodeDvFramePacket;
+};
+
+class CBenchDplus : public CBench<CDplusProtocol>
+{
+public:
+	using CDplusProtocol::IsValidDvHeaderPacket;
+	using CDplusProtocol::IsValidDvFramePacket;
+	using CDplusProtocol::EncodeDvHeaderPacket;
+	using CDplusProtocol::EncodeDvFramePacket;
+};
+
+class CBenchG3 : public CBench<CG3Protocol>
+{
+public:
+	using CG3Protocol::IsValidDvHeaderPacket;
+	using CG3Protocol::IsValidDvFramePacket;
+	using CG3Protocol::EncodeDvHeaderPacket;
+	using CG3Protocol::EncodeDvFramePacket;
+};
+
+class CBenchBM : public CBench<CBMProtocol>
+{
+public:
+	using CBMProtocol::IsValidDvHeaderPacket;
+	using CBMProtocol::IsValidDvFramePacket;
+	using CBMProtocol::EncodeDvHeaderPacket;
+	using CBMProtocol::EncodeDvFramePacket;
+};
+
+class CBenchURF : public CBench<CURFProtocol>
+{
+public:
+	using CURFProtocol::IsValidDvHeaderPacket;
+	using CURFProtocol::IsValidDvFramePacket;
+	using CURFProtocol::EncodeDvHeaderPacket;
+	using CURFProtocol::EncodeDvFramePacket;
+};
+
+class CBenchDcs : public CBench<CDcsProtocol>
+{
+public:
+	using CDcsProtocol::IsValidDvPacket;
+	using CDcsProtocol::EncodeDCSPacket;
+};
+
+class CBenchM17 : public CBench<CM17Protocol>
+{
+public:
+	using CM17Protocol::IsValidDvPacket;
+	using CM17Protocol::EncodeM17Packet;
+};
+
+class CBenchMmdvm : public CBench<CDmrmmdvmProtocol>
+{
+public:
+	CBenchMmdvm() { m_DefaultId = 9990001; }
+	using CDmrmmdvmProtocol::IsValidDvHeaderPacket;
+	using CDmrmmdvmProtocol::IsValidDvFramePacket;
+	using CDmrmmdvmProtocol::EncodeMMDVMHeaderPacket;
+	using CDmrmmdvmProtocol::EncodeMMDVMPacket;
+};
+
+class CBenchDmrplus : public CBench<CDmrplusProtocol>
+{
+public:
+	using CDmrplusProtocol::IsValidDvHeaderPacket;
+	using CDmrplusProtocol::IsValidDvFramePacket;
+	using CDmrplusProtocol::EncodeDMRPlusHeaderPacket;
+	using CDmrplusProtocol::EncodeDMRPlusPacket;
+};
+
+class CBenchYsf : public CBench<CYsfProtocol>
+{
+public:
+	using CYsfProtocol::IsValidDvPacket;
+	using CYsfProtocol::IsValidDvHeaderPacket;
+	using CYsfProtocol::IsValidDvFramePacket;
+	using CYsfProtocol::EncodeYSFHeaderPacket;
+	using CYsfProtocol::EncodeYSFPacket;
+	uint16_t StreamId(const CIp &ip) const { return uint16_t(IpToStreamId(ip)); }
+};
+
+class CBenchNxdn : public CBench<CNXDNProtocol>
+{
+public:
+	CBenchNxdn() { m_ReflectorId = 1000; }
+	using CNXDNProtocol::IsValidDvHeaderPacket;
+	using CNXDNProtocol::IsValidDvFramePacket;
+	using CNXDNProtocol::EncodeNXDNHeaderPacket;
+	using CNXDNProtocol::EncodeNXDNPacket;
+	void SetStreamId(uint16_t sid) { m_uiStreamId = sid; }
+};
+
+class CBenchP25 : public CBench<CP25Protocol>
+{
+public:
+	CBenchP25() { m_ReflectorId = 1000; m_DefaultId = 9990001; }
+	using CP25Protocol::IsValidDvHeaderPacket;
+	using CP25Protocol::IsValidDvPacket;
+	using CP25Protocol::EncodeP25Packet;
+	void SetStreamId(uint16_t sid) { m_uiStreamId = sid; }
+};
+
+class CBenchUsrp : public CBench<CUSRPProtocol>
+{
+public:
+	using CUSRPProtocol::IsValidDvHeaderPacket;
+	using CUSRPProtocol::IsValidDvPacket;
+	using CUSRPProtocol::EncodeUSRPHeaderPacket;
+	using CUSRPProtocol::EncodeUSRPPacket;
+	void SetStreamId(uint16_t sid) { m_uiStreamId = sid; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the id lookups
+
+// the callsigns the bench uses, with their DMR and NXDN ids
+static const struct { const char *cs; uint32_t dmrid; uint16_t nxdnid; } s_Calls[] = {
+	{ "N0CALL",  3100001, 1001 },
+	{ "W1AW",    3100002, 1002 },
+	{ "G4KLX",   2340001, 1003 },
+	{ "N7TAE",   3106543, 1004 },
+	{ "DL1ABC",  2620001, 1005 },
+	{ "VK2XYZ",  5050001, 1006 },
+	{ "JA1RL",   4400001, 1007 },
+	{ "M0ABC",   2350001, 1008 }
+};
+
+// the lookups are filled in as they'd be from their files, without the files
+class CBenchLookupDmr : public CLookupDmr
+{
+public:
+	static void Load(std::stringstream &ss) { (g_LDid.*(&CBenchLookupDmr::UpdateContent))(ss, Eaction::normal); }
+};
+
+class CBenchLookupNxdn : public CLookupNxdn
+{
+public:
+	static void Load(std::stringstream &ss) { (g_LNid.*(&CBenchLookupNxdn::UpdateContent))(ss, Eaction::normal); }
+};
+
+static void LoadLookups(void)
+{
+	std::stringstream dmr, nxdn;
+	for (const auto &c : s_Calls)
+	{
+		dmr << c.dmrid << ';' << c.cs << ";\n";
+		nxdn << c.nxdnid << ',' << c.cs << ",\n";
+	}
+	CBenchLookupDmr::Load(dmr);
+	CBenchLookupNxdn::Load(nxdn);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the benchmark
+
+struct SBenchOptions
+{
+	SBenchOptions() : ms(BENCH_MIN_MS) {}
+
+	unsigned ms;
+	std::vector<std::string> only;
+	std::string capture, outfile;
+};
+
+// one function, called on input i for i < count
+struct SBenchCase
+{
+	std::string name;
+	unsigned frames;                            // voice frames in one call
+	size_t count;
+	std::function<void(void)> setup;            // the protocol state it needs, or nullptr
+	std::function<bool(size_t)> call;           // false if it didn't take its input
+};
+
+class CPacketBench
+{
+public:
+	CPacketBench();
+
+	// true on failure
+	bool Configure(const SBenchOptions &opt);
+	void Run(nlohmann::json &results);
+	void List(std::ostream &os) const;
+
+protected:
+	void MakeStream(void);
+	void AddEncoders(void);
+	void AddParsers(void);
+	void AddCallsigns(void);
+	void AddEncoder(const std::string &name, EProtocol protocol, unsigned frames, size_t count, std::function<void(size_t, CBuffer &)> encode);
+	void AddParser(const std::string &name, EProtocol protocol, std::function<void(void)> setup, std::function<bool(const CBuffer &)> parse);
+	bool Selected(const std::string &name) const;
+	void Measure(const SBenchCase &c, nlohmann::json &result);
+	static uint64_t Now(void);
+
+	// data
+	SBenchOptions m_Options;
+	CIp m_Ip;
+	std::unique_ptr<CDvHeaderPacket> m_Header;
+	std::vector<CDvFramePacket> m_Frames;
+	std::vector<SBenchCase> m_Cases;
+	std::map<EProtocol, std::vector<CBuffer>> m_Packets;    // what the parsers are given
+	std::set<EProtocol> m_Captured;
+	CInstructions m_Instructions;
+
+	CBenchDextra m_Dextra;
+	CBenchDplus m_Dplus;
+	CBenchG3 m_G3;
+	CBenchBM m_BM;
+	CBenchURF m_URF;
+	CBenchDcs m_Dcs;
+	CBenchM17 m_M17;
+	CBenchMmdvm m_Mmdvm;
+	CBenchDmrplus m_Dmrplus;
+	CBenchYsf m_Ysf;
+	CBenchNxdn m_Nxdn;
+	CBenchP25 m_P25;
+	CBenchUsrp m_Usrp;
+};
+
+CPacketBench::CPacketBench() : m_Ip(AF_INET, 42000, BENCH_ADDRESS), m_Dextra(), m_Dplus(), m_G3(), m_BM(), m_URF(), m_Dcs(), m_M17(), m_Mmdvm(), m_Dmrplus(), m_Ysf(), m_Nxdn(), m_P25(), m_Usrp() {}
+
+bool CPacketBench::Configure(const SBenchOptions &opt)
+{
+	m_Options = opt;
+	LoadLookups();
+	MakeStream();
+
+	// the encoders make the packets, unless they're captured
+	if (! m_Options.capture.empty())
+	{
+		CCaptureReader reader;
+		if (reader.Open(m_Options.capture))
+			return true;
+		size_t n = 0;
+		while (auto record = reader.Next())
+		{
+			if (m_Captured.end() == m_Captured.find(record->protocol))
+			{
+				m_Captured.insert(record->protocol);
+				m_Packets[record->protocol].clear();
+			}
+			m_Packets[record->protocol].emplace_back(record->data, record->size);
+			n++;
+		}
+		std::cerr << "Read " << n << " datagrams from " << m_Options.capture << std::endl;
+	}
+
+	AddEncoders();
+	AddParsers();
+	AddCallsigns();
+	return false;
+}
+
+// a header and voice frames, every codec of them filled in
+void CPacketBench::MakeStream(void)
+{
+	std::mt19937 rnd(BENCH_STREAMID);
+	auto byte = [&rnd]() { return uint8_t(rnd() >> 24); };
+
+	const CCallsign my(s_Calls[0].cs), ur("CQCQCQ"), rpt1("N0CALL B"), rpt2("URF000 A");
+	m_Header = std::unique_ptr<CDvHeaderPacket>(new CDvHeaderPacket(my, ur, rpt1, rpt2, BENCH_STREAMID, uint8_t(0x80)));
+
+	STCPacket tc {};
+	tc.codec_in = ECodecType::dstar;
+	m_Frames.reserve(BENCH_FRAMES);
+	for (unsigned i=0; i<BENCH_FRAMES; i++)
+	{
+		SDStarFrame dstar;
+		for (auto &b : dstar.AMBE)   b = byte();
+		for (auto &b : dstar.DVDATA) b = byte();
+		memcpy(tc.dstar, dstar.AMBE, 9);
+		for (auto &b : tc.dmr) b = byte();
+		for (auto &b : tc.m17) b = byte();
+		for (auto &b : tc.p25) b = byte();
+		for (auto &s : tc.usrp) s = int16_t(rnd());
+		tc.sequence = i;
+		m_Frames.emplace_back(&dstar, BENCH_STREAMID, uint8_t(i % 21));
+		m_Frames.back().SetCodecData(&tc);
+	}
+}
+
+void CPacketBench::AddEncoder(const std::string &name, EProtocol protocol, unsigned frames, size_t count, std::function<void(size_t, CBuffer &)> encode)
+{
+	// what it makes is what the parsers get
+	if (m_Captured.end() == m_Captured.find(protocol))
+	{
+		auto &packets = m_Packets[protocol];
+		for (size_t i=0; i<count; i++)
+		{
+			packets.emplace_back();
+			encode(i, packets.back());
+		}
+	}
+
+	if (Selected(name))
+		m_Cases.push_back({ name, frames, count, nullptr, [encode](size_t i) { CBuffer buf; encode(i, buf); return true; } });
+}
+
+void CPacketBench::AddParser(const std::string &name, EProtocol protocol, std::function<void(void)> setup, std::function<bool(const CBuffer &)> parse)
+{
+	if (! Selected(name))
+		return;
+	const auto &packets = m_Packets[protocol];
+	m_Cases.push_back({ name, 1, packets.size(), setup, [&packets, parse](size_t i) { return parse(packets[i]); } });
+}
+
+void CPacketBench::AddEncoders(void)
+{
+	const auto &h = *m_Header;
+	const auto &f = m_Frames;
+	const size_t n = f.size();
+
+	// D-Star and the interlinks, the header and then a frame at a time
+	AddEncoder("dextra.EncodeDvHeaderPacket", EProtocol::dextra, 0, 1, [this, &h](size_t, CBuffer &b) { m_Dextra.EncodeDvHeaderPacket(h, b); });
+	AddEncoder("dextra.EncodeDvFramePacket", EProtocol::dextra, 1, n, [this, &f](size_t i, CBuffer &b) { m_Dextra.EncodeDvFramePacket(f[i], b); });
+	AddEncoder("dplus.EncodeDvHeaderPacket", EProtocol::dplus, 0, 1, [this, &h](size_t, CBuffer &b) { m_Dplus.EncodeDvHeaderPacket(h, b); });
+	AddEncoder("dplus.EncodeDvFramePacket", EProtocol::dplus, 1, n, [this, &f](size_t i, CBuffer &b) { m_Dplus.EncodeDvFramePacket(f[i], b); });
+	AddEncoder("g3.EncodeDvHeaderPacket", EProtocol::g3, 0, 1, [this, &h](size_t, CBuffer &b) { m_G3.EncodeDvHeaderPacket(h, b); });
+	AddEncoder("g3.EncodeDvFramePacket", EProtocol::g3, 1, n, [this, &f](size_t i, CBuffer &b) { m_G3.EncodeDvFramePacket(f[i], b); });
+	AddEncoder("bm.EncodeDvHeaderPacket", EProtocol::bm, 0, 1, [this, &h](size_t, CBuffer &b) { m_BM.EncodeDvHeaderPacket(h, b); });
+	AddEncoder("bm.EncodeDvFramePacket", EProtocol::bm, 1, n, [this, &f](size_t i, CBuffer &b) { m_BM.EncodeDvFramePacket(f[i], b); });
+	AddEncoder("urf.EncodeDvHeaderPacket", EProtocol::urf, 0, 1, [this, &h](size_t, CBuffer &b) { m_URF.EncodeDvHeaderPacket(h, b); });
+	AddEncoder("urf.EncodeDvFramePacket", EProtocol::urf, 1, n, [this, &f](size_t i, CBuffer &b) { m_URF.EncodeDvFramePacket(f[i], b); });
+	AddEncoder("dcs.EncodeDCSPacket", EProtocol::dcs, 1, n, [this, &h, &f](size_t i, CBuffer &b) { m_Dcs.EncodeDCSPacket(h, f[i], uint32_t(i), &b); });
+
+	// M17 sends every other frame, with the two codec halves in it
+	AddEncoder("m17.EncodeM17Packet", EProtocol::m17, 2, n / 2, [this, &h, &f](size_t i, CBuffer &b)
+	{
+		static const CM17CRC crc;
+		SM17Frame frame;
+		m_M17.EncodeM17Packet(frame, h, &f[2 * i + 1], uint32_t(2 * i + 1));
+		h.GetRpt1Callsign().CodeOut(frame.lich.addr_dst);
+		frame.crc = htons(crc.CalcCRC(frame.magic, sizeof(SM17Frame) - 2));
+		b.Set((uint8_t *)&frame, sizeof(frame));
+	});
+
+	// DMR carries 3 frames in a packet, NXDN 4 and YSF 5
+	AddEncoder("mmdvm.EncodeMMDVMHeaderPacket", EProtocol::dmrmmdvm, 0, 1, [this, &h](size_t, CBuffer &b) { m_Mmdvm.EncodeMMDVMHeaderPacket(h, 0, &b); });
+	AddEncoder("mmdvm.EncodeMMDVMPacket", EProtocol::dmrmmdvm, 3, n / 3, [this, &h, &f](size_t i, CBuffer &b) { m_Mmdvm.EncodeMMDVMPacket(h, f[3 * i], f[3 * i + 1], f[3 * i + 2], uint8_t(i + 1), &b); });
+	AddEncoder("dmrplus.EncodeDMRPlusHeaderPacket", EProtocol::dmrplus, 0, 1, [this, &h](size_t, CBuffer &b) { m_Dmrplus.EncodeDMRPlusHeaderPacket(h, &b); });
+	AddEncoder("dmrplus.EncodeDMRPlusPacket", EProtocol::dmrplus, 3, n / 3, [this, &h, &f](size_t i, CBuffer &b) { m_Dmrplus.EncodeDMRPlusPacket(h, f[3 * i], f[3 * i + 1], f[3 * i + 2], uint8_t(i + 1), &b); });
+	AddEncoder("nxdn.EncodeNXDNHeaderPacket", EProtocol::nxdn, 0, 1, [this, &h](size_t, CBuffer &b) { m_Nxdn.EncodeNXDNHeaderPacket(h, b); });
+	AddEncoder("nxdn.EncodeNXDNPacket", EProtocol::nxdn, 4, n / 4, [this, &h, &f](size_t i, CBuffer &b) { m_Nxdn.EncodeNXDNPacket(h, uint32_t(i), &f[4 * i], b); });
+	AddEncoder("ysf.EncodeYSFHeaderPacket", EProtocol::ysf, 0, 1, [this, &h](size_t, CBuffer &b) { m_Ysf.EncodeYSFHeaderPacket(h, &b); });
+	AddEncoder("ysf.EncodeYSFPacket", EProtocol::ysf, 5, n / 5, [this, &h, &f](size_t i, CBuffer &b) { m_Ysf.EncodeYSFPacket(h, &f[5 * i], &b); });
+
+	// P25 and USRP, a frame at a time
+	AddEncoder("p25.EncodeP25Packet", EProtocol::p25, 1, n, [this, &h, &f](size_t i, CBuffer &b) { m_P25.EncodeP25Packet(h, f[i], uint32_t(i), b, false); });
+	AddEncoder("usrp.EncodeUSRPHeaderPacket", EProtocol::usrp, 0, 1, [this, &h](size_t, CBuffer &b) { m_Usrp.EncodeUSRPHeaderPacket(h, 0, b); });
+	AddEncoder("usrp.EncodeUSRPPacket", EProtocol::usrp, 1, n, [this, &h, &f](size_t i, CBuffer &b) { m_Usrp.EncodeUSRPPacket(h, f[i], uint32_t(i + 1), b, false); });
+}
+
+void CPacketBench::AddParsers(void)
+{
+	const CIp &ip = m_Ip;
+
+	AddParser("dextra.IsValidDvHeaderPacket", EProtocol::dextra, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_Dextra.IsValidDvHeaderPacket(b, h); });
+	AddParser("dextra.IsValidDvFramePacket", EProtocol::dextra, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvFramePacket> f; return m_Dextra.IsValidDvFramePacket(b, f); });
+	AddParser("dplus.IsValidDvHeaderPacket", EProtocol::dplus, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_Dplus.IsValidDvHeaderPacket(b, h); });
+	AddParser("dplus.IsValidDvFramePacket", EProtocol::dplus, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvFramePacket> f; return m_Dplus.IsValidDvFramePacket(b, f); });
+	AddParser("g3.IsValidDvHeaderPacket", EProtocol::g3, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_G3.IsValidDvHeaderPacket(b, h); });
+	AddParser("g3.IsValidDvFramePacket", EProtocol::g3, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvFramePacket> f; return m_G3.IsValidDvFramePacket(b, f); });
+	AddParser("bm.IsValidDvHeaderPacket", EProtocol::bm, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_BM.IsValidDvHeaderPacket(b, h); });
+	AddParser("bm.IsValidDvFramePacket", EProtocol::bm, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvFramePacket> f; return m_BM.IsValidDvFramePacket(b, f); });
+	AddParser("urf.IsValidDvHeaderPacket", EProtocol::urf, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_URF.IsValidDvHeaderPacket(b, h); });
+	AddParser("urf.IsValidDvFramePacket", EProtocol::urf, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvFramePacket> f; return m_URF.IsValidDvFramePacket(b, f); });
+	AddParser("dcs.IsValidDvPacket", EProtocol::dcs, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; std::unique_ptr<CDvFramePacket> f; return m_Dcs.IsValidDvPacket(b, h, f); });
+	AddParser("m17.IsValidDvPacket", EProtocol::m17, nullptr, [this](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; std::unique_ptr<CDvFramePacket> f; return m_M17.IsValidDvPacket(b, h, f); });
+
+	AddParser("mmdvm.IsValidDvHeaderPacket", EProtocol::dmrmmdvm, nullptr, [this](const CBuffer &b)
+	{
+		std::unique_ptr<CDvHeaderPacket> h;
+		uint8_t cmd, type;
+		return m_Mmdvm.IsValidDvHeaderPacket(b, h, &cmd, &type);
+	});
+	AddParser("mmdvm.IsValidDvFramePacket", EProtocol::dmrmmdvm, nullptr, [this](const CBuffer &b) { std::array<std::unique_ptr<CDvFramePacket>, 3> f; return m_Mmdvm.IsValidDvFramePacket(b, f); });
+	AddParser("dmrplus.IsValidDvHeaderPacket", EProtocol::dmrplus, nullptr, [this, &ip](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_Dmrplus.IsValidDvHeaderPacket(ip, b, h); });
+	AddParser("dmrplus.IsValidDvFramePacket", EProtocol::dmrplus, nullptr, [this, &ip](const CBuffer &b) { std::array<std::unique_ptr<CDvFramePacket>, 3> f; return m_Dmrplus.IsValidDvFramePacket(ip, b, f); });
+
+	// a YSF packet has its FICH decoded first, then it's one of the others
+	AddParser("ysf.IsValidDvPacket", EProtocol::ysf, nullptr, [this](const CBuffer &b) { CYSFFICH fich; return m_Ysf.IsValidDvPacket(b, &fich); });
+	AddParser("ysf.IsValidDvHeaderPacket", EProtocol::ysf, nullptr, [this, &ip](const CBuffer &b)
+	{
+		CYSFFICH fich;
+		std::unique_ptr<CDvHeaderPacket> h;
+		std::array<std::unique_ptr<CDvFramePacket>, 5> f;
+		return m_Ysf.IsValidDvPacket(b, &fich) && m_Ysf.IsValidDvHeaderPacket(ip, fich, b, h, f);
+	});
+	AddParser("ysf.IsValidDvFramePacket", EProtocol::ysf, [this, &ip]() { m_Ysf.OpenStream(m_Ysf.StreamId(ip), ip, *m_Header); }, [this, &ip](const CBuffer &b)
+	{
+		CYSFFICH fich;
+		std::unique_ptr<CDvHeaderPacket> h;
+		std::array<std::unique_ptr<CDvFramePacket>, 5> f;
+		return m_Ysf.IsValidDvPacket(b, &fich) && m_Ysf.IsValidDvFramePacket(ip, fich, b, h, f);
+	});
+
+	// these take a header only when there's no stream, and frames only when there is
+	AddParser("nxdn.IsValidDvHeaderPacket", EProtocol::nxdn, [this]() { m_Nxdn.CloseStreams(); }, [this, &ip](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_Nxdn.IsValidDvHeaderPacket(ip, b, h); });
+	AddParser("nxdn.IsValidDvFramePacket", EProtocol::nxdn, [this, &ip]() { m_Nxdn.SetStreamId(BENCH_STREAMID); m_Nxdn.OpenStream(BENCH_STREAMID, ip, *m_Header); }, [this, &ip](const CBuffer &b)
+	{
+		std::unique_ptr<CDvHeaderPacket> h;
+		std::array<std::unique_ptr<CDvFramePacket>, 4> f;
+		return m_Nxdn.IsValidDvFramePacket(ip, b, h, f);
+	});
+	AddParser("p25.IsValidDvHeaderPacket", EProtocol::p25, [this]() { m_P25.CloseStreams(); }, [this, &ip](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_P25.IsValidDvHeaderPacket(ip, b, h); });
+	AddParser("p25.IsValidDvPacket", EProtocol::p25, [this, &ip]() { m_P25.SetStreamId(BENCH_STREAMID); m_P25.OpenStream(BENCH_STREAMID, ip, *m_Header); }, [this, &ip](const CBuffer &b) { std::unique_ptr<CDvFramePacket> f; return m_P25.IsValidDvPacket(ip, b, f); });
+	AddParser("usrp.IsValidDvHeaderPacket", EProtocol::usrp, [this]() { m_Usrp.CloseStreams(); }, [this, &ip](const CBuffer &b) { std::unique_ptr<CDvHeaderPacket> h; return m_Usrp.IsValidDvHeaderPacket(ip, b, h); });
+	AddParser("usrp.IsValidDvPacket", EProtocol::usrp, [this, &ip]() { m_Usrp.SetStreamId(BENCH_STREAMID); m_Usrp.OpenStream(BENCH_STREAMID, ip, *m_Header); }, [this, &ip](const CBuffer &b)
+	{
+		std::unique_ptr<CDvHeaderPacket> h;
+		std::unique_ptr<CDvFramePacket> f;
+		return m_Usrp.IsValidDvPacket(ip, b, h, f);
+	});
+
+	// the interlink packets are parsed by their constructors
+	AddParser("CDvHeaderPacket(CBuffer)", EProtocol::urf, nullptr, [](const CBuffer &b) { return b.size() == CDvHeaderPacket::GetNetworkSize() && CDvHeaderPacket(b).IsValid(); });
+	AddParser("CDvFramePacket(CBuffer)", EProtocol::urf, nullptr, [](const CBuffer &b) { return b.size() == CDvFramePacket::GetNetworkSize() && CDvFramePacket(b).IsValid(); });
+}
+
+void CPacketBench::AddCallsigns(void)
+{
+	// some with a module
+	static std::vector<std::string> calls;
+	static std::vector<uint32_t> ids;
+	static std::vector<std::array<uint8_t, 6>> coded;
+	calls.clear();
+	ids.clear();
+	coded.clear();
+	for (const auto &c : s_Calls)
+	{
+		calls.push_back(c.cs);
+		if (calls.size() % 2)
+			calls.back().append(8 - calls.back().size() - 1, ' ').push_back(char('A' + calls.size() % 5));
+		ids.push_back(c.dmrid);
+		coded.emplace_back();
+		CCallsign(c.cs).CodeOut(coded.back().data());
+	}
+	const auto n = calls.size();
+
+	auto add = [this, n](const std::string &name, std::function<bool(size_t)> call)
+	{
+		if (Selected(name))
+			m_Cases.push_back({ name, 0, n, nullptr, call });
+	};
+	add("CCallsign(string)", [](size_t i) { return CCallsign(calls[i]).IsValid(); });
+	add("CCallsign(dmrid)", [](size_t i) { return CCallsign("", ids[i]).IsValid(); });
+	add("CCallsign::SetCallsign", [](size_t i) { CCallsign cs; cs.SetCallsign((const uint8_t *)calls[i].c_str(), int(calls[i].size())); return cs.IsValid(); });
+	add("CCallsign::CodeIn", [](size_t i) { CCallsign cs; cs.CodeIn(coded[i].data()); return cs.IsValid(); });
+	add("CCallsign::CodeOut", [](size_t i) { uint8_t out[6]; CCallsign(calls[i]).CodeOut(out); return true; });
+	add("CCallsign::GetCS", [](size_t i) { return ! CCallsign(calls[i]).GetCS().empty(); });
+}
+
+bool CPacketBench::Selected(const std::string &name) const
+{
+	if (m_Options.only.empty())
+		return true;
+	for (const auto &prefix : m_Options.only)
+	{
+		if (0 == name.compare(0, prefix.size(), prefix))
+			return true;
+	}
+	return false;
+}
+
+uint64_t CPacketBench::Now(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CPacketBench::Measure(const SBenchCase &c, nlohmann::json &result)
+{
+	if (c.setup)
+		c.setup();
+
+	// only what it takes is timed, turning a packet away is only a size or a tag check
+	std::vector<size_t> inputs;
+	for (size_t i=0; i<c.count; i++)
+	{
+		if (c.call(i))
+			inputs.push_back(i);
+	}
+	result["Offered"] = c.count;
+	result["Calls"] = inputs.size();
+	if (inputs.empty())
+	{
+		std::cerr << std::left << std::setw(36) << c.name << " took none of its " << c.count << " packets" << std::endl;
+		return;
+	}
+
+	// the allocations and instructions of one pass
+	const auto allocs = s_Allocations.load(), bytes = s_AllocatedBytes.load();
+	m_Instructions.Start();
+	for (auto i : inputs)
+		c.call(i);
+	const auto instructions = m_Instructions.Stop();
+	const double calls = double(inputs.size());
+	const double na = (s_Allocations.load() - allocs) / calls;
+	const double nb = (s_AllocatedBytes.load() - bytes) / calls;
+
+	// the best pass is the one that's least disturbed by everything else on the machine
+	uint64_t best = UINT64_MAX, total = 0;
+	unsigned passes = 0;
+	do
+	{
+		const auto start = Now();
+		for (auto i : inputs)
+			c.call(i);
+		const auto ns = Now() - start;
+		best = std::min(best, ns);
+		total += ns;
+		passes++;
+	} while (passes < BENCH_MIN_PASSES || total < uint64_t(m_Options.ms) * 1000000ull);
+
+	const double ns = best / calls;
+	result["FramesPerCall"] = c.frames;
+	result["Passes"] = passes;
+	result["NsPerCall"] = ns;
+	result["CallsPerSecond"] = 1.0e9 / ns;
+	result["AllocationsPerCall"] = na;
+	result["AllocatedBytesPerCall"] = nb;
+	if (m_Instructions.IsOpen())
+	{
+		result["InstructionsPerCall"] = instructions / calls;
+		if (c.frames)
+			result["InstructionsPerFrame"] = instructions / calls / c.frames;
+	}
+
+	std::cerr << std::left << std::setw(36) << c.name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << ns << " ns/call " << std::setw(12) << std::setprecision(0) << 1.0e9 / ns << " calls/s " << std::setw(6) << std::setprecision(1) << na << " allocs/call";
+	if (m_Instructions.IsOpen())
+		std::cerr << std::setw(10) << std::setprecision(0) << instructions / calls << " instructions/call";
+	std::cerr << std::endl;
+}
+
+void CPacketBench::Run(nlohmann::json &results)
+{
+	results["Source"] = m_Options.capture.empty() ? "synthetic" : m_Options.capture;
+	results["Captured"] = nlohmann::json::array();
+	for (auto p : m_Captured)
+		results["Captured"].push_back(CMetrics::ProtocolLabel(p));
+	results["InstructionCounter"] = m_Instructions.IsOpen();
+	results["Functions"] = nlohmann::json::object();
+	for (const auto &c : m_Cases)
+		Measure(c, results["Functions"][c.name]);
+}
+
+void CPacketBench::List(std::ostream &os) const
+{
+	for (const auto &c : m_Cases)
+		os << c.name << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// main
+
+static void usage(std::ostream &os, const char *name)
+{
+	os << "\nUsage: " << name << " [options]\n"
+		"Time the protocols' packet parsers and encoders, one function at a time.\n"
+		"Options\n"
+		"    -r FILE    : parse the datagrams in this capture, made with [Files] CapturePath, instead\n"
+		"                 of the encoders' packets, for the protocols that are in it\n"
+		"    -t MS      : time each function for at least this long, default " << BENCH_MIN_MS << ",\n"
+		"                 and at least " << BENCH_MIN_PASSES << " passes, the best pass is reported\n"
+		"    -k NAMES   : only the functions starting with one of these comma separated names\n"
+		"    -o FILE    : write the json results to FILE instead of stdout\n"
+		"    -l         : list the functions\n"
+		"A parser is only timed on the packets it takes. The instructions are only counted if\n"
+		"the kernel has a hardware counter for them and perf_event_paranoid allows it.\n\n";
+}
+
+int main(int argc, char *argv[])
+{
+	SBenchOptions opt;
+	bool list = false;
+	int c;
+	while (-1 != (c = getopt(argc, argv, "r:t:k:o:lh")))
+	{
+		switch (c)
+		{
+		case 'r': opt.capture.assign(optarg);  break;
+		case 't': opt.ms = std::stoul(optarg); break;
+		case 'o': opt.outfile.assign(optarg);  break;
+		case 'l': list = true;                 break;
+		case 'k':
+		{
+			std::istringstream ss(optarg);
+			std::string name;
+			while (std::getline(ss, name, ','))
+				opt.only.push_back(name);
+			break;
+		}
+		default:
+			usage(std::cerr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc)
+	{
+		usage(std::cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// stdout is for the results, the chatter goes to stderr
+	auto coutbuf = std::cout.rdbuf(std::cerr.rdbuf());
+
+	CPacketBench bench;
+	if (bench.Configure(opt))
+		return EXIT_FAILURE;
+	std::cout.rdbuf(coutbuf);
+	if (list)
+	{
+		bench.List(std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	nlohmann::json results;
+	coutbuf = std::cout.rdbuf(std::cerr.rdbuf());
+	bench.Run(results);
+	std::cout.rdbuf(coutbuf);
+
+	if (opt.outfile.empty())
+		std::cout << results.dump(4) << std::endl;
+	else
+	{
+		std::ofstream f(opt.outfile, std::ios::out | std::ios::trunc);
+		f << results.dump(4) << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
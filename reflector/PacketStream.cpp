@@ -22,20 +22,22 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 // constructor
 
-CPacketStream::CPacketStream(char module) : m_PSModule(module)
+CPacketStream::CPacketStream(char module) : m_Queue(STREAM_QUEUE_DEPTH, EQueuePolicy::backpressure), m_PSModule(module)
 {
-	m_bOpen = false;
+	m_State = EStreamState::closed;
 	m_uiStreamId = 0;
 	m_uiPacketCntr = 0;
 	m_OwnerClient = nullptr;
 	m_CodecStream = nullptr;
+	m_PacketsIn = nullptr;
+	m_PushLatency = CLatency::Get(ETraceStage::push, module);
 }
 
-bool CPacketStream::InitCodecStream()
+bool CPacketStream::InitCodecStream(CCodecEngine *engine)
 {
 	m_CodecStream = std::unique_ptr<CCodecStream>(new CCodecStream(this, m_PSModule));
 	if (m_CodecStream)
-		return m_CodecStream->InitCodecStream();
+		return m_CodecStream->InitCodecStream(engine);
 	else
 	{
 		std::cerr << "Could not create a CCodecStream for module '" << m_PSModule << "'" << std::endl;
@@ -48,31 +50,59 @@ bool CPacketStream::InitCodecStream()
 
 bool CPacketStream::OpenPacketStream(const CDvHeaderPacket &DvHeader, std::shared_ptr<CClient>client)
 {
+	std::lock_guard<std::mutex> lock(m_Mutex);
 	// not already open?
-	if ( !m_bOpen )
+	if ( EStreamState::closed == m_State )
 	{
-		// update status
-		m_bOpen = true;
+		// update status, open goes last, for whoever looks at the stream without the lock
 		m_uiStreamId = DvHeader.GetStreamId();
 		m_uiPacketCntr = 0;
 		m_DvHeader = DvHeader;
-		m_OwnerClient = client;
+		std::atomic_store(&m_OwnerClient, client);
 		m_LastPacketTime.start();
+		m_PacketsIn = CMetrics::Counter("urfd_packets_in_total", "Packets that came into a module's stream", CMetrics::Labels({{"protocol", CMetrics::ProtocolLabel(client->GetProtocol())}, {"module", std::string(1, m_PSModule)}}));
 		if (m_CodecStream)
-			m_CodecStream->ResetStats(m_uiStreamId, m_DvHeader.GetCodecIn());
+			m_CodecStream->ResetStats(DvHeader.GetStreamId(), m_DvHeader.GetCodecIn());
+		m_State.store(EStreamState::open, std::memory_order_release);
 		return true;
 	}
 	return false;
 }
 
-void CPacketStream::ClosePacketStream(void)
+void CPacketStream::RequestClose(std::function<void(void)> done)
 {
-	// update status
-	m_bOpen = false;
-	m_uiStreamId = 0;
-	m_OwnerClient.reset();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if ( EStreamState::open != m_State )
+		return;
+	m_CloseDone = std::move(done);
+	m_CloseTime.start();
+	m_State.store(EStreamState::closing, std::memory_order_release);
+	// the router may be waiting on an empty queue
+	m_Queue.Wake();
+}
+
+bool CPacketStream::IsDrained(void) const
+{
+	// frames still out at the transcoder come back to the queue
+	return m_Queue.IsEmpty() && (! m_CodecStream || m_CodecStream->IsIdle());
+}
+
+bool CPacketStream::FinishClose(std::function<void(void)> &done, double &seconds)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if ( EStreamState::closing != m_State )
+		return false;
+	done = std::move(m_CloseDone);
+	m_CloseDone = nullptr;
+	seconds = m_CloseTime.time();
 	if (m_CodecStream)
 		m_CodecStream->ReportStats();
+
+	// the id and the owner are cleared before the stream can be seen closed, and opened again
+	m_uiStreamId = 0;
+	std::atomic_store(&m_OwnerClient, std::shared_ptr<CClient>());
+	m_State.store(EStreamState::closed, std::memory_order_release);
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -82,6 +112,13 @@ void CPacketStream::Push(std::unique_ptr<CPacket> Packet)
 {
 	// update stream dependent packet data
 	m_LastPacketTime.start();
+	if (m_PacketsIn)
+		m_PacketsIn->Add();
+	if (Packet->GetTrace().rx)
+	{
+		Packet->Trace().push = CLatency::Now();
+		m_PushLatency->Record(Packet->GetTrace().push - Packet->GetTrace().rx);
+	}
 	if (Packet->IsDvFrame())
 	{
 		Packet->UpdatePids(m_uiPacketCntr++);
@@ -102,15 +139,3 @@ void CPacketStream::Push(std::unique_ptr<CPacket> Packet)
 		m_Queue.Push(std::move(Packet));
 	}
 }
-
-////////////////////////////////////////////////////////////////////////////////////////
-// get
-
-const CIp *CPacketStream::GetOwnerIp(void)
-{
-	if ( m_OwnerClient != nullptr )
-	{
-		return &(m_OwnerClient->GetIp());
-	}
-	return nullptr;
-}
@@ -18,16 +18,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+
 #include "Timer.h"
 #include "DVHeaderPacket.h"
 #include "Client.h"
 #include "CodecStream.h"
+#include "Metrics.h"
+#include "Latency.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
 //#define STREAM_TIMEOUT      (0.600)
 #define STREAM_TIMEOUT      (1.600)
 
+// a closing stream is still open until everything in it has gone out
+enum class EStreamState { closed, open, closing };
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // class
 
@@ -35,11 +44,15 @@ class CPacketStream
 {
 public:
 	CPacketStream(char module);
-	bool InitCodecStream();
+	bool InitCodecStream(CCodecEngine *engine);
 
 	// open / close
 	bool OpenPacketStream(const CDvHeaderPacket &, std::shared_ptr<CClient>);
-	void ClosePacketStream(void);
+	// doesn't wait, the router finishes the close once the stream has drained
+	void RequestClose(std::function<void(void)> done);
+	// closes a closing stream, false if it isn't one anymore, done gets what RequestClose was given
+	// and the caller runs it with the clients locked, seconds is how long the close took
+	bool FinishClose(std::function<void(void)> &done, double &seconds);
 
 	// push & pop
 	void ReturnPacket(std::unique_ptr<CPacket> p) { m_Queue.Push(std::move(p)); }
@@ -47,28 +60,40 @@ public:
 	void Tickle(void)                               { m_LastPacketTime.start(); }
 
 	// get
-	std::shared_ptr<CClient> GetOwnerClient(void)   { return m_OwnerClient; }
-	const CIp       *GetOwnerIp(void);
+	std::shared_ptr<CClient> GetOwnerClient(void) const { return std::atomic_load(&m_OwnerClient); }
 	bool             IsExpired(void) const          { return (m_LastPacketTime.time() > STREAM_TIMEOUT); }
-	bool             IsOpen(void) const             { return m_bOpen; }
-	uint16_t         GetStreamId(void) const        { return m_uiStreamId; }
+	double           GetIdleTime(void) const        { return m_LastPacketTime.time(); }
+	bool             IsOpen(void) const             { return EStreamState::closed != m_State.load(std::memory_order_acquire); }
+	bool             IsClosing(void) const          { return EStreamState::closing == m_State.load(std::memory_order_acquire); }
+	bool             IsDrained(void) const;
+	uint16_t         GetStreamId(void) const        { return m_uiStreamId.load(std::memory_order_acquire); }
 	const CCallsign &GetUserCallsign(void) const    { return m_DvHeader.GetMyCallsign(); }
 	char             GetRpt2Module(void) const      { return m_DvHeader.GetRpt2Module(); }
 
 	// pass-through
 	std::unique_ptr<CPacket> Pop()        { return m_Queue.Pop(); }
-	std::unique_ptr<CPacket> PopWait()    { return m_Queue.PopWait(); }
+	std::unique_ptr<CPacket> PopWait(int timeout_ms) { return m_Queue.PopWait(timeout_ms); }
 	bool IsEmpty()                        { return m_Queue.IsEmpty(); }
+	void GetQueueStats(SQueueStats &stats) const { m_Queue.GetStats(stats); }
+	size_t GetQueueSize(void) const       { return m_Queue.GetSize(); }
+	uint64_t GetQueuePushed(void) const   { return m_Queue.GetPushed(); }
+	void CodecJsonReport(nlohmann::json &report) const { if (m_CodecStream) m_CodecStream->JsonReport(report); }
 
 protected:
 	// data
-	CSafePacketQueue<std::unique_ptr<CPacket>> m_Queue;
+	CRingQueue<std::unique_ptr<CPacket>> m_Queue;
 	const char          m_PSModule;
-	bool                m_bOpen;
-	uint16_t            m_uiStreamId;
+	// the protocols open and close, the router finishes a close, this is taken for all of them
+	std::mutex          m_Mutex;
+	std::atomic<EStreamState> m_State;
+	std::function<void(void)> m_CloseDone;
+	CTimer              m_CloseTime;
+	std::atomic<uint16_t> m_uiStreamId;
 	uint32_t            m_uiPacketCntr;
 	CTimer              m_LastPacketTime;
 	CDvHeaderPacket     m_DvHeader;
-	std::shared_ptr<CClient> m_OwnerClient;
+	std::shared_ptr<CClient> m_OwnerClient;	// only with std::atomic_load() and std::atomic_store()
 	std::unique_ptr<CCodecStream> m_CodecStream;
+	CMetricCounter     *m_PacketsIn;      // of the owner's protocol
+	CLatencyHistogram  *m_PushLatency;
 };
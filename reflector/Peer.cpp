@@ -106,23 +106,23 @@ void CPeer::Alive(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // reporting
 
-void CPeer::WriteXml(std::ofstream &xmlFile)
+void CPeer::WriteXml(std::ostream &xmlFile)
 {
-	xmlFile << "<PEER>" << std::endl;
-	xmlFile << "\t<Callsign>" << m_Callsign << "</Callsign>" << std::endl;
-	xmlFile << "\t<IP>" << m_Ip.GetAddress() << "</IP>" << std::endl;
-	xmlFile << "\t<LinkedModule>" << m_ReflectorModules << "</LinkedModule>" << std::endl;
-	xmlFile << "\t<Protocol>" << GetProtocolName() << "</Protocol>" << std::endl;
+	xmlFile << "<PEER>\n";
+	xmlFile << "\t<Callsign>" << m_Callsign << "</Callsign>\n";
+	xmlFile << "\t<IP>" << m_Ip.GetAddress() << "</IP>\n";
+	xmlFile << "\t<LinkedModule>" << m_ReflectorModules << "</LinkedModule>\n";
+	xmlFile << "\t<Protocol>" << GetProtocolName() << "</Protocol>\n";
 	char mbstr[100];
 	if (std::strftime(mbstr, sizeof(mbstr), "%A %c", std::localtime(&m_ConnectTime)))
 	{
-		xmlFile << "\t<ConnectTime>" << mbstr << "</ConnectTime>" << std::endl;
+		xmlFile << "\t<ConnectTime>" << mbstr << "</ConnectTime>\n";
 	}
 	if (std::strftime(mbstr, sizeof(mbstr), "%A %c", std::localtime(&m_LastHeardTime)))
 	{
-		xmlFile << "\t<LastHeardTime>" << mbstr << "</LastHeardTime>" << std::endl;
+		xmlFile << "\t<LastHeardTime>" << mbstr << "</LastHeardTime>\n";
 	}
-	xmlFile << "</PEER>" << std::endl;
+	xmlFile << "</PEER>\n";
 }
 
 void CPeer::JsonReport(nlohmann::json &report)
@@ -68,7 +68,7 @@ public:
 	std::list<std::shared_ptr<CClient>>::const_iterator cend() const   { return m_Clients.cend(); }
 
 	// reporting
-	virtual void WriteXml(std::ofstream &);
+	virtual void WriteXml(std::ostream &);
 	void JsonReport(nlohmann::json &report);
 
 protected:
@@ -30,9 +30,9 @@ CPeers::CPeers() {}
 
 CPeers::~CPeers()
 {
-	m_Mutex.lock();
+	m_Mutex.Lock();
 	m_Peers.clear();
-	m_Mutex.unlock();
+	m_Mutex.Unlock();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -67,6 +67,9 @@ void CPeers::AddPeer(std::shared_ptr<CPeer> peer)
 
 	// notify
 	g_Reflector.OnPeersChanged();
+	nlohmann::json event;
+	peer->JsonReport(event);
+	g_Reflector.PostEvent("peerlink", event["Peers"][0]);
 }
 
 void CPeers::RemovePeer(std::shared_ptr<CPeer> peer)
@@ -94,6 +97,9 @@ void CPeers::RemovePeer(std::shared_ptr<CPeer> peer)
 			pit = m_Peers.erase(pit);
 			// notify
 			g_Reflector.OnPeersChanged();
+			nlohmann::json event;
+			peer->JsonReport(event);
+			g_Reflector.PostEvent("peerunlink", event["Peers"][0]);
 		}
 		else
 		{
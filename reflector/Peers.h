@@ -19,6 +19,7 @@
 #pragma once
 
 #include "Peer.h"
+#include "CountedMutex.h"
 
 class CPeers
 {
@@ -30,8 +31,9 @@ public:
 	virtual ~CPeers();
 
 	// locks
-	void Lock(void)   { m_Mutex.lock(); }
-	void Unlock(void) { m_Mutex.unlock(); }
+	void Lock(void)   { m_Mutex.Lock(); }
+	void Unlock(void) { m_Mutex.Unlock(); }
+	void GetLockStats(SLockStats &stats) const { m_Mutex.GetStats(stats); }
 
 	// manage peers
 	int  GetSize(void) const { return (int)m_Peers.size(); }
@@ -54,6 +56,6 @@ public:
 
 protected:
 	// data
-	std::mutex         m_Mutex;
+	CCountedMutex      m_Mutex;
 	std::list<std::shared_ptr<CPeer>> m_Peers;
 };
@@ -21,11 +21,13 @@
 #include "Protocol.h"
 #include "Clients.h"
 
+#include <algorithm>
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // constructor
 
 
-CProtocol::CProtocol() : keep_running(true) {}
+CProtocol::CProtocol() : m_Protocol(EProtocol::none), m_Queue(PROTOCOL_QUEUE_DEPTH, EQueuePolicy::dropoldest), m_QueueDone(0), m_Injected(PROTOCOL_QUEUE_DEPTH), m_InjectedCount(0), m_InjectedDone(0), m_InjectedTaken(false), m_ParseFailures(nullptr), m_RxTime(0), m_SendLatency(), m_KeepalivePeriod(0), m_PeerLinksPeriod(0), m_ClientKeepalives(false), m_ClientTimersVersion(UINT64_MAX), m_Random(std::random_device{}()), m_SubscribersVersion(UINT64_MAX), m_SubscribersProtocol(EProtocol::none), keep_running(true) {}
 
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +37,7 @@ CProtocol::~CProtocol()
 {
 	// kill threads
 	Close();
+	CMetrics::Remove(this);
 
 	// empty queue
 	while ( !m_Queue.IsEmpty() )
@@ -49,6 +52,7 @@ CProtocol::~CProtocol()
 bool CProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
 	m_Port = port;
+	m_Protocol = ptype;
 	// init reflector apparent callsign
 	m_ReflectorCallsign = g_Reflector.GetCallsign();
 
@@ -59,6 +63,10 @@ bool CProtocol::Initialize(const char *type, const EProtocol ptype, const uint16
 	if (type)
 		m_ReflectorCallsign.PatchCallsign(0, type, 3);
 
+	// create our readiness set
+	if (! m_Reactor.Open())
+		return false;
+
 	// create our sockets
 	if (has_ipv4)
 	{
@@ -68,6 +76,9 @@ bool CProtocol::Initialize(const char *type, const EProtocol ptype, const uint16
 		{
 			if (! m_Socket4.Open(ip4))
 				return false;
+			if (g_Configure.GetBoolean(g_Keys.ip.kerneltimestamps))
+				m_Socket4.EnableKernelTimestamps();
+			m_Reactor.Add(m_Socket4.GetSocket());
 		}
 		std::cout << "Listening on " << ip4 << std::endl;
 	}
@@ -85,11 +96,16 @@ bool CProtocol::Initialize(const char *type, const EProtocol ptype, const uint16
 					m_Socket4.Close();
 					return false;
 				}
+				if (g_Configure.GetBoolean(g_Keys.ip.kerneltimestamps))
+					m_Socket6.EnableKernelTimestamps();
+				m_Reactor.Add(m_Socket6.GetSocket());
 				std::cout << "Listening on " << ip6 << std::endl;
 			}
 		}
 	}
 
+	RegisterMetrics();
+
 	try
 	{
 		m_Future = std::async(std::launch::async, &CProtocol::Thread, this);
@@ -107,21 +123,39 @@ bool CProtocol::Initialize(const char *type, const EProtocol ptype, const uint16
 
 void CProtocol::Thread()
 {
+	// the timers belong to this thread
+	StartTimers();
+
 	while (keep_running)
 	{
 		Task();
+		UpdateClientTimers();
+		m_Timers.Advance();
+
+		// a replayed datagram is done with when everything it started is
+		if (m_InjectedTaken)
+		{
+			m_InjectedTaken = false;
+			m_InjectedDone.fetch_add(1, std::memory_order_release);
+		}
+		// what has left the queue has been sent, or dropped when it was full
+		const auto queued = m_Queue.GetPushed();
+		if (m_Queue.IsEmpty())
+			m_QueueDone.store(queued, std::memory_order_release);
 	}
 }
 
 void CProtocol::Close(void)
 {
 	keep_running = false;
+	m_Reactor.Notify();
 	if ( m_Future.valid() )
 	{
 		m_Future.get();
 	}
 	m_Socket4.Close();
 	m_Socket6.Close();
+	m_Reactor.Close();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -129,12 +163,17 @@ void CProtocol::Close(void)
 
 void CProtocol::OnDvFramePacketIn(std::unique_ptr<CDvFramePacket> &Frame, const CIp *Ip)
 {
+	// a paced frame was stamped when it came in
+	if (0 == Frame->GetTrace().rx)
+		Frame->Trace().rx = m_RxTime;
+
 	// find the stream
 	auto stream = GetStream(Frame->GetStreamId(), Ip);
-	if ( stream )
+	auto owner = stream ? stream->GetOwnerClient() : nullptr;
+	if ( owner )
 	{
 		// set the packet module, the transcoder needs this
-		Frame->SetPacketModule(stream->GetOwnerClient()->GetReflectorModule());
+		Frame->SetPacketModule(owner->GetReflectorModule());
 		// and push
 		stream->Push(std::move(Frame));
 	}
@@ -147,6 +186,25 @@ void CProtocol::OnDvFramePacketIn(std::unique_ptr<CDvFramePacket> &Frame, const
 #endif
 }
 
+// the frame goes in when its slot comes up, HandlePacer() has to be called every pass of the Task()
+void CProtocol::PaceDvFramePacketIn(std::unique_ptr<CDvFramePacket> &Frame, const CIp &Ip)
+{
+	Frame->Trace().rx = m_RxTime;
+	m_Pacer.Push(std::move(Frame), &Ip);
+}
+
+void CProtocol::HandlePacer(void)
+{
+	CIp Ip;
+	auto Packet = m_Pacer.Pop(&Ip);
+	while (Packet)
+	{
+		auto Frame = std::unique_ptr<CDvFramePacket>((CDvFramePacket *)Packet.release());
+		OnDvFramePacketIn(Frame, &Ip);
+		Packet = m_Pacer.Pop(&Ip);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // stream handle helpers
 
@@ -156,9 +214,11 @@ std::shared_ptr<CPacketStream> CProtocol::GetStream(uint16_t uiStreamId, const C
 	if (it == m_Streams.end())
 		return nullptr;
 
-	if (Ip != nullptr && it->second->GetOwnerIp() != nullptr)
+	// the router can close the stream meanwhile, the owner is only looked at once
+	const auto owner = it->second->GetOwnerClient();
+	if (Ip != nullptr && owner != nullptr)
 	{
-		if (*Ip == *it->second->GetOwnerIp())
+		if (*Ip == owner->GetIp())
 		{
 			return it->second;
 		}
@@ -167,23 +227,118 @@ std::shared_ptr<CPacketStream> CProtocol::GetStream(uint16_t uiStreamId, const C
 	return nullptr;
 }
 
-void CProtocol::CheckStreamsTimeout(void)
+void CProtocol::AddStream(std::shared_ptr<CPacketStream> stream)
+{
+	const auto sid = stream->GetStreamId();
+	m_Streams[sid] = stream;
+	m_Timers.Arm(m_StreamTimers[sid], unsigned(1000.0 * STREAM_TIMEOUT), [this, sid]{ CheckStreamTimeout(sid); });
+}
+
+// the timer goes off when the stream could have expired,
+// if it's been tickled since, it's set again for the time that's left
+void CProtocol::CheckStreamTimeout(uint16_t sid)
+{
+	auto it = m_Streams.find(sid);
+	if ( it == m_Streams.end() )
+	{
+		m_StreamTimers.erase(sid);
+		return;
+	}
+
+	// time out ?
+	if ( it->second->IsExpired() )
+	{
+		// yes, close it
+		g_Reflector.CloseStream(it->second);
+		// and remove it from the m_Streams map
+		m_Streams.erase(it);
+		m_StreamTimers.erase(sid);
+	}
+	else
+	{
+		m_Timers.Arm(m_StreamTimers[sid], unsigned(1000.0 * (STREAM_TIMEOUT - it->second->GetIdleTime())) + 1);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// timer helpers
+
+void CProtocol::StartTimers(void)
 {
-	for ( auto it=m_Streams.begin(); it!=m_Streams.end(); )
+	if ( m_KeepalivePeriod )
 	{
-		// time out ?
-		if ( it->second->IsExpired() )
+		m_Timers.Arm(m_KeepaliveTimer, 1000 * m_KeepalivePeriod, [this]{
+			HandleKeepalives();
+			m_Timers.Arm(m_KeepaliveTimer, 1000 * m_KeepalivePeriod);
+		});
+	}
+	if ( m_PeerLinksPeriod )
+	{
+		m_Timers.Arm(m_PeerLinksTimer, 1000 * m_PeerLinksPeriod, [this]{
+			HandlePeerLinks();
+			m_Timers.Arm(m_PeerLinksTimer, 1000 * m_PeerLinksPeriod);
+		});
+	}
+}
+
+// after the clients change, each new client gets a keepalive timer and the ones that left lose theirs
+void CProtocol::UpdateClientTimers(void)
+{
+	if ( ! m_ClientKeepalives )
+		return;
+	const auto version = g_Reflector.GetSubscribersVersion();
+	if ( version == m_ClientTimersVersion )
+		return;
+	m_ClientTimersVersion = version;
+
+	for ( auto &item : m_ClientTimers )
+		item.second.seen = false;
+
+	// a new timer starts at a random point of the period,
+	// so the keepalives of clients that came in together are spread out
+	std::uniform_int_distribution<unsigned> phase(0, 1000 * m_KeepalivePeriod - 1);
+	CClients *clients = g_Reflector.GetClients();
+	auto it = clients->begin();
+	std::shared_ptr<CClient>client = nullptr;
+	while ( (client = clients->FindNextClient(m_Protocol, it)) != nullptr )
+	{
+		const CClient *key = client.get();
+		auto &entry = m_ClientTimers[key];
+		entry.seen = true;
+		if ( entry.client.lock() != client )
 		{
-			// yes, close it
-			g_Reflector.CloseStream(it->second);
-			// and remove it from the m_Streams map
-			it = m_Streams.erase(it);
+			entry.client = client;
+			m_Timers.Arm(entry.timer, phase(m_Random), [this, key]{ OnClientKeepalive(key); });
 		}
+	}
+	g_Reflector.ReleaseClients();
+
+	for ( auto cit=m_ClientTimers.begin(); cit!=m_ClientTimers.end(); )
+	{
+		if ( cit->second.seen )
+			cit++;
 		else
-		{
-			it++;
-		}
+			cit = m_ClientTimers.erase(cit);
+	}
+}
+
+void CProtocol::OnClientKeepalive(const CClient *key)
+{
+	auto it = m_ClientTimers.find(key);
+	if ( it == m_ClientTimers.end() )
+		return;
+
+	auto client = it->second.client.lock();
+	if ( client )
+	{
+		CClients *clients = g_Reflector.GetClients();
+		if ( clients->IsClient(client) )
+			HandleClientKeepalive(clients, client);
+		g_Reflector.ReleaseClients();
 	}
+
+	// if the client is gone, the next update throws the timer away
+	m_Timers.Arm(it->second.timer, 1000 * m_KeepalivePeriod);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -220,51 +375,122 @@ uint32_t CProtocol::ModuleToDmrDestId(char m) const
 ////////////////////////////////////////////////////////////////////////////////////////
 // Receivers
 
+// the next datagram from a socket, and when it came in
+bool CProtocol::ReceiveBatch(CUdpSocket &socket, CBuffer &buf, CIp &ip)
+{
+	if (! socket.ReceiveBatch(buf, ip))
+		return false;
+	m_RxTime = socket.GetRxTime();
+	g_Reflector.Capture(m_Protocol, ip, m_RxTime, buf);
+	return true;
+}
+
+// a replayed datagram comes before the sockets
+bool CProtocol::ReceiveInjected(CBuffer &buf, CIp &ip)
+{
+	if (m_Injected.IsEmpty())
+		return false;
+	auto record = m_Injected.Pop();
+	buf.Set(record->data, record->size);
+	ip = record->ip;
+	m_RxTime = CLatency::Now();
+	m_InjectedTaken = true;
+	return true;
+}
+
+bool CProtocol::Inject(std::unique_ptr<SCaptureRecord> &record)
+{
+	// there's only the one producer, so it can't fill up in between
+	if (m_Injected.IsFull())
+		return false;
+	m_Injected.Push(std::move(record));
+	m_InjectedCount++;
+	m_Reactor.Notify();
+	return true;
+}
+
+// a pending batch is served before waiting, the reactor can't see it
 bool CProtocol::Receive6(CBuffer &buf, CIp &ip, int time_ms)
 {
-	return m_Socket6.Receive(buf, ip, time_ms);
+	if (ReceiveInjected(buf, ip))
+		return true;
+	if (m_Socket6.HasBatched())
+		return ReceiveBatch(m_Socket6, buf, ip);
+
+	const auto fd = m_Reactor.Wait(GetWaitTime(time_ms));
+	return (fd >= 0) && (fd == m_Socket6.GetSocket()) && ReceiveBatch(m_Socket6, buf, ip);
 }
 
 bool CProtocol::Receive4(CBuffer &buf, CIp &ip, int time_ms)
 {
-	return m_Socket4.Receive(buf, ip, time_ms);
+	if (ReceiveInjected(buf, ip))
+		return true;
+	if (m_Socket4.HasBatched())
+		return ReceiveBatch(m_Socket4, buf, ip);
+
+	const auto fd = m_Reactor.Wait(GetWaitTime(time_ms));
+	return (fd >= 0) && (fd == m_Socket4.GetSocket()) && ReceiveBatch(m_Socket4, buf, ip);
 }
 
 bool CProtocol::ReceiveDS(CBuffer &buf, CIp &ip, int time_ms)
 {
-	auto fd4 = m_Socket4.GetSocket();
-	auto fd6 = m_Socket6.GetSocket();
+	if (ReceiveInjected(buf, ip))
+		return true;
+	if (m_Socket4.HasBatched())
+		return ReceiveBatch(m_Socket4, buf, ip);
+	if (m_Socket6.HasBatched())
+		return ReceiveBatch(m_Socket6, buf, ip);
+
+	const auto fd = m_Reactor.Wait(GetWaitTime(time_ms));
+	if (fd < 0)
+		return false;
 
-	if (fd4 < 0)
-	{
-		if (fd6 < 0)
-			return false;
-		return m_Socket6.Receive(buf, ip, time_ms);
-	}
-	else if (fd6 < 0)
-		return m_Socket4.Receive(buf, ip, time_ms);
-
-	fd_set fset;
-	FD_ZERO(&fset);
-	FD_SET(fd4, &fset);
-	FD_SET(fd6, &fset);
-	int max = (fd4 > fd6) ? fd4 : fd6;
-	struct timeval tv;
-	tv.tv_sec = time_ms / 1000;
-	tv.tv_usec = (time_ms % 1000) * 1000;
-
-	auto rval = select(max+1, &fset, 0, 0, &tv);
-	if (rval <= 0)
+	if (fd == m_Socket4.GetSocket())
+		return ReceiveBatch(m_Socket4, buf, ip);
+	else if (fd == m_Socket6.GetSocket())
+		return ReceiveBatch(m_Socket6, buf, ip);
+
+	return false;
+}
+
+// without an open stream, there is nothing to do until the next timer,
+// and a paced frame can't be kept waiting
+int CProtocol::GetWaitTime(int time_ms) const
+{
+	if (m_Streams.empty() && time_ms < PROTOCOL_IDLE_WAIT)
+		time_ms = PROTOCOL_IDLE_WAIT;
+	return m_Pacer.TimeToNext(m_Timers.TimeToNext(time_ms));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// subscribers
+
+// only the version is read per packet, a snapshot is loaded again only after a client
+// links, unlinks or moves
+const ClientVector &CProtocol::GetSubscribers(EProtocol protocol, char module)
+{
+	static const auto empty = std::make_shared<const ClientVector>();
+
+	const auto version = g_Reflector.GetSubscribersVersion();
+	if ( version != m_SubscribersVersion || protocol != m_SubscribersProtocol )
 	{
-		if (rval < 0)
-			std::cerr << "ReceiveDS select error: " << strerror(errno) << std::endl;
-		return false;
+		for ( auto &s : m_Subscribers )
+			s.reset();
+		m_SubscribersVersion = version;
+		m_SubscribersProtocol = protocol;
 	}
 
-	if (FD_ISSET(fd4, &fset))
-		return m_Socket4.ReceiveFrom(buf, ip);
-	else
-		return m_Socket6.ReceiveFrom(buf, ip);
+	const auto m = CClients::GetSubscriberSlot(protocol, module);
+	if ( m < 0 )
+		return *empty;
+	auto &snapshot = m_Subscribers[m];
+	if ( ! snapshot )
+	{
+		snapshot = g_Reflector.GetSubscribers(protocol, module);
+		if ( ! snapshot )
+			snapshot = empty;
+	}
+	return *snapshot;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -350,6 +576,147 @@ void CProtocol::Send(const SM17Frame &frame, const CIp &Ip) const
 	}
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+// dual stack fan-out senders
+
+void CProtocol::Send(const CBuffer &buf, const std::vector<CIp> &Ips) const
+{
+	Send(buf.data(), buf.size(), 0, Ips);
+}
+
+// one frame per destination
+void CProtocol::Send(const std::vector<SM17Frame> &frames, const std::vector<CIp> &Ips) const
+{
+	if (frames.size() == Ips.size() && ! frames.empty())
+		Send(frames.front().magic, sizeof(SM17Frame), sizeof(SM17Frame), Ips);
+}
+
+void CProtocol::Send(const uint8_t *data, size_t size, size_t stride, const std::vector<CIp> &Ips) const
+{
+	// the usual case, all destinations in one family
+	const auto is4 = [](const CIp &ip) { return AF_INET  == ip.GetFamily(); };
+	const auto is6 = [](const CIp &ip) { return AF_INET6 == ip.GetFamily(); };
+	if (std::all_of(Ips.begin(), Ips.end(), is4))
+	{
+		m_Socket4.Send(data, size, Ips, stride);
+		return;
+	}
+	if (std::all_of(Ips.begin(), Ips.end(), is6))
+	{
+		m_Socket6.Send(data, size, Ips, stride);
+		return;
+	}
+
+	// mixed, so split them up, a strided payload has to follow its destination
+	std::vector<CIp> ips4, ips6;
+	std::vector<uint8_t> data4, data6;
+	for (size_t i=0; i<Ips.size(); i++)
+	{
+		const auto p = data + i * stride;
+		if (is4(Ips[i]))
+		{
+			ips4.push_back(Ips[i]);
+			if (stride)
+				data4.insert(data4.end(), p, p + stride);
+		}
+		else if (is6(Ips[i]))
+		{
+			ips6.push_back(Ips[i]);
+			if (stride)
+				data6.insert(data6.end(), p, p + stride);
+		}
+		else
+			std::cerr << "Wrong family: " << Ips[i].GetFamily() << std::endl;
+	}
+	if (! ips4.empty())
+		m_Socket4.Send(stride ? data4.data() : data, size, ips4, stride);
+	if (! ips6.empty())
+		m_Socket6.Send(stride ? data6.data() : data, size, ips6, stride);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// metrics
+
+void CProtocol::RegisterMetrics(void)
+{
+	const std::string protocol(CMetrics::ProtocolLabel(m_Protocol));
+	m_ParseFailures = CMetrics::Counter("urfd_parse_failures_total", "Datagrams that no packet decoder recognized", CMetrics::Labels({{"protocol", protocol}, {"type", "unknown"}}));
+
+	const CUdpSocket *sockets[] = { &m_Socket4, &m_Socket6 };
+	const char *families[] = { "ipv4", "ipv6" };
+	for (int i=0; i<2; i++)
+	{
+		if (0 > sockets[i]->GetSocket())
+			continue;
+		const auto socket = sockets[i];
+		const auto labels = CMetrics::Labels({{"protocol", protocol}, {"family", families[i]}});
+		CMetrics::CounterFn("urfd_datagrams_in_total", "Datagrams received", labels, this, [socket]() { SUdpStats s; socket->GetStats(s); return double(s.rxdatagrams); });
+		CMetrics::CounterFn("urfd_datagrams_out_total", "Datagrams sent", labels, this, [socket]() { SUdpStats s; socket->GetStats(s); return double(s.txdatagrams); });
+		CMetrics::CounterFn("urfd_bytes_in_total", "Bytes received", labels, this, [socket]() { SUdpStats s; socket->GetStats(s); return double(s.rxbytes); });
+		CMetrics::CounterFn("urfd_bytes_out_total", "Bytes sent", labels, this, [socket]() { SUdpStats s; socket->GetStats(s); return double(s.txbytes); });
+		CMetrics::CounterFn("urfd_send_errors_total", "Failed sendto() and sendmmsg() calls", labels, this, [socket]() { SUdpStats s; socket->GetStats(s); return double(s.txerrors); });
+	}
+
+	const auto queue = CMetrics::Labels({{"queue", std::string("Port ") + std::to_string(m_Port)}});
+	CMetrics::GaugeFn("urfd_queue_depth", "Packets waiting in a queue", queue, this, [this]() { return double(m_Queue.GetSize()); });
+	CMetrics::CounterFn("urfd_queue_dropped_total", "Packets a full queue dropped or refused", queue, this, [this]() { SQueueStats s; m_Queue.GetStats(s); return double(s.dropped); });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// latency
+
+void CProtocol::TraceSent(const CPacket &packet)
+{
+	const auto &trace = packet.GetTrace();
+	const auto module = packet.GetPacketModule();
+	if (0 == trace.rx || module < 'A' || module > 'Z')
+		return;
+	auto &histogram = m_SendLatency[module - 'A'];
+	if (nullptr == histogram)
+		histogram = CLatency::Get(ETraceStage::send, module, m_Protocol);
+	histogram->Record(CLatency::Now() - trace.rx);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// report
+
+void CProtocol::JsonReport(nlohmann::json &report) const
+{
+	const CUdpSocket *sockets[] = { &m_Socket4, &m_Socket6 };
+	const char *families[] = { "IPv4", "IPv6" };
+	for (int i=0; i<2; i++)
+	{
+		if (0 > sockets[i]->GetSocket())
+			continue;
+		SUdpStats stats;
+		sockets[i]->GetStats(stats);
+		nlohmann::json jsocket;
+		jsocket["Port"] = m_Port;
+		jsocket["Family"] = families[i];
+		jsocket["RxCalls"] = stats.rxcalls;
+		jsocket["RxDatagrams"] = stats.rxdatagrams;
+		jsocket["TxCalls"] = stats.txcalls;
+		jsocket["TxDatagrams"] = stats.txdatagrams;
+		jsocket["RxBytes"] = stats.rxbytes;
+		jsocket["TxBytes"] = stats.txbytes;
+		jsocket["TxErrors"] = stats.txerrors;
+		report["Sockets"].push_back(jsocket);
+	}
+
+	SQueueStats stats;
+	m_Queue.GetStats(stats);
+	nlohmann::json jqueue;
+	jqueue["Name"] = std::string("Port ") + std::to_string(m_Port);
+	jqueue["Capacity"] = stats.capacity;
+	jqueue["HighWater"] = stats.highwater;
+	jqueue["Pushed"] = stats.pushed;
+	jqueue["Dropped"] = stats.dropped;
+	report["Queues"].push_back(jqueue);
+
+	if (m_Pacer.GetPushed())
+		m_Pacer.JsonReport(report, std::string("Port ") + std::to_string(m_Port));
+}
+
 #ifdef DEBUG
 void CProtocol::Dump(const char *title, const uint8_t *data, int length)
 {
@@ -18,8 +18,19 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <atomic>
+#include <random>
+#include <nlohmann/json.hpp>
+
 #include "UDPSocket.h"
+#include "Clients.h"
+#include "Reactor.h"
+#include "Pacer.h"
+#include "TimerWheel.h"
+#include "Metrics.h"
+#include "Latency.h"
 #include "PacketStream.h"
+#include "Capture.h"
 #include "DVHeaderPacket.h"
 #include "DVFramePacket.h"
 
@@ -54,6 +65,9 @@
 #define DMR_DATA_HEADER_CRC_MASK        0xCC
 #define DMR_CSBK_CRC_MASK               0xA5
 
+// longest reactor wait when no stream is open, in ms
+#define PROTOCOL_IDLE_WAIT              100
+
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // class
@@ -74,27 +88,51 @@ public:
 	// get
 	const CCallsign &GetReflectorCallsign(void)const { return m_ReflectorCallsign; }
 	uint16_t GetPort(void) const { return m_Port; }
+	EProtocol GetProtocol(void) const { return m_Protocol; }
 
 	// task
 	void Thread(void);
 	virtual void Task(void) = 0;
 
+	// report
+	void JsonReport(nlohmann::json &report) const;
+
 	// pass-through
-	void Push(std::unique_ptr<CPacket> p) { m_Queue.Push(std::move(p)); }
+	void Push(std::unique_ptr<CPacket> p) { m_Queue.Push(std::move(p)); m_Reactor.Notify(); }
+
+	// replay, a captured datagram is handled as if the socket had received it,
+	// false if there's no room for it yet
+	bool Inject(std::unique_ptr<SCaptureRecord> &record);
+	// every injected datagram has been handled, not only taken, called from the replay thread
+	bool IsInjectedDone(void) const { return m_InjectedDone.load(std::memory_order_acquire) == m_InjectedCount; }
+	// and everything the routers pushed has been sent
+	bool IsQueueDone(void) const { return m_QueueDone.load(std::memory_order_acquire) == m_Queue.GetPushed(); }
+	void Wake(void) { m_Reactor.Notify(); }
 
 protected:
 	// stream helpers
 	virtual void OnDvFramePacketIn(std::unique_ptr<CDvFramePacket> &, const CIp * = nullptr);
+	// frames that have to go in at a steady 20 ms
+	void PaceDvFramePacketIn(std::unique_ptr<CDvFramePacket> &, const CIp &);
+	void HandlePacer(void);
 
 	// stream handle helpers
 	std::shared_ptr<CPacketStream> GetStream(uint16_t, const CIp * = nullptr);
-	void CheckStreamsTimeout(void);
+	void AddStream(std::shared_ptr<CPacketStream>);
+	void CheckStreamTimeout(uint16_t);
 
 	// queue helper
 	virtual void HandleQueue(void) = 0;
 
-	// keepalive helpers
-	virtual void HandleKeepalives(void) = 0;
+	// keepalive helpers, run by the timers
+	virtual void HandleKeepalives(void) {}
+	virtual void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &) {}
+	virtual void HandlePeerLinks(void) {}
+
+	// timer helpers
+	void StartTimers(void);
+	void UpdateClientTimers(void);
+	void OnClientKeepalive(const CClient *);
 
 	// syntax helper
 	bool IsNumber(char) const;
@@ -105,28 +143,89 @@ protected:
 	virtual char DmrDstIdToModule(uint32_t) const;
 	virtual uint32_t ModuleToDmrDestId(char) const;
 
+	bool ReceiveBatch(CUdpSocket &socket, CBuffer &buf, CIp &Ip);
+	bool ReceiveInjected(CBuffer &buf, CIp &Ip);
 	bool Receive6(CBuffer &buf, CIp &Ip, int time_ms);
 	bool Receive4(CBuffer &buf, CIp &Ip, int time_ms);
 	bool ReceiveDS(CBuffer &buf, CIp &Ip, int time_ms);
+	int  GetWaitTime(int time_ms) const;
+
+	// metrics read from the sockets and the queue
+	void RegisterMetrics(void);
+
+	// a packet from the queue has gone out, for its latency
+	void TraceSent(const CPacket &);
+
+	// the clients linked to a module, for HandleQueue() only, without the clients lock
+	// the reference is good until the next call
+	const ClientVector &GetSubscribers(EProtocol, char);
 
 	void Send(const CBuffer &buf, const CIp &Ip) const;
 	void Send(const char    *buf, const CIp &Ip) const;
 	void Send(const CBuffer &buf, const CIp &Ip, uint16_t port) const;
 	void Send(const char    *buf, const CIp &Ip, uint16_t port) const;
 	void Send(const SM17Frame &frame, const CIp &Ip) const;
+	// fan-out, batched into as few syscalls as possible
+	void Send(const CBuffer &buf, const std::vector<CIp> &Ips) const;
+	void Send(const std::vector<SM17Frame> &frames, const std::vector<CIp> &Ips) const;
+	void Send(const uint8_t *data, size_t size, size_t stride, const std::vector<CIp> &Ips) const;
 #ifdef DEBUG
 	void Dump(const char *title, const uint8_t *data, int length);
 #endif
 
+	// what we are
+	EProtocol m_Protocol;
+
 	// socket
 	CUdpSocket m_Socket4;
 	CUdpSocket m_Socket6;
 
+	// readiness of the sockets and the queue
+	CReactor m_Reactor;
+
 	// streams
+	CPacer m_Pacer;
 	std::unordered_map<uint16_t, std::shared_ptr<CPacketStream>> m_Streams;
 
 	// queue
-	CSafePacketQueue<std::unique_ptr<CPacket>> m_Queue;
+	CRingQueue<std::unique_ptr<CPacket>> m_Queue;
+	std::atomic<uint64_t> m_QueueDone;
+	// and what a replay hands in, how much of it, and how much the thread is done with
+	CSpscRingQueue<std::unique_ptr<SCaptureRecord>> m_Injected;
+	uint64_t m_InjectedCount;
+	std::atomic<uint64_t> m_InjectedDone;
+	bool m_InjectedTaken;
+
+	// datagrams that no handler recognized
+	CMetricCounter *m_ParseFailures;
+
+	// latency, when the datagram being handled was received, and the histograms by module
+	uint64_t m_RxTime;
+	CLatencyHistogram *m_SendLatency[26];
+
+	// timers, they all run on the protocol's thread. The periods are in seconds,
+	// 0 for none, and have to be set before Initialize() starts the thread
+	CTimerWheel m_Timers;
+	unsigned    m_KeepalivePeriod;
+	unsigned    m_PeerLinksPeriod;
+	bool        m_ClientKeepalives;     // each client has its own keepalive timer
+	CWheelTimer m_KeepaliveTimer;
+	CWheelTimer m_PeerLinksTimer;
+	std::unordered_map<uint16_t, CWheelTimer> m_StreamTimers;
+	struct SClientTimer
+	{
+		std::weak_ptr<CClient> client;
+		CWheelTimer timer;
+		bool seen;
+	};
+	std::unordered_map<const CClient *, SClientTimer> m_ClientTimers;
+	uint64_t    m_ClientTimersVersion;
+	std::minstd_rand m_Random;
+
+	// subscriber snapshots, reloaded after the clients change
+	std::shared_ptr<const ClientVector> m_Subscribers[NB_SUBSCRIBER_MODULES];
+	uint64_t  m_SubscribersVersion;
+	EProtocol m_SubscribersProtocol;
 
 	// thread
 	std::atomic<bool> keep_running;
@@ -119,6 +119,9 @@ bool CProtocols::Init(void)
 void CProtocols::Close(void)
 {
 	m_Mutex.lock();
+	// the threads have to stop before the derived parts of the protocols are gone
+	for (auto &protocol : m_Protocols)
+		protocol->Close();
 	m_Protocols.clear();
 	m_Mutex.unlock();
 }
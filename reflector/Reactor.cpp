@@ -0,0 +1,187 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <cstdint>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "Reactor.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+CReactor::CReactor() : m_EpollFd(-1), m_EventFd(-1) {}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// destructor
+
+CReactor::~CReactor()
+{
+	Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// open & close
+
+// returns false on error
+bool CReactor::Open(void)
+{
+	if (m_EpollFd >= 0)
+		return true;	// already open
+
+	m_EpollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (m_EpollFd < 0)
+	{
+		std::cerr << "epoll_create1() failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	m_EventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_EventFd < 0)
+	{
+		std::cerr << "eventfd() failed: " << strerror(errno) << std::endl;
+		Close();
+		return false;
+	}
+
+	if (! Add(m_EventFd))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void CReactor::Close(void)
+{
+	if (m_EventFd >= 0)
+	{
+		close(m_EventFd);
+		m_EventFd = -1;
+	}
+	if (m_EpollFd >= 0)
+	{
+		close(m_EpollFd);
+		m_EpollFd = -1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// registration
+
+// returns false on error
+bool CReactor::Add(int fd)
+{
+	if (fd < 0 || m_EpollFd < 0)
+		return false;
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(m_EpollFd, EPOLL_CTL_ADD, fd, &ev))
+	{
+		std::cerr << "epoll_ctl() could not add fd " << fd << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void CReactor::Remove(int fd)
+{
+	if (fd >= 0 && m_EpollFd >= 0)
+		epoll_ctl(m_EpollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// doorbell
+
+void CReactor::Notify(void)
+{
+	if (m_EventFd >= 0)
+	{
+		const uint64_t one = 1;
+		if (ssize_t(sizeof(one)) != write(m_EventFd, &one, sizeof(one)) && EAGAIN != errno)
+			std::cerr << "Reactor notify failed: " << strerror(errno) << std::endl;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// wait
+
+int CReactor::Wait(int timeout_ms)
+{
+	if (m_EpollFd < 0)
+		return REACTOR_TIMEOUT;
+
+	// level triggered and one event at a time, so the kernel
+	// round-robins between descriptors that are all ready
+	struct epoll_event ev;
+	auto rval = epoll_wait(m_EpollFd, &ev, 1, timeout_ms);
+	if (rval <= 0)
+	{
+		if (rval < 0 && EINTR != errno)
+			std::cerr << "epoll_wait() error: " << strerror(errno) << std::endl;
+		return REACTOR_TIMEOUT;
+	}
+
+	if (ev.data.fd == m_EventFd)
+	{
+		// reset the doorbell
+		uint64_t count;
+		if (ssize_t(sizeof(count)) != read(m_EventFd, &count, sizeof(count)) && EAGAIN != errno)
+			std::cerr << "Reactor doorbell read failed: " << strerror(errno) << std::endl;
+		return REACTOR_NOTIFIED;
+	}
+
+	return ev.data.fd;
+}
+
+int CReactor::Wait(int timeout_ms, int *fds, int size)
+{
+	if (m_EpollFd < 0 || size <= 0)
+		return 0;
+
+	struct epoll_event ev[REACTOR_MAX_EVENTS];
+	if (size > REACTOR_MAX_EVENTS)
+		size = REACTOR_MAX_EVENTS;
+	auto rval = epoll_wait(m_EpollFd, ev, size, timeout_ms);
+	if (rval <= 0)
+	{
+		if (rval < 0 && EINTR != errno)
+			std::cerr << "epoll_wait() error: " << strerror(errno) << std::endl;
+		return 0;
+	}
+
+	for (int i=0; i<rval; i++)
+	{
+		if (ev[i].data.fd == m_EventFd)
+		{
+			uint64_t count;
+			if (ssize_t(sizeof(count)) != read(m_EventFd, &count, sizeof(count)) && EAGAIN != errno)
+				std::cerr << "Reactor doorbell read failed: " << strerror(errno) << std::endl;
+			fds[i] = REACTOR_NOTIFIED;
+		}
+		else
+			fds[i] = ev[i].data.fd;
+	}
+	return rval;
+}
@@ -0,0 +1,66 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+// Wait() return values that are not a file descriptor
+#define REACTOR_TIMEOUT     -1
+#define REACTOR_NOTIFIED    -2
+
+// the most descriptors one Wait() can report
+#define REACTOR_MAX_EVENTS  32
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// An epoll readiness set with an eventfd doorbell.
+// The thread that owns the reactor blocks in Wait() until one of its
+// registered descriptors is readable, or another thread calls Notify()
+// to tell it that there is something in its queue.
+
+class CReactor
+{
+public:
+	// constructor
+	CReactor();
+
+	// destructor
+	~CReactor();
+
+	// open & close
+	bool Open(void);
+	void Close(void);
+
+	// registration
+	bool Add(int fd);
+	void Remove(int fd);
+
+	// wake the thread waiting in Wait()
+	void Notify(void);
+
+	// returns a readable fd, REACTOR_NOTIFIED or REACTOR_TIMEOUT
+	int Wait(int timeout_ms);
+	// fills fds with up to size readable fds or REACTOR_NOTIFIED, returns how many, 0 on timeout
+	int Wait(int timeout_ms, int *fds, int size);
+
+protected:
+	// data
+	int m_EpollFd;
+	int m_EventFd;
+};
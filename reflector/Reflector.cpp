@@ -18,11 +18,21 @@
 
 
 #include <string.h>
+#include <sstream>
 
 #include "Global.h"
 
 CReflector::CReflector()
 {
+	for (unsigned i=0; i<26; i++)
+	{
+		m_RouterCopies[i] = 0;
+		m_RouterSkipped[i] = 0;
+		m_RouterDone[i] = 0;
+		m_Closes[i] = 0;
+		m_CloseUs[i] = 0;
+		m_CloseWorstUs[i] = 0;
+	}
 #ifndef NO_DHT
 	peers_put_count = clients_put_count = users_put_count = 0;
 #endif
@@ -30,6 +40,7 @@ CReflector::CReflector()
 
 CReflector::~CReflector()
 {
+	CMetrics::Remove(this);
 	keep_running = false;
 	if ( m_XmlReportFuture.valid() )
 	{
@@ -42,6 +53,7 @@ CReflector::~CReflector()
 			m_RouterFuture[*it].get();
 	}
 	m_RouterFuture.clear();
+	m_CodecEngines.clear();	// before the streams they serve
 	m_Stream.clear();
 }
 
@@ -79,6 +91,10 @@ bool CReflector::Start(void)
 	// init wiresx node directory. Likewise with the return vale.
 	g_LYtr.LookupInit();
 
+	// the capture has to be open before the first datagram comes in
+	if (g_Configure.IsString(g_Keys.files.capture) && m_Capture.Open(g_Configure.GetString(g_Keys.files.capture)))
+		return true;
+
 	// create protocols
 	if (! m_Protocols.Init())
 	{
@@ -86,6 +102,18 @@ bool CReflector::Start(void)
 		return true;
 	}
 
+	// the transcoded modules share a small pool of transcoder threads
+	if (! tcmods.empty())
+	{
+		if (m_TranscoderPool.Init(g_Configure.GetString(g_Keys.modules.tcsockets)))
+			return true;
+		auto n = g_Configure.GetUnsigned(g_Keys.modules.tcthreads);
+		if (n > tcmods.size())
+			n = tcmods.size();
+		for (unsigned i=0; i<n; i++)
+			m_CodecEngines.emplace_back(new CCodecEngine(i, &m_TranscoderPool));
+	}
+
 	// start one thread per reflector module
 	for (auto c : m_Modules)
 	{
@@ -93,9 +121,10 @@ bool CReflector::Start(void)
 		if (stream)
 		{
 			// if it's a transcoded module, then we need to initialize the codec stream
-			if (std::string::npos != tcmods.find(c))
+			const auto tc = tcmods.find(c);
+			if (std::string::npos != tc)
 			{
-				if (stream->InitCodecStream())
+				if (stream->InitCodecStream(m_CodecEngines[tc % m_CodecEngines.size()].get()))
 					return true;
 			}
 			m_Stream[c] = stream;
@@ -117,6 +146,20 @@ bool CReflector::Start(void)
 		}
 	}
 
+	// start the transcoder threads, now that they have all their modules
+	for (auto &engine : m_CodecEngines)
+	{
+		if (engine->Start())
+			return true;
+	}
+
+	RegisterMetrics();
+
+	// the status server has to be up before the reporting thread looks for it
+	const auto statusport = g_Configure.GetUnsigned(g_Keys.files.statusport);
+	if (statusport && m_Status.Start(statusport))
+		std::cerr << "The status server isn't available" << std::endl;
+
 	// start the reporting thread
 	try
 	{
@@ -144,6 +187,8 @@ void CReflector::Stop(void)
 	{
 		m_XmlReportFuture.get();
 	}
+	m_Status.Stop();
+	CMetrics::Remove(this);
 
 	// stop & delete all router thread
 	for (auto c : m_Modules)
@@ -152,8 +197,13 @@ void CReflector::Stop(void)
 			m_RouterFuture[c].get();
 	}
 
+	// stop the transcoder threads
+	for (auto &engine : m_CodecEngines)
+		engine->Stop();
+
 	// close protocols
 	m_Protocols.Close();
+	m_Capture.Close();
 
 	// close gatekeeper
 	g_GateKeeper.Close();
@@ -217,6 +267,11 @@ std::shared_ptr<CPacketStream> CReflector::OpenStream(std::unique_ptr<CDvHeaderP
 		return nullptr;
 	}
 
+	// a stream still draining its last transmission is finished now, so this one isn't lost,
+	// whatever of the old one is still at the transcoder is dropped
+	if ( stream->IsClosing() )
+		FinishClose(module, stream);
+
 	// is it available ?
 	if ( stream->OpenPacketStream(*DvHeader, client) )
 	{
@@ -226,10 +281,12 @@ std::shared_ptr<CPacketStream> CReflector::OpenStream(std::unique_ptr<CDvHeaderP
 
 		// update last heard time
 		client->Heard();
+		OnClientsChanged();
 
 		// report
 		std::cout << std::showbase << std::hex;
 		std::cout << "Opening stream on module " << module << " for client " << client->GetCallsign() << " with sid " << ntohs(DvHeader->GetStreamId()) << " by user " << DvHeader->GetMyCallsign() << std::endl;
+		PostEvent("open", { {"Module", std::string(1, module)}, {"StreamId", ntohs(DvHeader->GetStreamId())}, {"User", DvHeader->GetMyCallsign().GetCS()}, {"Client", client->GetCallsign().GetCS()}, {"Protocol", client->GetProtocolName()} });
 		std::cout << std::noshowbase << std::dec;
 
 		// and push header packet
@@ -238,45 +295,56 @@ std::shared_ptr<CPacketStream> CReflector::OpenStream(std::unique_ptr<CDvHeaderP
 		// notify
 		//OnStreamOpen(stream->GetUserCallsign());
 
+		return stream;
 	}
-	return stream;
+	return nullptr;
 }
 
 void CReflector::CloseStream(std::shared_ptr<CPacketStream> stream)
 {
 	if ( stream != nullptr )
 	{
-		// wait queue is empty. this waits forever
-		bool bEmpty = stream->IsEmpty();
-		while (! bEmpty)
-		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
-			bEmpty = stream->IsEmpty();
-		}
-
-		GetClients();	// lock clients
-
-		// get and check the master
+		// this doesn't wait for the stream to drain, its router thread finishes the close
 		std::shared_ptr<CClient>client = stream->GetOwnerClient();
-		if ( client != nullptr )
+		const char module = GetStreamModule(stream);
+		// the clients are locked when it's called
+		stream->RequestClose([this, client, module]
 		{
-			// client no longer a master
-			client->NotAMaster();
-
-			// notify
-			//OnStreamClose(stream->GetUserCallsign());
-
-			std::cout << "Closing stream of module " << GetStreamModule(stream) << std::endl;
-		}
+			// check the master
+			if ( client != nullptr )
+			{
+				// client no longer a master
+				client->NotAMaster();
 
-		// release clients
-		ReleaseClients();
+				// notify
+				//OnStreamClose(stream->GetUserCallsign());
 
-		// and stop the queue
-		stream->ClosePacketStream();
+				std::cout << "Closing stream of module " << module << std::endl;
+				PostEvent("close", { {"Module", std::string(1, module)}, {"Client", client->GetCallsign().GetCS()} });
+			}
+		});
 	}
 }
 
+// called with the clients locked, by the router thread once a closing stream has drained,
+// or by OpenStream() when a new stream wants the module
+void CReflector::FinishClose(const char module, std::shared_ptr<CPacketStream> stream)
+{
+	std::function<void(void)> done;
+	double seconds;
+	if ( ! stream->FinishClose(done, seconds) )
+		return;
+	if (done)
+		done();
+
+	const uint64_t us = 1.0e6 * seconds;
+	const auto i = module - 'A';
+	m_Closes[i].fetch_add(1, std::memory_order_relaxed);
+	m_CloseUs[i].fetch_add(us, std::memory_order_relaxed);
+	if (us > m_CloseWorstUs[i].load(std::memory_order_relaxed))
+		m_CloseWorstUs[i].store(us, std::memory_order_relaxed);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // router threads
 
@@ -289,39 +357,156 @@ void CReflector::RouterThread(const char ThisModule)
 		return;
 	}
 	const auto streamIn = pitem->second;
+	auto &copies = m_RouterCopies[ThisModule - 'A'];
+	auto &skipped = m_RouterSkipped[ThisModule - 'A'];
+	auto &done = m_RouterDone[ThisModule - 'A'];
+
+	// who is listening, worked out again for each header and whenever the clients change
+	uint32_t listeners = 0;
+	uint64_t version = UINT64_MAX;
+
+	// packets handed to each protocol, the counters are found the first time
+	CMetricCounter *routed[NB_SUBSCRIBER_PROTOCOLS] = {};
+	auto routeLatency = CLatency::Get(ETraceStage::route, ThisModule);
+	auto tcLatency = CLatency::Get(ETraceStage::transcoder, ThisModule);
+
 	while (keep_running)
 	{
-		// wait until something shows up
-		auto packet = streamIn->PopWait();
+		// a closing stream is finished here, after everything in it has gone out
+		if (streamIn->IsClosing() && streamIn->IsDrained())
+		{
+			GetClients();	// lock clients
+			FinishClose(ThisModule, streamIn);
+			ReleaseClients();
+		}
+
+		// wait until something shows up, or time out to check keep_running
+		auto packet = streamIn->PopWait(100);
+		if (! packet)
+			continue;
 
 		packet->SetPacketModule(ThisModule);
 
-		// iterate on all protocols
-		m_Protocols.Lock();
-		for ( auto it=m_Protocols.begin(); it!=m_Protocols.end(); it++ )
+		// the copies take the trace with them
+		auto &trace = packet->Trace();
+		if (trace.rx)
 		{
-			auto copy = packet->Copy();
+			trace.route = CLatency::Now();
+			routeLatency->Record(trace.route - trace.rx);
+			if (trace.tcsent && trace.tcback)
+				tcLatency->Record(trace.tcback - trace.tcsent);
+		}
+
+		// headers go to every protocol, so their stream caches are always current,
+		// frames only go to the protocols with somebody to send them to
+		const bool isHeader = packet->IsDvHeader();
+		if (isHeader || version != m_Clients.GetSubscribersVersion())
+		{
+			version = m_Clients.GetSubscribersVersion();
+			listeners = GetListeners(ThisModule);
+		}
 
+		// iterate on all protocols, each one gets a copy,
+		// except the last one, that gets the original
+		CProtocol *last = nullptr;
+		auto push = [&](CProtocol *protocol, std::unique_ptr<CPacket> copy)
+		{
 			// if packet is header, update RPT2 according to protocol
-			if ( copy->IsDvHeader() )
+			if ( isHeader )
 			{
 				// make the protocol-patched reflector callsign
-				CCallsign csRPT = (*it)->GetReflectorCallsign();
+				CCallsign csRPT = protocol->GetReflectorCallsign();
 				csRPT.SetCSModule(ThisModule);
 				// and put it in the copy
 				(dynamic_cast<CDvHeaderPacket *>(copy.get()))->SetRpt2Callsign(csRPT);
 			}
-
-			(*it)->Push(std::move(copy));
+			auto &counter = routed[unsigned(protocol->GetProtocol())];
+			if (nullptr == counter)
+				counter = CMetrics::Counter("urfd_packets_routed_total", "Packets a module's router handed to a protocol", CMetrics::Labels({{"protocol", CMetrics::ProtocolLabel(protocol->GetProtocol())}, {"module", std::string(1, ThisModule)}}));
+			counter->Add();
+			protocol->Push(std::move(copy));
+		};
+		m_Protocols.Lock();
+		for ( auto it=m_Protocols.begin(); it!=m_Protocols.end(); it++ )
+		{
+			const auto type = unsigned((*it)->GetProtocol());
+			if ( ! isHeader && type < NB_SUBSCRIBER_PROTOCOLS && 0 == (listeners & (1u << type)) )
+			{
+				skipped.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			if ( last )
+			{
+				push(last, packet->Copy());
+				copies.fetch_add(1, std::memory_order_relaxed);
+			}
+			last = it->get();
 		}
+		if ( last )
+			push(last, std::move(packet));
 		m_Protocols.Unlock();
+		done.fetch_add(1, std::memory_order_release);
+	}
+}
+
+// frames out at the transcoder aren't waited for, they come back on its time
+bool CReflector::IsRouted(void)
+{
+	for (auto c : m_Modules)
+	{
+		auto pitem = m_Stream.find(c);
+		if (m_Stream.end() != pitem && m_RouterDone[c - 'A'].load(std::memory_order_acquire) != pitem->second->GetQueuePushed())
+			return false;
+	}
+	return true;
+}
+
+// the protocols with a client linked to the module that isn't the one talking on it
+uint32_t CReflector::GetListeners(const char module)
+{
+	auto listening = [this](EProtocol protocol, char m)
+	{
+		auto subscribers = m_Clients.GetSubscribers(protocol, m);
+		if (subscribers)
+		{
+			for (const auto &client : *subscribers)
+			{
+				if (! client->IsAMaster())
+					return true;
+			}
+		}
+		return false;
+	};
+
+	auto listeners = m_Clients.GetListening(module);
+	for (unsigned p=0; p<NB_SUBSCRIBER_PROTOCOLS; p++)
+	{
+		if ((listeners & (1u << p)) && ! listening(EProtocol(p), module))
+			listeners &= ~(1u << p);
 	}
+
+	// DPlus sends every module to all its clients, wherever they are linked,
+	// a client talking on another module isn't checked, it will be done before this stream is
+	const auto dplus = 1u << unsigned(EProtocol::dplus);
+	if (0 == (listeners & dplus))
+	{
+		const std::string slots(" ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+		for (const auto m : slots)
+		{
+			if (m != module && (m_Clients.GetListening(m) & dplus))
+			{
+				listeners |= dplus;
+				break;
+			}
+		}
+	}
+	return listeners;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // report threads
 
-#define XML_UPDATE_PERIOD 10
+#define XML_UPDATE_PERIOD 10	// in seconds, the statistics in the json report are refreshed this often
 
 void CReflector::StateReportThread()
 {
@@ -333,68 +518,116 @@ void CReflector::StateReportThread()
 		xmlpath.assign(g_Configure.GetString(g_Keys.files.xml));
 	if (g_Configure.Contains(g_Keys.files.json))
 		jsonpath.assign(g_Configure.GetString(g_Keys.files.json));
+	const auto interval = g_Configure.GetUnsigned(g_Keys.files.reportinterval);
 
-	if (xmlpath.empty() && jsonpath.empty())
+	if (xmlpath.empty() && jsonpath.empty() && ! m_Status.IsRunning())
 		return;	// nothing to do
 
+	uint64_t xmlserial = UINT64_MAX, jsonserial = UINT64_MAX;
+	CTimer statstime;
 	while (keep_running)
 	{
-		// report to xml file
-		if (! xmlpath.empty())
-		{
-			std::ofstream xmlFile;
-			xmlFile.open(xmlpath, std::ios::out | std::ios::trunc);
-			if ( xmlFile.is_open() )
-			{
-				// write xml file
-				WriteXmlFile(xmlFile);
+		// bring the changed sections of the state up to date
+		UpdateState();
+		const auto serial = m_State.GetSerial();
 
-				// and close file
-				xmlFile.close();
-			}
-			else
-			{
-				std::cout << "Failed to open " << xmlpath  << std::endl;
-			}
+		// the xml file only changes with the state
+		if (! xmlpath.empty() && serial != xmlserial)
+		{
+			std::ostringstream xml;
+			WriteXmlFile(xml);
+			if (CStateReport::Publish(xmlpath, xml.str()))
+				std::cout << "Failed to write " << xmlpath << std::endl;
+			xmlserial = serial;
 		}
 
-		// json report
-		if (!  jsonpath.empty())
+		// the json report also has statistics, that change all the time
+		if ((! jsonpath.empty() || m_Status.IsRunning()) && (serial != jsonserial || statstime.time() >= XML_UPDATE_PERIOD))
 		{
 			nlohmann::json jreport;
 			JsonReport(jreport);
-			std::ofstream jsonFile;
-			jsonFile.open(jsonpath, std::ios::out | std::ios::trunc);
-			if (jsonFile.is_open())
-			{
-				jsonFile << jreport.dump();
-				jsonFile.close();
-			}
+			auto json = jreport.dump();
+			if (! jsonpath.empty() && CStateReport::Publish(jsonpath, json))
+				std::cout << "Failed to write " << jsonpath << std::endl;
+			if (m_Status.IsRunning())
+				m_Status.SetSnapshot(std::move(json));
+			jsonserial = serial;
+			statstime.start();
 		}
 
-		// and wait a bit and do something useful at the same time
-		for (int i=0; i< XML_UPDATE_PERIOD && keep_running; i++)
-		{
 #ifndef NO_DHT
-			// update the dht data, if needed
-			if (peers_changed)
-			{
-				PutDHTPeers();
-				peers_changed = false;
-			}
-			if (clients_changed)
-			{
-				PutDHTClients();
-				clients_changed = false;
-			}
-			if (users_changed)
-			{
-				PutDHTUsers();
-				users_changed = false;
-			}
+		// update the dht data, if needed
+		if (peers_changed)
+		{
+			PutDHTPeers();
+			peers_changed = false;
+		}
+		if (clients_changed)
+		{
+			PutDHTClients();
+			clients_changed = false;
+		}
+		if (users_changed)
+		{
+			PutDHTUsers();
+			users_changed = false;
+		}
 #endif
-			std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+		// and wait a bit, but not too long to notice keep_running
+		for (unsigned ms=0; ms<interval && keep_running; ms+=100)
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::min(100u, interval - ms)));
+	}
+}
+
+// serialize the sections that have changed, each one under its own lock
+void CReflector::UpdateState(void)
+{
+	uint64_t version;
+	if (m_State.NeedsUpdate(EStateSection::peers, version))
+	{
+		std::ostringstream xml;
+		nlohmann::json json;
+		json["Peers"] = nlohmann::json::array();
+		auto peers = GetPeers();
+		for (auto pit=peers->cbegin(); pit!=peers->cend(); pit++)
+		{
+			(*pit)->WriteXml(xml);
+			(*pit)->JsonReport(json);
 		}
+		ReleasePeers();
+		m_State.Update(EStateSection::peers, version, xml.str(), std::move(json["Peers"]));
+	}
+
+	if (m_State.NeedsUpdate(EStateSection::clients, version))
+	{
+		std::ostringstream xml;
+		nlohmann::json json;
+		json["Clients"] = nlohmann::json::array();
+		auto clients = GetClients();
+		for (auto cit=clients->cbegin(); cit!=clients->cend(); cit++)
+		{
+			if ( (*cit)->IsNode() )
+				(*cit)->WriteXml(xml);
+			(*cit)->JsonReport(json);
+		}
+		ReleaseClients();
+		m_State.Update(EStateSection::clients, version, xml.str(), std::move(json["Clients"]));
+	}
+
+	if (m_State.NeedsUpdate(EStateSection::users, version))
+	{
+		std::ostringstream xml;
+		nlohmann::json json;
+		json["Users"] = nlohmann::json::array();
+		auto users = GetUsers();
+		for (auto uid=users->begin(); uid!=users->end(); uid++)
+		{
+			uid->WriteXml(xml);
+			uid->JsonReport(json);
+		}
+		ReleaseUsers();
+		m_State.Update(EStateSection::users, version, xml.str(), std::move(json["Users"]));
 	}
 }
 
@@ -403,6 +636,7 @@ void CReflector::StateReportThread()
 
 void CReflector::OnPeersChanged(void)
 {
+	m_State.Changed(EStateSection::peers);
 #ifndef NO_DHT
 	peers_changed = true;
 #endif
@@ -410,6 +644,7 @@ void CReflector::OnPeersChanged(void)
 
 void CReflector::OnClientsChanged(void)
 {
+	m_State.Changed(EStateSection::clients);
 #ifndef NO_DHT
 	clients_changed = true;
 #endif
@@ -417,6 +652,7 @@ void CReflector::OnClientsChanged(void)
 
 void CReflector::OnUsersChanged(void)
 {
+	m_State.Changed(EStateSection::users);
 #ifndef NO_DHT
 	users_changed = true;
 #endif
@@ -465,77 +701,175 @@ void CReflector::JsonReport(nlohmann::json &report)
 			report["Configure"][item.key()] = item.value();
 	}
 
-	report["Peers"] = nlohmann::json::array();
-	auto peers = GetPeers();
-	for (auto pit=peers->cbegin(); pit!=peers->cend(); pit++)
+	// peers, clients and users as of the last UpdateState()
+	m_State.JsonReport(report);
+
+	report["Sockets"] = nlohmann::json::array();
+	report["Queues"] = nlohmann::json::array();
+	report["Pacers"] = nlohmann::json::array();
+	m_Protocols.Lock();
+	for (auto pit=m_Protocols.begin(); pit!=m_Protocols.end(); pit++)
 		(*pit)->JsonReport(report);
-	ReleasePeers();
+	m_Protocols.Unlock();
 
-	report["Clients"] = nlohmann::json::array();
-	auto clients = GetClients();
-	for (auto cit=clients->cbegin(); cit!=clients->cend(); cit++)
-		(*cit)->JsonReport(report);
-	ReleaseClients();
+	for (auto &item : m_Stream)
+	{
+		SQueueStats stats;
+		item.second->GetQueueStats(stats);
+		nlohmann::json jqueue;
+		jqueue["Name"] = std::string("Module ") + item.first;
+		jqueue["Capacity"] = stats.capacity;
+		jqueue["HighWater"] = stats.highwater;
+		jqueue["Pushed"] = stats.pushed;
+		jqueue["Dropped"] = stats.dropped;
+		report["Queues"].push_back(jqueue);
+	}
 
-	report["Users"] = nlohmann::json::array();
-	auto users = GetUsers();
-	for (auto uid=users->begin(); uid!=users->end(); uid++)
-		(*uid).JsonReport(report);
-	ReleaseUsers();
+	report["Transcoder"] = nlohmann::json::array();
+	for (auto &item : m_Stream)
+		item.second->CodecJsonReport(report);
+	report["TranscoderPool"] = nlohmann::json::array();
+	m_TranscoderPool.JsonReport(report);
+
+	report["Pools"] = nlohmann::json::array();
+	std::vector<SPoolStats> pools;
+	CSlabPool::GetAllStats(pools);
+	for (const auto &stats : pools)
+	{
+		nlohmann::json jpool;
+		jpool["Name"] = stats.name;
+		jpool["BlockSize"] = stats.blocksize;
+		jpool["Slabs"] = stats.slabs;
+		jpool["InUse"] = stats.inuse;
+		jpool["HighWater"] = stats.highwater;
+		jpool["Gets"] = stats.gets;
+		jpool["HeapAllocs"] = stats.heapallocs;
+		report["Pools"].push_back(jpool);
+	}
+	report["FrameCopies"]["Shared"] = CDvFramePacket::GetSharedCopies();
+	report["FrameCopies"]["PayloadClones"] = CDvFramePacket::GetPayloadClones();
+
+	m_Status.JsonReport(report);
+	CLatency::JsonReport(report);
+
+	report["Router"] = nlohmann::json::array();
+	for (auto c : m_Modules)
+	{
+		nlohmann::json jrouter;
+		jrouter["Module"] = std::string(1, c);
+		jrouter["Listeners"] = GetListeners(c);
+		jrouter["Copies"] = m_RouterCopies[c - 'A'].load(std::memory_order_relaxed);
+		jrouter["CopiesAvoided"] = m_RouterSkipped[c - 'A'].load(std::memory_order_relaxed);
+		jrouter["Closes"] = m_Closes[c - 'A'].load(std::memory_order_relaxed);
+		jrouter["CloseTotalUs"] = m_CloseUs[c - 'A'].load(std::memory_order_relaxed);
+		jrouter["CloseWorstUs"] = m_CloseWorstUs[c - 'A'].load(std::memory_order_relaxed);
+		report["Router"].push_back(jrouter);
+	}
+
+	SLockStats lstats;
+	m_Clients.GetLockStats(lstats);
+	report["Locks"]["Clients"]["Acquired"] = lstats.acquired;
+	report["Locks"]["Clients"]["Contended"] = lstats.contended;
+	report["Locks"]["Clients"]["WaitNs"] = lstats.waitns;
+	report["Locks"]["Clients"]["MaxWaitNs"] = lstats.maxwaitns;
+	report["Locks"]["Clients"]["SubscribersVersion"] = m_Clients.GetSubscribersVersion();
+	m_Users.GetLockStats(lstats);
+	report["Locks"]["Users"]["Acquired"] = lstats.acquired;
+	report["Locks"]["Users"]["Contended"] = lstats.contended;
+	report["Locks"]["Users"]["WaitNs"] = lstats.waitns;
+	report["Locks"]["Users"]["MaxWaitNs"] = lstats.maxwaitns;
+	m_Peers.GetLockStats(lstats);
+	report["Locks"]["Peers"]["Acquired"] = lstats.acquired;
+	report["Locks"]["Peers"]["Contended"] = lstats.contended;
+	report["Locks"]["Peers"]["WaitNs"] = lstats.waitns;
+	report["Locks"]["Peers"]["MaxWaitNs"] = lstats.maxwaitns;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// metrics
+
+void CReflector::RegisterMetrics(void)
+{
+	for (auto c : m_Modules)
+	{
+		const auto labels = CMetrics::Labels({{"module", std::string(1, c)}});
+		const auto i = c - 'A';
+		CMetrics::CounterFn("urfd_router_copies_total", "Packet copies the router made", labels, this, [this, i]() { return double(m_RouterCopies[i].load(std::memory_order_relaxed)); });
+		CMetrics::CounterFn("urfd_router_copies_avoided_total", "Packet copies skipped for protocols with nobody listening", labels, this, [this, i]() { return double(m_RouterSkipped[i].load(std::memory_order_relaxed)); });
+		CMetrics::CounterFn("urfd_stream_closes_total", "Streams closed", labels, this, [this, i]() { return double(m_Closes[i].load(std::memory_order_relaxed)); });
+		CMetrics::CounterFn("urfd_stream_close_seconds_total", "Time closing streams spent draining", labels, this, [this, i]() { return 1.0e-6 * m_CloseUs[i].load(std::memory_order_relaxed); });
+		const auto stream = m_Stream[c];
+		CMetrics::GaugeFn("urfd_queue_depth", "Packets waiting in a queue", CMetrics::Labels({{"queue", std::string("Module ") + c}}), this, [stream]() { return double(stream->GetQueueSize()); });
+	}
+
+	CMetrics::GaugeFn("urfd_streams_active", "Modules with an open stream", "", this, [this]()
+	{
+		unsigned n = 0;
+		for (const auto &item : m_Stream)
+		{
+			if (item.second->IsOpen())
+				n++;
+		}
+		return double(n);
+	});
+
+	// the subscriber snapshots are read without the clients lock
+	for (unsigned p=unsigned(EProtocol::dextra); p<NB_SUBSCRIBER_PROTOCOLS; p++)
+	{
+		const auto protocol = EProtocol(p);
+		CMetrics::GaugeFn("urfd_clients", "Linked clients", CMetrics::Labels({{"protocol", CMetrics::ProtocolLabel(protocol)}}), this, [this, protocol]()
+		{
+			size_t n = 0;
+			for (auto c : m_Modules)
+			{
+				auto subscribers = m_Clients.GetSubscribers(protocol, c);
+				if (subscribers)
+					n += subscribers->size();
+			}
+			return double(n);
+		});
+	}
+
+	const std::pair<const char *, std::function<void(SLockStats &)>> locks[] = {
+		{ "clients", [this](SLockStats &s) { m_Clients.GetLockStats(s); } },
+		{ "users",   [this](SLockStats &s) { m_Users.GetLockStats(s); } },
+		{ "peers",   [this](SLockStats &s) { m_Peers.GetLockStats(s); } }
+	};
+	for (const auto &lock : locks)
+	{
+		const auto labels = CMetrics::Labels({{"lock", lock.first}});
+		const auto stats = lock.second;
+		CMetrics::CounterFn("urfd_lock_acquired_total", "Times a list lock was taken", labels, this, [stats]() { SLockStats s; stats(s); return double(s.acquired); });
+		CMetrics::CounterFn("urfd_lock_contended_total", "Times a list lock had to be waited for", labels, this, [stats]() { SLockStats s; stats(s); return double(s.contended); });
+		CMetrics::CounterFn("urfd_lock_wait_seconds_total", "Time spent waiting for a list lock", labels, this, [stats]() { SLockStats s; stats(s); return 1.0e-9 * s.waitns; });
+	}
 }
 
-void CReflector::WriteXmlFile(std::ofstream &xmlFile)
+void CReflector::WriteXmlFile(std::ostream &xmlFile)
 {
 	// write header
-	xmlFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << std::endl;
+	xmlFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
 
 	// software version
-	xmlFile << "<Version>" << g_Version << "</Version>" << std::endl;
+	xmlFile << "<Version>" << g_Version << "</Version>\n";
 
 	CCallsign cs = m_Callsign;
 	cs.PatchCallsign(0, "XLX", 3);
 
 	// linked peers
-	xmlFile << "<" << cs << "linked peers>" << std::endl;
-	// lock
-	CPeers *peers = GetPeers();
-	// iterate on peers
-	for ( auto pit=peers->cbegin(); pit!=peers->cend(); pit++ )
-	{
-		(*pit)->WriteXml(xmlFile);
-	}
-	// unlock
-	ReleasePeers();
-	xmlFile << "</" << cs << "linked peers>" << std::endl;
+	xmlFile << "<" << cs << "linked peers>\n";
+	xmlFile << m_State.GetXml(EStateSection::peers);
+	xmlFile << "</" << cs << "linked peers>\n";
 
 	// linked nodes
-	xmlFile << "<" << cs << "linked nodes>" << std::endl;
-	// lock
-	CClients *clients = GetClients();
-	// iterate on clients
-	for ( auto cit=clients->cbegin(); cit!=clients->cend(); cit++ )
-	{
-		if ( (*cit)->IsNode() )
-		{
-			(*cit)->WriteXml(xmlFile);
-		}
-	}
-	// unlock
-	ReleaseClients();
-	xmlFile << "</" << cs << "linked nodes>" << std::endl;
+	xmlFile << "<" << cs << "linked nodes>\n";
+	xmlFile << m_State.GetXml(EStateSection::clients);
+	xmlFile << "</" << cs << "linked nodes>\n";
 
 	// last heard users
-	xmlFile << "<" << cs << "heard users>" << std::endl;
-	// lock
-	CUsers *users = GetUsers();
-	// iterate on users
-	for ( auto it=users->begin(); it!=users->end(); it++ )
-	{
-		it->WriteXml(xmlFile);
-	}
-	// unlock
-	ReleaseUsers();
-	xmlFile << "</" << cs << "heard users>" << std::endl;
+	xmlFile << "<" << cs << "heard users>\n";
+	xmlFile << m_State.GetXml(EStateSection::users);
+	xmlFile << "</" << cs << "heard users>\n";
 }
 
 #ifndef NO_DHT
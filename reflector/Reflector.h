@@ -25,6 +25,9 @@
 #include "Peers.h"
 #include "Protocols.h"
 #include "PacketStream.h"
+#include "StateReport.h"
+#include "StatusServer.h"
+#include "Capture.h"
 
 #ifndef NO_DHT
 #include "urfd-dht-values.h"
@@ -56,6 +59,20 @@ public:
 	// clients
 	CClients *GetClients(void)                      { m_Clients.Lock(); return &m_Clients; }
 	void      ReleaseClients(void)                  { m_Clients.Unlock(); }
+	// lock-free subscriber snapshots, see CClients
+	std::shared_ptr<const ClientVector> GetSubscribers(EProtocol p, char m) const { return m_Clients.GetSubscribers(p, m); }
+	uint64_t  GetSubscribersVersion(void) const     { return m_Clients.GetSubscribersVersion(); }
+	// the protocols a module's stream has to go to
+	uint32_t  GetListeners(const char);
+
+	// protocols, for a replay
+	CProtocols *GetProtocols(void)                  { m_Protocols.Lock(); return &m_Protocols; }
+	void      ReleaseProtocols(void)                { m_Protocols.Unlock(); }
+	// the routers have handed on everything the streams took in
+	bool      IsRouted(void);
+
+	// the capture file, for every received datagram
+	void Capture(EProtocol p, const CIp &ip, uint64_t time, const CBuffer &buf) { if (m_Capture.IsOpen()) m_Capture.Record(p, ip, time, buf); }
 
 	// peers
 	CPeers   *GetPeers(void)                        { m_Peers.Lock(); return &m_Peers; }
@@ -79,6 +96,8 @@ public:
 	void OnPeersChanged(void);
 	void OnClientsChanged(void);
 	void OnUsersChanged(void);
+	// for the status server's event subscribers
+	void PostEvent(const char *type, const nlohmann::json &data) { m_Status.Event(type, data); }
 #ifndef NO_DHT
 	void GetDHTConfig(const std::string &cs);
 #endif
@@ -94,15 +113,20 @@ protected:
 
 	// threads
 	void RouterThread(const char);
+	void FinishClose(const char, std::shared_ptr<CPacketStream>);
 	void StateReportThread(void);
 
+	// metrics read from the modules and the lists
+	void RegisterMetrics(void);
+
 	// streams
 	std::shared_ptr<CPacketStream> GetStream(char);
 	bool IsStreamOpen(const std::unique_ptr<CDvHeaderPacket> &);
 	char GetStreamModule(std::shared_ptr<CPacketStream>);
 
 	// xml helpers
-	void WriteXmlFile(std::ofstream &);
+	void UpdateState(void);
+	void WriteXmlFile(std::ostream &);
 	void JsonReport(nlohmann::json &report);
 
 	// identity
@@ -114,13 +138,25 @@ protected:
 	CClients   m_Clients;          // list of linked repeaters/nodes/peers's modules
 	CPeers     m_Peers;            // list of linked peers
 	CProtocols m_Protocols;        // list of supported protocol handlers
+	CStateReport m_State;          // what the dashboard sees of them
+	CStatusServer m_Status;        // and where it can get it live
+	CCapture   m_Capture;          // what came in, for a replay
 
 	// queues
 	std::unordered_map<char, std::shared_ptr<CPacketStream>> m_Stream;
+	CTranscoderPool m_TranscoderPool;
+	std::vector<std::unique_ptr<CCodecEngine>> m_CodecEngines;
 
 	// threads
 	std::atomic<bool> keep_running;
 	std::unordered_map<char, std::future<void>> m_RouterFuture;
+
+	// router fan-out, by module
+	std::atomic<uint64_t> m_RouterCopies[26], m_RouterSkipped[26];
+	// and the packets each router is done with
+	std::atomic<uint64_t> m_RouterDone[26];
+	// stream closes, and how long they took to drain, by module
+	std::atomic<uint64_t> m_Closes[26], m_CloseUs[26], m_CloseWorstUs[26];
 	std::future<void> m_XmlReportFuture;
 
 #ifndef NO_DHT
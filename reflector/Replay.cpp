@@ -0,0 +1,168 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <thread>
+#include <sys/resource.h>
+
+#include "Global.h"
+#include "Replay.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+CReplay::CReplay() : m_Protocols(), m_Speed(0.0), m_Datagrams(), m_Bytes(0), m_Unhandled(0), m_CaptureNs(0), m_ReplayNs(0), m_CpuUs(0) {}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// run
+
+static uint64_t CpuUs(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return uint64_t(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ull + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+bool CReplay::Run(const std::string &path, double speed)
+{
+	CCaptureReader reader;
+	if (reader.Open(path))
+		return true;
+	m_Path.assign(path);
+	m_Speed = speed;
+
+	// the protocols that are running, by what they are
+	auto protocols = g_Reflector.GetProtocols();
+	for (auto it=protocols->begin(); it!=protocols->end(); it++)
+	{
+		const auto p = unsigned((*it)->GetProtocol());
+		if (p < REPLAY_PROTOCOLS)
+			m_Protocols[p] = it->get();
+	}
+	g_Reflector.ReleaseProtocols();
+
+	const auto cpu = CpuUs();
+	const auto wall = CLatency::Now();
+	m_Start = CClock::Now();
+	uint64_t first = 0;
+	bool started = false;
+	while (auto record = reader.Next())
+	{
+		if (! started)
+		{
+			first = record->time;
+			started = true;
+		}
+		const auto offset = (record->time > first) ? record->time - first : 0;
+		m_CaptureNs = offset;
+
+		const auto p = unsigned(record->protocol);
+		auto protocol = (p < REPLAY_PROTOCOLS) ? m_Protocols[p] : nullptr;
+		if (nullptr == protocol)
+		{
+			m_Unhandled++;
+			continue;
+		}
+
+		// at a set speed, wait for its time to come
+		if (m_Speed > 0.0)
+		{
+			const auto due = wall + uint64_t(offset / m_Speed);
+			const auto now = CLatency::Now();
+			if (due > now)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+		}
+		CatchUp(offset);
+
+		m_Datagrams[p]++;
+		m_Bytes += record->size;
+		while (! protocol->Inject(record))
+			std::this_thread::yield();
+	}
+
+	Drain();
+	m_ReplayNs = CLatency::Now() - wall;
+	m_CpuUs = CpuUs() - cpu;
+
+	// let the last streams close, on the clock they go by
+	CClock::Skip(uint64_t(REPLAY_SETTLE_MS) * 1000000ull);
+	for (auto protocol : m_Protocols)
+	{
+		if (protocol)
+			protocol->Wake();
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(REPLAY_SETTLE_MS / 4));
+	return false;
+}
+
+// the clock is behind the capture when the replay goes faster than real time
+void CReplay::CatchUp(uint64_t offset)
+{
+	const auto due = m_Start + std::chrono::nanoseconds(offset);
+	if (CClock::Now() >= due)
+		return;
+
+	// everything before it has to be handled on the old time
+	Drain();
+	const auto now = CClock::Now();
+	if (due > now)
+		CClock::Skip(std::chrono::duration_cast<std::chrono::nanoseconds>(due - now).count());
+}
+
+// in the order the packets go: received, routed, then sent
+void CReplay::Drain(void)
+{
+	for (auto protocol : m_Protocols)
+	{
+		while (protocol && ! protocol->IsInjectedDone())
+			std::this_thread::yield();
+	}
+	while (! g_Reflector.IsRouted())
+		std::this_thread::yield();
+	for (auto protocol : m_Protocols)
+	{
+		while (protocol && ! protocol->IsQueueDone())
+			std::this_thread::yield();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// report
+
+void CReplay::JsonReport(nlohmann::json &report) const
+{
+	report["Capture"] = m_Path;
+	if (m_Speed > 0.0)
+		report["Speed"] = m_Speed;
+	else
+		report["Speed"] = "max";
+
+	uint64_t total = 0;
+	report["Protocols"] = nlohmann::json::object();
+	for (unsigned p=0; p<REPLAY_PROTOCOLS; p++)
+	{
+		if (m_Datagrams[p])
+			report["Protocols"][CMetrics::ProtocolLabel(EProtocol(p))] = m_Datagrams[p];
+		total += m_Datagrams[p];
+	}
+	report["Datagrams"] = total;
+	report["Bytes"] = m_Bytes;
+	report["Unhandled"] = m_Unhandled;
+	report["CaptureSeconds"] = 1.0e-9 * m_CaptureNs;
+	report["ReplaySeconds"] = 1.0e-9 * m_ReplayNs;
+	report["DatagramsPerSecond"] = m_ReplayNs ? 1.0e9 * total / m_ReplayNs : 0.0;
+	report["CpuSeconds"] = 1.0e-6 * m_CpuUs;
+	CLatency::JsonReport(report);
+}
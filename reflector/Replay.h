@@ -0,0 +1,67 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <nlohmann/json.hpp>
+
+#include "Defines.h"
+#include "Capture.h"
+#include "Clock.h"
+
+class CProtocol;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define REPLAY_SETTLE_MS    2000    // after the last datagram, for the streams to close
+#define REPLAY_PROTOCOLS    (unsigned(EProtocol::m17) + 1)
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// Feeds a capture file to the running reflector's protocols, each datagram as if
+// its socket had just received it. The clock the timers go by follows the capture,
+// at real time it just runs, faster than that it's moved forward to the time of each
+// datagram, but only after the reflector is done with everything before it. So the
+// streams and the timeouts see the same timing at any speed.
+
+class CReplay
+{
+public:
+	CReplay();
+
+	// speed is a multiple of real time, 0 is as fast as the protocols can take it
+	// true on failure
+	bool Run(const std::string &path, double speed);
+
+	void JsonReport(nlohmann::json &report) const;
+
+protected:
+	// wait until every injected datagram has been handled, routed and sent
+	void Drain(void);
+	// move the clock to a time in the capture
+	void CatchUp(uint64_t offset);
+
+	// data
+	CProtocol *m_Protocols[REPLAY_PROTOCOLS];
+	std::string m_Path;
+	double   m_Speed;
+	CClock::time_point m_Start;     // on the clock, when the capture started
+	uint64_t m_Datagrams[REPLAY_PROTOCOLS];
+	uint64_t m_Bytes, m_Unhandled, m_CaptureNs, m_ReplayNs, m_CpuUs;
+};
@@ -0,0 +1,322 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <climits>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/************************************************************
+ * Bounded lock-free packet queues, primarily designed for
+ * std::unique_ptr, a failed Pop() returns nullptr.
+ *
+ * CRingQueue is multi-producer (Vyukov's bounded queue),
+ * for queues fed by more than one thread.
+ * CSpscRingQueue is single-producer single-consumer.
+ *
+ * When full, a backpressure queue refuses the new element
+ * and a dropoldest queue throws away its oldest one. Either
+ * way the casualty is counted in the dropped statistic.
+\************************************************************/
+
+enum class EQueuePolicy { backpressure, dropoldest };
+
+struct SQueueStats
+{
+	uint64_t pushed, dropped;
+	size_t   highwater, capacity;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// common to both rings: statistics and a futex to block a consumer
+
+class CRingQueueBase
+{
+public:
+	CRingQueueBase(size_t capacity) : m_Capacity(RoundUp(capacity)), m_Mask(m_Capacity - 1), m_Epoch(0), m_Sleepers(0), m_Pushed(0), m_Dropped(0), m_HighWater(0) {}
+
+	void GetStats(SQueueStats &stats) const
+	{
+		stats.pushed    = m_Pushed.load(std::memory_order_relaxed);
+		stats.dropped   = m_Dropped.load(std::memory_order_relaxed);
+		stats.highwater = m_HighWater.load(std::memory_order_relaxed);
+		stats.capacity  = m_Capacity;
+	}
+
+	// every element counted here can be popped by whoever reads it
+	uint64_t GetPushed(void) const { return m_Pushed.load(std::memory_order_acquire); }
+
+	// wake a consumer waiting in PopWait(), it will come back empty handed
+	void Wake(void)
+	{
+		// a consumer that read the old epoch will not sleep through this
+		m_Epoch.fetch_add(1, std::memory_order_seq_cst);
+		if (m_Sleepers.load(std::memory_order_seq_cst))
+			syscall(SYS_futex, (uint32_t *)&m_Epoch, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+protected:
+	static size_t RoundUp(size_t n)
+	{
+		size_t c = 2;
+		while (c < n)
+			c <<= 1;
+		return c;
+	}
+
+	// producer side, after an element is published
+	void Published(size_t size)
+	{
+		m_Pushed.fetch_add(1, std::memory_order_release);
+		auto hw = m_HighWater.load(std::memory_order_relaxed);
+		while (size > hw && ! m_HighWater.compare_exchange_weak(hw, size, std::memory_order_relaxed))
+			;
+		Wake();
+	}
+
+	// consumer side, returns the epoch to hand to Sleep()
+	uint32_t PrepareSleep(void)
+	{
+		m_Sleepers.fetch_add(1, std::memory_order_seq_cst);
+		return m_Epoch.load(std::memory_order_seq_cst);
+	}
+
+	// sleep until the epoch moves on or the timeout, then cancel PrepareSleep()
+	void Sleep(uint32_t epoch, int timeout_ms)
+	{
+		struct timespec ts;
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		syscall(SYS_futex, (uint32_t *)&m_Epoch, FUTEX_WAIT_PRIVATE, epoch, (timeout_ms < 0) ? nullptr : &ts, nullptr, 0);
+		m_Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	// data
+	const size_t m_Capacity, m_Mask;
+	std::atomic<uint32_t> m_Epoch, m_Sleepers;
+	std::atomic<uint64_t> m_Pushed, m_Dropped;
+	std::atomic<size_t>   m_HighWater;
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the futex word must be a plain 32-bit integer");
+
+////////////////////////////////////////////////////////////////////////////////////////
+// multi-producer ring
+
+template <class T>
+class CRingQueue : public CRingQueueBase
+{
+public:
+	CRingQueue(size_t capacity, EQueuePolicy policy) : CRingQueueBase(capacity), m_Policy(policy), m_Cells(new SCell[m_Capacity]), m_Head(0), m_Tail(0)
+	{
+		for (size_t i=0; i<m_Capacity; i++)
+			m_Cells[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	~CRingQueue(void) {}
+
+	// returns false if the element was refused
+	bool Push(T t)
+	{
+		auto pos = m_Tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			auto &cell = m_Cells[pos & m_Mask];
+			const auto seq = cell.seq.load(std::memory_order_acquire);
+			const auto diff = intptr_t(seq) - intptr_t(pos);
+			if (0 == diff)
+			{
+				// the cell is free, claim it
+				if (m_Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.data = std::move(t);
+					cell.seq.store(pos + 1, std::memory_order_release);
+					const auto head = m_Head.load(std::memory_order_relaxed);
+					Published((head < pos + 1) ? pos + 1 - head : 0);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// full
+				if (EQueuePolicy::backpressure == m_Policy)
+				{
+					m_Dropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				// make room, unless the consumer beat us to it
+				if (Pop())
+					m_Dropped.fetch_add(1, std::memory_order_relaxed);
+				pos = m_Tail.load(std::memory_order_relaxed);
+			}
+			else
+				pos = m_Tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	T Pop(void)
+	{
+		auto pos = m_Head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			auto &cell = m_Cells[pos & m_Mask];
+			const auto seq = cell.seq.load(std::memory_order_acquire);
+			const auto diff = intptr_t(seq) - intptr_t(pos + 1);
+			if (0 == diff)
+			{
+				// a dropoldest producer may also be popping
+				if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					T val = std::move(cell.data);
+					cell.seq.store(pos + m_Capacity, std::memory_order_release);
+					return val;
+				}
+			}
+			else if (diff < 0)
+				return nullptr;	// empty
+			else
+				pos = m_Head.load(std::memory_order_relaxed);
+		}
+	}
+
+	// If the queue is empty, wait until an element is available or the timeout (in ms, negative is forever)
+	T PopWait(int timeout_ms = -1)
+	{
+		T val = Pop();
+		if (! val)
+		{
+			const auto epoch = PrepareSleep();
+			val = Pop();
+			if (! val)
+			{
+				Sleep(epoch, timeout_ms);
+				val = Pop();
+			}
+			else
+				m_Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+		}
+		return val;
+	}
+
+	bool IsEmpty(void) const
+	{
+		return m_Head.load(std::memory_order_acquire) >= m_Tail.load(std::memory_order_acquire);
+	}
+
+	// only a snapshot, producers and the consumer keep going
+	size_t GetSize(void) const
+	{
+		const auto head = m_Head.load(std::memory_order_acquire);
+		const auto tail = m_Tail.load(std::memory_order_acquire);
+		return (tail > head) ? tail - head : 0;
+	}
+
+private:
+	struct SCell
+	{
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	const EQueuePolicy m_Policy;
+	std::unique_ptr<SCell[]> m_Cells;
+	alignas(64) std::atomic<size_t> m_Head;
+	alignas(64) std::atomic<size_t> m_Tail;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// single-producer single-consumer ring
+
+template <class T>
+class CSpscRingQueue : public CRingQueueBase
+{
+public:
+	// only the consumer can remove elements, so this is always a backpressure queue
+	CSpscRingQueue(size_t capacity) : CRingQueueBase(capacity), m_Cells(new T[m_Capacity]), m_Head(0), m_Tail(0) {}
+
+	~CSpscRingQueue(void) {}
+
+	// returns false if the element was refused
+	bool Push(T t)
+	{
+		const auto tail = m_Tail.load(std::memory_order_relaxed);
+		const auto size = tail - m_Head.load(std::memory_order_acquire);
+		if (size >= m_Capacity)
+		{
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		m_Cells[tail & m_Mask] = std::move(t);
+		m_Tail.store(tail + 1, std::memory_order_release);
+		Published(size + 1);
+		return true;
+	}
+
+	T Pop(void)
+	{
+		const auto head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire))
+			return nullptr;
+		T val = std::move(m_Cells[head & m_Mask]);
+		m_Head.store(head + 1, std::memory_order_release);
+		return val;
+	}
+
+	// If the queue is empty, wait until an element is available or the timeout (in ms, negative is forever)
+	T PopWait(int timeout_ms = -1)
+	{
+		T val = Pop();
+		if (! val)
+		{
+			const auto epoch = PrepareSleep();
+			val = Pop();
+			if (! val)
+			{
+				Sleep(epoch, timeout_ms);
+				val = Pop();
+			}
+			else
+				m_Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+		}
+		return val;
+	}
+
+	bool IsEmpty(void) const
+	{
+		return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+	}
+
+	size_t GetSize(void) const
+	{
+		return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire);
+	}
+
+	bool IsFull(void) const
+	{
+		return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire) >= m_Capacity;
+	}
+
+private:
+	std::unique_ptr<T[]> m_Cells;
+	alignas(64) std::atomic<size_t> m_Head;
+	alignas(64) std::atomic<size_t> m_Tail;
+};
@@ -0,0 +1,110 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <new>
+
+#include "SlabPool.h"
+
+// every pool, for the reports
+static std::mutex s_PoolsMutex;
+static std::vector<CSlabPool *> s_Pools;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+// blocks are rounded up so that each one is suitably aligned for anything
+CSlabPool::CSlabPool(const char *name, size_t blocksize) : m_Name(name), m_BlockSize((blocksize + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1)), m_FreeList(nullptr), m_Slabs(0), m_InUse(0), m_HighWater(0), m_Gets(0), m_HeapAllocs(0) {}
+
+CSlabPool *CSlabPool::Create(const char *name, size_t blocksize)
+{
+	auto pool = new CSlabPool(name, blocksize);
+	std::lock_guard<std::mutex> lock(s_PoolsMutex);
+	s_Pools.push_back(pool);
+	return pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// allocation
+
+void *CSlabPool::Get(size_t size)
+{
+	if (size > m_BlockSize)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_HeapAllocs++;
+		return ::operator new(size);
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (nullptr == m_FreeList)
+	{
+		// carve a new slab into blocks, each free block holds the pointer to the next one
+		auto slab = (uint8_t *)::operator new(m_BlockSize * SLAB_BLOCKS);
+		for (unsigned i=0; i<SLAB_BLOCKS; i++)
+		{
+			auto block = slab + i * m_BlockSize;
+			*(void **)block = m_FreeList;
+			m_FreeList = block;
+		}
+		m_Slabs++;
+	}
+	auto block = m_FreeList;
+	m_FreeList = *(void **)block;
+	m_Gets++;
+	if (++m_InUse > m_HighWater)
+		m_HighWater = m_InUse;
+	return block;
+}
+
+void CSlabPool::Put(void *p, size_t size)
+{
+	if (nullptr == p)
+		return;
+
+	if (size > m_BlockSize)
+	{
+		::operator delete(p);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	*(void **)p = m_FreeList;
+	m_FreeList = p;
+	m_InUse--;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// stats
+
+void CSlabPool::GetStats(SPoolStats &stats) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	stats.name       = m_Name;
+	stats.blocksize  = m_BlockSize;
+	stats.slabs      = m_Slabs;
+	stats.inuse      = m_InUse;
+	stats.highwater  = m_HighWater;
+	stats.gets       = m_Gets;
+	stats.heapallocs = m_HeapAllocs;
+}
+
+void CSlabPool::GetAllStats(std::vector<SPoolStats> &all)
+{
+	std::lock_guard<std::mutex> lock(s_PoolsMutex);
+	all.resize(s_Pools.size());
+	for (size_t i=0; i<s_Pools.size(); i++)
+		s_Pools[i]->GetStats(all[i]);
+}
@@ -0,0 +1,91 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <memory>
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define SLAB_BLOCKS     64      // blocks carved from each slab
+
+struct SPoolStats
+{
+	std::string name;
+	size_t   blocksize, slabs, inuse, highwater;
+	uint64_t gets, heapallocs;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// A fixed block size free list, grown a slab at a time and never shrunk, so
+// after the first few streams, packets don't touch the heap at all.
+// Requests that don't fit in a block go to the heap and are counted.
+// Pools live until the program exits, so they are created with Create().
+
+class CSlabPool
+{
+public:
+	// create a named pool, it's never destroyed
+	static CSlabPool *Create(const char *name, size_t blocksize);
+
+	// allocation
+	void *Get(size_t size);
+	void  Put(void *p, size_t size);
+
+	// stats
+	void GetStats(SPoolStats &stats) const;
+	static void GetAllStats(std::vector<SPoolStats> &all);
+
+protected:
+	CSlabPool(const char *name, size_t blocksize);
+
+	// data
+	const std::string m_Name;
+	const size_t m_BlockSize;
+	mutable std::mutex m_Mutex;
+	void  *m_FreeList;
+	size_t m_Slabs, m_InUse, m_HighWater;
+	uint64_t m_Gets, m_HeapAllocs;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// allocator for std::allocate_shared(), so the control block shares the pool block
+
+template <class T>
+class CSlabAllocator
+{
+public:
+	using value_type = T;
+
+	CSlabAllocator(CSlabPool *pool) noexcept : m_Pool(pool) {}
+	template <class U> CSlabAllocator(const CSlabAllocator<U> &other) noexcept : m_Pool(other.m_Pool) {}
+
+	T *allocate(size_t n)               { return (T *)m_Pool->Get(n * sizeof(T)); }
+	void deallocate(T *p, size_t n)     { m_Pool->Put(p, n * sizeof(T)); }
+
+	template <class U> bool operator==(const CSlabAllocator<U> &other) const { return m_Pool == other.m_Pool; }
+	template <class U> bool operator!=(const CSlabAllocator<U> &other) const { return m_Pool != other.m_Pool; }
+
+	CSlabPool *m_Pool;
+};
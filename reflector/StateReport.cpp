@@ -0,0 +1,99 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <fstream>
+
+#include "StateReport.h"
+
+// the json arrays the sections go to
+static const char *s_JsonNames[STATE_SECTIONS] = { "Peers", "Clients", "Users" };
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+// every section starts out of date
+CStateReport::CStateReport() : m_Serial(0)
+{
+	for (int i=0; i<STATE_SECTIONS; i++)
+	{
+		m_Version[i] = 1;
+		m_Section[i].version = 0;
+		m_Section[i].json = nlohmann::json::array();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// update
+
+bool CStateReport::NeedsUpdate(EStateSection s, uint64_t &version) const
+{
+	// read before the section is serialized, so a change while that happens isn't lost
+	version = m_Version[int(s)].load();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return version != m_Section[int(s)].version;
+}
+
+void CStateReport::Update(EStateSection s, uint64_t version, std::string &&xml, nlohmann::json &&json)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto &section = m_Section[int(s)];
+	section.version = version;
+	section.xml = std::move(xml);
+	section.json = std::move(json);
+	m_Serial.fetch_add(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// get
+
+std::string CStateReport::GetXml(EStateSection s) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Section[int(s)].xml;
+}
+
+void CStateReport::JsonReport(nlohmann::json &report) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (int i=0; i<STATE_SECTIONS; i++)
+		report[s_JsonNames[i]] = m_Section[i].json;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// files
+
+bool CStateReport::Publish(const std::string &path, const std::string &contents)
+{
+	const std::string tmp(path + ".tmp");
+	std::ofstream file(tmp, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (! file.is_open())
+		return true;
+	file.write(contents.data(), contents.size());
+	file.close();
+	if (file.fail())
+	{
+		std::remove(tmp.c_str());
+		return true;
+	}
+	if (std::rename(tmp.c_str(), path.c_str()))
+	{
+		std::remove(tmp.c_str());
+		return true;
+	}
+	return false;
+}
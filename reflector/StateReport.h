@@ -0,0 +1,73 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <nlohmann/json.hpp>
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+// the parts of the reflector's state that the dashboard shows
+enum class EStateSection { peers, clients, users };
+#define STATE_SECTIONS 3
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// The dashboard's view of the reflector. The change notifications bump the version
+// of their section, and only a section whose version has moved is serialized again,
+// so the report thread takes a lock only for what has changed. The report files are
+// written to a temporary and renamed into place, a reader never sees half of one.
+
+class CStateReport
+{
+public:
+	CStateReport();
+
+	// any thread
+	void     Changed(EStateSection s)               { m_Version[int(s)].fetch_add(1); }
+	uint64_t GetSerial(void) const                  { return m_Serial.load(); }
+
+	// the report thread, true if the section is out of date, and the version it will be brought up to
+	bool NeedsUpdate(EStateSection s, uint64_t &version) const;
+	void Update(EStateSection s, uint64_t version, std::string &&xml, nlohmann::json &&json);
+
+	// the cached sections
+	std::string GetXml(EStateSection s) const;
+	void JsonReport(nlohmann::json &report) const;
+
+	// write to a temporary next to path, then rename it over path, true on failure
+	static bool Publish(const std::string &path, const std::string &contents);
+
+protected:
+	struct SSection
+	{
+		uint64_t       version;	// of what's cached
+		std::string    xml;
+		nlohmann::json json;
+	};
+
+	// data
+	std::atomic<uint64_t> m_Version[STATE_SECTIONS];
+	std::atomic<uint64_t> m_Serial;	// bumped by every Update()
+	mutable std::mutex m_Mutex;
+	SSection m_Section[STATE_SECTIONS];
+};
@@ -0,0 +1,381 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "StatusServer.h"
+#include "Metrics.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+CStatusServer::CStatusServer() : m_ListenFd(-1), m_Running(false), m_Generation(0), m_Boot(time(nullptr)), m_Events(STATUS_EVENT_QUEUE, EQueuePolicy::dropoldest), m_Subscribers(0), m_EventId(0), m_Requests(0), m_NotModified(0), m_EventsSent(0), m_Dropped(0) {}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// destructor
+
+CStatusServer::~CStatusServer()
+{
+	Stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// start & stop
+
+bool CStatusServer::Start(uint16_t port)
+{
+	m_ListenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_ListenFd < 0)
+	{
+		std::cerr << "Status server socket() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+
+	const int on = 1;
+	setsockopt(m_ListenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	// it's for the dashboard on this machine, so only the loopback
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(m_ListenFd, (struct sockaddr *)&addr, sizeof(addr)) || listen(m_ListenFd, 16))
+	{
+		std::cerr << "Status server can't listen on 127.0.0.1:" << port << ": " << strerror(errno) << std::endl;
+		close(m_ListenFd);
+		m_ListenFd = -1;
+		return true;
+	}
+
+	if (! m_Reactor.Open() || ! m_Reactor.Add(m_ListenFd))
+	{
+		close(m_ListenFd);
+		m_ListenFd = -1;
+		return true;
+	}
+
+	m_Running = true;
+	try
+	{
+		m_Future = std::async(std::launch::async, &CStatusServer::Thread, this);
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << "Cannot start the status server thread: " << e.what() << std::endl;
+		m_Running = false;
+		return true;
+	}
+
+	std::cout << "Status server listening on 127.0.0.1:" << port << std::endl;
+	return false;
+}
+
+void CStatusServer::Stop(void)
+{
+	if (m_Running)
+	{
+		m_Running = false;
+		m_Reactor.Notify();
+	}
+	if (m_Future.valid())
+		m_Future.get();
+	if (m_ListenFd >= 0)
+	{
+		close(m_ListenFd);
+		m_ListenFd = -1;
+	}
+	m_Reactor.Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// snapshot & events
+
+void CStatusServer::SetSnapshot(std::string &&json)
+{
+	auto snapshot = std::make_shared<SSnapshot>();
+	snapshot->body = std::move(json);
+	std::ostringstream etag;
+	etag << '"' << std::hex << m_Boot << '-' << ++m_Generation << '"';
+	snapshot->etag = etag.str();
+
+	std::lock_guard<std::mutex> lock(m_SnapshotMutex);
+	m_Snapshot = snapshot;
+}
+
+void CStatusServer::Event(const char *type, const nlohmann::json &data)
+{
+	// nobody to tell
+	if (0 == m_Subscribers.load(std::memory_order_relaxed))
+		return;
+
+	// the server thread puts the id in front
+	std::unique_ptr<std::string> event(new std::string("event: "));
+	event->append(type);
+	event->append("\ndata: ");
+	event->append(data.dump());
+	event->append("\n\n");
+	m_Events.Push(std::move(event));
+	m_Reactor.Notify();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the server thread
+
+void CStatusServer::Thread(void)
+{
+	CTimer heartbeat;
+	while (m_Running)
+	{
+		// requests in progress and subscribers that are behind are looked at often
+		bool busy = false;
+		for (const auto &item : m_Connections)
+		{
+			if (! item.second.subscriber || ! item.second.out.empty())
+			{
+				busy = true;
+				break;
+			}
+		}
+
+		const auto fd = m_Reactor.Wait(busy ? 100 : 1000);
+		if (fd == m_ListenFd)
+			Accept();
+		else if (fd >= 0)
+		{
+			auto it = m_Connections.find(fd);
+			if (m_Connections.end() != it)
+				Read(it->second);
+		}
+
+		// pass the events on
+		auto event = m_Events.Pop();
+		while (event)
+		{
+			Broadcast("id: " + std::to_string(++m_EventId) + "\n" + *event);
+			m_EventsSent.fetch_add(1, std::memory_order_relaxed);
+			event = m_Events.Pop();
+		}
+
+		// so proxies and browsers don't give up on a quiet stream
+		if (heartbeat.time() >= STATUS_HEARTBEAT)
+		{
+			Broadcast(": heartbeat\n\n");
+			heartbeat.start();
+		}
+
+		// write what's pending, and close what's finished, stuck or too far behind
+		for (auto it=m_Connections.begin(); it!=m_Connections.end(); )
+		{
+			auto &c = it->second;
+			bool done = Flush(c);
+			if (! done && ! c.subscriber && c.opened.time() > STATUS_REQUEST_TIMEOUT)
+				done = true;
+			if (done)
+			{
+				const int cfd = it->first;
+				if (c.subscriber)
+					m_Subscribers--;
+				it = m_Connections.erase(it);
+				CloseConnection(cfd);
+			}
+			else
+				it++;
+		}
+	}
+
+	for (auto &item : m_Connections)
+		CloseConnection(item.first);
+	m_Connections.clear();
+	m_Subscribers = 0;
+}
+
+void CStatusServer::Accept(void)
+{
+	while (true)
+	{
+		const int fd = accept4(m_ListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		if (m_Connections.size() >= STATUS_MAX_CONNECTIONS || ! m_Reactor.Add(fd))
+		{
+			close(fd);
+			continue;
+		}
+		auto &c = m_Connections[fd];
+		c.fd = fd;
+		c.subscriber = false;
+		c.done = false;
+		c.opened.start();
+	}
+}
+
+void CStatusServer::Read(SConnection &c)
+{
+	char buf[1024];
+	const auto len = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (len <= 0)
+	{
+		if (0 == len || (EAGAIN != errno && EWOULDBLOCK != errno))
+		{
+			// the other end is gone, or going
+			c.out.clear();
+			c.done = true;
+		}
+		return;
+	}
+
+	// a subscriber has nothing more to say, and a request is only answered once
+	if (c.subscriber || c.done)
+		return;
+
+	c.in.append(buf, len);
+	const auto end = c.in.find("\r\n\r\n");
+	if (std::string::npos != end)
+		Respond(c, c.in.substr(0, end + 2));
+	else if (c.in.size() > STATUS_MAX_REQUEST)
+	{
+		c.out = "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		c.done = true;
+	}
+}
+
+void CStatusServer::Respond(SConnection &c, const std::string &request)
+{
+	m_Requests.fetch_add(1, std::memory_order_relaxed);
+	c.done = true;
+
+	std::string method, path;
+	std::istringstream line(request.substr(0, request.find("\r\n")));
+	line >> method >> path;
+	path = path.substr(0, path.find('?'));
+
+	if ("GET" != method)
+	{
+		c.out = "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		return;
+	}
+
+	if ("/" == path || "/status" == path)
+	{
+		std::shared_ptr<const SSnapshot> snapshot;
+		{
+			std::lock_guard<std::mutex> lock(m_SnapshotMutex);
+			snapshot = m_Snapshot;
+		}
+		if (! snapshot)
+		{
+			c.out = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			return;
+		}
+
+		// header names are case insensitive
+		std::string headers(request);
+		std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+		const auto pos = headers.find("\r\nif-none-match:");
+		if (std::string::npos != pos)
+		{
+			const auto value = request.substr(pos + 16, request.find("\r\n", pos + 2) - pos - 16);
+			if (std::string::npos != value.find(snapshot->etag) || std::string::npos != value.find('*'))
+			{
+				m_NotModified.fetch_add(1, std::memory_order_relaxed);
+				c.out = "HTTP/1.1 304 Not Modified\r\nETag: " + snapshot->etag + "\r\nConnection: close\r\n\r\n";
+				return;
+			}
+		}
+
+		c.out = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(snapshot->body.size()) + "\r\nETag: " + snapshot->etag + "\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n";
+		c.out.append(snapshot->body);
+	}
+	else if ("/metrics" == path)
+	{
+		std::ostringstream body;
+		CMetrics::Write(body);
+		const auto text = body.str();
+		c.out = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(text.size()) + "\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n";
+		c.out.append(text);
+	}
+	else if ("/events" == path)
+	{
+		c.out = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: 2000\n\n";
+		c.subscriber = true;
+		c.done = false;
+		m_Subscribers++;
+	}
+	else
+		c.out = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+}
+
+// returns true when the connection is finished with
+bool CStatusServer::Flush(SConnection &c)
+{
+	while (! c.out.empty())
+	{
+		const auto len = send(c.fd, c.out.data(), c.out.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (len < 0)
+		{
+			if (EAGAIN == errno || EWOULDBLOCK == errno)
+				break;
+			return true;
+		}
+		c.out.erase(0, len);
+	}
+
+	// a subscriber that can't keep up is cut loose, it can reconnect and fetch /status
+	if (c.subscriber && c.out.size() > STATUS_MAX_BACKLOG)
+	{
+		m_Dropped.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return c.done && c.out.empty();
+}
+
+void CStatusServer::Broadcast(const std::string &text)
+{
+	for (auto &item : m_Connections)
+	{
+		if (item.second.subscriber)
+			item.second.out.append(text);
+	}
+}
+
+void CStatusServer::CloseConnection(int fd)
+{
+	m_Reactor.Remove(fd);
+	close(fd);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// report
+
+void CStatusServer::JsonReport(nlohmann::json &report) const
+{
+	report["StatusServer"]["Subscribers"] = m_Subscribers.load(std::memory_order_relaxed);
+	report["StatusServer"]["Requests"] = m_Requests.load(std::memory_order_relaxed);
+	report["StatusServer"]["NotModified"] = m_NotModified.load(std::memory_order_relaxed);
+	report["StatusServer"]["Events"] = m_EventsSent.load(std::memory_order_relaxed);
+	report["StatusServer"]["SubscribersDropped"] = m_Dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,120 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+#include "Timer.h"
+#include "Reactor.h"
+#include "RingQueue.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define STATUS_MAX_CONNECTIONS  32
+#define STATUS_MAX_REQUEST      4096    // bytes, for the request line and headers
+#define STATUS_MAX_BACKLOG      65536   // bytes an event subscriber can fall behind before it's dropped
+#define STATUS_REQUEST_TIMEOUT  5       // seconds to send a complete request
+#define STATUS_HEARTBEAT        15      // seconds between comments to idle subscribers
+#define STATUS_EVENT_QUEUE      256
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// A small HTTP server on the loopback interface, for the dashboard.
+// GET /status returns the latest json report, as serialized by the report thread,
+// with an ETag so an unchanged report costs a 304 and nothing else.
+// GET /events is a server-sent event stream of stream open and close, last heard,
+// and link and unlink events, as they happen. GET /metrics is every CMetrics series
+// in the Prometheus text format, for a scraper on the same host. Events are posted from any thread
+// to a queue, and only the server's own thread ever touches a socket.
+
+class CStatusServer
+{
+public:
+	// constructor
+	CStatusServer();
+
+	// destructor
+	~CStatusServer();
+
+	// start & stop, Start() returns true on failure
+	bool Start(uint16_t port);
+	void Stop(void);
+	bool IsRunning(void) const                      { return m_Running; }
+
+	// the report thread, a freshly serialized json report
+	void SetSnapshot(std::string &&json);
+
+	// any thread, sent to every event subscriber
+	void Event(const char *type, const nlohmann::json &data);
+
+	// report
+	void JsonReport(nlohmann::json &report) const;
+
+protected:
+	struct SSnapshot
+	{
+		std::string body, etag;
+	};
+
+	struct SConnection
+	{
+		int         fd;
+		std::string in, out;
+		bool        subscriber;
+		bool        done;	// close once out has been sent
+		CTimer      opened;
+	};
+
+	// the server thread
+	void Thread(void);
+	void Accept(void);
+	void Read(SConnection &);
+	void Respond(SConnection &, const std::string &);
+	bool Flush(SConnection &);
+	void Broadcast(const std::string &);
+	void CloseConnection(int fd);
+
+	// data
+	int               m_ListenFd;
+	CReactor          m_Reactor;
+	std::atomic<bool> m_Running;
+	std::future<void> m_Future;
+	std::unordered_map<int, SConnection> m_Connections;
+
+	// the latest report, swapped in whole
+	mutable std::mutex m_SnapshotMutex;
+	std::shared_ptr<const SSnapshot> m_Snapshot;
+	uint64_t          m_Generation;
+	const time_t      m_Boot;	// keeps ETags from one run apart from the next
+
+	// events on their way to the server thread
+	CRingQueue<std::unique_ptr<std::string>> m_Events;
+	std::atomic<unsigned> m_Subscribers;
+	uint64_t          m_EventId;
+
+	// statistics
+	std::atomic<uint64_t> m_Requests, m_NotModified, m_EventsSent, m_Dropped;
+};
@@ -38,3 +38,48 @@ using STCPacket = struct tcpacket_tag {
 	uint8_t p25[11];
 	int16_t usrp[160];
 };
+
+/************************************************************
+ * Version 2 of the transcoder link.
+ *
+ * Instead of a whole STCPacket, each datagram is a header
+ * followed by only the codecs that are needed: towards the
+ * transcoder, just the input codec, and back, just the codecs
+ * the reflector asked for. PCM is only asked for when somebody
+ * on the module can use it. Multi-byte fields are big-endian.
+ *
+ * The reflector sends a hello with the versions it speaks, and
+ * keeps to version 1 (a raw STCPacket) until the transcoder
+ * acknowledges version 2.
+ *
+ * hello and hello_ack:  header, module
+ * frame:                header, sequence(4), streamid(2), module,
+ *                       flags, codec_in, codecs, wanted, then the
+ *                       payload of each codec in codecs, in bit order
+\************************************************************/
+
+#define TC_MAGIC            0x5443u     // "TC"
+#define TC_VERSION          2u
+#define TC_HEADER_SIZE      6u
+#define TC_FRAME_SIZE       (TC_HEADER_SIZE + 11u)  // without any payload
+#define TC_MAX_PACKET       512u
+
+enum class ETCPacketType : std::uint8_t { hello = 1, hello_ack = 2, frame = 3 };
+
+// codec bits, for codecs and wanted
+#define TC_CODEC_DSTAR      0x01u       //   9 bytes
+#define TC_CODEC_DMR        0x02u       //   9 bytes
+#define TC_CODEC_M17        0x04u       //  16 bytes
+#define TC_CODEC_P25        0x08u       //  11 bytes
+#define TC_CODEC_USRP       0x10u       // 320 bytes, 160 big-endian samples
+#define TC_CODEC_DIGITAL    (TC_CODEC_DSTAR | TC_CODEC_DMR | TC_CODEC_M17 | TC_CODEC_P25)
+
+// frame flags
+#define TC_FLAG_LAST        0x01u
+
+using STCHeader = struct __attribute__((__packed__)) tcheader_tag {
+	uint16_t magic;
+	uint8_t version;
+	ETCPacketType type;
+	uint16_t length;    // of the whole datagram, header included
+};
@@ -19,6 +19,8 @@
 #include <ctime>
 #include <chrono>
 
+#include "Clock.h"
+
 class CTimer
 {
 public:
@@ -26,11 +28,11 @@ public:
 	~CTimer() {}
 	void start()
 	{
-		starttime = std::chrono::steady_clock::now();
+		starttime = CClock::Now();
 	}
 	double time() const
 	{
-		std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - starttime);
+		std::chrono::duration<double> elapsed(CClock::Now() - starttime);
 		return elapsed.count();
 	}
 private:
@@ -0,0 +1,200 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#include "TimerWheel.h"
+#include "Clock.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// timer
+
+CWheelTimer::~CWheelTimer()
+{
+	if (m_Wheel && IsArmed())
+		m_Wheel->Cancel(*this);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// constructor
+
+CTimerWheel::CTimerWheel() : m_Start(CClock::Now()), m_Tick(0), m_Armed(0)
+{
+	for (auto &level : m_Slots)
+	{
+		for (auto &head : level)
+		{
+			head.m_Prev = &head;
+			head.m_Next = &head;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// destructor
+
+CTimerWheel::~CTimerWheel()
+{
+	// disown whatever is still armed
+	for (auto &level : m_Slots)
+	{
+		for (auto &head : level)
+		{
+			while (head.m_Next != &head)
+			{
+				auto timer = head.m_Next;
+				Unlink(*timer);
+				timer->m_Wheel = nullptr;
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// arm & cancel
+
+void CTimerWheel::Arm(CWheelTimer &timer, unsigned ms, std::function<void(void)> callback)
+{
+	timer.m_Callback = std::move(callback);
+	Arm(timer, ms);
+}
+
+void CTimerWheel::Arm(CWheelTimer &timer, unsigned ms)
+{
+	if (timer.IsArmed())
+		Cancel(timer);
+
+	// never sooner than asked for
+	auto expires = Now() + (ms + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+	timer.m_Expires = (expires < m_Tick) ? m_Tick : expires;
+	timer.m_Wheel = this;
+	Insert(timer);
+	m_Armed++;
+}
+
+void CTimerWheel::Cancel(CWheelTimer &timer)
+{
+	if (! timer.IsArmed())
+		return;
+	Unlink(timer);
+	m_Armed--;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// run
+
+void CTimerWheel::Advance(void)
+{
+	const auto now = Now();
+	while (m_Tick <= now)
+	{
+		// each time a level wraps, the next one up hands down a slot
+		auto index = unsigned(m_Tick & WHEEL_MASK);
+		for (unsigned level=1; 0==index && level<WHEEL_LEVELS; level++)
+		{
+			index = unsigned(m_Tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+			Cascade(level, index);
+		}
+
+		// take the due timers out first, so callbacks can arm and cancel as they please
+		auto &slot = m_Slots[0][m_Tick & WHEEL_MASK];
+		m_Tick++;
+		if (slot.m_Next == &slot)
+			continue;
+		CWheelTimer due;
+		due.m_Prev = slot.m_Prev;
+		due.m_Next = slot.m_Next;
+		due.m_Prev->m_Next = &due;
+		due.m_Next->m_Prev = &due;
+		slot.m_Prev = slot.m_Next = &slot;
+
+		while (due.m_Next != &due)
+		{
+			auto timer = due.m_Next;
+			Unlink(*timer);
+			m_Armed--;
+			// the callback can destroy its timer
+			auto callback = timer->m_Callback;
+			if (callback)
+				callback();
+		}
+		due.m_Prev = due.m_Next = nullptr;
+	}
+}
+
+int CTimerWheel::TimeToNext(int max_ms) const
+{
+	if (0 == m_Armed)
+		return max_ms;
+
+	// the first busy slot, or the next cascade, which could bring down more
+	auto tick = m_Tick;
+	while ((tick & WHEEL_MASK) && m_Slots[0][tick & WHEEL_MASK].m_Next == &m_Slots[0][tick & WHEEL_MASK])
+		tick++;
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(CClock::Now() - m_Start).count();
+	const auto left = int64_t(tick * WHEEL_TICK_MS) - elapsed;
+	return (left < 0) ? 0 : ((left < max_ms) ? int(left) : max_ms);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+
+uint64_t CTimerWheel::Now(void) const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(CClock::Now() - m_Start).count() / WHEEL_TICK_MS;
+}
+
+void CTimerWheel::Insert(CWheelTimer &timer)
+{
+	// the level is picked by how far away it is, the slot by when it's due
+	auto delta = timer.m_Expires - m_Tick;
+	unsigned level = 0;
+	while (level < WHEEL_LEVELS - 1 && delta >= (uint64_t(1) << (WHEEL_BITS * (level + 1))))
+		level++;
+	if (delta >= (uint64_t(1) << (WHEEL_BITS * WHEEL_LEVELS)))
+	{
+		// as far as the wheel goes
+		delta = (uint64_t(1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+		timer.m_Expires = m_Tick + delta;
+	}
+	Link(m_Slots[level][(timer.m_Expires >> (WHEEL_BITS * level)) & WHEEL_MASK], timer);
+}
+
+void CTimerWheel::Cascade(unsigned level, unsigned index)
+{
+	auto &slot = m_Slots[level][index];
+	while (slot.m_Next != &slot)
+	{
+		auto timer = slot.m_Next;
+		Unlink(*timer);
+		Insert(*timer);
+	}
+}
+
+void CTimerWheel::Link(CWheelTimer &head, CWheelTimer &timer)
+{
+	timer.m_Prev = head.m_Prev;
+	timer.m_Next = &head;
+	head.m_Prev->m_Next = &timer;
+	head.m_Prev = &timer;
+}
+
+void CTimerWheel::Unlink(CWheelTimer &timer)
+{
+	timer.m_Prev->m_Next = timer.m_Next;
+	timer.m_Next->m_Prev = timer.m_Prev;
+	timer.m_Prev = timer.m_Next = nullptr;
+}
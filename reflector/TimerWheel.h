@@ -0,0 +1,102 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <functional>
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define WHEEL_TICK_MS       10      // resolution
+#define WHEEL_BITS          6       // 64 slots a level
+#define WHEEL_LEVELS        4       // 640 ms, 41 s, 44 min and 47 hours
+
+#define WHEEL_SLOTS         (1u << WHEEL_BITS)
+#define WHEEL_MASK          (WHEEL_SLOTS - 1)
+
+////////////////////////////////////////////////////////////////////////////////////////
+// classes
+
+class CTimerWheel;
+
+// A timer is linked into its wheel, so it can't be copied or moved.
+// Destroying an armed timer cancels it.
+class CWheelTimer
+{
+public:
+	CWheelTimer() : m_Prev(nullptr), m_Next(nullptr), m_Expires(0), m_Wheel(nullptr) {}
+	~CWheelTimer();
+	CWheelTimer(const CWheelTimer &) = delete;
+	CWheelTimer &operator=(const CWheelTimer &) = delete;
+
+	bool IsArmed(void) const { return nullptr != m_Next; }
+
+protected:
+	friend class CTimerWheel;
+	CWheelTimer *m_Prev, *m_Next;
+	uint64_t     m_Expires;     // in ticks
+	CTimerWheel *m_Wheel;
+	std::function<void(void)> m_Callback;
+};
+
+// A hierarchical timing wheel: arming and cancelling a timer is O(1), and a
+// timer far in the future is only looked at each time the level below wraps.
+// It isn't thread safe, it belongs to the thread that calls Advance(), and a
+// callback can arm, cancel or destroy any timer, including its own.
+
+class CTimerWheel
+{
+public:
+	// constructor
+	CTimerWheel();
+
+	// destructor
+	~CTimerWheel();
+
+	// (re)arm a timer to go off in ms milliseconds, without a callback it keeps the one it has
+	void Arm(CWheelTimer &timer, unsigned ms, std::function<void(void)> callback);
+	void Arm(CWheelTimer &timer, unsigned ms);
+	void Cancel(CWheelTimer &timer);
+
+	// run the callback of every timer that is due
+	void Advance(void);
+
+	// how long, in ms, until a timer could be due, no longer than max_ms
+	int TimeToNext(int max_ms) const;
+
+	// get
+	size_t GetArmed(void) const { return m_Armed; }
+
+protected:
+	uint64_t Now(void) const;
+	void Insert(CWheelTimer &timer);
+	void Cascade(unsigned level, unsigned index);
+
+	// the slots are circular lists, a slot's head is a timer that is never armed
+	static void Link(CWheelTimer &head, CWheelTimer &timer);
+	static void Unlink(CWheelTimer &timer);
+
+	// data
+	const std::chrono::steady_clock::time_point m_Start;
+	uint64_t    m_Tick;         // the next tick to run
+	size_t      m_Armed;
+	CWheelTimer m_Slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
@@ -0,0 +1,168 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+#include "TranscoderPool.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// initialization
+
+bool CTranscoderPool::Init(const std::string &names)
+{
+	std::string list(names);
+	std::replace(list.begin(), list.end(), ',', ' ');
+	std::istringstream iss(list);
+	std::string name;
+	while (iss >> name)
+	{
+		if (name.size() > 100)
+		{
+			std::cerr << "Transcoder socket name '" << name << "' is too long" << std::endl;
+			return true;
+		}
+		SEndpoint ep;
+		ep.name.assign(name);
+		ep.streams = ep.misses = 0;
+		ep.down = false;
+		ep.answered = ep.missed = ep.failovers = ep.totalus = 0;
+		m_Endpoints.push_back(ep);
+	}
+	if (m_Endpoints.empty())
+	{
+		std::cerr << "No transcoder socket names" << std::endl;
+		return true;
+	}
+	if (m_Endpoints.size() > 1)
+	{
+		std::cout << "Transcoder pool:";
+		for (const auto &ep : m_Endpoints)
+			std::cout << ' ' << ep.name;
+		std::cout << std::endl;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// assignment
+
+int CTranscoderPool::Pick(int current, bool busy)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (busy && current >= 0 && m_Endpoints[current].streams)
+		m_Endpoints[current].streams--;
+
+	// the least loaded of the healthy ones, the current one wins a tie
+	int best = -1;
+	for (int i=0; i<int(m_Endpoints.size()); i++)
+	{
+		auto &ep = m_Endpoints[i];
+		if (! Healthy(ep))
+			continue;
+		if (best < 0 || ep.streams < m_Endpoints[best].streams || (ep.streams == m_Endpoints[best].streams && i == current))
+			best = i;
+	}
+	if (best >= 0)
+	{
+		m_Endpoints[best].streams++;
+		if (busy && current >= 0 && best != current)
+			m_Endpoints[best].failovers++;
+	}
+	return best;
+}
+
+void CTranscoderPool::Release(int i)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Endpoints[i].streams)
+		m_Endpoints[i].streams--;
+}
+
+bool CTranscoderPool::IsHealthy(int i)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return Healthy(m_Endpoints[i]);
+}
+
+// once the hold time is up, a transcoder gets another chance
+bool CTranscoderPool::Healthy(SEndpoint &ep)
+{
+	if (ep.down && ep.downtime.time() >= TC_POOL_HOLD)
+	{
+		std::cout << "Trying transcoder " << ep.name << " again" << std::endl;
+		ep.down = false;
+		ep.misses = 0;
+	}
+	return ! ep.down;
+}
+
+void CTranscoderPool::TakeOut(SEndpoint &ep, const char *why)
+{
+	if (ep.down)
+		return;
+	std::cout << "Transcoder " << ep.name << " " << why << ", taking it out of the pool for " << TC_POOL_HOLD << " seconds" << std::endl;
+	ep.down = true;
+	ep.downtime.start();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// health
+
+void CTranscoderPool::Answered(int i, uint64_t us)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto &ep = m_Endpoints[i];
+	ep.answered++;
+	ep.totalus += us;
+	ep.misses = 0;
+}
+
+void CTranscoderPool::Missed(int i)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto &ep = m_Endpoints[i];
+	ep.missed++;
+	if (++ep.misses >= TC_POOL_MISSES)
+		TakeOut(ep, "isn't answering");
+}
+
+void CTranscoderPool::Failed(int i)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	TakeOut(m_Endpoints[i], "can't be reached");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// report
+
+void CTranscoderPool::JsonReport(nlohmann::json &report)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (auto &ep : m_Endpoints)
+	{
+		nlohmann::json jep;
+		jep["Name"] = ep.name;
+		jep["Healthy"] = Healthy(ep);
+		jep["Streams"] = ep.streams;
+		jep["Answered"] = ep.answered;
+		jep["Missed"] = ep.missed;
+		jep["Failovers"] = ep.failovers;
+		jep["AverageRTus"] = ep.answered ? ep.totalus / ep.answered : 0;
+		report["TranscoderPool"].push_back(jep);
+	}
+}
@@ -0,0 +1,85 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+#include "Timer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define TC_POOL_MISSES      3       // frames in a row without an answer before a transcoder is taken out
+#define TC_POOL_HOLD        5.0     // seconds a transcoder stays out before it's tried again
+
+////////////////////////////////////////////////////////////////////////////////////////
+// class
+
+// The transcoder instances urfd can send to, each one listening on its own
+// unix socket. They all answer on the module's TC2URFMod<X> socket.
+// A stream is given the healthy instance with the fewest streams, and keeps
+// it until the stream closes or the instance stops answering, then it goes
+// to another one. If none is healthy, frames go out untranscoded.
+
+class CTranscoderPool
+{
+public:
+	// constructor
+	CTranscoderPool() {}
+
+	// the socket names, separated by spaces or commas, returns true on failure
+	bool Init(const std::string &names);
+
+	// get
+	size_t GetSize(void) const                  { return m_Endpoints.size(); }
+	const std::string &GetName(int i) const     { return m_Endpoints[i].name; }
+
+	// assignment, Pick() returns the endpoint for a stream, or -1 if none is healthy
+	// if current isn't -1, it's preferred, and if busy, its stream is given up first
+	int  Pick(int current, bool busy);
+	void Release(int i);
+	bool IsHealthy(int i);
+
+	// health, from the round trips
+	void Answered(int i, uint64_t us);
+	void Missed(int i);
+	void Failed(int i);
+
+	// report
+	void JsonReport(nlohmann::json &report);
+
+protected:
+	struct SEndpoint
+	{
+		std::string name;
+		unsigned streams, misses;
+		bool down;
+		CTimer downtime;
+		uint64_t answered, missed, failovers, totalus;
+	};
+
+	bool Healthy(SEndpoint &);
+	void TakeOut(SEndpoint &, const char *why);
+
+	// data
+	std::mutex m_Mutex;
+	std::vector<SEndpoint> m_Endpoints;
+};
@@ -0,0 +1,329 @@
+// urfd -- The universal reflector
+// Copyright © 2023 Thomas A. Early N7TAE
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// urftcpool -- checks that the transcoder pool moves a stream when its transcoder goes away.
+//
+// Two faketcd instances are started, each filling the codecs it makes with its
+// own byte, so every frame that comes back says who transcoded it. Two modules
+// talk through a codec engine the way the router would push to them, while the
+// instances are killed, restarted and hung. The 5 second hold is skipped with
+// CClock::Skip(). Each case prints what it saw, and the exit code is the number
+// of cases that failed.
+
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Global.h"
+#include "PacketStream.h"
+#include "CodecStream.h"
+#include "CodecEngine.h"
+#include "TranscoderPool.h"
+#include "DMRMMDVMClient.h"
+#include "Clock.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+// global objects, the codec stream brings in the rest of urfd
+
+SJsonKeys   g_Keys;
+CReflector  g_Reflector;
+CGateKeeper g_GateKeeper;
+CConfigure  g_Configure;
+CVersion    g_Version(3,1,0);   // as in Main.cpp
+CLookupDmr  g_LDid;
+CLookupNxdn g_LNid;
+CLookupYsf  g_LYtr;
+
+////////////////////////////////////////////////////////////////////////////////////////
+// define
+
+#define TEST_DEADLINE_MS    100     // a quicker TranscodeDeadline, so a hung transcoder is noticed sooner
+#define TEST_HANG_FRAMES    10      // what the restarted instance answers before it hangs
+#define TEST_WAIT_MS        2000    // for an instance to start, or the frames in flight to come back
+
+// the modules are at the end, out of the way of a urfd that might be running here
+#define TEST_MODULE_1       'Y'
+#define TEST_MODULE_2       'Z'
+
+enum class ESource { none, first, second };
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the transcoders
+
+struct STcd
+{
+	const char *name;
+	uint8_t fill;
+	pid_t pid;
+};
+
+// true once something is bound to the name
+static bool Listening(const char *name)
+{
+	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return false;
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path+1, name, sizeof(addr.sun_path)-2);
+	const bool rval = (0 == connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+	close(fd);
+	return rval;
+}
+
+// answers is how many frames it answers before it hangs, -1 for all of them, returns true on failure
+static bool Start(STcd &tcd, int answers = -1)
+{
+	const auto fill = std::to_string(tcd.fill);
+	const auto count = std::to_string(answers);
+	tcd.pid = fork();
+	if (tcd.pid < 0)
+	{
+		std::cerr << "fork() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	if (0 == tcd.pid)
+	{
+		execl("./faketcd", "faketcd", "-n", tcd.name, "-b", fill.c_str(), "-a", count.c_str(), nullptr);
+		std::cerr << "Could not run ./faketcd: " << strerror(errno) << std::endl;
+		_exit(127);
+	}
+	for (int ms=0; ms<TEST_WAIT_MS; ms+=10)
+	{
+		if (Listening(tcd.name))
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	std::cerr << "faketcd " << tcd.name << " didn't start" << std::endl;
+	return true;
+}
+
+static void Kill(STcd &tcd)
+{
+	if (tcd.pid <= 0)
+		return;
+	kill(tcd.pid, SIGKILL);
+	waitpid(tcd.pid, nullptr, 0);
+	tcd.pid = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// a module with somebody talking on it
+
+// the deadline is normally from the ini file
+class CTestCodecStream : public CCodecStream
+{
+public:
+	CTestCodecStream(CPacketStream *packetstream, char module) : CCodecStream(packetstream, module) {}
+
+	// returns true on failure
+	bool Init(CCodecEngine *engine)
+	{
+		// there's no ini file, so the deadline it looks for isn't there, that's only worth seeing if the rest fails
+		std::ostringstream errors;
+		auto saved = std::cerr.rdbuf(errors.rdbuf());
+		const bool rval = InitCodecStream(engine);
+		std::cerr.rdbuf(saved);
+		if (rval)
+			std::cerr << errors.str();
+		m_Deadline = TEST_DEADLINE_MS;
+		return rval;
+	}
+};
+
+class CTestModule
+{
+public:
+	CTestModule(char module, uint16_t sid) : m_Module(module), m_Sid(sid), m_Pid(0), m_PacketStream(module), m_CodecStream(&m_PacketStream, module) {}
+
+	bool Init(CCodecEngine *engine)
+	{
+		if (m_CodecStream.Init(engine))
+			return true;
+		// a DMR client listening, or the frames wouldn't need the transcoder
+		auto clients = g_Reflector.GetClients();
+		clients->AddClient(std::make_shared<CDmrmmdvmClient>(CCallsign(std::string("N0CALL")), CIp("127.0.0.1"), m_Module));
+		g_Reflector.ReleaseClients();
+		return false;
+	}
+
+	void Open(void) { m_CodecStream.ResetStats(m_Sid, ECodecType::dstar); }
+
+	// a DStar frame every 20 ms, the way the router pushes them
+	void Talk(unsigned frames)
+	{
+		const SDStarFrame dstar { { 0 }, { 0 } };
+		for (unsigned i=0; i<frames; i++)
+		{
+			auto frame = std::unique_ptr<CPacket>(new CDvFramePacket(&dstar, m_Sid, m_Pid));
+			m_Pid = (m_Pid + 1) % 21;
+			frame->SetPacketModule(m_Module);
+			m_CodecStream.Push(std::move(frame));
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	}
+
+	// everything that has come back since the last time, by who transcoded it
+	std::vector<ESource> Collect(const STcd &first, const STcd &second)
+	{
+		for (int ms=0; ms<TEST_WAIT_MS && ! m_CodecStream.IsIdle(); ms+=10)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		std::vector<ESource> out;
+		auto packet = m_PacketStream.Pop();
+		while (packet)
+		{
+			const auto dmr = ((CDvFramePacket *)packet.get())->GetCodecData(ECodecType::dmr);
+			auto is = [dmr](const STcd &tcd) { for (unsigned i=0; i<9; i++) if (dmr[i] != tcd.fill) return false; return true; };
+			out.push_back(is(first) ? ESource::first : (is(second) ? ESource::second : ESource::none));
+			packet = m_PacketStream.Pop();
+		}
+		return out;
+	}
+
+	const CCodecStream &GetCodecStream(void) const { return m_CodecStream; }
+
+private:
+	const char m_Module;
+	const uint16_t m_Sid;
+	uint8_t m_Pid;
+	CPacketStream m_PacketStream;	// only for the frames that come back
+	CTestCodecStream m_CodecStream;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+// the cases
+
+// the frames from first to last, by who transcoded them
+static unsigned Count(const std::vector<ESource> &out, ESource source, size_t first = 0, size_t last = SIZE_MAX)
+{
+	unsigned n = 0;
+	for (size_t i=first; i<out.size() && i<last; i++)
+		if (out[i] == source)
+			n++;
+	return n;
+}
+
+static std::string Show(const std::vector<ESource> &out)
+{
+	std::string s;
+	for (const auto source : out)
+		s.append(1, (ESource::first == source) ? '1' : ((ESource::second == source) ? '2' : '-'));
+	return s;
+}
+
+// returns true on failure
+static bool Check(const char *name, const std::string &what, bool ok)
+{
+	std::cout << name << ": " << what << (ok ? "  ok" : "  FAILED") << std::endl;
+	return ! ok;
+}
+
+static nlohmann::json Endpoint(CTranscoderPool &pool, int i)
+{
+	nlohmann::json report;
+	pool.JsonReport(report);
+	return report["TranscoderPool"][i];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// main
+
+int main()
+{
+	STcd tcd[2] = { { "URFTCcheck1", 0xA1u, -1 }, { "URFTCcheck2", 0xB2u, -1 } };
+	if (Start(tcd[0]) || Start(tcd[1]))
+	{
+		Kill(tcd[0]);
+		Kill(tcd[1]);
+		std::cout << "FAILED" << std::endl;
+		return 1;
+	}
+
+	CTranscoderPool pool;
+	pool.Init(std::string(tcd[0].name) + ' ' + tcd[1].name);
+	CCodecEngine engine(0, &pool);
+	CTestModule one(TEST_MODULE_1, 0x1111u), two(TEST_MODULE_2, 0x2222u);
+	if (one.Init(&engine) || two.Init(&engine) || engine.Start())
+	{
+		engine.Stop();
+		Kill(tcd[0]);
+		Kill(tcd[1]);
+		std::cout << "FAILED" << std::endl;
+		return 1;
+	}
+
+	int failed = 0;
+
+	// both are up, the stream gets one of them and keeps it
+	one.Open();
+	one.Talk(20);
+	auto out = one.Collect(tcd[0], tcd[1]);
+	const auto using1st = (Count(out, ESource::first) >= Count(out, ESource::second));
+	const int x = using1st ? 0 : 1, y = using1st ? 1 : 0;
+	const auto X = using1st ? ESource::first : ESource::second;
+	const auto Y = using1st ? ESource::second : ESource::first;
+	failed += Check("pick", Show(out), 20 == out.size() && 20 == Count(out, X));
+
+	// it's killed with frames in flight, the frames after that go to the other one,
+	// except for the one that found it gone
+	one.Talk(10);
+	Kill(tcd[x]);
+	one.Talk(20);
+	out = one.Collect(tcd[0], tcd[1]);
+	failed += Check("failover", Show(out), 30 == out.size() && 0 == Count(out, X, 10) && Count(out, Y, 10) >= 19);
+	auto ep = Endpoint(pool, x);
+	failed += Check("failover", std::string("killed one is out, healthy=") + ep["Healthy"].dump(), false == ep["Healthy"]);
+	ep = Endpoint(pool, y);
+	failed += Check("failover", std::string("other one took over, failovers=") + ep["Failovers"].dump(), 1u == ep["Failovers"]);
+
+	// back again, but it has to wait out the hold, then it's given the next stream, the one with the fewest,
+	// and once it hangs, that stream goes to the other one too
+	if (Start(tcd[x], TEST_HANG_FRAMES))
+		failed++;
+	const bool held = ! pool.IsHealthy(x);
+	CClock::Skip(uint64_t(TC_POOL_HOLD * 1.0e9) + 1000000ull);
+	failed += Check("return", std::string("held=") + (held ? "true" : "false") + ", after the hold=" + (pool.IsHealthy(x) ? "true" : "false"), held && pool.IsHealthy(x));
+	two.Open();
+	two.Talk(30);
+	out = two.Collect(tcd[0], tcd[1]);
+	failed += Check("return", Show(out), 30 == out.size() && TEST_HANG_FRAMES == Count(out, X, 0, TEST_HANG_FRAMES));
+	ep = Endpoint(pool, x);
+	failed += Check("hang", Show(out), TEST_HANG_FRAMES == Count(out, X) && 10 == Count(out, Y, 20));
+	failed += Check("hang", std::string("hung one is out, healthy=") + ep["Healthy"].dump() + ", missed=" + ep["Missed"].dump(), false == ep["Healthy"] && ep["Missed"].get<unsigned>() >= TC_POOL_MISSES);
+
+	// with neither one, frames still go out, untranscoded
+	Kill(tcd[y]);
+	one.Talk(10);
+	out = one.Collect(tcd[0], tcd[1]);
+	nlohmann::json report;
+	one.GetCodecStream().JsonReport(report);
+	failed += Check("passthrough", Show(out) + ", untranscoded=" + report["Transcoder"][0]["Untranscoded"].dump(), 10 == out.size() && 10 == Count(out, ESource::none) && report["Transcoder"][0]["Untranscoded"].get<unsigned>() >= 10);
+
+	engine.Stop();
+	Kill(tcd[0]);
+	Kill(tcd[1]);
+	std::cout << (failed ? "FAILED" : "passed") << std::endl;
+	return failed;
+}
@@ -17,14 +17,46 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <string.h>
+#include <time.h>
+#include <algorithm>
 
 #include "UDPSocket.h"
 
+// one recvmmsg() worth of datagrams, handed out one at a time by ReceiveBatch()
+struct SUdpBatch
+{
+	uint8_t data[UDP_BATCH_MAX][UDP_BUFFER_LENMAX];
+	struct iovec iov[UDP_BATCH_MAX];
+	struct mmsghdr msgs[UDP_BATCH_MAX];
+	CIp ips[UDP_BATCH_MAX];
+	uint8_t control[UDP_BATCH_MAX][CMSG_SPACE(sizeof(struct timespec))];
+	uint64_t rxtime[UDP_BATCH_MAX];
+	unsigned int count, next;
+};
+
+// where a replay's datagrams go, by family
+static CIp s_Sink4, s_Sink6;
+
+static const CIp &To(const CIp &ip)
+{
+	if (AF_INET == ip.GetFamily() && s_Sink4.IsSet())
+		return s_Sink4;
+	if (AF_INET6 == ip.GetFamily() && s_Sink6.IsSet())
+		return s_Sink6;
+	return ip;
+}
+
+static uint64_t ClockNs(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // constructor
 
-CUdpSocket::CUdpSocket() : m_fd(-1) {}
+CUdpSocket::CUdpSocket() : m_fd(-1), m_KernelTimestamps(false), m_RxTime(0), m_RxCalls(0), m_RxDatagrams(0), m_TxCalls(0), m_TxDatagrams(0), m_RxBytes(0), m_TxBytes(0), m_TxErrors(0) {}
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // destructor
@@ -86,16 +118,28 @@ bool CUdpSocket::Open(const CIp &Ip)
 			Close();
 			return false;
 		}
+		m_addr.SetPort(a.GetPort());
 		if (a != m_addr)
 			std::cout << "getsockname didn't return the same address as set: returned " << a << ", should have been " << m_addr << std::endl;
-
-		m_addr.SetPort(a.GetPort());
 	}
 
 	// done
 	return true;
 }
 
+// returns true on error
+bool CUdpSocket::EnableKernelTimestamps(void)
+{
+	int on = 1;
+	if (0 > m_fd || 0 > setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(int)))
+	{
+		std::cerr << "Cannot enable kernel timestamps on " << m_addr << ", " << strerror(errno) << std::endl;
+		return true;
+	}
+	m_KernelTimestamps = true;
+	return false;
+}
+
 void CUdpSocket::Close(void)
 {
 	if ( m_fd >= 0 )
@@ -103,6 +147,8 @@ void CUdpSocket::Close(void)
 		close(m_fd);
 		m_fd = -1;
 	}
+	if (m_Batch)
+		m_Batch->count = m_Batch->next = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -143,6 +189,89 @@ bool CUdpSocket::ReceiveFrom(CBuffer &Buffer, CIp &ip)
 		return false;
 
 	Buffer.Set(buf, iRecvLen);
+	m_RxTime = ClockNs(CLOCK_MONOTONIC);
+	m_RxCalls++;
+	m_RxDatagrams++;
+	m_RxBytes += iRecvLen;
+
+	return true;
+}
+
+bool CUdpSocket::HasBatched(void) const
+{
+	return m_Batch && (m_Batch->next < m_Batch->count);
+}
+
+bool CUdpSocket::ReceiveBatch(CBuffer &Buffer, CIp &ip)
+{
+	if ( 0 > m_fd )
+		return false;
+
+	if (! HasBatched())
+	{
+		if (! m_Batch)
+			m_Batch.reset(new SUdpBatch);
+
+		auto b = m_Batch.get();
+		for (unsigned int i=0; i<UDP_BATCH_MAX; i++)
+		{
+			b->iov[i].iov_base = b->data[i];
+			b->iov[i].iov_len = UDP_BUFFER_LENMAX;
+			memset(&b->msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+			b->msgs[i].msg_hdr.msg_name = b->ips[i].GetPointer();
+			b->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+			b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+			b->msgs[i].msg_hdr.msg_iovlen = 1;
+			if (m_KernelTimestamps)
+			{
+				b->msgs[i].msg_hdr.msg_control = b->control[i];
+				b->msgs[i].msg_hdr.msg_controllen = sizeof(b->control[i]);
+			}
+		}
+
+		auto n = recvmmsg(m_fd, b->msgs, UDP_BATCH_MAX, MSG_DONTWAIT, nullptr);
+		if (0 >= n)
+		{
+			b->count = b->next = 0;
+			return false;
+		}
+		b->count = n;
+		b->next = 0;
+
+		// the kernel stamps are CLOCK_REALTIME, moved here onto the monotonic clock
+		const auto now = ClockNs(CLOCK_MONOTONIC);
+		const auto offset = m_KernelTimestamps ? ClockNs(CLOCK_REALTIME) - now : 0;
+		for (int i=0; i<n; i++)
+		{
+			b->rxtime[i] = now;
+			if (! m_KernelTimestamps)
+				continue;
+			for (auto cmsg=CMSG_FIRSTHDR(&b->msgs[i].msg_hdr); cmsg; cmsg=CMSG_NXTHDR(&b->msgs[i].msg_hdr, cmsg))
+			{
+				if (SOL_SOCKET == cmsg->cmsg_level && SCM_TIMESTAMPNS == cmsg->cmsg_type)
+				{
+					struct timespec ts;
+					memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+					const auto kernel = uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec - offset;
+					if (kernel < now)
+						b->rxtime[i] = kernel;
+				}
+			}
+		}
+
+		m_RxCalls++;
+		m_RxDatagrams += n;
+		uint64_t bytes = 0;
+		for (int i=0; i<n; i++)
+			bytes += b->msgs[i].msg_len;
+		m_RxBytes += bytes;
+	}
+
+	auto b = m_Batch.get();
+	const auto i = b->next++;
+	Buffer.Set(b->data[i], b->msgs[i].msg_len);
+	ip = b->ips[i];
+	m_RxTime = b->rxtime[i];
 
 	return true;
 }
@@ -152,29 +281,105 @@ bool CUdpSocket::ReceiveFrom(CBuffer &Buffer, CIp &ip)
 
 void CUdpSocket::Send(const CBuffer &Buffer, const CIp &Ip) const
 {
-	sendto(m_fd, Buffer.data(), Buffer.size(), 0, Ip.GetCPointer(), Ip.GetSize());
+	const auto &to = To(Ip);
+	Sent(sendto(m_fd, Buffer.data(), Buffer.size(), 0, to.GetCPointer(), to.GetSize()));
 }
 
 void CUdpSocket::Send(const char *Buffer, const CIp &Ip) const
 {
-	sendto(m_fd, Buffer, ::strlen(Buffer), 0, Ip.GetCPointer(), Ip.GetSize());
+	const auto &to = To(Ip);
+	Sent(sendto(m_fd, Buffer, ::strlen(Buffer), 0, to.GetCPointer(), to.GetSize()));
 }
 
 void CUdpSocket::Send(const CBuffer &Buffer, const CIp &Ip, uint16_t destport) const
 {
 	CIp temp(Ip);
 	temp.SetPort(destport);
-	sendto(m_fd, Buffer.data(), Buffer.size(), 0, temp.GetCPointer(), temp.GetSize());
+	const auto &to = To(temp);
+	Sent(sendto(m_fd, Buffer.data(), Buffer.size(), 0, to.GetCPointer(), to.GetSize()));
 }
 
 void CUdpSocket::Send(const char *Buffer, const CIp &Ip, uint16_t destport) const
 {
 	CIp temp(Ip);
 	temp.SetPort(destport);
-	sendto(m_fd, Buffer, ::strlen(Buffer), 0, temp.GetCPointer(), temp.GetSize());
+	const auto &to = To(temp);
+	Sent(sendto(m_fd, Buffer, ::strlen(Buffer), 0, to.GetCPointer(), to.GetSize()));
 }
 
 void CUdpSocket::Send(const uint8_t *data, size_t size, const CIp &Ip) const
 {
-	sendto(m_fd, data, size, 0, Ip.GetCPointer(), Ip.GetSize());
+	const auto &to = To(Ip);
+	Sent(sendto(m_fd, data, size, 0, to.GetCPointer(), to.GetSize()));
+}
+
+void CUdpSocket::Send(const CBuffer &Buffer, const std::vector<CIp> &Ips) const
+{
+	Send(Buffer.data(), Buffer.size(), Ips);
+}
+
+void CUdpSocket::Send(const uint8_t *data, size_t size, const std::vector<CIp> &Ips, size_t stride) const
+{
+	struct iovec iov[UDP_BATCH_MAX];
+	struct mmsghdr msgs[UDP_BATCH_MAX];
+
+	size_t done = 0;
+	while (done < Ips.size())
+	{
+		const auto count = std::min(Ips.size() - done, size_t(UDP_BATCH_MAX));
+		for (size_t i=0; i<count; i++)
+		{
+			iov[i].iov_base = (void *)(data + (done + i) * stride);
+			iov[i].iov_len = size;
+			memset(&msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+			const auto &to = To(Ips[done + i]);
+			msgs[i].msg_hdr.msg_name = (void *)to.GetCPointer();
+			msgs[i].msg_hdr.msg_namelen = to.GetSize();
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		auto n = sendmmsg(m_fd, msgs, count, 0);
+		m_TxCalls++;
+		if (n > 0)
+		{
+			m_TxDatagrams += n;
+			m_TxBytes += n * size;
+		}
+		else
+			m_TxErrors++;
+		// like sendto(), a failed destination is dropped and the rest still go out
+		done += (n > 0) ? n : 1;
+	}
+}
+
+void CUdpSocket::Sent(ssize_t rval) const
+{
+	m_TxCalls++;
+	if (rval < 0)
+		m_TxErrors++;
+	else
+	{
+		m_TxDatagrams++;
+		m_TxBytes += rval;
+	}
+}
+
+void CUdpSocket::SetSink(const CIp &sink)
+{
+	if (AF_INET == sink.GetFamily())
+		s_Sink4 = sink;
+	else
+		s_Sink6 = sink;
+}
+
+void CUdpSocket::GetStats(SUdpStats &stats) const
+{
+	stats.rxcalls = m_RxCalls;
+	stats.rxdatagrams = m_RxDatagrams;
+	stats.txcalls = m_TxCalls;
+	stats.txdatagrams = m_TxDatagrams;
+	stats.rxbytes = m_RxBytes;
+	stats.txbytes = m_TxBytes;
+	stats.txerrors = m_TxErrors;
 }
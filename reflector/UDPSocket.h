@@ -19,6 +19,9 @@
 #pragma once
 
 #include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -30,6 +33,17 @@
 #include "Buffer.h"
 
 #define UDP_BUFFER_LENMAX       1024
+#define UDP_BATCH_MAX           32      // datagrams per recvmmsg()/sendmmsg() call
+
+// syscall and datagram counts, a datagrams/calls ratio above 1 is the batching at work
+struct SUdpStats
+{
+	uint64_t rxcalls, rxdatagrams, txcalls, txdatagrams;
+	uint64_t rxbytes, txbytes, txerrors;
+};
+
+// storage for one recvmmsg() batch
+struct SUdpBatch;
 
 class CUdpSocket
 {
@@ -43,7 +57,7 @@ public:
 	// open & close
 	bool Open(const CIp &Ip);
 	void Close(void);
-	int  GetSocket(void)
+	int  GetSocket(void) const
 	{
 		return m_fd;
 	}
@@ -51,6 +65,14 @@ public:
 	// read
 	bool Receive(CBuffer &, CIp &, int);
 	bool ReceiveFrom(CBuffer &buf, CIp &ip);
+	// batched read, returns the next datagram of the batch and refills an empty batch with one recvmmsg()
+	// the socket isn't readable while a batch is pending, so check HasBatched() before waiting on it
+	bool ReceiveBatch(CBuffer &buf, CIp &ip);
+	bool HasBatched(void) const;
+	// when the last datagram handed out was received, in CLOCK_MONOTONIC ns
+	uint64_t GetRxTime(void) const { return m_RxTime; }
+	// take the receive time from the kernel's SO_TIMESTAMPNS, call it after Open()
+	bool EnableKernelTimestamps(void);
 
 	// write
 	void Send(const CBuffer &, const CIp &) const;
@@ -58,9 +80,29 @@ public:
 	void Send(const CBuffer &, const CIp &, uint16_t) const;
 	void Send(const char    *, const CIp &, uint16_t) const;
 	void Send(const u_int8_t *, size_t size, const CIp &) const;
+	// batched write with sendmmsg(), one payload to every destination
+	// or, with a stride, payload i starts at data + i * stride
+	void Send(const CBuffer &, const std::vector<CIp> &) const;
+	void Send(const uint8_t *, size_t size, const std::vector<CIp> &, size_t stride = 0) const;
+
+	// stats
+	void GetStats(SUdpStats &stats) const;
+
+	// a replay sends everything to a sink of the same family instead, the captured clients hear nothing
+	static void SetSink(const CIp &sink);
 
 protected:
+	// count one sendto()
+	void Sent(ssize_t rval) const;
+
 	// data
 	int m_fd;
 	CIp m_addr;
+	std::unique_ptr<SUdpBatch> m_Batch;
+	bool     m_KernelTimestamps;
+	uint64_t m_RxTime;
+
+	// stats
+	mutable std::atomic<uint64_t> m_RxCalls, m_RxDatagrams, m_TxCalls, m_TxDatagrams;
+	mutable std::atomic<uint64_t> m_RxBytes, m_TxBytes, m_TxErrors;
 };
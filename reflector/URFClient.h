@@ -42,7 +42,7 @@ public:
 	bool IsAlive(void) const;
 
 	// reporting
-	void WriteXml(std::ofstream &) {}
+	void WriteXml(std::ostream &) {}
 
 protected:
 	// data
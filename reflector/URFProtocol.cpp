@@ -29,13 +29,14 @@
 
 bool CURFProtocol::Initialize(const char *type, const EProtocol ptype, const uint16_t port, const bool has_ipv4, const bool has_ipv6)
 {
+
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = URF_KEEPALIVE_PERIOD;
+	m_PeerLinksPeriod = URF_RECONNECT_PERIOD;
+
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-	m_LastPeersLinkTime.start();
-
 	// done
 	return true;
 }
@@ -162,37 +163,15 @@ void CURFProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 			std::string title("Unknown URF packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep alive
-	if ( m_LastKeepaliveTime.time() > URF_KEEPALIVE_PERIOD )
-	{
-		// handle keep alives
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
-
-	// peer connections
-	if ( m_LastPeersLinkTime.time() > URF_RECONNECT_PERIOD )
-	{
-		// handle remote peers connections
-		HandlePeerLinks();
-
-		// update time
-		m_LastPeersLinkTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -200,11 +179,10 @@ void CURFProtocol::Task(void)
 
 void CURFProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// check if origin of packet is local
 		// if not, do not stream it out as it will cause
 		// network loop between linked URF peers
@@ -215,23 +193,22 @@ void CURFProtocol::HandleQueue(void)
 			if ( EncodeDvPacket(*packet, buffer) )
 			{
 				// and push it to all our clients linked to the module and who are not streaming in
-				CClients *clients = g_Reflector.GetClients();
-				auto it = clients->begin();
-				std::shared_ptr<CClient>client = nullptr;
-				while ( (client = clients->FindNextClient(EProtocol::urf, it)) != nullptr )
+				std::vector<CIp> ips;
+				for ( auto &client : GetSubscribers(EProtocol::urf, packet->GetPacketModule()) )
 				{
 					// is this client busy ?
-					if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+					if ( !client->IsAMaster() )
 					{
-						// no, send the packet
+						// no, add it to the destinations
 						// this is protocol revision dependent
 						if (EProtoRev::original == client->GetProtocolRevision())
 						{
-							Send(buffer, client->GetIp());
+							ips.push_back(client->GetIp());
 						}
 					}
 				}
-				g_Reflector.ReleaseClients();
+				Send(buffer, ips);
+				TraceSent(*packet);
 			}
 		}
 	}
@@ -403,7 +380,7 @@ void CURFProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 			// get origin
 			peer = client->GetCallsign();
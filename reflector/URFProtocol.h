@@ -64,9 +64,4 @@ protected:
 	void EncodeConnectNackPacket(CBuffer *Buffer);
 	bool EncodeDvHeaderPacket(const CDvHeaderPacket &, CBuffer &) const;
 	bool EncodeDvFramePacket(const CDvFramePacket &, CBuffer &) const;
-
-protected:
-	// time
-	CTimer m_LastKeepaliveTime;
-	CTimer m_LastPeersLinkTime;
 };
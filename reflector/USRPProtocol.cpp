@@ -42,6 +42,10 @@ bool CUSRPProtocol::Initialize(const char *type, const EProtocol ptype, const ui
 	std::ifstream file;
 	std::streampos size;
 
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = USRP_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class, create the listing port for the read-write client
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
@@ -108,9 +112,6 @@ bool CUSRPProtocol::Initialize(const char *type, const EProtocol ptype, const ui
 		}
 	}
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	// done
 	return true;
 }
@@ -143,8 +144,8 @@ void CUSRPProtocol::Task(void)
 		// crack the packet
 		if ( IsValidDvPacket(Ip, Buffer, Header, Frame) )
 		{
-			// push the packet
-			OnDvFramePacketIn(Frame, &Ip);
+			// push the packet, evenly spaced
+			PaceDvFramePacketIn(Frame, Ip);
 		}
 		else if( IsValidDvHeaderPacket(Ip, Buffer, Header) )
 		{
@@ -162,27 +163,18 @@ void CUSRPProtocol::Task(void)
 		else
 		{
 			// invalid packet
+			m_ParseFailures->Add();
 			std::string title("Unknown USRP packet from ");
 			title += Ip.GetAddress();
 			Buffer.Dump(title);
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
+	// frames whose time has come
+	HandlePacer();
 
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > USRP_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -218,7 +210,7 @@ void CUSRPProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -235,11 +227,10 @@ void CUSRPProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 
 void CUSRPProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto module = packet->GetPacketModule();
 		CBuffer buffer;
@@ -262,19 +253,18 @@ void CUSRPProtocol::HandleQueue(void)
 		if ( buffer.size() > 0 )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::usrp, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::usrp, module) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == module) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
-					Send(buffer, client->GetIp());
+					// no, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+			Send(buffer, ips);
+			TraceSent(*packet);
 		}
 	}
 }
@@ -383,28 +373,8 @@ void CUSRPProtocol::EncodeUSRPPacket(const CDvHeaderPacket &Header, const CDvFra
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CUSRPProtocol::HandleKeepalives(void)
+// the USRP clients are set up in the ini file, they never time out
+void CUSRPProtocol::HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &client)
 {
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::usrp, it)) != nullptr )
-	{
-		// is this client busy ?
-		//if ( client->IsAMaster() )
-		//{
-			// yes, just tickle it
-			client->Alive();
-		//}
-		// check it's still with us
-		//else if ( !client->IsAlive() )
-		//{
-			// no, remove it
-			//std::cout << "USRP client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			//clients->RemoveClient(client);
-		//}
-
-	}
-	g_Reflector.ReleaseClients();
+	client->Alive();
 }
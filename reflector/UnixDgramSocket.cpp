@@ -95,6 +95,14 @@ bool CUnixDgramReader::Read(STCPacket *pack) const
 	return true;
 }
 
+ssize_t CUnixDgramReader::Read(void *buf, size_t size) const
+{
+	auto len = recv(fd, buf, size, MSG_DONTWAIT);
+	if (len < 0 && EAGAIN != errno && EWOULDBLOCK != errno)
+		std::cerr << "Read error on transcoder socket: " << strerror(errno) << std::endl;
+	return len;
+}
+
 void CUnixDgramReader::Close()
 {
 	if (fd >= 0)
@@ -107,48 +115,111 @@ int CUnixDgramReader::GetFD() const
 	return fd;
 }
 
-CUnixDgramWriter::CUnixDgramWriter() {}
+CUnixDgramWriter::CUnixDgramWriter() : fd(-1), connected_once(false), is_down(false), sent(0), failed(0), reconnects(0) {}
 
-CUnixDgramWriter::~CUnixDgramWriter() {}
+CUnixDgramWriter::~CUnixDgramWriter()
+{
+	Close();
+}
 
 void CUnixDgramWriter::SetUp(const char *path)	// returns true on failure
 {
+	Close();
 	// setup the socket address
 	memset(&addr, 0, sizeof(addr));
 	addr.sun_family = AF_UNIX;
 	strncpy(addr.sun_path+1, path, sizeof(addr.sun_path)-2);
 }
 
-bool CUnixDgramWriter::Send(const STCPacket *pack) const
+bool CUnixDgramWriter::Send(const STCPacket *pack)
+{
+	return Send(pack, sizeof(STCPacket));
+}
+
+bool CUnixDgramWriter::Send(const void *buf, size_t size)
 {
-	auto len = Write(pack, sizeof(STCPacket));
+	auto len = Write(buf, size);
 
-	if (len != sizeof(STCPacket))
+	if (len != ssize_t(size))
+	{
+		failed++;
 		return true;
+	}
 
+	sent++;
 	return false;
 }
 
-ssize_t CUnixDgramWriter::Write(const void *buf, ssize_t size) const
+void CUnixDgramWriter::Close()
+{
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+}
+
+void CUnixDgramWriter::GetStats(SDgramStats &stats) const
 {
+	stats.sent = sent.load(std::memory_order_relaxed);
+	stats.failed = failed.load(std::memory_order_relaxed);
+	stats.reconnects = reconnects.load(std::memory_order_relaxed);
+}
+
+bool CUnixDgramWriter::Connect()	// returns true on failure
+{
+	// don't hammer a receiver that isn't there
+	if (is_down && retry.time() < DGRAM_RECONNECT_DELAY)
+		return true;
+	retry.start();
+
 	// open the socket
-	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
 	if (fd < 0)
 	{
 		std::cerr << "socket() failed for " << addr.sun_path+1 << ": " << strerror(errno) << std::endl;
-		return -1;
+		is_down = true;
+		return true;
 	}
 	// connect to the receiver
 	int rval = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
 	if (rval < 0)
 	{
-		std::cerr << "connect() failed for " << addr.sun_path+1 << ": " << strerror(errno) << std::endl;
+		// only report the first failure of an outage
+		if (! is_down)
+			std::cerr << "connect() failed for " << addr.sun_path+1 << ": " << strerror(errno) << std::endl;
 		close(fd);
-		return -1;
+		fd = -1;
+		is_down = true;
+		return true;
 	}
 
-	auto written = write(fd, buf, size);
-	if (written != size) {
+	if (connected_once)
+	{
+		reconnects++;
+		std::cout << "Reconnected to " << addr.sun_path+1 << std::endl;
+	}
+	connected_once = true;
+	is_down = false;
+	return false;
+}
+
+ssize_t CUnixDgramWriter::Write(const void *buf, ssize_t size)
+{
+	// a connection to a reader that has since been restarted fails once, then we connect again
+	for (int attempt=0; attempt<2; attempt++)
+	{
+		if (fd < 0 && Connect())
+			return -1;
+
+		auto written = write(fd, buf, size);
+		if (written == size)
+			return written;
+
+		if (written < 0 && (ECONNREFUSED == errno || ENOTCONN == errno || ECONNRESET == errno))
+		{
+			Close();
+			continue;
+		}
+
 		std::cerr << "write on " << addr.sun_path+1;
 		if (written < 0)
 			std::cerr << " returned error: " << strerror(errno) << std::endl;
@@ -156,8 +227,7 @@ ssize_t CUnixDgramWriter::Write(const void *buf, ssize_t size) const
 			std::cerr << " returned zero" << std::endl;
 		else
 			std::cerr << " only wrote " << written << " bytes, should be " << size << std::endl;
+		return written;
 	}
-
-	close(fd);
-	return written;
+	return -1;
 }
@@ -18,9 +18,20 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
 #include <sys/un.h>
 
 #include "TCPacketDef.h"
+#include "Timer.h"
+
+// how long a writer waits before trying to connect again, in seconds
+#define DGRAM_RECONNECT_DELAY 1.0
+
+struct SDgramStats
+{
+	uint64_t sent, failed, reconnects;
+};
 
 class CUnixDgramReader
 {
@@ -29,6 +40,7 @@ public:
 	~CUnixDgramReader();
 	bool Open(const char *path);
 	bool Read(STCPacket *pack) const;
+	ssize_t Read(void *buf, size_t size) const;	// any size, doesn't block, returns the length or -1
 	bool Receive(STCPacket *pack, unsigned timeout) const;
 	void Close();
 	int GetFD() const;
@@ -36,15 +48,26 @@ private:
 	int fd;
 };
 
+// The writer stays connected to the reader. If the reader goes away, say the
+// transcoder is restarted, the next Send() connects again, and while nobody
+// is listening, a connection is only attempted once every DGRAM_RECONNECT_DELAY.
 class CUnixDgramWriter
 {
 public:
 	CUnixDgramWriter();
 	~CUnixDgramWriter();
 	void SetUp(const char *path);
-	bool Send(const STCPacket *pack) const;
+	bool Send(const STCPacket *pack);	// returns true on failure
+	bool Send(const void *buf, size_t size);
+	void Close();
+	void GetStats(SDgramStats &stats) const;
 private:
-	ssize_t Write(const void *buf, ssize_t size) const;
+	bool Connect();
+	ssize_t Write(const void *buf, ssize_t size);
 
 	struct sockaddr_un addr;
+	int fd;
+	bool connected_once, is_down;
+	CTimer retry;
+	std::atomic<uint64_t> sent, failed, reconnects;
 };
@@ -61,20 +61,20 @@ bool CUser::operator <(const CUser &user) const
 ////////////////////////////////////////////////////////////////////////////////////////
 // reporting
 
-void CUser::WriteXml(std::ofstream &xmlFile)
+void CUser::WriteXml(std::ostream &xmlFile)
 {
-	xmlFile << "<STATION>" << std::endl;
-	xmlFile << "\t<Callsign>" << m_My << "</Callsign>" << std::endl;
-	xmlFile << "\t<Via node>" << m_Rpt1 << "</Via node>" << std::endl;
-	xmlFile << "\t<On module>" << m_Rpt2.GetCSModule() << "</On module>" << std::endl;
-	xmlFile << "\t<Via peer>" << m_Xlx << "</Via peer>" << std::endl;
+	xmlFile << "<STATION>\n";
+	xmlFile << "\t<Callsign>" << m_My << "</Callsign>\n";
+	xmlFile << "\t<Via node>" << m_Rpt1 << "</Via node>\n";
+	xmlFile << "\t<On module>" << m_Rpt2.GetCSModule() << "</On module>\n";
+	xmlFile << "\t<Via peer>" << m_Xlx << "</Via peer>\n";
 
 	char mbstr[100];
 	if (std::strftime(mbstr, sizeof(mbstr), "%A %c", std::localtime(&m_LastHeardTime)))
 	{
-		xmlFile << "\t<LastHeardTime>" << mbstr << "</LastHeardTime>" << std::endl;
+		xmlFile << "\t<LastHeardTime>" << mbstr << "</LastHeardTime>\n";
 	}
-	xmlFile << "</STATION>" << std::endl;
+	xmlFile << "</STATION>\n";
 }
 
 void CUser::JsonReport(nlohmann::json &report)
@@ -49,7 +49,7 @@ public:
 	bool operator <(const CUser &) const;
 
 	// reporting
-	void WriteXml(std::ofstream &);
+	void WriteXml(std::ostream &);
 	void JsonReport(nlohmann::json &report);
 
 protected:
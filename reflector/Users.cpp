@@ -67,4 +67,9 @@ void CUsers::Hearing(const CCallsign &my, const CCallsign &rpt1, const CCallsign
 	}
 
 	AddUser(heard);
+
+	// and tell the status server's subscribers who it was
+	nlohmann::json event;
+	heard.JsonReport(event);
+	g_Reflector.PostEvent("heard", event["Users"][0]);
 }
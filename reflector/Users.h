@@ -22,6 +22,7 @@
 #include <mutex>
 
 #include "User.h"
+#include "CountedMutex.h"
 
 class CUsers
 {
@@ -33,8 +34,9 @@ public:
 	virtual ~CUsers() {}
 
 	// locks
-	void Lock(void)                     { m_Mutex.lock(); }
-	void Unlock(void)                   { m_Mutex.unlock(); }
+	void Lock(void)                     { m_Mutex.Lock(); }
+	void Unlock(void)                   { m_Mutex.Unlock(); }
+	void GetLockStats(SLockStats &stats) const { m_Mutex.GetStats(stats); }
 
 	// management
 	int    GetSize(void) const          { return (int)m_Users.size(); }
@@ -52,6 +54,6 @@ public:
 
 protected:
 	// data
-	std::mutex        m_Mutex;
+	CCountedMutex     m_Mutex;
 	std::list<CUser>  m_Users;
 };
@@ -71,3 +71,32 @@ void CUtils::bitsToByteLE(const bool* bits, unsigned char& byte)
 	byte |= bits[6U] ? 0x40U : 0x00U;
 	byte |= bits[7U] ? 0x80U : 0x00U;
 }
+
+uint32_t CUtils::readBitsBE(const unsigned char* in, unsigned int pos, unsigned int n)
+{
+	assert(in != nullptr);
+	assert(n > 0U && n <= 25U);
+
+	// the bytes it's in, at most four
+	const unsigned int first = pos >> 3, shift = pos & 7U, bytes = (shift + n + 7U) >> 3;
+	uint32_t w = 0U;
+	for (unsigned int i = 0U; i < 4U; i++)
+		w = (w << 8) | ((i < bytes) ? in[first + i] : 0U);
+
+	return (w << shift) >> (32U - n);
+}
+
+void CUtils::writeBitsBE(unsigned char* out, unsigned int pos, unsigned int n, uint32_t bits)
+{
+	assert(out != nullptr);
+	assert(n > 0U && n <= 25U);
+
+	const unsigned int first = pos >> 3, shift = 32U - (pos & 7U) - n, bytes = ((pos & 7U) + n + 7U) >> 3;
+	const uint32_t mask = ((1U << n) - 1U) << shift;
+	bits = (bits << shift) & mask;
+	for (unsigned int i = 0U; i < bytes; i++)
+	{
+		const unsigned int s = 24U - 8U * i;
+		out[first + i] = (out[first + i] & ~(mask >> s)) | (bits >> s);
+	}
+}
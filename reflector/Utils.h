@@ -15,10 +15,20 @@
 #define	Utils_H
 
 #include <string>
+#include <cstdint>
 
 class CUtils
 {
 public:
+	// packed bits
+	static unsigned popcount(uint32_t w)  { return unsigned(__builtin_popcount(w)); }
+	static unsigned parity(uint32_t w)    { return unsigned(__builtin_parity(w)); }
+	static unsigned lowestBit(uint32_t w) { return unsigned(__builtin_ctz(w)); }   // w can't be 0
+
+	// 1 to 25 bits from a byte array, starting at bit pos, most significant bit first
+	static uint32_t readBitsBE(const unsigned char* in, unsigned int pos, unsigned int n);
+	static void writeBitsBE(unsigned char* out, unsigned int pos, unsigned int n, uint32_t bits);
+
 	static void byteToBitsBE(unsigned char byte, bool* bits);
 	static void byteToBitsLE(unsigned char byte, bool* bits);
 
@@ -48,6 +48,10 @@ bool CYsfProtocol::Initialize(const char *type, const EProtocol ptype, const uin
 	m_RegistrationName.resize(REG_NAME_SIZE, ' ');
 	m_RegistrationDesc.resize(REG_DESC_SIZE, ' ');
 
+	// timers, armed when the thread starts
+	m_KeepalivePeriod = YSF_KEEPALIVE_PERIOD;
+	m_ClientKeepalives = true;
+
 	// base class
 	if (! CProtocol::Initialize(type, ptype, port, has_ipv4, has_ipv6))
 		return false;
@@ -56,9 +60,6 @@ bool CYsfProtocol::Initialize(const char *type, const EProtocol ptype, const uin
 	if (! m_WiresxCmdHandler.Init())
 		return false;
 
-	// update time
-	m_LastKeepaliveTime.start();
-
 	return true;
 }
 
@@ -224,6 +225,7 @@ void CYsfProtocol::Task(void)
 		}
 		else
 		{
+			m_ParseFailures->Add();
 #ifdef DEBUG
 			std::string title("Unknown YSF packet from ");
 			title += Ip.GetAddress();
@@ -232,21 +234,8 @@ void CYsfProtocol::Task(void)
 		}
 	}
 
-	// handle end of streaming timeout
-	CheckStreamsTimeout();
-
 	// handle queue from reflector
 	HandleQueue();
-
-	// keep client alive
-	if ( m_LastKeepaliveTime.time() > YSF_KEEPALIVE_PERIOD )
-	{
-		//
-		HandleKeepalives();
-
-		// update time
-		m_LastKeepaliveTime.start();
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -284,7 +273,7 @@ void CYsfProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 			if ( (stream = g_Reflector.OpenStream(Header, client)) != nullptr )
 			{
 				// keep the handle
-				m_Streams[stream->GetStreamId()] = stream;
+				AddStream(stream);
 			}
 		}
 		// release
@@ -304,11 +293,10 @@ void CYsfProtocol::OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &Header,
 
 void CYsfProtocol::HandleQueue(void)
 {
-	while (! m_Queue.IsEmpty())
+	// get the packets
+	std::unique_ptr<CPacket> packet;
+	while ( (packet = m_Queue.Pop()) != nullptr )
 	{
-		// get the packet
-		auto packet = m_Queue.Pop();
-
 		// get our sender's id
 		const auto mod = packet->GetPacketModule();
 
@@ -352,20 +340,18 @@ void CYsfProtocol::HandleQueue(void)
 		if ( buffer.size() > 0 )
 		{
 			// and push it to all our clients linked to the module and who are not streaming in
-			CClients *clients = g_Reflector.GetClients();
-			auto it = clients->begin();
-			std::shared_ptr<CClient>client = nullptr;
-			while ( (client = clients->FindNextClient(EProtocol::ysf, it)) != nullptr )
+			std::vector<CIp> ips;
+			for ( auto &client : GetSubscribers(EProtocol::ysf, packet->GetPacketModule()) )
 			{
 				// is this client busy ?
-				if ( !client->IsAMaster() && (client->GetReflectorModule() == packet->GetPacketModule()) )
+				if ( !client->IsAMaster() )
 				{
-					// no, send the packet
-					Send(buffer, client->GetIp());
-
+					// no, add it to the destinations
+					ips.push_back(client->GetIp());
 				}
 			}
-			g_Reflector.ReleaseClients();
+			Send(buffer, ips);
+			TraceSent(*packet);
 		}
 	}
 }
@@ -373,34 +359,25 @@ void CYsfProtocol::HandleQueue(void)
 ////////////////////////////////////////////////////////////////////////////////////////
 // keepalive helpers
 
-void CYsfProtocol::HandleKeepalives(void)
+void CYsfProtocol::HandleClientKeepalive(CClients *clients, std::shared_ptr<CClient> &client)
 {
 	// YSF protocol keepalive request is client tasks
 	// here, just check that all clients are still alive
 	// and disconnect them if not
 
-	// iterate on clients
-	CClients *clients = g_Reflector.GetClients();
-	auto it = clients->begin();
-	std::shared_ptr<CClient>client = nullptr;
-	while ( (client = clients->FindNextClient(EProtocol::ysf, it)) != nullptr )
+	// is this client busy ?
+	if ( client->IsAMaster() )
 	{
-		// is this client busy ?
-		if ( client->IsAMaster() )
-		{
-			// yes, just tickle it
-			client->Alive();
-		}
-		// check it's still with us
-		else if ( !client->IsAlive() )
-		{
-			// no, remove it
-			std::cout << "YSF client " << client->GetCallsign() << " keepalive timeout" << std::endl;
-			clients->RemoveClient(client);
-		}
-
+		// yes, just tickle it
+		client->Alive();
+	}
+	// check it's still with us
+	else if ( !client->IsAlive() )
+	{
+		// no, remove it
+		std::cout << "YSF client " << client->GetCallsign() << " keepalive timeout" << std::endl;
+		clients->RemoveClient(client);
 	}
-	g_Reflector.ReleaseClients();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -76,7 +76,7 @@ protected:
 	void HandleQueue(void);
 
 	// keepalive helpers
-	void HandleKeepalives(void);
+	void HandleClientKeepalive(CClients *, std::shared_ptr<CClient> &);
 
 	// stream helpers
 	void OnDvHeaderPacketIn(std::unique_ptr<CDvHeaderPacket> &, const CIp &);
@@ -120,9 +120,6 @@ protected:
 	bool DebugDumpLastDvPacket(const CBuffer &);
 
 protected:
-	// for keep alive
-	CTimer m_LastKeepaliveTime;
-
 	// for queue header caches
 	std::unordered_map<char, CYsfStreamCacheItem> m_StreamsCache;
 
@@ -0,0 +1,3 @@
+BINDIR=/tmp
+debug=false
+DHT=false